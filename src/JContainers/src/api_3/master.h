@@ -14,8 +14,11 @@ namespace tes_api_3 {
 #include "api_3/tes_object.h"
 #include "api_3/tes_atomic.h"
 #include "api_3/tes_array.h"
+#include "api_3/tes_typed_array.h"
+#include "api_3/tes_set.h"
 #include "api_3/tes_map.h"
 #include "api_3/tes_db.h"
+#include "api_3/tes_data_pack.h"
 #include "api_3/tes_jcontainers.h"
 #include "api_3/tes_string.h"
 #include "api_3/tes_form_db.h"
@@ -5,8 +5,10 @@
 #include <errno.h>
 
 #include <sstream>
+#include <fstream>
 #include <set>
 #include <thread>
+#include <future>
 #include <array>
 
 #include <boost/filesystem.hpp>
@@ -16,6 +18,8 @@
 
 #include "gtest.h"
 #include "util/util.h"
+#include "util/lz4.h"
+#include "util/record_stream.h"
 #include "jcontainers_constants.h"
 
 #include "skse/string.h"
@@ -28,6 +32,9 @@
 #include "collections/collections.h"
 
 #include "collections/json_serialization.h"
+#include "collections/flat_serialization.h"
+#include "collections/persistence_profile.h"
+#include "collections/data_pack.h"
 #include "collections/copying.h"
 #include "collections/access.h"
 
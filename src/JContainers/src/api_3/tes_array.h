@@ -1,6 +1,7 @@
 #pragma once
 
 #include "collections/functions.h"
+#include "collections/item_sort.h"
 
 namespace tes_api_3 {
 
@@ -98,7 +99,8 @@ objectWithBooleans converts booleans into integers");
             }
 
             auto obj = &array::objectWithInitializer([&](array &me) {
-                me._array.insert(me.begin(), source->begin() + startIndex, source->begin() + endIndex);
+                const auto& values = static_cast<const array&>(*source).u_container();
+                me._array.insert(me.begin(), values.begin() + startIndex, values.begin() + endIndex);
             },
                 ctx);
 
@@ -117,7 +119,8 @@ objectWithBooleans converts booleans into integers");
             object_lock g2(another);
 
             doWriteOp(obj, insertAtIndex, [&obj, &another](uint32_t whereTo) {
-                obj->_array.insert(obj->begin() + whereTo, another->begin(), another->end());
+                const auto& values = static_cast<const array&>(*another).u_container();
+                obj->_array.insert(obj->begin() + whereTo, values.begin(), values.end());
             });
         }
         REGISTERF2(addFromArray, "* source insertAtIndex=-1",
@@ -206,11 +209,11 @@ NEGATIVE_IDX_COMMENT);
 
             doReadOp(obj, pySearchStartIndex, [=, &result](uint32_t idx) {
                 if (pySearchStartIndex >= 0) {
-                    auto itr = std::find(obj->begin() + idx, obj->end(), item(value));
-                    result = itr != obj->end() ? (itr - obj->begin()) : -1;
+                    result = obj->u_find(item(value), idx);
                 } else {
-                    auto itr = std::find(obj->rbegin() + (-pySearchStartIndex - 1), obj->rend(), item(value));
-                    result = itr != obj->rend() ? (obj->rend() - itr) : -1;
+                    // backward search has always returned the found index + 1
+                    auto found = obj->u_find(item(value), idx, true);
+                    result = found != -1 ? (found + 1) : -1;
                 }
             });
 
@@ -235,8 +238,7 @@ NEGATIVE_IDX_COMMENT);
             if (obj) 
             {
                 object_lock g (obj);
-                auto n = std::count (obj->u_container ().begin (), obj->u_container ().end (), item (value));
-                result = static_cast<SInt32> (n);
+                result = static_cast<SInt32> (obj->u_count_value (item (value)));
             }
             return result;
         }
@@ -252,7 +254,7 @@ NEGATIVE_IDX_COMMENT);
             JC_LOG_API ("%p, %d, ...", (void*) obj, index);
 
             doReadOp(obj, index, [=](uint32_t idx) {
-                obj->_array[idx] = item(val);
+                obj->u_set(idx, item(val));
             });
         }
         REGISTERF(replaceItemAtIndex<SInt32>, "setInt", "* index value", "Replaces existing value at the @index of the array with the new @value.\n"
@@ -268,7 +270,11 @@ NEGATIVE_IDX_COMMENT);
             JC_LOG_API ("%p, ..., %d", (void*) obj, addToIndex);
 
             doWriteOp(obj, addToIndex, [&](uint32_t idx) {
-                (void)obj->_array.emplace(obj->begin() + idx, val);
+                if (idx == obj->_array.size()) {
+                    obj->u_push(item(val));
+                } else {
+                    (void)obj->u_container().emplace(obj->begin() + idx, val);
+                }
             });
         }
         REGISTERF(addItemAt<SInt32>, "addInt", "* value addToIndex=-1", "Appends the @value/@container to the end of the array.\n\
@@ -295,7 +301,7 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
             JC_LOG_API ("%p, %d", (void*) obj, index);
 
             doReadOp(obj, index, [=](uint32_t idx) {
-                obj->_array.erase(obj->begin() + idx);
+                obj->u_erase(idx);
             });
         }
         REGISTERF2(eraseIndex, "* index", "Erases the item at the index. "NEGATIVE_IDX_COMMENT);
@@ -311,7 +317,7 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
             SInt32 pyIndexes[] { first, last };
             doReadOp(obj, pyIndexes, [=](const std::array<uint32_t, 2>& indices) {
                 if (indices[0] <= indices[1]) {
-                    obj->_array.erase(obj->begin() + indices[0], obj->begin() + indices[1] + 1);
+                    obj->u_container().erase(obj->begin() + indices[0], obj->begin() + indices[1] + 1);
                 }
             });
         }
@@ -327,6 +333,9 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
             if (obj) 
             {
                 object_lock g (obj);
+                if (obj->u_value_index_enabled () && obj->u_count_value (item (value)) == 0) {
+                    return 0; // the index is kept intact
+                }
                 auto new_end = std::remove (obj->u_container ().begin (), obj->u_container ().end (), item (value));
                 result = static_cast<SInt32> (std::distance (new_end, obj->u_container ().end ()));
                 obj->u_container ().erase (new_end, obj->u_container ().end ());
@@ -339,6 +348,45 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
         REGISTERF (erase_item<object_base*>, "eraseObject", "* container", "");
         REGISTERF (erase_item<form_ref>, "eraseForm", "* value", "");
 
+        static void enableValueIndex(tes_context& ctx, ref obj, bool enable = true)
+        {
+            JC_LOG_API ("%p, %d", (void*) obj, enable);
+
+            if (obj) {
+                object_lock g (obj);
+                obj->u_enable_value_index (enable);
+            }
+        }
+        REGISTERF2 (enableValueIndex, "* enable=true",
+"Enables (or disables) the index of the array values. The index speeds up find*, count* and erase* (by value) functions\n\
+on large arrays at the cost of extra memory (see valueIndexMemoryUsage). It is built on first search, adding new values\n\
+to the end of the array or replacing them keeps it up to date, any other modification causes it to be rebuilt on next search.\n\
+The setting is saved with the array");
+
+        static bool isValueIndexEnabled(tes_context& ctx, ref obj)
+        {
+            JC_LOG_API ("%p", (void*) obj);
+
+            if (obj) {
+                object_lock g (obj);
+                return obj->u_value_index_enabled ();
+            }
+            return false;
+        }
+        REGISTERF2 (isValueIndexEnabled, "*", nullptr);
+
+        static SInt32 valueIndexMemoryUsage(tes_context& ctx, ref obj)
+        {
+            JC_LOG_API ("%p", (void*) obj);
+
+            if (obj) {
+                object_lock g (obj);
+                return static_cast<SInt32> (obj->u_value_index_memory_usage ());
+            }
+            return 0;
+        }
+        REGISTERF2 (valueIndexMemoryUsage, "*", "Returns approximate amount of memory (in bytes) occupied by the index of the array values");
+
         static SInt32 valueType(tes_context& ctx, ref obj, SInt32 index)
         {
             JC_LOG_API ("%p, %d", (void*) obj, index);
@@ -372,19 +420,63 @@ If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
 
             if (obj) {
                 object_lock g(obj);
-                std::sort(obj->u_container().begin(), obj->u_container().end());
+                item_sort::sort(obj->u_container());
             }
             return obj;
         }
         REGISTERF2(sort, "*", "Sorts the items into ascending order (none < int < float < form < object < string). Returns the array itself");
 
+        static ref sortBy(tes_context& ctx, ref obj, const char* path)
+        {
+            JC_LOG_API ("%p, \"%s\"", (void*) obj, path ? path : "<nullptr>");
+
+            if (!obj || !path) {
+                return obj;
+            }
+
+            // have to copy array to resolve the paths without the array being locked.
+            // The sorted copy replaces the items only if they haven't been modified meanwhile, else it starts over
+            while (true) {
+                array::container_type values;
+                uint32_t modifications = 0;
+                {
+                    object_lock g(obj);
+                    values = static_cast<const array&>(*obj).u_container();
+                    modifications = obj->u_modification_count();
+                }
+
+                std::vector<item> keys(values.size());
+                for (size_t i = 0; i < values.size(); ++i) {
+                    if (auto child = values[i].object()) {
+                        path_resolving::resolve(ctx, child, path, [&keys, i](item* itm) {
+                            if (itm) {
+                                keys[i] = *itm;
+                            }
+                        });
+                    }
+                }
+
+                item_sort::apply_order(values, item_sort::sorted_order(keys));
+
+                object_lock g(obj);
+                if (obj->u_modification_count() == modifications) {
+                    obj->u_container() = std::move(values);
+                    return obj;
+                }
+            }
+        }
+        REGISTERF2(sortBy, "* path",
+"Sorts the containers of the array by the values found at the @path of each container, in the same order the sort function does.\n\
+Items without such path (and non-container items) come first. Items with equal values keep their relative order. Returns the array itself.\n\
+For ex. sortBy(array, \".level\") sorts [{\"level\": 3}, {\"level\": 1}] into [{\"level\": 1}, {\"level\": 3}]");
+
         static ref unique(tes_context& ctx, ref obj)
         {
             JC_LOG_API ("%p", (void*) obj);
 
             if (obj) {
                 object_lock g(obj);
-                std::sort(obj->u_container().begin(), obj->u_container().end());
+                item_sort::sort(obj->u_container());
                 auto newEnd = std::unique(obj->u_container().begin(), obj->u_container().end());
                 obj->u_container().erase(newEnd, obj->u_container().end());
             }
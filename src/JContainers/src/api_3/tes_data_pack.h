@@ -0,0 +1,71 @@
+#include "collections/data_pack.h"
+
+namespace tes_api_3 {
+
+/// Redefine in each logging module
+#undef  JC_LOG_API_SOURCE
+#define JC_LOG_API_SOURCE "JDataPack"
+
+    using namespace collections;
+
+    class tes_data_pack : public class_meta<tes_data_pack> {
+    public:
+
+        REGISTER_TES_NAME("JDataPack");
+
+        void additionalSetup() {
+            metaInfo.comment =
+"Read-only data packs - large static datasets (recipes, loot tables), memory-mapped right from the file\n\
+instead of being read into containers. A pack is built from JSON file by tools/pack_data.py,\n\
+opened on first use and shared by all the calls, until unloaded or until a game gets loaded.\n\
+Values are read from the mapped file as is; a container is created only when requested with solveObj,\n\
+as a new copy the caller owns and may modify - the pack itself never changes";
+        }
+
+        template<class T>
+        static T solveGetter(tes_context& ctx, const char *packPath, const char *path, T t = default_value<T>())
+        {
+            JC_LOG_API ("\"%s\", \"%s\"", packPath ? packPath : "", path ? path : "");
+
+            auto pack = data_packs::of(ctx).get(packPath);
+            auto value = pack ? pack->find(path) : std::nullopt;
+            return value ? pack->to_item(*value, ctx).readAs<T>() : t;
+        }
+        REGISTERF(solveGetter<Float32>, "solveFlt", "packPath path default=0.0",
+"Returns the value at @path of the pack at @packPath (a path relative to Skyrim's folder), or @default.\n\
+The path syntax is the same as JValue.solve* have, except for operators: JDataPack.solveInt(\"Data/recipes.jcpack\", \".iron.weight\")");
+        REGISTERF(solveGetter<SInt32>, "solveInt", "packPath path default=0", nullptr);
+        REGISTERF(solveGetter<skse::string_ref>, "solveStr", "packPath path default=\"\"", nullptr);
+        REGISTERF(solveGetter<form_ref>, "solveForm", "packPath path default=None", nullptr);
+        REGISTERF(solveGetter<object_base*>, "solveObj", "packPath path default=0",
+            "Creates a new container with a copy of the pack's container at @path");
+
+        static bool hasPath(tes_context& ctx, const char *packPath, const char *path)
+        {
+            JC_LOG_API ("\"%s\", \"%s\"", packPath ? packPath : "", path ? path : "");
+
+            auto pack = data_packs::of(ctx).get(packPath);
+            return pack && pack->find(path).has_value();
+        }
+        REGISTERF2(hasPath, "packPath path", "Returns true, if the pack can be opened and has a value at @path");
+
+        static SInt32 count(tes_context& ctx, const char *packPath, const char *path)
+        {
+            JC_LOG_API ("\"%s\", \"%s\"", packPath ? packPath : "", path ? path : "");
+
+            auto pack = data_packs::of(ctx).get(packPath);
+            auto value = pack ? pack->find(path) : std::nullopt;
+            return value ? pack->count(*value) : 0;
+        }
+        REGISTERF2(count, "packPath path=\"\"", "Returns the number of items in the pack's container at @path, without creating the container");
+
+        static bool unload(tes_context& ctx, const char *packPath)
+        {
+            JC_LOG_API ("\"%s\"", packPath ? packPath : "");
+            return data_packs::of(ctx).unload(packPath);
+        }
+        REGISTERF2(unload, "packPath", "Unmaps the pack. Returns false if it wasn't opened");
+    };
+
+    TES_META_INFO(tes_data_pack);
+}
@@ -97,6 +97,13 @@ for ex. JDB.setObj(\"frostfall\", frostFallInformation) will associate 'frostall
         }
         REGISTERF2(writeToFile, "path", "writes storage data into JSON file at given path");
 
+        static SInt32 writeToDirectory(tes_context& ctx, const char * path) {
+            JC_LOG_API ("%s", path ? path : "");
+            return tes_object::writeToDirectory(ctx, &ctx.root(), path);
+        }
+        REGISTERF2(writeToDirectory, "path", "writes each JDB's container into its own JSON file in the directory at given path,\n"
+            "rewriting only the files of the containers that have changed since the last write. See JValue.writeToDirectory");
+
         static object_base* root(tes_context& ctx) {
             JC_LOG_API ("");
             return &ctx.root();
@@ -128,6 +128,22 @@ namespace tes_api_3 {
         }
         REGISTERF_STATELESS(_userDirectory, "userDirectory", "", "A path to user-specific directory - " JC_USER_FILES);
 
+        static object_base* persistenceProfile(tes_context& ctx)
+        {
+            JC_LOG_API ("");
+            json_t *profiles = persistence_profile::last_to_json();
+            object_base *obj = json_deserializer::object_from_json(ctx, profiles);
+            json_decref(profiles);
+            return obj;
+        }
+        REGISTERF2(persistenceProfile, nullptr,
+            "Returns JMap {\"save\": profile, \"load\": profile} - the profiles of the last save and load, the same as\n"
+            JC_PLUGIN_NAME "_profile.json next to the SKSE log. A profile has the time of each phase, the objects and the bytes\n"
+            "of each container type and of each domain:\n"
+            "    {\"wallMs\", \"storedBytes\", \"payloadBytes\", \"phasesMs\": {phase: ms},\n"
+            "     \"types\": {\"JMap\": {\"objects\", \"bytes\", \"ms\"}, ...}, \"domains\": [{\"name\", \"objects\", \"bytes\", \"ms\", \"encoded\"}]}\n"
+            "The phase times are summed over the threads. A profile is None until the first save or load");
+
         REGISTER_TEXT([]() {
             const char fmt[] = R"===(
 ; Returns true if JContainers plugin installed properly
@@ -31,7 +31,7 @@ namespace tes_api_3 {
         template<class T>
         static T getItem(tes_context& ctx, ref obj, key_cref key, T def = default_value<T>()) {
             JC_LOG_API ("%p, ..., ...", (void*) obj);
-            map_functions::doReadOp(obj, key, [&](item& itm) { def = itm.readAs<T>(); });
+            map_functions::doReadOp(obj, key, [&](const item& itm) { def = itm.readAs<T>(); });
             return def;
         }
         REGISTERF(getItem<SInt32>, "getInt", "object key default=0", "Returns the value associated with the @key. If not, returns @default value");
@@ -60,7 +60,7 @@ namespace tes_api_3 {
         static SInt32 valueType(tes_context& ctx, ref obj, key_cref key) {
             JC_LOG_API ("%p, ...", (void*) obj);
             auto type = item_type::no_item;
-            map_functions::doReadOp(obj, key, [&](item& itm) { type = itm.type(); });
+            map_functions::doReadOp(obj, key, [&](const item& itm) { type = itm.type(); });
             return (SInt32)type;
         }
         REGISTERF2(valueType, "* key", "Returns type of the value associated with the @key.\n"VALUE_TYPE_COMMENT);
@@ -77,7 +77,7 @@ namespace tes_api_3 {
                 object_lock g(obj);
 
                 arr._array.reserve(obj->u_count());
-                for each(auto& pair in obj->u_container()) {
+                for each(auto& pair in static_cast<const Cnt&>(*obj).u_container()) {
                     arr.u_container().emplace_back(pair.first);
                 }
             },
@@ -96,7 +96,8 @@ namespace tes_api_3 {
             VMResultArray<tes_key> keys;
             object_lock l(obj);
             keys.reserve(obj->u_count());
-            std::transform(obj->u_container().begin(), obj->u_container().end(),
+            const auto& pairs = static_cast<const Cnt&>(*obj).u_container();
+            std::transform(pairs.begin(), pairs.end(),
                 std::back_inserter(keys),
                 [&ctx](const typename map_type::value_type& p) {
                     return reflection::binding::get_converter<typename map_type::key_type>::convert2Tes(p.first);
@@ -119,7 +120,7 @@ namespace tes_api_3 {
                 object_lock g(obj);
 
                 arr._array.reserve(obj->u_count());
-                for each(auto& pair in obj->u_container()) {
+                for each(auto& pair in static_cast<const Cnt&>(*obj).u_container()) {
                     arr._array.push_back(pair.second);
                 }
             },
@@ -173,13 +174,15 @@ namespace tes_api_3 {
             object_lock g(obj);
             object_lock c(source);
 
+            const auto& pairs = static_cast<const Cnt&>(*source).u_container();
             if (overrideDuplicates) {
-                for (const auto& pair : source->u_container()) {
-                    obj->u_container()[pair.first] = pair.second;
+                auto& container = obj->u_container();
+                for (const auto& pair : pairs) {
+                    container[pair.first] = pair.second;
                 }
             }
             else {
-                obj->u_container().insert(source->u_container().begin(), source->u_container().end());
+                obj->u_container().insert(pairs.begin(), pairs.end());
             }
         }
         REGISTERF2(addPairs, "* source overrideDuplicates", "Inserts key-value pairs from the source container");
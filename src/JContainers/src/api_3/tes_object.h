@@ -1,5 +1,8 @@
 
 #include "collections/lua_module.h"
+#include "object/object_staging_arena.h"
+#include "collections/json_file_requests.h"
+#include "util/base64.h"
 
 namespace tes_api_3 {
 
@@ -31,7 +34,7 @@ namespace tes_api_3 {
         REGISTER_TES_NAME("JValue");
 
         void additionalSetup() {
-            metaInfo.comment = "Common functionality, shared by JArray, JMap, JFormMap, JIntMap";
+            metaInfo.comment = "Common functionality, shared by JArray, JMap, JFormMap, JIntMap, JIntArray, JFltArray, JSet";
         }
 
         static void enable_api_log (tes_context& ctx, bool next) {
@@ -212,6 +215,9 @@ JValue.cleanPool(\"uniquePoolName\")"
         REGISTERF(isCast<map>, "isMap", "*", nullptr);
         REGISTERF(isCast<form_map>, "isFormMap", "*", nullptr);
         REGISTERF(isCast<integer_map>, "isIntegerMap", "*", nullptr);
+        REGISTERF(isCast<int_array>, "isIntArray", "*", nullptr);
+        REGISTERF(isCast<float_array>, "isFltArray", "*", nullptr);
+        REGISTERF(isCast<set>, "isSet", "*", nullptr);
 
         static bool empty (tes_context& ctx, ref obj)
         {
@@ -246,47 +252,118 @@ JValue.cleanPool(\"uniquePoolName\")"
         }
         REGISTERF2(readFromFile, "filePath", "JSON serialization/deserialization:\n\nCreates and returns a new container object containing contents of JSON file");
 
-        static object_base* readFromDirectory(tes_context& context, const char *dirPath, const char *extension = "")
+        struct json_file {
+            boost::filesystem::path path;
+            std::string key;
+        };
+
+        static void collect_json_files(const boost::filesystem::path& dir, const boost::filesystem::path& relativeDir,
+            const char *extension, bool recursive, std::vector<json_file>& files)
         {
             using namespace boost;
 
-            JC_LOG_API ("\"%s\", \"%s\"", (dirPath ? dirPath : "<nullptr>"), (extension ? extension : "<nullptr>"));
+            for (filesystem::directory_iterator itr(dir), end_itr; itr != end_itr; ++itr) {
+                const auto& path = itr->path();
+                const auto relativePath = relativeDir / path.filename();
 
-            if (!dirPath)
-                return nullptr;
-
-            if (!extension)
-                extension = "";
+                if (recursive && filesystem::is_directory(path)) {
+                    collect_json_files(path, relativePath, extension, recursive, files);
+                }
+                else if (!*extension || path.extension().generic_string().compare(extension) == 0) {
+                    files.push_back({ path, recursive ? relativePath.generic_string() : path.filename().generic_string() });
+                }
+            }
+        }
 
-            map* files = nullptr;
-            try
-            {
-                filesystem::path root(dirPath);
+        // Parses the files concurrently. Each thread stages the objects it creates in own arena,
+        // the objects get registered in one batch once all files are parsed. The results are referenced:
+        // the commit leaves the objects, nothing else owns, to the autorelease queue
+        static map& read_json_files(tes_context& context, const std::vector<json_file>& files, size_t threadCount) {
+            std::vector<object_stack_ref> results(files.size());
+            std::vector<std::unique_ptr<object_staging_arena>> arenas;
+            std::atomic<size_t> nextFile{ 0 };
+
+            threadCount = (std::max)(size_t(1), (std::min)(threadCount, files.size()));
+            for (size_t i = 0; i < threadCount; ++i) {
+                arenas.emplace_back(new object_staging_arena(context));
+            }
 
-                files = &map::object(context);
+            auto parseFiles = [&](object_staging_arena& arena) {
+                object_staging_arena::scope scope(arena);
+                for (size_t idx = nextFile++; idx < files.size(); idx = nextFile++) {
+                    try {
+                        results[idx] = json_deserializer::object_from_file(context, files[idx].path);
+                    }
+                    catch (const std::exception& exc) {
+                        JC_LOG_ERROR("Can't read '%s': '%s'", files[idx].path.generic_string().c_str(), exc.what());
+                    }
+                }
+            };
 
-                for (filesystem::directory_iterator itr(root), end_itr; itr != end_itr; ++itr) {
+            std::vector<std::thread> workers;
+            for (size_t i = 1; i < threadCount; ++i) {
+                workers.emplace_back(parseFiles, std::ref(*arenas[i]));
+            }
+            parseFiles(*arenas[0]);
+            for (auto& worker : workers) {
+                worker.join();
+            }
 
-                    if (!*extension || itr->path().extension().generic_string().compare(extension) == 0) {
-                        auto asniString = itr->path().generic_string();
-                        auto jsonObject = tes_object::readFromFile(context, asniString.c_str());
+            for (auto& arena : arenas) {
+                arena->commit();
+            }
 
-                        if (jsonObject) {
-                            files->set(itr->path().filename().generic_string(), item(jsonObject));
-                        }
-                    }
+            auto& filesMap = map::object(context);
+            for (size_t i = 0; i < files.size(); ++i) {
+                if (results[i]) {
+                    filesMap.set(files[i].key, item(results[i].get()));
                 }
             }
+            return filesMap;
+        }
+
+        static size_t directory_reading_threads() {
+            return (std::max)(1u, (std::min)(std::thread::hardware_concurrency(), 8u));
+        }
+
+        static object_base* readDirectory(tes_context& context, const char *dirPath, const char *extension, bool recursive,
+            size_t threadCount = directory_reading_threads())
+        {
+            if (!dirPath)
+                return nullptr;
+
+            if (!extension)
+                extension = "";
+
+            std::vector<json_file> files;
+            try {
+                collect_json_files(dirPath, boost::filesystem::path(), extension, recursive, files);
+            }
             catch (const boost::filesystem::filesystem_error& exc) {
                 JC_LOG_TES_API_ERROR(JValue, readFromDirectory, "throws '%s'", exc.what());
             }
 
-            return files;
+            return &read_json_files(context, files, threadCount);
+        }
+
+        static object_base* readFromDirectory(tes_context& context, const char *dirPath, const char *extension = "")
+        {
+            JC_LOG_API ("\"%s\", \"%s\"", (dirPath ? dirPath : "<nullptr>"), (extension ? extension : "<nullptr>"));
+            return readDirectory(context, dirPath, extension, false);
         }
         REGISTERF2(readFromDirectory, "directoryPath extension=\"\"",
             "Parses JSON files in a directory (non recursive) and returns JMap containing {filename, container-object} pairs.\n"
             "Note: by default it does not filter files by extension and will try to parse everything");
 
+        static object_base* readFromDirectoryRecursive(tes_context& context, const char *dirPath, const char *extension = "")
+        {
+            JC_LOG_API ("\"%s\", \"%s\"", (dirPath ? dirPath : "<nullptr>"), (extension ? extension : "<nullptr>"));
+            return readDirectory(context, dirPath, extension, true);
+        }
+        REGISTERF2(readFromDirectoryRecursive, "directoryPath extension=\"\"",
+            "Parses JSON files in a directory and all its subdirectories and returns JMap containing {relative file path, container-object} pairs.\n"
+            "File paths are relative to the directory and use '/' separator, i.e. 'subdir/file.json'");
+
         static object_base* objectFromPrototype(tes_context& ctx, const char *prototype)
         {
             JC_LOG_API ("\"%s\"", prototype ? prototype : "<nullptr>");
@@ -294,6 +371,44 @@ JValue.cleanPool(\"uniquePoolName\")"
         }
         REGISTERF2(objectFromPrototype, "prototype", "Creates a new container object using given JSON string-prototype");
 
+        static bool apply_mode(SInt32 mode, json_apply_mode& applyMode) {
+            switch (mode) {
+            case 0: applyMode = json_apply_mode::replace; return true;
+            case 1: applyMode = json_apply_mode::merge; return true;
+            case 2: applyMode = json_apply_mode::merge_patch; return true;
+            default: return false;
+            }
+        }
+
+        static bool applyFromFile(tes_context& ctx, object_base *obj, const char *filePath, SInt32 mode)
+        {
+            JC_LOG_API ("0x%p, \"%s\", %d", (void*) obj, filePath ? filePath : "<nullptr>", mode);
+
+            json_apply_mode applyMode;
+            if (!obj || !filePath || !apply_mode(mode, applyMode))
+                return false;
+
+            return json_deserializer::apply_json_file(ctx, *obj, filePath, applyMode);
+        }
+        REGISTERF(applyFromFile, "applyFromFile", "* filePath mode=1",
+"Reads JSON file into the existing container instead of creating a new one. The file must contain a container of the same type.\n\
+Child containers, stored under the same keys, are updated in place and keep their identifiers, only new ones get created.\n\
+@mode 0 - replace: the container ends up with the file's keys only, 1 - merge: keys absent in the file are kept,\n\
+2 - merge patch (RFC 7396): as merge, but null values remove the keys. Arrays are always replaced.\n\
+Returns false if the file can't be read or contains a container of another type");
+
+        static bool applyPrototype(tes_context& ctx, object_base *obj, const char *prototype, SInt32 mode)
+        {
+            JC_LOG_API ("0x%p, \"%s\", %d", (void*) obj, prototype ? prototype : "<nullptr>", mode);
+
+            json_apply_mode applyMode;
+            if (!obj || !prototype || !apply_mode(mode, applyMode))
+                return false;
+
+            return json_deserializer::apply_json_data(ctx, *obj, prototype, applyMode);
+        }
+        REGISTERF(applyPrototype, "applyPrototype", "* prototype mode=1", "Same as applyFromFile, but reads given JSON string-prototype");
+
         static void writeToFile(tes_context& ctx, object_base *obj, const char * cpath)
         {
             JC_LOG_API ("0x%p, \"%s\"", (void*) obj, cpath ? cpath : "<nullptr>");
@@ -301,19 +416,111 @@ JValue.cleanPool(\"uniquePoolName\")"
             if (!cpath || !obj)
                 return;
 
-            boost::filesystem::path path(cpath);
-            auto& dir = path.remove_filename();
-            if (!dir.empty() && !boost::filesystem::exists(dir) &&
-                (boost::filesystem::create_directories(dir), !boost::filesystem::exists(dir)))
-            {
+            json_file_requests::write_file(*obj, cpath);
+        }
+        REGISTERF(writeToFile, "writeToFile", "* filePath", "Writes the object into JSON file");
+
+        static SInt32 writeToDirectory(tes_context& ctx, object_base *obj, const char *directoryPath)
+        {
+            JC_LOG_API ("0x%p, \"%s\"", (void*) obj, directoryPath ? directoryPath : "<nullptr>");
+
+            auto root = obj ? obj->as<map>() : nullptr;
+            if (!directoryPath || !root)
+                return 0;
+
+            return static_cast<SInt32>(json_file_requests::of(ctx).write_directory(*root, directoryPath));
+        }
+        REGISTERF(writeToDirectory, "writeToDirectory", "* directoryPath",
+            "Writes each container of the map into its own JSON file in the directory, the keys are the file names - the opposite of readFromDirectory.\n"
+            "Repeated writes into the same directory rewrite only the files whose containers (including nested ones) have changed since,\n"
+            "the files of removed keys get deleted. Returns the number of files written");
+
+        static SInt32 writeToFileAsync(tes_context& ctx, object_base *obj, const char *filePath)
+        {
+            JC_LOG_API ("0x%p, \"%s\"", (void*) obj, filePath ? filePath : "<nullptr>");
+
+            if (!filePath || !obj)
+                return 0;
+
+            return json_file_requests::of(ctx).write_async(*obj, filePath);
+        }
+        REGISTERF(writeToFileAsync, "writeToFileAsync", "* filePath",
+            "Writes a copy of the object into JSON file in background, so that the object can be modified right after the call.\n"
+            "Returns the identifier of the request, see asyncRequestState and asyncRequestResult");
+
+        static SInt32 readFromFileAsync(tes_context& ctx, const char *filePath)
+        {
+            JC_LOG_API ("\"%s\"", filePath ? filePath : "<nullptr>");
+
+            if (!filePath)
+                return 0;
+
+            return json_file_requests::of(ctx).read_async(filePath);
+        }
+        REGISTERF2(readFromFileAsync, "filePath",
+            "Reads JSON file in background. Returns the identifier of the request, see asyncRequestState and asyncRequestResult");
+
+        static void writeToBinaryFile(tes_context& ctx, object_base *obj, const char *filePath)
+        {
+            JC_LOG_API ("0x%p, \"%s\"", (void*) obj, filePath ? filePath : "<nullptr>");
+
+            if (!filePath || !obj)
                 return;
-            }
 
-            auto json = json_serializer::create_json_value(*obj);
-            if (json)
-                json_dump_file(json.get(), cpath, JSON_INDENT(2));
+            json_file_requests::write_binary_file(*obj, filePath);
         }
-        REGISTERF(writeToFile, "writeToFile", "* filePath", "Writes the object into JSON file");
+        REGISTERF(writeToBinaryFile, "writeToBinaryFile", "* filePath",
+            "Binary serialization/deserialization:\n\n"
+            "Writes the object into a file in compact binary (CBOR) format. Keeps the same data as writeToFile,\n"
+            "but the file is smaller and faster to read and write");
+
+        static object_base* readFromBinaryFile(tes_context& ctx, const char *filePath)
+        {
+            JC_LOG_API ("\"%s\"", filePath ? filePath : "<nullptr>");
+            return json_deserializer::object_from_cbor_file (ctx, filePath);
+        }
+        REGISTERF2(readFromBinaryFile, "filePath", "Creates and returns a new container object containing contents of the file writeToBinaryFile has written");
+
+        static std::string writeToBinaryString(tes_context& ctx, object_base *obj)
+        {
+            JC_LOG_API ("0x%p", (void*) obj);
+
+            if (!obj)
+                return std::string();
+
+            return util::base64_encode(json_serializer::create_cbor_data(*obj));
+        }
+        REGISTERF(writeToBinaryString, "writeToBinaryString", "*", "Returns the object in binary format, as base64 string");
+
+        static object_base* readFromBinaryString(tes_context& ctx, const char *data)
+        {
+            JC_LOG_API ("\"%s\"", data ? data : "<nullptr>");
+
+            if (!data)
+                return nullptr;
+
+            auto binary = util::base64_decode(data);
+            return binary ? json_deserializer::object_from_cbor(ctx, binary->data(), binary->data() + binary->size()) : nullptr;
+        }
+        REGISTERF2(readFromBinaryString, "data", "Creates and returns a new container object from the string writeToBinaryString has returned");
+
+        static SInt32 asyncRequestState(tes_context& ctx, SInt32 requestId)
+        {
+            JC_LOG_API ("%d", requestId);
+            return static_cast<SInt32>(json_file_requests::of(ctx).state(requestId));
+        }
+        REGISTERF2(asyncRequestState, "requestId",
+            "Returns the state of writeToFileAsync or readFromFileAsync request:\n"
+            "0 - no such request, 1 - in progress, 2 - succeeded, 3 - failed");
+
+        static object_base* asyncRequestResult(tes_context& ctx, SInt32 requestId)
+        {
+            JC_LOG_API ("%d", requestId);
+            return json_file_requests::of(ctx).take_result(requestId).get();
+        }
+        REGISTERF2(asyncRequestResult, "requestId",
+            "Returns the container object readFromFileAsync request has read and forgets the completed request.\n"
+            "Every completed request, including writeToFileAsync one, should be forgotten this way");
 
         static SInt32 solvedValueType(tes_context& ctx, object_base* obj, const char *path)
         {
@@ -0,0 +1,330 @@
+#pragma once
+
+namespace tes_api_3 {
+
+/// Redefine in each logging module
+#undef  JC_LOG_API_SOURCE
+#define JC_LOG_API_SOURCE "JSet"
+
+    using namespace collections;
+
+    class tes_set : public class_meta< tes_set > {
+    public:
+
+        typedef set* ref;
+
+        REGISTER_TES_NAME("JSet");
+
+        void additionalSetup() {
+            metaInfo.comment = "Unordered collection of unique values (value is float, integer, string, form or another container).\n"
+                "Strings are compared case-insensitively. Adding, removing and lookup of a value take constant time.\n"
+                "Inherits JValue functionality";
+        }
+
+        REGISTERF(tes_object::object<set>, "object", "", kCommentObject);
+
+        template<class T>
+        static bool addValue(tes_context& ctx, ref obj, T value)
+        {
+            JC_LOG_API ("%p, ...", (void*) obj);
+
+            if (!obj) {
+                return false;
+            }
+
+            object_lock g(obj);
+            return obj->u_add(item(value));
+        }
+        REGISTERF(addValue<SInt32>, "addInt", "* value", "Adds the @value to the set. Returns false if the set already contains the @value");
+        REGISTERF(addValue<Float32>, "addFlt", "* value", "");
+        REGISTERF(addValue<const char *>, "addStr", "* value", "");
+        REGISTERF(addValue<object_base*>, "addObj", "* container", "");
+        REGISTERF(addValue<form_ref>, "addForm", "* value", "");
+
+        template<class T>
+        static bool removeValue(tes_context& ctx, ref obj, T value)
+        {
+            JC_LOG_API ("%p, ...", (void*) obj);
+
+            if (!obj) {
+                return false;
+            }
+
+            object_lock g(obj);
+            return obj->u_remove(item(value));
+        }
+        REGISTERF(removeValue<SInt32>, "removeInt", "* value", "Removes the @value from the set. Returns false if there was no such value");
+        REGISTERF(removeValue<Float32>, "removeFlt", "* value", "");
+        REGISTERF(removeValue<const char *>, "removeStr", "* value", "");
+        REGISTERF(removeValue<object_base*>, "removeObj", "* container", "");
+
+        static bool removeForm(tes_context& ctx, ref obj, form_ref_lightweight value)
+        {
+            JC_LOG_API ("%p, ...", (void*) obj);
+
+            if (!obj || !value) {
+                return false;
+            }
+
+            object_lock g(obj);
+            return obj->u_remove_form(value.get());
+        }
+        REGISTERF2(removeForm, "* value", "");
+
+        template<class T>
+        static bool hasValue(tes_context& ctx, ref obj, T value)
+        {
+            JC_LOG_API ("%p, ...", (void*) obj);
+
+            if (!obj) {
+                return false;
+            }
+
+            object_lock g(obj);
+            return obj->u_contains(item(value));
+        }
+        REGISTERF(hasValue<SInt32>, "hasInt", "* value", "Returns true if the set contains the @value");
+        REGISTERF(hasValue<Float32>, "hasFlt", "* value", "");
+        REGISTERF(hasValue<const char *>, "hasStr", "* value", "");
+        REGISTERF(hasValue<object_base*>, "hasObj", "* container", "");
+
+        static bool hasForm(tes_context& ctx, ref obj, form_ref_lightweight value)
+        {
+            JC_LOG_API ("%p, ...", (void*) obj);
+
+            if (!obj || !value) {
+                return false;
+            }
+
+            object_lock g(obj);
+            return obj->u_contains_form(value.get());
+        }
+        REGISTERF2(hasForm, "* value", "");
+
+        //////////////////////////////////////////////////////////////////////////
+
+        static object_base* objectWithArray(tes_context& ctx, array* source)
+        {
+            JC_LOG_API ("%p", (void*) source);
+
+            if (!source) {
+                return nullptr;
+            }
+
+            return &set::objectWithInitializer([&](set &me) {
+                object_lock g(source);
+                for (auto& itm : source->_array) {
+                    me.u_add(itm);
+                }
+            },
+                ctx);
+        }
+        REGISTERF2(objectWithArray, "source", "Creates a new set containing unique values of the @source array");
+
+        static SInt32 addFromArray(tes_context& ctx, ref obj, array* source)
+        {
+            JC_LOG_API ("%p, %p", (void*) obj, (void*) source);
+
+            if (!obj || !source) {
+                return 0;
+            }
+
+            auto values = source->container_copy();
+            SInt32 added = 0;
+
+            object_lock g(obj);
+            for (auto& itm : values) {
+                added += obj->u_add(std::move(itm)) ? 1 : 0;
+            }
+            return added;
+        }
+        REGISTERF2(addFromArray, "* source", "Adds values of the @source array into the set. Returns the number of added values");
+
+        static object_base* toArray(tes_context& ctx, ref obj)
+        {
+            JC_LOG_API ("%p", (void*) obj);
+
+            if (!obj) {
+                return nullptr;
+            }
+
+            return &array::objectWithInitializer([&](array &arr) {
+                arr._array = obj->container_copy();
+            },
+                ctx);
+        }
+        REGISTERF2(toArray, "*", "Creates a new array containing the values of the set");
+
+        //////////////////////////////////////////////////////////////////////////
+
+        template<class F>
+        static object_base* combine(tes_context& ctx, ref left, ref right, F&& filter) {
+            if (!left || !right) {
+                return nullptr;
+            }
+
+            auto leftValues = left->container_copy();
+            auto rightValues = right->container_copy();
+
+            return &set::objectWithInitializer([&](set &me) {
+                filter(me, leftValues, rightValues);
+            },
+                ctx);
+        }
+
+        static object_base* setUnion(tes_context& ctx, ref obj, ref another)
+        {
+            JC_LOG_API ("%p, %p", (void*) obj, (void*) another);
+
+            return combine(ctx, obj, another, [](set& me, set::container_type& l, set::container_type& r) {
+                me.u_container() = std::move(l);
+                for (auto& itm : r) {
+                    me.u_add(std::move(itm));
+                }
+            });
+        }
+        REGISTERF(setUnion, "union", "* another", "Returns a new set containing values found in either of the sets");
+
+        static object_base* intersection(tes_context& ctx, ref obj, ref another)
+        {
+            JC_LOG_API ("%p, %p", (void*) obj, (void*) another);
+
+            return combine(ctx, obj, another, [](set& me, set::container_type& l, set::container_type& r) {
+                me.u_container() = std::move(r); // used for lookups only
+                set::container_type common;
+                for (auto& itm : l) {
+                    if (me.u_contains(itm)) {
+                        common.push_back(std::move(itm));
+                    }
+                }
+                me.u_container() = std::move(common);
+            });
+        }
+        REGISTERF2(intersection, "* another", "Returns a new set containing values found in both of the sets");
+
+        static object_base* difference(tes_context& ctx, ref obj, ref another)
+        {
+            JC_LOG_API ("%p, %p", (void*) obj, (void*) another);
+
+            return combine(ctx, obj, another, [](set& me, set::container_type& l, set::container_type& r) {
+                me.u_container() = std::move(l);
+                for (auto& itm : r) {
+                    me.u_remove(itm);
+                }
+            });
+        }
+        REGISTERF2(difference, "* another", "Returns a new set containing values of the set which are not found in @another set");
+    };
+
+    TES_META_INFO(tes_set);
+
+    JC_TEST(tes_set, api)
+    {
+        set* st = tes_object::object<set>(context);
+
+        EXPECT_TRUE(tes_set::addValue<SInt32>(context, st, 1));
+        EXPECT_FALSE(tes_set::addValue<SInt32>(context, st, 1));
+        EXPECT_TRUE(tes_set::addValue<Float32>(context, st, 1.f));
+        EXPECT_TRUE(tes_set::addValue<Float32>(context, st, 0.f));
+        EXPECT_FALSE(tes_set::addValue<Float32>(context, st, -0.f));
+        EXPECT_TRUE(tes_set::addValue<const char*>(context, st, "Sword"));
+        EXPECT_FALSE(tes_set::addValue<const char*>(context, st, "sWORD"));
+        EXPECT_TRUE(tes_set::addValue<form_ref>(context, st, make_weak_form_id((FormId)0x14, context)));
+        EXPECT_FALSE(tes_set::addValue<form_ref>(context, st, make_weak_form_id((FormId)0x14, context)));
+        EXPECT_EQ(5, st->s_count());
+
+        EXPECT_TRUE(tes_set::hasValue<const char*>(context, st, "SWORD"));
+        EXPECT_TRUE(tes_set::hasForm(context, st, make_lightweight_form_ref((FormId)0x14, context)));
+        EXPECT_FALSE(tes_set::hasForm(context, st, make_lightweight_form_ref((FormId)0x15, context)));
+        EXPECT_FALSE(tes_set::hasValue<SInt32>(context, st, 2));
+
+        EXPECT_TRUE(tes_set::removeValue<SInt32>(context, st, 1));
+        EXPECT_FALSE(tes_set::removeValue<SInt32>(context, st, 1));
+        EXPECT_TRUE(tes_set::hasValue<Float32>(context, st, 1.f));
+        EXPECT_TRUE(tes_set::removeForm(context, st, make_lightweight_form_ref((FormId)0x14, context)));
+        EXPECT_EQ(3, st->s_count());
+        EXPECT_TRUE(tes_set::hasValue<const char*>(context, st, "sword"));
+
+        // direct modification doesn't break lookups
+        st->u_container().push_back(item("sword"));
+        EXPECT_TRUE(tes_set::hasValue<const char*>(context, st, "sword"));
+        EXPECT_EQ(3, st->s_count());
+    }
+
+    JC_TEST(tes_set, set_operations)
+    {
+        auto makeSet = [&](const char *json) {
+            array* arr = tes_object::objectFromPrototype(context, json)->as<array>();
+            return tes_set::objectWithArray(context, arr)->as<set>();
+        };
+
+        set* a = makeSet(STR([1, 2, 3, "a", 2]));
+        set* b = makeSet(STR([2, 3, 4, "A"]));
+        EXPECT_EQ(4, a->s_count());
+
+        EXPECT_EQ(6, tes_set::setUnion(context, a, b)->s_count());
+        EXPECT_EQ(3, tes_set::intersection(context, a, b)->s_count());
+
+        set* diff = tes_set::difference(context, a, b)->as<set>();
+        EXPECT_TRUE(diff && diff->s_count() == 1 && tes_set::hasValue<SInt32>(context, diff, 1));
+
+        EXPECT_EQ(1, tes_set::addFromArray(context, a, tes_set::toArray(context, b)->as<array>()));
+    }
+
+    JC_TEST(tes_set, serialization)
+    {
+        object_stack_ref obj = tes_object::objectFromPrototype(context, STR(
+            { "obj": {"k": 1}, "set": { "__metaInfo": {"typeName": "JSet"}, "__values": [1, "__reference|.obj", "x", 1] } }
+        ));
+
+        set* st = tes_object::resolveGetter<object_base*>(context, obj, ".set")->as<set>();
+        auto contained = tes_object::resolveGetter<object_base*>(context, obj, ".obj");
+        EXPECT_TRUE(st && contained);
+        EXPECT_TRUE(tes_set::hasValue<object_base*>(context, st, contained));
+        EXPECT_EQ(3, st->s_count());
+        EXPECT_EQ(3, tes_object::resolveGetter<SInt32>(context, obj, ".set@count"));
+
+        // the set owns the object
+        bool visited = false;
+        st->u_visit_referenced_objects([&](object_base& o) { visited = visited || &o == contained; });
+        EXPECT_TRUE(visited);
+
+        auto data = json_serializer::create_json_data(*st);
+        set* restored = json_deserializer::object_from_json_data(context, data.get())->as<set>();
+        EXPECT_TRUE(restored && restored->s_count() == 3 && tes_set::hasValue<const char*>(context, restored, "X"));
+
+        auto copy = copying::deep_copy(context, *obj).as<map>();
+        set* copiedSet = tes_object::resolveGetter<object_base*>(context, copy, ".set")->as<set>();
+        auto copiedObj = tes_object::resolveGetter<object_base*>(context, copy, ".obj");
+        EXPECT_TRUE(copiedSet && copiedSet != st && tes_set::hasValue<object_base*>(context, copiedSet, copiedObj));
+    }
+
+    TEST(tes_set, perft)
+    {
+        tes_context_standalone ctx;
+        const int formsCount = 10000, lookupsCount = 1000;
+
+        array* arr = tes_object::object<array>(ctx);
+        set* st = tes_object::object<set>(ctx);
+        for (int i = 0; i < formsCount; ++i) {
+            auto form = make_weak_form_id(static_cast<FormId>(0x1000 + i), ctx);
+            arr->_array.emplace_back(form);
+            st->u_add(item(form));
+        }
+
+        int foundInArray = 0, foundInSet = 0;
+        util::do_with_timing("JArray.findForm membership test", [&]() {
+            for (int i = 0; i < lookupsCount; ++i) {
+                auto form = make_weak_form_id(static_cast<FormId>(0x1000 + i * 13), ctx);
+                foundInArray += tes_array::findVal<form_ref>(ctx, arr, form) != -1 ? 1 : 0;
+            }
+        });
+        util::do_with_timing("JSet.hasForm membership test", [&]() {
+            for (int i = 0; i < lookupsCount; ++i) {
+                auto form = make_lightweight_form_ref(static_cast<FormId>(0x1000 + i * 13), ctx);
+                foundInSet += tes_set::hasForm(ctx, st, form) ? 1 : 0;
+            }
+        });
+        EXPECT_EQ(foundInArray, foundInSet);
+    }
+}
@@ -0,0 +1,400 @@
+#pragma once
+
+#include "collections/functions.h"
+#include "collections/numeric_kernels.h"
+#include "util/radix_sort.h"
+
+namespace tes_api_3 {
+
+/// Redefine in each logging module
+#undef  JC_LOG_API_SOURCE
+#define JC_LOG_API_SOURCE "JTypedArray"
+
+    using namespace collections;
+
+    template<class Cnt>
+    class tes_typed_array_t : public class_meta< tes_typed_array_t<Cnt> >, public collections::array_functions {
+    public:
+
+        using value_type = typename Cnt::value_type;
+        using tes_array_type = VMArray<value_type>;
+        using tes_result_array_type = VMResultArray<value_type>;
+
+        typedef Cnt* ref;
+
+        void additionalSetup();
+
+        REGISTERF(tes_object::object<Cnt>, "object", "", kCommentObject);
+
+        static object_base* objectWithSize(tes_context& ctx, SInt32 size)
+        {
+            JC_LOG_API ("%d", size);
+
+            if (size < 0)
+                return nullptr;
+
+            return &Cnt::objectWithInitializer([&](Cnt &me) {
+                me.u_container().resize(size);
+            },
+                ctx);
+        }
+        REGISTERF2(objectWithSize, "size", "Creates a new array of given size, filled with zeros");
+
+        static object_base* objectWithValues(tes_context& ctx, tes_array_type values)
+        {
+            JC_LOG_API ("...");
+
+            return &Cnt::objectWithInitializer([&](Cnt &me) {
+                auto& cnt = me.u_container();
+                cnt.resize(values.Length());
+                for (UInt32 i = 0; i < values.Length(); ++i) {
+                    values.Get(&cnt[i], i);
+                }
+            },
+                ctx);
+        }
+        REGISTERF2(objectWithValues, "values", "Creates a new array that contains given values");
+
+        static value_type getValue(tes_context& ctx, ref obj, SInt32 index)
+        {
+            JC_LOG_API ("%p, %d", (void*) obj, index);
+
+            value_type value = 0;
+            if (obj) {
+                object_lock g(obj);
+                if (auto valuePtr = static_cast<const Cnt&>(*obj).u_get(index)) {
+                    value = *valuePtr;
+                }
+            }
+            return value;
+        }
+        REGISTERF(getValue, "get", "* index", "Returns the value at the @index of the array or zero if there is no such index.\n"
+            NEGATIVE_IDX_COMMENT);
+
+        static void setValue(tes_context& ctx, ref obj, SInt32 index, value_type value)
+        {
+            JC_LOG_API ("%p, %d, ...", (void*) obj, index);
+
+            if (obj) {
+                object_lock g(obj);
+                obj->u_set(index, value);
+            }
+        }
+        REGISTERF(setValue, "set", "* index value", "Replaces existing value at the @index of the array with the new @value.\n"
+            NEGATIVE_IDX_COMMENT);
+
+        static void addValue(tes_context& ctx, ref obj, value_type value, SInt32 addToIndex = -1)
+        {
+            JC_LOG_API ("%p, ..., %d", (void*) obj, addToIndex);
+
+            if (!obj) {
+                return;
+            }
+
+            object_lock g(obj);
+            if (auto idx = convertWriteIndex(obj, addToIndex)) {
+                auto& cnt = obj->u_container();
+                cnt.insert(cnt.begin() + *idx, value);
+            }
+        }
+        REGISTERF(addValue, "add", "* value addToIndex=-1", "Appends the @value to the end of the array.\n"
+            "If @addToIndex >= 0 it inserts value at given index. " NEGATIVE_IDX_COMMENT);
+
+        static tes_result_array_type getValues(tes_context& ctx, ref obj, SInt32 first = 0, SInt32 last = -1)
+        {
+            JC_LOG_API ("%p, %d, %d", (void*) obj, first, last);
+
+            tes_result_array_type values;
+            if (!obj) {
+                return values;
+            }
+
+            object_lock g(obj);
+            auto fst = convertReadIndex(obj, first), lst = convertReadIndex(obj, last);
+            if (fst && lst && *fst <= *lst) {
+                values.assign(obj->_array.begin() + *fst, obj->_array.begin() + *lst + 1);
+            }
+            return values;
+        }
+        REGISTERF(getValues, "getValues", "* first=0 last=-1",
+            "Copies [first, last] index range of the values into new native Papyrus array. " NEGATIVE_IDX_COMMENT);
+
+        static bool setValues(tes_context& ctx, ref obj, tes_array_type values, SInt32 writeAtIndex = 0)
+        {
+            JC_LOG_API ("%p, ..., %d", (void*) obj, writeAtIndex);
+
+            if (!obj) {
+                return false;
+            }
+
+            object_lock g(obj);
+            auto idx = convertWriteIndex(obj, writeAtIndex);
+            if (!idx) {
+                return false;
+            }
+
+            const UInt32 length = values.Length();
+            auto& cnt = obj->u_container();
+            if (*idx + length > cnt.size()) {
+                cnt.resize(*idx + length);
+            }
+            for (UInt32 i = 0; i < length; ++i) {
+                values.Get(&cnt[*idx + i], i);
+            }
+            return true;
+        }
+        REGISTERF(setValues, "setValues", "* values writeAtIndex=0",
+            "Overwrites the values starting at @writeAtIndex with given @values, growing the array if needed.\n"
+            "@writeAtIndex equal to -1 appends the values to the end of the array.");
+
+        static object_base* slice(tes_context& ctx, ref obj, SInt32 first = 0, SInt32 last = -1)
+        {
+            JC_LOG_API ("%p, %d, %d", (void*) obj, first, last);
+
+            if (!obj) {
+                return nullptr;
+            }
+
+            object_lock g(obj);
+            auto fst = convertReadIndex(obj, first), lst = convertReadIndex(obj, last);
+            if (!(fst && lst && *fst <= *lst)) {
+                return nullptr;
+            }
+
+            return &Cnt::objectWithInitializer([&](Cnt &me) {
+                me.u_container().assign(obj->_array.begin() + *fst, obj->_array.begin() + *lst + 1);
+            },
+                ctx);
+        }
+        REGISTERF2(slice, "* first=0 last=-1", "Creates a new array containing [first, last] index range of the values. " NEGATIVE_IDX_COMMENT);
+
+        static void eraseIndex(tes_context& ctx, ref obj, SInt32 index)
+        {
+            JC_LOG_API ("%p, %d", (void*) obj, index);
+
+            if (obj) {
+                object_lock g(obj);
+                obj->u_erase(index);
+            }
+        }
+        REGISTERF2(eraseIndex, "* index", "Erases the value at the index. " NEGATIVE_IDX_COMMENT);
+
+        static SInt32 count(tes_context& ctx, ref obj) {
+            JC_LOG_API ("%p", (void*) obj);
+            return tes_object::count(ctx, obj);
+        }
+        REGISTERF2(count, "*", "Returns count of the values in the array");
+
+        static void clear(tes_context& ctx, ref obj) {
+            JC_LOG_API ("%p", (void*) obj);
+            tes_object::clear(ctx, obj);
+        }
+        REGISTERF2(clear, "*", "Removes all the values from the array");
+
+        //////////////////////////////////////////////////////////////////////////
+
+        static object_base* toArray(tes_context& ctx, ref obj)
+        {
+            JC_LOG_API ("%p", (void*) obj);
+
+            if (!obj) {
+                return nullptr;
+            }
+
+            return &array::objectWithInitializer([&](array &arr) {
+                object_lock g(obj);
+                arr._array.reserve(obj->_array.size());
+                for (auto value : obj->_array) {
+                    arr._array.emplace_back(value);
+                }
+            },
+                ctx);
+        }
+        REGISTERF2(toArray, "*", "Creates a new JArray containing the values of the array");
+
+        static object_base* fromArray(tes_context& ctx, array* source)
+        {
+            JC_LOG_API ("%p", (void*) source);
+
+            if (!source) {
+                return nullptr;
+            }
+
+            return &Cnt::objectWithInitializer([&](Cnt &me) {
+                object_lock g(source);
+                auto& cnt = me.u_container();
+                cnt.reserve(source->_array.size());
+                for (auto& itm : source->_array) {
+                    cnt.push_back(itm.readAs<value_type>());
+                }
+            },
+                ctx);
+        }
+        REGISTERF2(fromArray, "source", "Creates a new array containing the values of @source JArray.\n"
+            "Values that are not numbers are converted into zeros");
+
+        //////////////////////////////////////////////////////////////////////////
+
+        static ref sort(tes_context& ctx, ref obj)
+        {
+            JC_LOG_API ("%p", (void*) obj);
+
+            if (obj) {
+                object_lock g(obj);
+                util::radix_sort(obj->u_container());
+            }
+            return obj;
+        }
+        REGISTERF2(sort, "*", "Sorts the values into ascending order. Returns the array itself");
+
+        static value_type sum(tes_context& ctx, ref obj)
+        {
+            JC_LOG_API ("%p", (void*) obj);
+
+            double total = 0;
+            if (obj) {
+                object_lock g(obj);
+                total = numeric_kernels::sum(obj->_array.data(), obj->_array.size());
+            }
+            return static_cast<value_type>(total);
+        }
+        REGISTERF2(sum, "*", "Returns sum of all the values");
+
+        static value_type minValue(tes_context& ctx, ref obj)
+        {
+            JC_LOG_API ("%p", (void*) obj);
+
+            value_type mn = 0, mx = 0;
+            if (obj) {
+                object_lock g(obj);
+                if (!obj->_array.empty()) {
+                    numeric_kernels::min_max(obj->_array.data(), obj->_array.size(), mn, mx);
+                }
+            }
+            return mn;
+        }
+        REGISTERF(minValue, "min", "*", "Returns minimum value or zero, if the array is empty");
+
+        static value_type maxValue(tes_context& ctx, ref obj)
+        {
+            JC_LOG_API ("%p", (void*) obj);
+
+            value_type mn = 0, mx = 0;
+            if (obj) {
+                object_lock g(obj);
+                if (!obj->_array.empty()) {
+                    numeric_kernels::min_max(obj->_array.data(), obj->_array.size(), mn, mx);
+                }
+            }
+            return mx;
+        }
+        REGISTERF(maxValue, "max", "*", "Returns maximum value or zero, if the array is empty");
+    };
+
+    typedef tes_typed_array_t<int_array> tes_int_array;
+    typedef tes_typed_array_t<float_array> tes_float_array;
+
+    void tes_int_array::additionalSetup() {
+        metaInfo._className = "JIntArray";
+        metaInfo.comment = "Ordered collection of integers, stored compactly.\n"
+            "Inherits JValue functionality";
+    }
+
+    void tes_float_array::additionalSetup() {
+        metaInfo._className = "JFltArray";
+        metaInfo.comment = "Ordered collection of floats, stored compactly.\n"
+            "Inherits JValue functionality";
+    }
+
+    TES_META_INFO(tes_int_array);
+    TES_META_INFO(tes_float_array);
+
+    JC_TEST(tes_typed_array, api)
+    {
+        int_array* ints = tes_object::object<int_array>(context);
+        for (SInt32 v : { 5, -3, 10, 0, 7 }) {
+            tes_int_array::addValue(context, ints, v);
+        }
+
+        EXPECT_EQ(5, tes_int_array::count(context, ints));
+        EXPECT_EQ(19, tes_int_array::sum(context, ints));
+        EXPECT_EQ(-3, tes_int_array::minValue(context, ints));
+        EXPECT_EQ(10, tes_int_array::maxValue(context, ints));
+        EXPECT_EQ(7, tes_int_array::getValue(context, ints, -1));
+
+        tes_int_array::sort(context, ints);
+        EXPECT_EQ((std::vector<SInt32>{ -3, 0, 5, 7, 10 }), ints->_array);
+
+        auto sliced = tes_int_array::slice(context, ints, 1, -2)->as<int_array>();
+        EXPECT_TRUE(sliced && sliced->_array == (std::vector<SInt32>{ 0, 5, 7 }));
+
+        array* arr = tes_int_array::toArray(context, ints)->as<array>();
+        EXPECT_TRUE(arr && arr->s_count() == 5 && arr->_array[4] == item(10));
+
+        arr->_array.push_back(item("not a number"));
+        arr->_array.push_back(item(2.5f));
+        auto flts = tes_float_array::fromArray(context, arr)->as<float_array>();
+        EXPECT_TRUE(flts && flts->_array == (std::vector<Float32>{ -3.f, 0.f, 5.f, 7.f, 10.f, 0.f, 2.5f }));
+        EXPECT_EQ(21.5f, tes_float_array::sum(context, flts));
+    }
+
+    JC_TEST(tes_typed_array, json_and_copying)
+    {
+        object_stack_ref obj = tes_object::objectFromPrototype(context, STR(
+            { "ints": { "__metaInfo": {"typeName": "JIntArray"}, "__values": [1, 2, 3] },
+              "flts": { "__metaInfo": {"typeName": "JFltArray"}, "__values": [0.5, -1] } }
+        ));
+
+        auto ints = tes_object::resolveGetter<object_base*>(context, obj, ".ints")->as<int_array>();
+        auto flts = tes_object::resolveGetter<object_base*>(context, obj, ".flts")->as<float_array>();
+        EXPECT_TRUE(ints && ints->_array == (std::vector<SInt32>{ 1, 2, 3 }));
+        EXPECT_TRUE(flts && flts->_array == (std::vector<Float32>{ 0.5f, -1.f }));
+
+        EXPECT_EQ(6, tes_object::resolveGetter<SInt32>(context, obj, ".ints@sumInt"));
+        EXPECT_EQ(-1.f, tes_object::resolveGetter<Float32>(context, obj, ".flts@minNum"));
+
+        auto copy = &copying::deep_copy(context, *obj);
+        auto data = json_serializer::create_json_data(*copy);
+        auto restored = json_deserializer::object_from_json_data(context, data.get());
+
+        auto restoredInts = tes_object::resolveGetter<object_base*>(context, restored, ".ints")->as<int_array>();
+        EXPECT_TRUE(restoredInts && restoredInts != ints && restoredInts->_array == ints->_array);
+    }
+
+    TEST(tes_typed_array, perft)
+    {
+        tes_context_standalone ctx;
+        const int itemsCount = 1000000;
+
+        array::ref arr = array::object(ctx);
+        float_array* flts = tes_object::object<float_array>(ctx);
+
+        for (int i = 0; i < itemsCount; ++i) {
+            const float value = static_cast<float>((i * 7919) % itemsCount);
+            arr->_array.emplace_back(value);
+            flts->_array.push_back(value);
+        }
+
+        JC_log("JArray of %d floats occupies %u bytes, JFltArray - %u bytes", itemsCount,
+            (uint32_t)(arr->_array.capacity() * sizeof(item)), (uint32_t)(flts->_array.capacity() * sizeof(Float32)));
+
+        float arraySum = 0, typedSum = 0;
+        util::do_with_timing("JArray sum (item-by-item)", [&]() {
+            for (int i = 0; i < itemsCount; ++i) {
+                arraySum += tes_array::itemAtIndex<Float32>(ctx, arr, i);
+            }
+        });
+        util::do_with_timing("JFltArray sum", [&]() {
+            typedSum = tes_float_array::sum(ctx, flts);
+        });
+        EXPECT_NEAR(arraySum, typedSum, typedSum * 0.001f);
+
+        util::do_with_timing("JArray sort", [&]() {
+            tes_array::sort(ctx, arr);
+        });
+        util::do_with_timing("JFltArray sort", [&]() {
+            tes_float_array::sort(ctx, flts);
+        });
+        EXPECT_TRUE(std::is_sorted(flts->_array.begin(), flts->_array.end()));
+    }
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <future>
+#include <fstream>
+#include <random>
+#include <thread>
 #include "util/util.h"
 
 namespace tes_api_3 {
@@ -100,6 +103,210 @@ namespace tes_api_3 {
         sort("[]");
     }
 
+    namespace {
+        // the same values in the same order, string case included
+        bool items_identical(const std::vector<item>& left, const std::vector<item>& right) {
+            return left.size() == right.size() && std::equal(left.begin(), left.end(), right.begin(), [](const item& l, const item& r) {
+                auto ls = l.get<std::string>(), rs = r.get<std::string>();
+                return (ls && rs) ? (*ls == *rs) : (l == r);
+            });
+        }
+
+        std::vector<item> make_mixed_items(tes_context& ctx, int count, bool typesMixed) {
+            std::vector<item> values;
+            values.reserve(count);
+            for (int i = 0; i < count; ++i) {
+                const int n = (i * 7919) % 1000 - 500;
+                switch (typesMixed ? i % 5 : 0) {
+                case 0: values.emplace_back(n); break;
+                case 1: values.emplace_back(n * 0.25f); break;
+                case 2: values.emplace_back(make_weak_form_id(static_cast<FormId>(0x1000 + n + 500), ctx)); break;
+                case 3: values.emplace_back(i % 2 ? "Abc" + std::to_string(n) : "aBC" + std::to_string(n)); break;
+                default: values.emplace_back(); break;
+                }
+            }
+            return values;
+        }
+    }
+
+    TEST(array, type_partitioned_sort)
+    {
+        tes_context_standalone ctx;
+
+        auto expectSameAsStableSort = [&](std::vector<item> values) {
+            auto expected = values;
+            std::stable_sort(expected.begin(), expected.end());
+            item_sort::sort(values);
+            EXPECT_TRUE(items_identical(expected, values));
+        };
+
+        auto arr = tes_object::objectFromPrototype(ctx, STR([null, "b", 2, "B", 1.5, -3, "a", -0.5, "__formData||0x12", 7, "__formData||0x5"]))->as<array>();
+        expectSameAsStableSort(arr->u_container());
+        expectSameAsStableSort(make_mixed_items(ctx, 1000, true));
+        expectSameAsStableSort(make_mixed_items(ctx, 1000, false));
+        expectSameAsStableSort({});
+
+        auto strings = tes_object::objectFromPrototype(ctx, STR(["x", "X", "a_", "A", "Ab"]))->as<array>();
+        tes_array::unique(ctx, strings);
+        EXPECT_EQ(4, strings->u_count());
+    }
+
+    TEST(array, sortBy)
+    {
+        tes_context_standalone ctx;
+        auto arr = tes_object::objectFromPrototype(ctx, STR([
+            {"name": "c", "level": 3},
+            {"name": "b", "level": 1},
+            5,
+            {"name": "a"},
+            {"name": "d", "level": 1}
+        ]))->as<array>();
+
+        tes_array::sortBy(ctx, arr, ".level");
+
+        auto nameAt = [&](SInt32 idx) { return tes_object::resolveGetter<std::string>(ctx, arr, ("[" + std::to_string(idx) + "].name").c_str()); };
+        EXPECT_EQ(5, tes_array::itemAtIndex<SInt32>(ctx, arr, 0));
+        EXPECT_EQ("a", nameAt(1));
+        EXPECT_EQ("b", nameAt(2));
+        EXPECT_EQ("d", nameAt(3));
+        EXPECT_EQ("c", nameAt(4));
+
+        tes_array::sortBy(ctx, arr, ".name");
+        EXPECT_EQ("a", nameAt(1));
+        EXPECT_EQ("d", nameAt(4));
+    }
+
+    // the values added while sortBy resolves the paths aren't lost
+    TEST(array, sortBy_while_modified)
+    {
+        tes_context_standalone ctx;
+        array::ref arr = array::object(ctx);
+        for (int32_t i = 0; i < 200; ++i) {
+            map& child = map::object(ctx);
+            child.set("level", item(i % 7));
+            arr->push(item(child));
+        }
+
+        std::thread modifier([&]() {
+            for (int32_t i = 0; i < 1000; ++i) {
+                tes_array::addItemAt<SInt32>(ctx, arr.get(), i);
+            }
+        });
+        for (int i = 0; i < 20; ++i) {
+            tes_array::sortBy(ctx, arr.get(), ".level");
+        }
+        modifier.join();
+
+        EXPECT_EQ(1200, arr->s_count());
+        EXPECT_EQ(1, tes_array::count_item<SInt32>(ctx, arr.get(), 999));
+    }
+
+    TEST(array, type_partitioned_sort_perft)
+    {
+        tes_context_standalone ctx;
+        const int itemsCount = 100000;
+
+        for (bool typesMixed : {true, false}) {
+            const auto values = make_mixed_items(ctx, itemsCount, typesMixed);
+            auto viaStdSort = values, viaPartitioning = values;
+
+            util::do_with_timing(typesMixed ? "std::sort, 100k mixed items" : "std::sort, 100k integers", [&]() {
+                std::sort(viaStdSort.begin(), viaStdSort.end());
+            });
+            util::do_with_timing(typesMixed ? "item_sort::sort, 100k mixed items" : "item_sort::sort, 100k integers", [&]() {
+                item_sort::sort(viaPartitioning);
+            });
+
+            EXPECT_TRUE(std::is_sorted(viaPartitioning.begin(), viaPartitioning.end()));
+        }
+    }
+
+    TEST(array, value_index)
+    {
+        tes_context_standalone ctx;
+        auto indexed = tes_object::objectFromPrototype(ctx, STR([1, 2.5, "Abc", 1, null, 2.5, 1]))->as<array>();
+        auto plain = tes_object::objectFromPrototype(ctx, STR([1, 2.5, "Abc", 1, null, 2.5, 1]))->as<array>();
+
+        EXPECT_EQ(0, tes_array::valueIndexMemoryUsage(ctx, indexed));
+        tes_array::enableValueIndex(ctx, indexed);
+        EXPECT_TRUE(tes_array::isValueIndexEnabled(ctx, indexed));
+
+        auto expectSameResults = [&]() {
+            for (SInt32 start : {0, 1, 3, 6, -1, -3, -7}) {
+                EXPECT_EQ(tes_array::findVal<SInt32>(ctx, plain, 1, start), tes_array::findVal<SInt32>(ctx, indexed, 1, start));
+                EXPECT_EQ(tes_array::findVal<Float32>(ctx, plain, 2.5f, start), tes_array::findVal<Float32>(ctx, indexed, 2.5f, start));
+                EXPECT_EQ(tes_array::findVal<const char*>(ctx, plain, "aBC", start), tes_array::findVal<const char*>(ctx, indexed, "aBC", start));
+            }
+            EXPECT_EQ(tes_array::count_item<SInt32>(ctx, plain, 1), tes_array::count_item<SInt32>(ctx, indexed, 1));
+            EXPECT_EQ(tes_array::count_item<const char*>(ctx, plain, "abc"), tes_array::count_item<const char*>(ctx, indexed, "abc"));
+            EXPECT_EQ(tes_array::count_item<Float32>(ctx, plain, 7.f), tes_array::count_item<Float32>(ctx, indexed, 7.f));
+        };
+
+        auto forBoth = [&](const std::function<void(array*)>& modify) {
+            modify(plain);
+            modify(indexed);
+            expectSameResults();
+        };
+
+        expectSameResults();
+        EXPECT_EQ(3, tes_array::count_item<SInt32>(ctx, indexed, 1));
+        EXPECT_TRUE(tes_array::valueIndexMemoryUsage(ctx, indexed) > 0);
+
+        forBoth([&](array* a) { tes_array::addItemAt<SInt32>(ctx, a, 1); });
+        forBoth([&](array* a) { tes_array::replaceItemAtIndex<const char*>(ctx, a, 0, "abc"); });
+        forBoth([&](array* a) { tes_array::eraseIndex(ctx, a, -1); });
+        forBoth([&](array* a) { tes_array::eraseIndex(ctx, a, 1); });
+        forBoth([&](array* a) { tes_array::addItemAt<SInt32>(ctx, a, 1, 0); });
+        forBoth([&](array* a) { tes_array::sort(ctx, a); });
+        forBoth([&](array* a) { EXPECT_EQ(0, tes_array::erase_item<Float32>(ctx, a, 7.f)); });
+        forBoth([&](array* a) { EXPECT_EQ(3, tes_array::erase_item<SInt32>(ctx, a, 1)); });
+        forBoth([&](array* a) { tes_array::clear(ctx, a); });
+        forBoth([&](array* a) { tes_array::addItemAt<SInt32>(ctx, a, 1); });
+
+        // reading through a path is not a modification, the index stays up to date
+        const auto modifications = indexed->u_modification_count();
+        EXPECT_EQ(1, tes_object::resolveGetter<SInt32>(ctx, indexed, "[0]"));
+        EXPECT_TRUE(tes_object::hasPath(ctx, indexed, "[-1]"));
+        EXPECT_EQ(modifications, indexed->u_modification_count());
+        expectSameResults();
+
+        tes_array::enableValueIndex(ctx, indexed, false);
+        EXPECT_FALSE(tes_array::isValueIndexEnabled(ctx, indexed));
+        EXPECT_EQ(0, tes_array::valueIndexMemoryUsage(ctx, indexed));
+    }
+
+    TEST(array, value_index_perft)
+    {
+        tes_context_standalone ctx;
+        const int formsCount = 50000, lookupsCount = 2000;
+
+        array* plain = tes_object::object<array>(ctx);
+        array* indexed = tes_object::object<array>(ctx);
+        tes_array::enableValueIndex(ctx, indexed);
+
+        for (int i = 0; i < formsCount; ++i) {
+            auto form = make_weak_form_id(static_cast<FormId>(0x1000 + i), ctx);
+            tes_array::addItemAt(ctx, plain, form);
+            tes_array::addItemAt(ctx, indexed, form);
+        }
+
+        auto lookup = [&](array* arr) {
+            int found = 0;
+            for (int i = 0; i < lookupsCount; ++i) {
+                auto form = make_weak_form_id(static_cast<FormId>(0x1000 + i * 29), ctx);
+                found += tes_array::findVal<form_ref>(ctx, arr, form) != -1 ? 1 : 0;
+            }
+            return found;
+        };
+
+        int foundPlain = 0, foundIndexed = 0;
+        util::do_with_timing("JArray.findForm, linear search", [&]() { foundPlain = lookup(plain); });
+        util::do_with_timing("JArray.findForm, value index", [&]() { foundIndexed = lookup(indexed); });
+        EXPECT_EQ(foundPlain, foundIndexed);
+
+        JC_log("value index of %d forms occupies %d bytes", formsCount, tes_array::valueIndexMemoryUsage(ctx, indexed));
+    }
+
     TEST(tes_jcontainers, tes_jcontainers)
     {
         EXPECT_TRUE(tes_jcontainers::__isInstalled());
@@ -159,6 +366,105 @@ namespace tes_api_3 {
         }
     }
 
+    TEST(path_resolving, collections_reducing_operators)
+    {
+        tes_context_standalone  ctx;
+
+        auto shouldReturnNumber = [&](object_base *obj, const char *path, float value) {
+            path_resolving::resolve(ctx, obj, path, [&](item * item) {
+                EXPECT_TRUE(item && std::fabs(item->fltValue() - value) < 0.0001f);
+            });
+        };
+
+        auto shouldReturnNull = [&](object_base *obj, const char *path) {
+            path_resolving::resolve(ctx, obj, path, [&](item * item) {
+                EXPECT_TRUE(item && item->isNull());
+            });
+        };
+
+        {
+            object_stack_ref obj = tes_object::objectFromPrototype(ctx, STR([1, 2, 3, 4, 5, 6, 2.5, "a", "A", null]));
+
+            shouldReturnNumber(obj, "@sumNum", 23.5f);
+            shouldReturnNumber(obj, "@sumInt", 21);
+            shouldReturnNumber(obj, "@sumFlt", 2.5f);
+            shouldReturnNumber(obj, "@avgNum", 23.5f / 7);
+            shouldReturnNumber(obj, "@productNum", 1800);
+            shouldReturnNumber(obj, "@count", 10);
+            shouldReturnNumber(obj, "@countNonNull", 9);
+            // "a" and "A" are equal, 2 and 2.5 are not
+            shouldReturnNumber(obj, "@distinctCount", 9);
+        }
+        {
+            object_stack_ref obj = tes_object::objectFromPrototype(ctx, STR([2, 4, 4, 4, 5, 5, 7, 9]));
+            shouldReturnNumber(obj, "@stddevNum", 2);
+
+            path_resolving::resolve(ctx, obj, "@histogram", [&](item * item) {
+                auto hist = item ? item->object()->as<integer_map>() : nullptr;
+                EXPECT_TRUE(hist && hist->s_count() == 5);
+                EXPECT_TRUE(hist && hist->findOrDef(4).intValue() == 3);
+            });
+        }
+        {
+            object_stack_ref obj = tes_object::objectFromPrototype(ctx, STR([2147483647, 1, 2147483647, 1e10, -1e10, -2.5]));
+            shouldReturnNumber(obj, "@sumInt", 2147483647);
+
+            // the floats out of the int range are skipped
+            path_resolving::resolve(ctx, obj, "@histogram", [&](item * item) {
+                auto hist = item ? item->object()->as<integer_map>() : nullptr;
+                EXPECT_TRUE(hist && hist->s_count() == 3);
+                EXPECT_TRUE(hist && hist->findOrDef(2147483647).intValue() == 2);
+                EXPECT_TRUE(hist && hist->findOrDef(-3).intValue() == 1);
+            });
+        }
+        {
+            object_stack_ref obj = tes_object::objectFromPrototype(ctx, STR(["a", null]));
+            shouldReturnNull(obj, "@sumNum");
+            shouldReturnNull(obj, "@stddevNum");
+            shouldReturnNumber(obj, "@count", 2);
+        }
+        {
+            object_stack_ref obj = tes_object::objectFromPrototype(ctx, STR(
+            { "a": {"score": 1}, "b" : {"score": 2.5}, "c" : {"score": "x"}, "d" : {"score": 3} }
+            ));
+
+            shouldReturnNumber(obj, "@sumNum.value.score", 6.5f);
+            shouldReturnNumber(obj, "@countNonNull.value.score", 4);
+            shouldReturnNumber(obj, "@distinctCount.key", 4);
+        }
+    }
+
+    TEST(path_resolving, collections_reducing_operators_perft)
+    {
+        tes_context_standalone  ctx;
+        const int itemsCount = 100000;
+
+        array::ref arr = array::object(ctx);
+        for (int i = 0; i < itemsCount; ++i) {
+            if (i % 2) {
+                tes_array::addItemAt<SInt32>(ctx, arr, i);
+            }
+            else {
+                tes_array::addItemAt<Float32>(ctx, arr, i * 0.5f);
+            }
+        }
+
+        float loopSum = 0, operatorSum = 0;
+
+        // what Papyrus scripts do: fetch every item through the API and sum it
+        util::do_with_timing("item-by-item sum", [&]() {
+            for (int i = 0; i < itemsCount; ++i) {
+                loopSum += tes_array::itemAtIndex<Float32>(ctx, arr, i);
+            }
+        });
+
+        util::do_with_timing("@sumNum", [&]() {
+            operatorSum = tes_object::resolveGetter<Float32>(ctx, arr.get(), "@sumNum");
+        });
+
+        EXPECT_NEAR(loopSum, operatorSum, std::fabs(loopSum) * 0.001f);
+    }
+
     TEST(path_resolving, explicit_key_construction)
     {
         tes_context_standalone  ctx;
@@ -226,6 +532,615 @@ namespace tes_api_3 {
         auto foundObj = ctx.getObject(id);
         EXPECT_TRUE(!foundObj/* || !foundObj->has_equal_tag("temp_location_test")*/);
     }
+
+    TEST(tes_object, readFromDirectory_threads)
+    {
+        namespace fs = boost::filesystem;
+
+        const auto dir = fs::temp_directory_path() / "jc_read_directory_test";
+        fs::remove_all(dir);
+        fs::create_directories(dir / "nested" / "deeper");
+
+        const int filesCount = 500;
+        auto writeFile = [](const fs::path& path, int i) {
+            std::ofstream file(path.generic_string());
+            file << "{\"index\": " << i << ", \"name\": \"file" << i << "\", \"weight\": " << i * 0.5
+                << ", \"items\": [";
+            for (int j = 0; j < 200; ++j) {
+                file << (j ? ", " : "") << "{\"id\": " << j << ", \"tags\": [\"a\", \"b\", " << j << "], \"owner\": \"__reference|\"}";
+            }
+            file << "]}";
+        };
+        for (int i = 0; i < filesCount; ++i) {
+            writeFile(dir / ("file" + std::to_string(i) + ".json"), i);
+        }
+        writeFile(dir / "nested" / "a.json", -1);
+        writeFile(dir / "nested" / "deeper" / "b.json", -2);
+        std::ofstream((dir / "broken.json").generic_string()) << "{\"unterminated\": [";
+        std::ofstream((dir / "notes.txt").generic_string()) << "[\"not filtered out\"]";
+
+        tes_context_standalone ctx;
+        const auto dirPath = dir.generic_string();
+
+        std::string singleThreaded;
+        for (size_t threads : {1, 4, 8}) {
+            object_base *files = nullptr;
+            util::do_with_timing(("readFromDirectory, 500 files, " + std::to_string(threads) + " threads").c_str(), [&]() {
+                files = tes_object::readDirectory(ctx, dirPath.c_str(), ".json", false, threads);
+            });
+            ASSERT_TRUE(files != nullptr);
+            EXPECT_EQ(filesCount, files->s_count());
+
+            // the objects are registered and the references are resolved
+            auto contents = files->as<map>()->findOrDef(std::string("file7.json")).object();
+            ASSERT_TRUE(contents != nullptr);
+            EXPECT_EQ(1, ctx.filter_objects([contents](object_base& obj) { return &obj == contents; }).size());
+            EXPECT_EQ(contents, tes_object::resolveGetter<object_base*>(ctx, contents, ".items[199].owner", nullptr));
+
+            const std::string text = json_serializer::create_json_data(*files).get();
+            if (singleThreaded.empty()) {
+                singleThreaded = text;
+            }
+            EXPECT_EQ(singleThreaded, text);
+        }
+
+        auto all = tes_object::readFromDirectory(ctx, dirPath.c_str());
+        EXPECT_EQ(filesCount + 1, all->s_count());
+        EXPECT_NOT_NIL(all->as<map>()->findOrDef(std::string("notes.txt")).object());
+
+        auto recursive = tes_object::readFromDirectoryRecursive(ctx, dirPath.c_str(), ".json")->as<map>();
+        EXPECT_EQ(filesCount + 2, recursive->s_count());
+        EXPECT_EQ(-1, recursive->findOrDef(std::string("nested/a.json")).object()->as<map>()->findOrDef(std::string("index")).intValue());
+        EXPECT_EQ(-2, recursive->findOrDef(std::string("nested/deeper/b.json")).object()->as<map>()->findOrDef(std::string("index")).intValue());
+        EXPECT_NIL(recursive->findOrDef(std::string("nested")).object());
+
+        fs::remove_all(dir);
+    }
+
+    TEST(tes_object, readDirectory_released_before_commit)
+    {
+        namespace fs = boost::filesystem;
+
+        const auto dir = fs::temp_directory_path() / "jc_read_directory_released_test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        // the first value of the key gets released while it's staged
+        std::ofstream((dir / "duplicates.json").generic_string()) << R"({"key": {"replaced": [1, 2]}, "key": [3]})";
+
+        tes_context_standalone ctx;
+        object_stack_ref files = tes_object::readDirectory(ctx, dir.generic_string().c_str(), ".json", false, 1);
+        ASSERT_TRUE(files != nullptr);
+        auto contents = files->as<map>()->findOrDef(std::string("duplicates.json")).object();
+        ASSERT_TRUE(contents != nullptr);
+
+        // the autorelease queue deletes the released map and then its array - registered ones
+        std::this_thread::sleep_for(std::chrono::seconds(8));
+
+        auto replaced = ctx.filter_objects([](object_base& obj) {
+            auto m = obj.as<map>();
+            return m && m->findOrDef(std::string("replaced")).object() != nullptr;
+        });
+        EXPECT_TRUE(replaced.empty());
+        auto value = contents->as<map>()->findOrDef(std::string("key")).object();
+        ASSERT_TRUE(value != nullptr && value->as<array>() != nullptr);
+        EXPECT_EQ(1, value->s_count());
+        EXPECT_EQ(3, ctx.filter_objects([](object_base&) { return true; }).size());
+
+        fs::remove_all(dir);
+    }
+
+    namespace {
+        std::string file_contents(const boost::filesystem::path& path) {
+            std::ifstream file(path.generic_string(), std::ios::binary);
+            std::ostringstream contents;
+            contents << file.rdbuf();
+            return contents.str();
+        }
+
+        // a map of @count arrays, each array contains a map and few numbers and strings
+        object_base* make_async_io_graph(tes_context& ctx, int count) {
+            auto& root = map::object(ctx);
+            for (int i = 0; i < count; ++i) {
+                auto& arr = array::object(ctx);
+                arr.u_push(item(i));
+                arr.u_push(item(i * 0.5));
+                arr.u_push(item("item " + std::to_string(i)));
+                arr.u_push(item(&map::object(ctx)));
+                root.u_set("key" + std::to_string(i), item(&arr));
+            }
+            return &root;
+        }
+    }
+
+    TEST(tes_object, async_file_requests)
+    {
+        namespace fs = boost::filesystem;
+
+        tes_context_standalone ctx;
+        auto& requests = json_file_requests::of(ctx);
+
+        const auto dir = fs::temp_directory_path() / "jc_async_requests_test";
+        fs::remove_all(dir);
+        const auto expectedPath = (dir / "expected.json").generic_string();
+        const auto asyncPath = (dir / "nested" / "async.json").generic_string();
+
+        object_stack_ref root = make_async_io_graph(ctx, 20000);
+        tes_object::writeToFile(ctx, root.get(), expectedPath.c_str());
+
+        // the file gets written as the object was at the moment of the call
+        auto writing = tes_object::writeToFileAsync(ctx, root.get(), asyncPath.c_str());
+        EXPECT_TRUE(writing > 0);
+        for (int i = 0; i < 20000; i += 2) {
+            auto arr = root->as<map>()->findOrDef("key" + std::to_string(i)).object()->as<array>();
+            arr->s_clear();
+            arr->push(item("modified"));
+            root->as<map>()->set("key" + std::to_string(i + 1), item());
+        }
+
+        requests.wait(writing);
+        EXPECT_TRUE(tes_object::asyncRequestState(ctx, writing) == 2);
+        EXPECT_NIL(tes_object::asyncRequestResult(ctx, writing));
+        EXPECT_TRUE(tes_object::asyncRequestState(ctx, writing) == 0);
+        EXPECT_EQ(file_contents(expectedPath), file_contents(asyncPath));
+
+        auto reading = tes_object::readFromFileAsync(ctx, asyncPath.c_str());
+        auto failing = tes_object::readFromFileAsync(ctx, (dir / "missing.json").generic_string().c_str());
+        requests.wait(reading);
+        requests.wait(failing);
+
+        EXPECT_TRUE(tes_object::asyncRequestState(ctx, reading) == 2);
+        object_stack_ref read = tes_object::asyncRequestResult(ctx, reading);
+        ASSERT_TRUE(read != nullptr);
+        EXPECT_EQ(1, ctx.filter_objects([&read](object_base& obj) { return &obj == read.get(); }).size());
+        EXPECT_EQ(std::string(json_serializer::create_json_data(*tes_object::readFromFile(ctx, expectedPath.c_str())).get()),
+            std::string(json_serializer::create_json_data(*read).get()));
+
+        EXPECT_TRUE(tes_object::asyncRequestState(ctx, failing) == 3);
+        EXPECT_NIL(tes_object::asyncRequestResult(ctx, failing));
+        EXPECT_TRUE(tes_object::asyncRequestState(ctx, 0) == 0);
+
+        fs::remove_all(dir);
+    }
+
+    TEST(tes_object, async_file_requests_and_clear_state)
+    {
+        namespace fs = boost::filesystem;
+
+        const auto dir = fs::temp_directory_path() / "jc_async_clear_state_test";
+        fs::remove_all(dir);
+        const auto path = (dir / "graph.json").generic_string();
+
+        std::vector<SInt32> ids;
+        {
+            tes_context_standalone ctx;
+            object_stack_ref root = make_async_io_graph(ctx, 20000);
+            tes_object::writeToFile(ctx, root.get(), path.c_str());
+
+            for (int i = 0; i < 4; ++i) {
+                ids.push_back(tes_object::readFromFileAsync(ctx, path.c_str()));
+                ids.push_back(tes_object::writeToFileAsync(ctx, root.get(), (dir / ("copy" + std::to_string(i) + ".json")).generic_string().c_str()));
+            }
+            root = nullptr;
+
+            // the pending requests get completed first, then forgotten
+            ctx.clearState();
+            for (auto id : ids) {
+                EXPECT_TRUE(tes_object::asyncRequestState(ctx, id) == 0);
+            }
+            EXPECT_EQ(0, ctx.object_count());
+
+            // the worker outlives the cleared state
+            auto reading = tes_object::readFromFileAsync(ctx, path.c_str());
+            json_file_requests::of(ctx).wait(reading);
+            EXPECT_TRUE(tes_object::asyncRequestState(ctx, reading) == 2);
+            EXPECT_NOT_NIL(tes_object::asyncRequestResult(ctx, reading));
+
+            // and the context gets destroyed with a request pending
+            tes_object::readFromFileAsync(ctx, path.c_str());
+        }
+
+        for (int i = 0; i < 4; ++i) {
+            EXPECT_EQ(file_contents(path), file_contents(dir / ("copy" + std::to_string(i) + ".json")));
+        }
+        fs::remove_all(dir);
+    }
+
+    TEST(tes_object, binary_files_and_strings)
+    {
+        namespace fs = boost::filesystem;
+
+        tes_context_standalone ctx;
+        const auto dir = fs::temp_directory_path() / "jc_binary_files_test";
+        fs::remove_all(dir);
+        const auto path = (dir / "nested" / "graph.jcb").generic_string();
+
+        object_stack_ref root = make_async_io_graph(ctx, 1000);
+        const std::string expected = json_serializer::create_json_data(*root).get();
+
+        tes_object::writeToBinaryFile(ctx, root.get(), path.c_str());
+        auto fromFile = tes_object::readFromBinaryFile(ctx, path.c_str());
+        ASSERT_TRUE(fromFile != nullptr);
+        EXPECT_EQ(expected, std::string(json_serializer::create_json_data(*fromFile).get()));
+
+        const std::string encoded = tes_object::writeToBinaryString(ctx, root.get());
+        EXPECT_EQ(std::string::npos, encoded.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/="));
+        auto fromString = tes_object::readFromBinaryString(ctx, encoded.c_str());
+        ASSERT_TRUE(fromString != nullptr);
+        EXPECT_EQ(expected, std::string(json_serializer::create_json_data(*fromString).get()));
+
+        EXPECT_TRUE(tes_object::writeToBinaryString(ctx, nullptr).empty());
+        EXPECT_NIL(tes_object::readFromBinaryString(ctx, "not base64!"));
+        EXPECT_NIL(tes_object::readFromBinaryString(ctx, encoded.substr(0, encoded.size() / 2).c_str()));
+        EXPECT_NIL(tes_object::readFromBinaryFile(ctx, (dir / "missing.jcb").generic_string().c_str()));
+
+        fs::remove_all(dir);
+    }
+
+    TEST(tes_object, writeToDirectory)
+    {
+        namespace fs = boost::filesystem;
+
+        tes_context_standalone ctx;
+        const auto dir = fs::temp_directory_path() / "jc_write_directory_test";
+        fs::remove_all(dir);
+        const auto dirPath = dir.generic_string();
+
+        object_stack_ref root = json_deserializer::object_from_json_data(ctx, STR({
+            "a.json": { "x": 1, "nested": [{ "deep": 1 }] },
+            "b.json": [1, 2],
+            "sub/c.json": { "y": "c" },
+            "value": 5
+        }));
+        auto& files = *root->as<map>();
+        auto deep = files.findOrDef(std::string("a.json")).object()->as<map>()->findOrDef(std::string("nested")).object()->as<array>()->get_item(0)->object();
+
+        // the modification counter
+        const auto count = deep->u_modification_count();
+        deep->as<map>()->findOrDef(std::string("deep"));
+        EXPECT_EQ(count, deep->u_modification_count());
+        deep->as<map>()->set(std::string("deep"), item(2));
+        EXPECT_EQ(count + 1, deep->u_modification_count());
+
+        auto expected = [&]() {
+            return std::string(json_serializer::create_json_data(*root).get());
+        };
+        auto written = [&]() {
+            auto read = tes_object::readFromDirectoryRecursive(ctx, dirPath.c_str());
+            read->as<map>()->set(std::string("value"), item(5));
+            return std::string(json_serializer::create_json_data(*read).get());
+        };
+
+        EXPECT_EQ(3, tes_object::writeToDirectory(ctx, root.get(), dirPath.c_str()));
+        EXPECT_EQ(expected(), written());
+        EXPECT_EQ(0, tes_object::writeToDirectory(ctx, root.get(), dirPath.c_str()));
+
+        // a change deep inside of a subtree
+        deep->as<map>()->set(std::string("deep"), item(3));
+        files.set(std::string("value"), item(5));
+        EXPECT_EQ(1, tes_object::writeToDirectory(ctx, root.get(), dirPath.c_str()));
+        EXPECT_EQ(expected(), written());
+
+        // replaced and removed subtrees
+        files.set(std::string("b.json"), item(tes_object::objectFromPrototype(ctx, "[3]")));
+        files.erase(std::string("sub/c.json"));
+        EXPECT_EQ(1, tes_object::writeToDirectory(ctx, root.get(), dirPath.c_str()));
+        EXPECT_FALSE(fs::exists(dir / "sub" / "c.json"));
+        EXPECT_EQ(expected(), written());
+
+        // another directory and forgotten state get all the files written
+        EXPECT_EQ(2, tes_object::writeToDirectory(ctx, root.get(), (dir / "copy").generic_string().c_str()));
+        json_file_requests::of(ctx).clear_state();
+        EXPECT_EQ(2, tes_object::writeToDirectory(ctx, root.get(), dirPath.c_str()));
+
+        EXPECT_EQ(0, tes_object::writeToDirectory(ctx, files.findOrDef(std::string("b.json")).object(), dirPath.c_str()));
+        EXPECT_EQ(0, tes_object::writeToDirectory(ctx, root.get(), nullptr));
+
+        // the keys leading out of the directory are skipped
+        const auto outside = fs::temp_directory_path() / "jc_write_directory_outside.json";
+        fs::remove(outside);
+        auto& escaping = map::object(ctx);
+        escaping.set(std::string("../jc_write_directory_outside.json"), item(tes_object::objectFromPrototype(ctx, "[1]")));
+        escaping.set(std::string("sub/../../jc_write_directory_outside.json"), item(tes_object::objectFromPrototype(ctx, "[2]")));
+        escaping.set(outside.generic_string(), item(tes_object::objectFromPrototype(ctx, "[3]")));
+        escaping.set(std::string("inside.json"), item(tes_object::objectFromPrototype(ctx, "[4]")));
+        EXPECT_EQ(1, tes_object::writeToDirectory(ctx, &escaping, dirPath.c_str()));
+        EXPECT_FALSE(fs::exists(outside));
+        EXPECT_TRUE(fs::exists(dir / "inside.json"));
+
+        fs::remove_all(dir);
+    }
+
+    // the reads leave the modification counters (see writeToDirectory) as they are
+    TEST(tes_object, modification_count_of_reads)
+    {
+        tes_context_standalone ctx;
+
+        map* m = tes_object::objectFromPrototype(ctx, STR({ "key": 1, "other": "value" }))->as<map>();
+        array* arr = tes_object::objectFromPrototype(ctx, "[1, 2, 3]")->as<array>();
+        int_array* ints = tes_object::object<int_array>(ctx);
+        tes_int_array::addValue(ctx, ints, 3);
+        tes_int_array::addValue(ctx, ints, 1);
+
+        auto counts = [&]() {
+            return std::make_tuple(m->u_modification_count(), arr->u_modification_count(), ints->u_modification_count());
+        };
+        const auto before = counts();
+
+        EXPECT_EQ(1, tes_map::getItem<SInt32>(ctx, m, "key"));
+        EXPECT_TRUE(tes_map::hasKey(ctx, m, "other"));
+        EXPECT_EQ(2, tes_map::allKeys(ctx, m)->s_count());
+        EXPECT_EQ(2, tes_map::allValues(ctx, m)->s_count());
+        map* pairs = tes_object::object<map>(ctx);
+        tes_map::addPairs(ctx, pairs, m, true);
+        EXPECT_EQ(2, pairs->s_count());
+
+        EXPECT_EQ(2, tes_array::itemAtIndex<SInt32>(ctx, arr, 1));
+        EXPECT_EQ(2, tes_array::subArray(ctx, arr, 0, 2)->s_count());
+        array* target = tes_object::object<array>(ctx);
+        tes_array::addFromArray(ctx, target, arr);
+        EXPECT_EQ(3, target->s_count());
+
+        EXPECT_EQ(1, tes_int_array::getValue(ctx, ints, -1));
+        EXPECT_EQ(4, tes_int_array::sum(ctx, ints));
+        EXPECT_TRUE(before == counts());
+
+        // the typed arrays count their writes too
+        tes_int_array::sort(ctx, ints);
+        tes_int_array::addValue(ctx, ints, 5, 0);
+        tes_int_array::setValue(ctx, ints, 1, 7);
+        EXPECT_EQ(std::get<2>(before) + 3, ints->u_modification_count());
+        EXPECT_EQ((std::vector<SInt32>{ 5, 7, 3 }), ints->_array);
+    }
+
+    // JSet and JIntArray, modified through their API while a snapshot is being written: the snapshot is
+    // the state as it was when taken, the delta written afterwards has the modifications
+    TEST(tes_object, snapshot_written_while_set_and_int_array_modified)
+    {
+        tes_context_standalone ctx;
+        set* st = tes_object::object<set>(ctx);
+        int_array* ints = tes_object::object<int_array>(ctx);
+        for (SInt32 i = 0; i < 1000; ++i) {
+            tes_set::addValue<SInt32>(ctx, st, i);
+            tes_int_array::addValue(ctx, ints, i);
+        }
+        ctx.root().set(std::string("set"), item(st));
+        ctx.root().set(std::string("ints"), item(ints));
+
+        auto jdb_json = [](tes_context& context) {
+            return std::string(json_serializer::create_json_data(context.root()).get());
+        };
+        const std::string expectedJson = jdb_json(ctx);
+
+        flat_writer base;
+        {
+            flat_serialization::snapshot taken(ctx, true);
+            std::thread modifier([&]() {
+                for (SInt32 i = 0; i < 1000; ++i) {
+                    tes_set::addValue<SInt32>(ctx, st, 1000 + i);
+                    tes_int_array::setValue(ctx, ints, i, -i);
+                    if (i % 10 == 0) {
+                        tes_int_array::addValue(ctx, ints, i, 0);
+                    }
+                }
+            });
+            flat_serialization::write_snapshot(taken, base);
+            modifier.join();
+            flat_serialization::make_base(taken);
+        }
+        EXPECT_EQ(2000, st->s_count());
+        EXPECT_EQ(1100, ints->s_count());
+
+        tes_context_standalone restored;
+        flat_reader reader(base.data().data(), base.data().data() + base.data().size());
+        flat_serialization::read_context(restored, reader);
+        EXPECT_EQ(expectedJson, jdb_json(restored));
+
+        flat_writer delta;
+        flat_serialization::write_context_delta(ctx, delta);
+        tes_context_standalone again;
+        flat_reader baseReader(base.data().data(), base.data().data() + base.data().size());
+        flat_reader deltaReader(delta.data().data(), delta.data().data() + delta.data().size());
+        flat_serialization::read_context_delta(again, &baseReader, deltaReader);
+        EXPECT_EQ(jdb_json(ctx), jdb_json(again));
+    }
+
+    // JIntArray and JFltArray changed through the script API after a base save end up in the delta
+    TEST(tes_object, delta_of_typed_arrays)
+    {
+        tes_context_standalone ctx;
+        int_array* ints = tes_object::object<int_array>(ctx);
+        float_array* flts = tes_object::object<float_array>(ctx);
+        for (SInt32 i = 0; i < 100; ++i) {
+            tes_int_array::addValue(ctx, ints, i);
+            tes_float_array::addValue(ctx, flts, i * 0.5f);
+        }
+        ctx.root().set(std::string("ints"), item(ints));
+        ctx.root().set(std::string("flts"), item(flts));
+
+        flat_writer base;
+        flat_serialization::write_context(ctx, base, true);
+
+        tes_int_array::setValue(ctx, ints, 0, 1000);
+        tes_int_array::addValue(ctx, ints, -1, 0);
+        tes_int_array::eraseIndex(ctx, ints, -1);
+        tes_int_array::sort(ctx, ints);
+        tes_float_array::setValue(ctx, flts, -1, -2.5f);
+        tes_float_array::addValue(ctx, flts, 7.f);
+
+        flat_writer delta;
+        flat_serialization::write_context_delta(ctx, delta);
+
+        tes_context_standalone restored;
+        flat_reader baseReader(base.data().data(), base.data().data() + base.data().size());
+        flat_reader deltaReader(delta.data().data(), delta.data().data() + delta.data().size());
+        flat_serialization::read_context_delta(restored, &baseReader, deltaReader);
+
+        auto restoredInts = tes_object::resolveGetter<object_base*>(restored, &restored.root(), ".ints")->as<int_array>();
+        auto restoredFlts = tes_object::resolveGetter<object_base*>(restored, &restored.root(), ".flts")->as<float_array>();
+        ASSERT_TRUE(restoredInts && restoredFlts);
+        EXPECT_EQ(ints->_array, restoredInts->_array);
+        EXPECT_EQ(flts->_array, restoredFlts->_array);
+        EXPECT_EQ(-1, restoredInts->_array.front());
+        EXPECT_EQ(1000, restoredInts->_array.back());
+        EXPECT_EQ(7.f, restoredFlts->_array.back());
+        EXPECT_EQ(-2.5f, restoredFlts->_array[99]);
+    }
+
+    // repeated saves of 100 subtrees (1000 arrays each) with few small edits in between
+    TEST(tes_object, writeToDirectory_perft)
+    {
+        namespace fs = boost::filesystem;
+
+        tes_context_standalone ctx;
+        const auto dir = fs::temp_directory_path() / "jc_write_directory_perft";
+        const auto filePath = (fs::temp_directory_path() / "jc_write_directory_perft.json").generic_string();
+        fs::remove_all(dir);
+
+        auto& root = map::object(ctx);
+        object_stack_ref rootRef = &root;
+        const int subtreeCount = 100;
+        for (int i = 0; i < subtreeCount; ++i) {
+            root.u_set("mod" + std::to_string(i) + ".json", item(make_async_io_graph(ctx, 1000)));
+        }
+
+        std::mt19937 random(42);
+        auto edit = [&]() {
+            for (int i = 0; i < 3; ++i) {
+                auto subtree = root.findOrDef("mod" + std::to_string(random() % subtreeCount) + ".json").object();
+                subtree->as<map>()->set("key" + std::to_string(random() % 1000), item("edited"));
+            }
+        };
+
+        tes_object::writeToDirectory(ctx, &root, dir.generic_string().c_str());
+        const int saves = 10;
+        util::do_with_timing("writeToFile, 10 saves", [&]() {
+            for (int i = 0; i < saves; ++i) {
+                edit();
+                tes_object::writeToFile(ctx, &root, filePath.c_str());
+            }
+        });
+        int written = 0;
+        util::do_with_timing("writeToDirectory, 10 saves", [&]() {
+            for (int i = 0; i < saves; ++i) {
+                edit();
+                written += tes_object::writeToDirectory(ctx, &root, dir.generic_string().c_str());
+            }
+        });
+        EXPECT_TRUE(written > 0 && written <= saves * 3);
+        JC_log("writeToDirectory: %d files of %d rewritten", written, saves * subtreeCount);
+
+        fs::remove_all(dir);
+        fs::remove(filePath);
+    }
+
+    // 100k records: random key lookups in a data pack versus the same lookups in the container, read from JSON
+    TEST(tes_data_pack, lookups_and_perft)
+    {
+        namespace fs = boost::filesystem;
+
+        tes_context_standalone ctx;
+        const auto jsonPath = (fs::temp_directory_path() / "jc_data_pack_perft.json").generic_string();
+        const auto packPath = (fs::temp_directory_path() / "jc_data_pack_perft.jcpack").generic_string();
+
+        const int recordCount = 100000;
+        {
+            tes_context_standalone source;
+            auto& root = map::object(source);
+            for (int i = 0; i < recordCount; ++i) {
+                auto& record = map::object(source);
+                record.u_set("weight", item(i));
+                record.u_set("value", item(i * 0.5f));
+                record.u_set("name", item("recipe " + std::to_string(i)));
+                auto& ingredients = array::object(source);
+                ingredients.u_push(item(i % 7));
+                ingredients.u_push(item(i % 11));
+                record.u_set("ingredients", item(ingredients));
+                root.u_set("recipe" + std::to_string(i), item(record));
+            }
+            json_file_requests::write_file(root, jsonPath.c_str());
+        }
+        ASSERT_TRUE(data_pack_writer::pack_json_file(jsonPath.c_str(), packPath.c_str()));
+        JC_log("JSON file size: %u KB, data pack size: %u KB",
+            (uint32_t)(fs::file_size(jsonPath) / 1024), (uint32_t)(fs::file_size(packPath) / 1024));
+
+        std::vector<std::string> paths;
+        std::mt19937 random(42);
+        for (int i = 0; i < recordCount; ++i) {
+            paths.push_back(".recipe" + std::to_string(random() % recordCount) + ".weight");
+        }
+
+        size_t peakBefore = util::peak_memory_usage();
+        int64_t packSum = 0;
+        util::do_with_timing("data pack: open and 100k random lookups", [&]() {
+            for (auto& path : paths) {
+                packSum += tes_data_pack::solveGetter<SInt32>(ctx, packPath.c_str(), path.c_str());
+            }
+        });
+        JC_log("data pack: peak working set grew by %u KB", (uint32_t)((util::peak_memory_usage() - peakBefore) / 1024));
+
+        peakBefore = util::peak_memory_usage();
+        int64_t materializedSum = 0;
+        util::do_with_timing("readFromFile and 100k random lookups", [&]() {
+            object_stack_ref root = tes_object::readFromFile(ctx, jsonPath.c_str());
+            for (auto& path : paths) {
+                materializedSum += tes_object::resolveGetter<SInt32>(ctx, root.get(), path.c_str());
+            }
+        });
+        JC_log("readFromFile: peak working set grew by %u KB", (uint32_t)((util::peak_memory_usage() - peakBefore) / 1024));
+        EXPECT_EQ(materializedSum, packSum);
+
+        EXPECT_EQ(recordCount, tes_data_pack::count(ctx, packPath.c_str(), ""));
+        EXPECT_EQ(std::string("recipe 5"), tes_data_pack::solveGetter<skse::string_ref>(ctx, packPath.c_str(), ".recipe5.name").c_str());
+        EXPECT_EQ(2.5f, tes_data_pack::solveGetter<Float32>(ctx, packPath.c_str(), ".recipe5.value"));
+        EXPECT_EQ(-1, tes_data_pack::solveGetter<SInt32>(ctx, packPath.c_str(), ".recipe5.missing", -1));
+        EXPECT_TRUE(tes_data_pack::hasPath(ctx, packPath.c_str(), ".recipe5.ingredients[1]"));
+        EXPECT_FALSE(tes_data_pack::hasPath(ctx, "no such pack", ""));
+
+        // the container is a copy: modifying it doesn't change the pack
+        object_stack_ref copy = tes_data_pack::solveGetter<object_base*>(ctx, packPath.c_str(), ".recipe5");
+        ASSERT_TRUE(copy != nullptr);
+        copy->as<map>()->set(std::string("weight"), item(-5));
+        EXPECT_EQ(5, tes_data_pack::solveGetter<SInt32>(ctx, packPath.c_str(), ".recipe5.weight"));
+        EXPECT_TRUE(copy.get() != tes_data_pack::solveGetter<object_base*>(ctx, packPath.c_str(), ".recipe5"));
+
+        EXPECT_TRUE(tes_data_pack::unload(ctx, packPath.c_str()));
+        EXPECT_FALSE(tes_data_pack::unload(ctx, packPath.c_str()));
+
+        fs::remove(jsonPath);
+        fs::remove(packPath);
+    }
+
+    TEST(tes_object, async_file_requests_perft)
+    {
+        namespace fs = boost::filesystem;
+
+        tes_context_standalone ctx;
+        const auto path = (fs::temp_directory_path() / "jc_async_requests_perft.json").generic_string();
+        object_stack_ref root = make_async_io_graph(ctx, 100000);
+
+        // time the calling thread is blocked for
+        util::do_with_timing("writeToFile, 100k arrays", [&]() {
+            tes_object::writeToFile(ctx, root.get(), path.c_str());
+        });
+        SInt32 writing = 0;
+        util::do_with_timing("writeToFileAsync, 100k arrays", [&]() {
+            writing = tes_object::writeToFileAsync(ctx, root.get(), path.c_str());
+        });
+        json_file_requests::of(ctx).wait(writing);
+        tes_object::asyncRequestResult(ctx, writing);
+
+        util::do_with_timing("readFromFile, 100k arrays", [&]() {
+            tes_object::readFromFile(ctx, path.c_str());
+        });
+        SInt32 reading = 0;
+        util::do_with_timing("readFromFileAsync, 100k arrays", [&]() {
+            reading = tes_object::readFromFileAsync(ctx, path.c_str());
+        });
+        json_file_requests::of(ctx).wait(reading);
+        EXPECT_NOT_NIL(tes_object::asyncRequestResult(ctx, reading));
+
+        fs::remove(path);
+    }
 }
 
 #endif
@@ -6,6 +6,7 @@
 #include <boost/range/algorithm/find_end.hpp>
 
 #include <functional>
+#include <vector>
 
 #include "forms/form_handling.h"
 #include "collections/collections.h"
@@ -45,6 +46,13 @@ namespace collections
             }
         };
 
+        // The containers on the way are only read: the const lookup neither counts as a modification,
+        // nor drops the value index of an array
+        template<class T, class Key>
+        static item* _u_lookup(T& container, const Key& key) {
+            return const_cast<item*>(static_cast<const T&>(container).u_get(key));
+        }
+
         template<class T>
         static bool _map_visit_helper(tes_context& context, T& container, path_type path, std::function<void(item *)>&& function)
         {
@@ -84,6 +92,20 @@ namespace collections
             return true;
         }
 
+        template<class T, CollectionType Type, class F>
+        static void _typed_array_visit_helper(typed_array<T, Type>& container, path_type path, F& function)
+        {
+            // numbers have no sub-paths
+            if (!path.empty()) {
+                return;
+            }
+
+            for (auto value : container.container_copy()) {
+                item itm(value);
+                function(&itm);
+            }
+        }
+
         void resolve(tes_context& context, item& target, const char *cpath,
             const std::function<void(item *)>& itemFunction, bool createMissingKeys)
         {
@@ -149,10 +171,17 @@ namespace collections
                 }
 
                 item sharedItem;
+                // reducing operators receive all visited values at once
+                std::vector<item> gathered;
 
                 auto itemVisitFunc = [&](item *item) {
                     if (item) {
-                        opr->func(*item, sharedItem);
+                        if (opr->reduce) {
+                            gathered.push_back(*item);
+                        }
+                        else {
+                            opr->func(*item, sharedItem);
+                        }
                     }
                 };
 
@@ -161,14 +190,33 @@ namespace collections
                     decltype(context)       context;
                     decltype(rightPath)     *rightPath;
                     decltype(itemVisitFunc) *visitFunc;
+                    decltype(opr)           opr;
+                    decltype(gathered)      *gathered;
 
                     void operator()(array& arr) {
                         // have to copy array to prevent its modification during iteration
                         auto array_copy = arr.container_copy();
+                        if (opr->reduce && rightPath->empty()) {
+                            // values are visited as is, no need to resolve them one by one
+                            *gathered = std::move(array_copy);
+                            return;
+                        }
                         for (auto &itm : array_copy) {
                             resolve(context, itm, rightPath->begin(), *visitFunc);
                         }
                     }
+                    void operator()(set& cnt) {
+                        auto values = cnt.container_copy();
+                        for (auto &itm : values) {
+                            resolve(context, itm, rightPath->begin(), *visitFunc);
+                        }
+                    }
+                    void operator()(int_array& arr) {
+                        _typed_array_visit_helper(arr, *rightPath, *visitFunc);
+                    }
+                    void operator()(float_array& arr) {
+                        _typed_array_visit_helper(arr, *rightPath, *visitFunc);
+                    }
                     void operator()(map& cnt) {
                         _map_visit_helper(context, cnt, *rightPath, *visitFunc);
                     }
@@ -179,10 +227,14 @@ namespace collections
                         _map_visit_helper(context, cnt, *rightPath, *visitFunc);
                     }
 
-                } helper{ context, &rightPath, &itemVisitFunc };
+                } helper{ context, &rightPath, &itemVisitFunc, opr, &gathered };
 
                 perform_on_object(*collection, helper);
 
+                if (opr->reduce) {
+                    opr->reduce(context, gathered.data(), gathered.data() + gathered.size(), sharedItem);
+                }
+
                 return state(true,
                     [=](object_base *) mutable -> item* { return &sharedItem;},
                     nullptr,
@@ -208,6 +260,9 @@ namespace collections
                 auto node = st.nodeGetter(st.object);
 
                 if (createMissingKeys && node && node->isNull()) {
+                    if (st.object) {
+                        st.object->u_mark_modified();
+                    }
                     *node = map::object(context);
                 }
 
@@ -223,11 +278,10 @@ namespace collections
 
                                         if (auto obj = container->as<map>()) {
                                             ss::string key(begin, end);
-                                            itemPtr = obj->u_get(key);
+                                            itemPtr = _u_lookup(*obj, key);
 
                                             if (!itemPtr && createMissingKeys) {
-                                                obj->u_set(key, item());
-                                                itemPtr = obj->u_get(key);
+                                                itemPtr = obj->u_set(key, item());
                                             }
                                         }
 
@@ -284,13 +338,13 @@ namespace collections
                 return state(   true,
                                 [=, &context](object_base* container) {
                                     if (container->as<array>()) {
-                                        return container->as<array>()->u_get(indexOrFormId);
+                                        return _u_lookup(*container->as<array>(), indexOrFormId);
                                     }
                                     else if (container->as<form_map>()) {
-                                        return container->as<form_map>()->u_get(make_weak_form_id(frmId, context));
+                                        return _u_lookup(*container->as<form_map>(), make_weak_form_id(frmId, context));
                                     }
                                     else if (container->as<integer_map>()) {
-                                        return container->as<integer_map>()->u_get(indexOrFormId);
+                                        return _u_lookup(*container->as<integer_map>(), indexOrFormId);
                                     }
                                     else {
                                         return (item *)nullptr;
@@ -454,26 +508,26 @@ namespace collections
                     return bs::none;
                 }
                 object_lock lock(collection);
-                auto itemPtr = u_access_value(collection, key->key);
+                if (auto found = u_access_value(collection, key->key)) {
+                    return bs::make_optional(found->object());
+                }
                 /*  is int-map and key is int
                 is form-map
                 is map and key is string
                 failure
                 */
-                if (!itemPtr) {
-                    itemPtr = u_assign_value(collection, key->key, item());
-                    auto next_key = parse_path(HACK_get_tcontext(collection), key->rest_of_path);
-                    if (itemPtr && next_key) {
-                        struct creator : public bs::static_visitor<object_base*> {
-                            object_context* ctx;
-                            explicit creator(object_context* c) : ctx(c) {}
-
-                            object_base* operator ()(const int32_t& k) const { return &integer_map::object(*ctx); }
-                            object_base* operator ()(const string& k) const { return &map::object(*ctx); }
-                            object_base* operator ()(const form_ref& k) const { return &form_map::object(*ctx); }
-                        };
-                        *itemPtr = bs::apply_visitor(creator(&collection.context()), next_key->key);
-                    }
+                auto itemPtr = u_assign_value(collection, key->key, item());
+                auto next_key = parse_path(HACK_get_tcontext(collection), key->rest_of_path);
+                if (itemPtr && next_key) {
+                    struct creator : public bs::static_visitor<object_base*> {
+                        object_context* ctx;
+                        explicit creator(object_context* c) : ctx(c) {}
+
+                        object_base* operator ()(const int32_t& k) const { return &integer_map::object(*ctx); }
+                        object_base* operator ()(const string& k) const { return &map::object(*ctx); }
+                        object_base* operator ()(const form_ref& k) const { return &form_map::object(*ctx); }
+                    };
+                    *itemPtr = bs::apply_visitor(creator(&collection.context()), next_key->key);
                 }
 
                 return itemPtr ? bs::make_optional(itemPtr->object()) : bs::none;
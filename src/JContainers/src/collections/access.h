@@ -16,6 +16,7 @@ namespace collections
 
     namespace path_resolving {
 
+        // The visited item is only to be read: resolving doesn't mark the containers on the way modified
         void resolve(tes_context& ctx, item& target, const char *cpath,
             const std::function<void(item *)>& itemFunction, bool createMissingKeys = false);
 
@@ -42,16 +43,31 @@ namespace collections
 
         struct u_access_value_helper {
             template<class Collection>
-            item* operator () (Collection& collection, const key_variant& key) {
+            const item* operator () (const Collection& collection, const key_variant& key) {
                 if (auto idx = bs::get<typename Collection::key_type>(&key)) {
                     return collection.u_get(*idx);
                 }
                 return nullptr;
             }
+            // typed array values aren't items
+            template<class T, CollectionType Type>
+            const item* operator () (const typed_array<T, Type>&, const key_variant&) {
+                return nullptr;
+            }
+        };
+
+        // read-only access, doesn't count as a modification of the collection
+        inline auto u_access_value(const object_base& collection, const key_variant& key) -> const item* {
+            return perform_on_object_and_return<const item* >(collection, u_access_value_helper(), key);
         };
 
-        inline auto u_access_value(object_base& collection, const key_variant& key) -> item* {
-            return perform_on_object_and_return<item* >(collection, u_access_value_helper(), key);
+        // access to the value which is about to be modified: the collection gets marked modified beforehand
+        inline auto u_access_value_to_modify(object_base& collection, const key_variant& key) -> item* {
+            auto itmPtr = const_cast<item*>(u_access_value(collection, key));
+            if (itmPtr) {
+                collection.u_mark_modified();
+            }
+            return itmPtr;
         };
         // 
 
@@ -64,6 +80,10 @@ namespace collections
                 }
                 return nullptr;
             }
+            template<class T, CollectionType Type>
+            item* operator()(typed_array<T, Type>&, const key_variant&, Value&&) {
+                return nullptr;
+            }
         };
 
         template<class Value>
@@ -92,8 +112,8 @@ namespace collections
         };
 
         template<class T>
-        inline bs::optional<T> _opt_from_pointer(T* t) {
-            return t ? bs::optional<T>(*t) : bs::none;
+        inline bs::optional<std::remove_const_t<T> > _opt_from_pointer(T* t) {
+            return t ? bs::optional<std::remove_const_t<T> >(*t) : bs::none;
         }
 
         enum access_way {
@@ -117,12 +137,15 @@ namespace collections
             }
         }
 
+        // @f which accepts const item& only reads the value, otherwise the collection gets marked modified
         template<class Func, class ...Args>
         inline bool visit_value(object_base& target, const char *cpath, access_way way, Func f, Args&&... args) {
             auto ac_info = (way == constant ? access_constant(target, cpath) : access_creative(target, cpath));
             if (ac_info) {
                 object_lock g(ac_info->collection);
-                auto itmPtr = u_access_value(ac_info->collection, ac_info->key);
+                auto itmPtr = std::is_invocable_v<Func, const item&, Args...>
+                    ? const_cast<item*>(u_access_value(ac_info->collection, ac_info->key))
+                    : u_access_value_to_modify(ac_info->collection, ac_info->key);
                 if (itmPtr) {
                     f(*itmPtr, std::forward<Args>(args)...);
                 }
@@ -152,7 +175,7 @@ namespace collections
             if (ac_info) {
                 object_lock g(ac_info->collection);
                 if (way == constant) {
-                    auto itmPtr = u_access_value(ac_info->collection, ac_info->key);
+                    auto itmPtr = u_access_value_to_modify(ac_info->collection, ac_info->key);
                     if (itmPtr) {
                         *itmPtr = std::forward<Value>(value);
                     }
@@ -35,6 +35,9 @@ namespace reflection { namespace binding {
     template<> struct GetConv < map* > : ObjectConverter< map >{};
     template<> struct GetConv < form_map* > : ObjectConverter< form_map >{};
     template<> struct GetConv < integer_map* > : ObjectConverter < integer_map >{};
+    template<> struct GetConv < int_array* > : ObjectConverter < int_array >{};
+    template<> struct GetConv < float_array* > : ObjectConverter < float_array >{};
+    template<> struct GetConv < set* > : ObjectConverter < set >{};
 
     //////////////////////////////////////////////////////////////////////////
 
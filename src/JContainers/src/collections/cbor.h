@@ -0,0 +1,390 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "collections/json_writer.h"
+
+namespace collections {
+
+    // CBOR (RFC 8949) encoding primitives, the binary counterpart of json_writer and json_pull_parser
+    namespace cbor {
+
+        enum major_type : uint8_t {
+            major_unsigned = 0,
+            major_negative = 1,
+            major_bytes = 2,
+            major_text = 3,
+            major_array = 4,
+            major_map = 5,
+            major_tag = 6,
+            major_simple = 7,
+        };
+
+        enum : uint8_t {
+            info_indefinite = 31,
+
+            simple_false = 20,
+            simple_true = 21,
+            simple_null = 22,
+            simple_undefined = 23,
+
+            info_half = 25,
+            info_float = 26,
+            info_double = 27,
+
+            break_byte = 0xFF,
+        };
+
+        enum tag : uint64_t {
+            // "self-described CBOR" - the magic number the data starts with
+            tag_self_described = 55799,
+            // registered "mathematical finite set" tag, used for JSet
+            tag_set = 258,
+            // the tags below are private to JContainers
+            tag_form = 0x4A40,          // [mod name or index of already written one, relative form id]
+            tag_form_map = 0x4A41,      // JFormMap, the tagged map is keyed by forms
+            tag_integer_map = 0x4A42,   // JIntMap, the tagged map is keyed by integers
+            tag_int_array = 0x4A43,     // JIntArray
+            tag_float_array = 0x4A44,   // JFltArray
+            tag_reference = 0x4A45,     // a path to the object, see reference_serialization
+        };
+
+        inline bool starts_with_magic(const char *begin, const char *end) {
+            static const unsigned char magic[] = { 0xD9, 0xD9, 0xF7 };
+            return size_t(end - begin) >= sizeof magic && memcmp(begin, magic, sizeof magic) == 0;
+        }
+    }
+
+    // Emits CBOR data items into json_text_output. Containers are written definite-length when the number of
+    // items is known in advance, maps with possibly skipped keys are written as indefinite-length ones
+    class cbor_writer {
+    public:
+
+        explicit cbor_writer(json_text_output& output) : _output(output) {}
+
+        void head(uint8_t major, uint64_t value) {
+            unsigned char buffer[9];
+            size_t length = 1;
+            if (value < 24) {
+                buffer[0] = static_cast<unsigned char>(major << 5 | value);
+            }
+            else {
+                int bytes = value <= 0xFF ? 1 : value <= 0xFFFF ? 2 : value <= 0xFFFFFFFFull ? 4 : 8;
+                buffer[0] = static_cast<unsigned char>(major << 5 | (bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27));
+                for (int i = bytes - 1; i >= 0; --i) {
+                    buffer[length++] = static_cast<unsigned char>(value >> (i * 8));
+                }
+            }
+            _output.write(reinterpret_cast<const char *>(buffer), length);
+        }
+
+        void self_described() {
+            head(cbor::major_tag, cbor::tag_self_described);
+        }
+
+        void tag(uint64_t value) {
+            head(cbor::major_tag, value);
+        }
+
+        void integer(int64_t value) {
+            if (value >= 0) {
+                head(cbor::major_unsigned, static_cast<uint64_t>(value));
+            }
+            else {
+                head(cbor::major_negative, static_cast<uint64_t>(-(value + 1)));
+            }
+        }
+
+        // the single precision is what JContainers stores
+        void real(float value) {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof bits);
+            unsigned char buffer[5] = {
+                static_cast<unsigned char>(cbor::major_simple << 5 | cbor::info_float),
+                static_cast<unsigned char>(bits >> 24), static_cast<unsigned char>(bits >> 16),
+                static_cast<unsigned char>(bits >> 8), static_cast<unsigned char>(bits) };
+            _output.write(reinterpret_cast<const char *>(buffer), sizeof buffer);
+        }
+
+        // valid UTF-8 is written as a text string, anything else as a byte string
+        void string(const char *str, size_t length) {
+            head(json_writer::is_valid_utf8(str, length) ? cbor::major_text : cbor::major_bytes, length);
+            _output.write(str, length);
+        }
+
+        void null() {
+            _output.put(static_cast<char>(cbor::major_simple << 5 | cbor::simple_null));
+        }
+
+        void begin_array(size_t count) {
+            head(cbor::major_array, count);
+        }
+
+        void begin_map() {
+            _output.put(static_cast<char>(cbor::major_map << 5 | cbor::info_indefinite));
+        }
+
+        void end_map() {
+            _output.put(static_cast<char>(cbor::break_byte));
+        }
+
+        // A mod name is written once, its later occurrences are replaced with the index of the first one
+        void form(std::string_view mod, uint32_t relativeId) {
+            tag(cbor::tag_form);
+            begin_array(2);
+
+            if (!_mods.empty() && mod == _lastMod) {
+                head(cbor::major_unsigned, _lastModIndex);
+            }
+            else {
+                auto inserted = _mods.emplace(std::string(mod), static_cast<uint32_t>(_mods.size()));
+                if (inserted.second) {
+                    string(mod.data(), mod.size());
+                }
+                else {
+                    head(cbor::major_unsigned, inserted.first->second);
+                }
+                _lastMod = mod;
+                _lastModIndex = inserted.first->second;
+            }
+
+            head(cbor::major_unsigned, relativeId);
+        }
+
+    private:
+        json_text_output& _output;
+        std::unordered_map<std::string, uint32_t> _mods;
+        std::string _lastMod;
+        uint32_t _lastModIndex = 0;
+    };
+
+    // Reads CBOR data items one by one. All reads are bounds-checked, a failed one returns false
+    class cbor_reader {
+    public:
+
+        struct head {
+            uint8_t major = 0;
+            uint8_t info = 0;
+            uint64_t value = 0;
+
+            bool indefinite() const { return info == cbor::info_indefinite; }
+        };
+
+        // how deep containers and tags may nest, as json_pull_parser::max_depth: the data gets built recursively
+        enum { max_depth = 2048 };
+
+        cbor_reader(const char *begin, const char *end)
+            : _begin(reinterpret_cast<const unsigned char *>(begin))
+            , _cur(_begin)
+            , _end(reinterpret_cast<const unsigned char *>(end))
+        {}
+
+        bool at_end() const { return _cur == _end; }
+        size_t offset() const { return _cur - _begin; }
+        size_t remaining() const { return _end - _cur; }
+
+        bool read_head(head& h) {
+            if (_cur == _end) {
+                return false;
+            }
+            const unsigned char initial = *_cur++;
+            h.major = initial >> 5;
+            h.info = initial & 0x1F;
+
+            if (h.info < 24) {
+                h.value = h.info;
+                return true;
+            }
+            if (h.info > 27) {
+                // 28-30 are reserved, indefinite length applies to strings and containers only
+                h.value = 0;
+                return h.info == cbor::info_indefinite &&
+                    (h.major == cbor::major_bytes || h.major == cbor::major_text || h.major == cbor::major_array ||
+                     h.major == cbor::major_map || h.major == cbor::major_simple);
+            }
+
+            const size_t bytes = size_t(1) << (h.info - 24);
+            if (remaining() < bytes) {
+                return false;
+            }
+            h.value = 0;
+            for (size_t i = 0; i < bytes; ++i) {
+                h.value = (h.value << 8) | *_cur++;
+            }
+            return true;
+        }
+
+        // consumes the "break" stop code, if it's next
+        bool read_break() {
+            if (_cur != _end && *_cur == cbor::break_byte) {
+                ++_cur;
+                return true;
+            }
+            return false;
+        }
+
+        // reads the byte or text string which head @h has been read
+        bool read_string(const head& h, std::string& str) {
+            str.clear();
+            if (!h.indefinite()) {
+                return append_chunk(h.value, str);
+            }
+            // a sequence of definite-length chunks of the same type
+            while (!read_break()) {
+                head chunk;
+                if (!read_head(chunk) || chunk.major != h.major || chunk.indefinite() || !append_chunk(chunk.value, str)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static bool is_real(const head& h) {
+            return h.major == cbor::major_simple && h.info >= cbor::info_half && h.info <= cbor::info_double;
+        }
+
+        static double real_value(const head& h) {
+            switch (h.info) {
+            case cbor::info_half: {
+                const int exponent = (h.value >> 10) & 0x1F;
+                const double mantissa = double(h.value & 0x3FF);
+                double value = exponent == 0 ? std::ldexp(mantissa, -24)
+                    : exponent != 31 ? std::ldexp(mantissa + 1024, exponent - 25)
+                    : mantissa == 0 ? INFINITY : NAN;
+                return (h.value & 0x8000) ? -value : value;
+            }
+            case cbor::info_float: {
+                const uint32_t bits = static_cast<uint32_t>(h.value);
+                float value;
+                memcpy(&value, &bits, sizeof value);
+                return value;
+            }
+            default: {
+                double value;
+                memcpy(&value, &h.value, sizeof value);
+                return value;
+            }
+            }
+        }
+
+        // Skips (and validates) the whole next data item. Iterative, yet rejects nesting deeper than max_depth:
+        // the data it has validated must be safe to read recursively. Rejects the integers out of the int64_t range
+        bool skip_value() {
+            head h;
+            return read_head(h) && skip_rest(h);
+        }
+
+        // skips the rest of the data item which head @h has been read
+        bool skip_rest(head h) {
+            const uint64_t until_break = UINT64_MAX;
+            std::vector<uint64_t> open; // the number of items left in each of the containers being skipped
+
+            for (bool haveHead = true;; haveHead = false) {
+                bool complete = true;
+
+                if (!haveHead && open.back() == until_break && read_break()) {
+                    open.pop_back();
+                }
+                else if (haveHead || read_head(h)) {
+                    uint64_t nested = 0;
+                    switch (h.major) {
+                    case cbor::major_unsigned:
+                    case cbor::major_negative:
+                        if (h.value > static_cast<uint64_t>(INT64_MAX)) { // as json_pull_parser, integers must fit into int64_t
+                            return false;
+                        }
+                        break;
+                    case cbor::major_bytes:
+                    case cbor::major_text:
+                        if (!skip_string(h)) {
+                            return false;
+                        }
+                        break;
+                    case cbor::major_array:
+                    case cbor::major_map:
+                        if (h.indefinite()) {
+                            nested = until_break;
+                        }
+                        else if (h.value > remaining()) { // each item takes a byte at least
+                            return false;
+                        }
+                        else {
+                            nested = h.major == cbor::major_map ? h.value * 2 : h.value;
+                        }
+                        break;
+                    case cbor::major_tag:
+                        nested = 1;
+                        break;
+                    case cbor::major_simple:
+                        if (h.indefinite()) { // unexpected break
+                            return false;
+                        }
+                        break;
+                    default:
+                        break;
+                    }
+
+                    if (nested != 0) {
+                        if (open.size() >= max_depth) {
+                            return false;
+                        }
+                        open.push_back(nested);
+                        complete = false;
+                    }
+                }
+                else {
+                    return false;
+                }
+
+                if (complete) {
+                    // a data item is complete, so may be the containers it completes
+                    while (!open.empty() && open.back() != until_break && --open.back() == 0) {
+                        open.pop_back();
+                    }
+                }
+
+                if (open.empty()) {
+                    return true;
+                }
+            }
+        }
+
+    private:
+        const unsigned char *_begin;
+        const unsigned char *_cur;
+        const unsigned char *_end;
+
+        bool append_chunk(uint64_t length, std::string& str) {
+            if (length > remaining()) {
+                return false;
+            }
+            str.append(reinterpret_cast<const char *>(_cur), static_cast<size_t>(length));
+            _cur += length;
+            return true;
+        }
+
+        bool skip_string(const head& h) {
+            if (!h.indefinite()) {
+                if (h.value > remaining()) {
+                    return false;
+                }
+                _cur += h.value;
+                return true;
+            }
+            while (!read_break()) {
+                head chunk;
+                if (!read_head(chunk) || chunk.major != h.major || chunk.indefinite() || chunk.value > remaining()) {
+                    return false;
+                }
+                _cur += chunk.value;
+            }
+            return true;
+        }
+    };
+}
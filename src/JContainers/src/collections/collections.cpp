@@ -43,7 +43,11 @@ BOOST_CLASS_EXPORT_GUID(collections::array, "kJArray");
 BOOST_CLASS_EXPORT_GUID(collections::map, "kJMap");
 BOOST_CLASS_EXPORT_GUID(collections::form_map, "kJFormMap");
 BOOST_CLASS_EXPORT_GUID(collections::integer_map, "kJIntegerMap");
+BOOST_CLASS_EXPORT_GUID(collections::int_array, "kJIntArray");
+BOOST_CLASS_EXPORT_GUID(collections::float_array, "kJFltArray");
+BOOST_CLASS_EXPORT_GUID(collections::set, "kJSet");
 
+BOOST_CLASS_VERSION(collections::array, 1)
 BOOST_CLASS_VERSION(collections::form_map, 1)
 BOOST_CLASS_VERSION(collections::item, 3)
 
@@ -101,6 +105,14 @@ namespace collections {
     void array::serialize(Archive & ar, const unsigned int version) {
         ar & boost::serialization::base_object<object_base>(*this);
         ar & _array;
+
+        if (version >= 1) {
+            bool indexed = u_value_index_enabled();
+            ar & indexed;
+            if (Archive::is_loading::value) {
+                u_enable_value_index(indexed);
+            }
+        }
     }
 
     template<class Archive>
@@ -147,6 +159,22 @@ namespace collections {
         ar & cnt;
     }
 
+    template<class T, CollectionType Type>
+    template<class Archive>
+    void typed_array<T, Type>::serialize(Archive & ar, const unsigned int version) {
+        ar & boost::serialization::base_object<object_base>(*this);
+        ar & _array;
+    }
+
+    template<class Archive>
+    void set::serialize(Archive & ar, const unsigned int version) {
+        ar & boost::serialization::base_object<object_base>(*this);
+        ar & _array;
+        if (Archive::is_loading::value) {
+            _index_outdated = true;
+        }
+    }
+
     //////////////////////////////////////////////////////////////////////////
 
     void form_map::u_onLoaded() {
@@ -162,6 +190,24 @@ namespace collections {
         for (auto& item : _array) {
             item.u_nullifyObject();
         }
+        u_invalidate_value_index();
+    }
+
+    void set::u_onLoaded() {
+        _array.erase(
+            std::remove_if(_array.begin(), _array.end(), [](const item& itm) {
+                auto form = itm.get<form_ref>();
+                return form && form->is_expired();
+            }),
+            _array.end());
+        _index_outdated = true;
+    }
+
+    void set::u_nullifyObjects() {
+        for (auto& item : _array) {
+            item.u_nullifyObject();
+        }
+        _index_outdated = true;
     }
 
     //////////////////////////////////////////////////////////////////////////
@@ -2,6 +2,9 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <memory>
+#include <algorithm>
 #include <assert.h>
 
 #include <boost/serialization/split_member.hpp>
@@ -15,11 +18,16 @@
 #include "object/object_base.h"
 
 #include "collections/item.h"
+#include "collections/item_hash.h"
 
 namespace collections {
 
 	class tes_context;
 
+    template<class T, CollectionType Type> class typed_array;
+    typedef typed_array<SInt32, CollectionType::IntArray> int_array;
+    typedef typed_array<Float32, CollectionType::FloatArray> float_array;
+
     template<class T>
     class collection_base : public object_base
     {
@@ -78,6 +86,12 @@ namespace collections {
             return func(container.as_link<form_map>(), std::forward<Args>(args)...);
         case integer_map::TypeId:
             return func(container.as_link<integer_map>(), std::forward<Args>(args)...);
+        case int_array::TypeId:
+            return func(container.as_link<int_array>(), std::forward<Args>(args)...);
+        case float_array::TypeId:
+            return func(container.as_link<float_array>(), std::forward<Args>(args)...);
+        case set::TypeId:
+            return func(container.as_link<set>(), std::forward<Args>(args)...);
         default:
             assert(false);
             noreturn_func();
@@ -100,6 +114,15 @@ namespace collections {
         case integer_map::TypeId:
             func(container.as_link<integer_map>(), std::forward<Args>(args)...);
             break;
+        case int_array::TypeId:
+            func(container.as_link<int_array>(), std::forward<Args>(args)...);
+            break;
+        case float_array::TypeId:
+            func(container.as_link<float_array>(), std::forward<Args>(args)...);
+            break;
+        case set::TypeId:
+            func(container.as_link<set>(), std::forward<Args>(args)...);
+            break;
         default:
             assert(false);
             break;
@@ -108,6 +131,7 @@ namespace collections {
 
     class array;
     class map;
+    class set;
     class object_base;
 
     class array : public collection_base< array >
@@ -129,10 +153,121 @@ namespace collections {
         typedef int32_t key_type;
         typedef container_type::iterator iterator;
         typedef container_type::reverse_iterator reverse_iterator;
+        // value hash -> position in _array
+        typedef std::unordered_multimap<size_t, uint32_t> value_index_type;
 
+        // direct modifications of the _array must be followed by u_invalidate_value_index call
         container_type _array;
 
+    private:
+
+        // optional, see u_enable_value_index
+        std::unique_ptr<value_index_type> _valueIndex;
+        bool _valueIndexOutdated = false;
+
+        value_index_type* _u_actual_value_index() {
+            if (_valueIndex && _valueIndexOutdated) {
+                _valueIndex->clear();
+                _valueIndex->reserve(_array.size());
+                for (uint32_t i = 0; i < _array.size(); ++i) {
+                    _valueIndex->emplace(item_hasher()(_array[i]), i);
+                }
+                _valueIndexOutdated = false;
+            }
+            return _valueIndex.get();
+        }
+
+        bool _u_value_index_maintained() const {
+            return _valueIndex && !_valueIndexOutdated;
+        }
+
+        void _u_unindex_position(uint32_t position) {
+            auto range = _valueIndex->equal_range(item_hasher()(_array[position]));
+            for (auto itr = range.first; itr != range.second; ++itr) {
+                if (itr->second == position) {
+                    _valueIndex->erase(itr);
+                    break;
+                }
+            }
+        }
+
+    public:
+
+        // The index speeds up value lookups (u_find, u_count_value) on large arrays at the cost of memory.
+        // It's built lazily, on first lookup. Pushes and assignments keep it up to date,
+        // other modifications cause it to be rebuilt
+        void u_enable_value_index(bool enable) {
+            if (!enable) {
+                _valueIndex.reset();
+            }
+            else if (!_valueIndex) {
+                _valueIndex.reset(new value_index_type());
+                _valueIndexOutdated = true;
+            }
+        }
+
+        bool u_value_index_enabled() const {
+            return _valueIndex != nullptr;
+        }
+
+        // approximate amount of memory occupied by the index, in bytes
+        size_t u_value_index_memory_usage() const {
+            if (!_valueIndex) {
+                return 0;
+            }
+            // a node holds the pair, 'next' pointer and cached hash
+            const size_t nodeSize = sizeof(value_index_type::value_type) + 2 * sizeof(void*);
+            return sizeof(value_index_type) + _valueIndex->size() * nodeSize + _valueIndex->bucket_count() * sizeof(void*);
+        }
+
+        void u_invalidate_value_index() {
+            _valueIndexOutdated = true;
+        }
+
+        // Position of the first item equal to @value in [@from, end), or -1.
+        // With @reverse searches backwards, in [0, @from] range
+        int32_t u_find(const item& value, uint32_t from, bool reverse = false) {
+            if (auto index = _u_actual_value_index()) {
+                int32_t found = -1;
+                auto range = index->equal_range(item_hasher()(value));
+                for (auto itr = range.first; itr != range.second; ++itr) {
+                    const int32_t position = itr->second;
+                    const bool inRange = reverse
+                        ? (position <= (int32_t)from && position > found)
+                        : (position >= (int32_t)from && (found == -1 || position < found));
+                    if (inRange && _array[position] == value) {
+                        found = position;
+                    }
+                }
+                return found;
+            }
+
+            if (!reverse) {
+                auto itr = std::find(_array.cbegin() + from, _array.cend(), value);
+                return itr != _array.cend() ? (int32_t)(itr - _array.cbegin()) : -1;
+            }
+            else {
+                auto itr = std::find(_array.crbegin() + (_array.size() - 1 - from), _array.crend(), value);
+                return itr != _array.crend() ? (int32_t)(_array.crend() - itr - 1) : -1;
+            }
+        }
+
+        // the number of items equal to @value
+        uint32_t u_count_value(const item& value) {
+            if (auto index = _u_actual_value_index()) {
+                uint32_t count = 0;
+                auto range = index->equal_range(item_hasher()(value));
+                for (auto itr = range.first; itr != range.second; ++itr) {
+                    count += _array[itr->second] == value ? 1 : 0;
+                }
+                return count;
+            }
+            return static_cast<uint32_t>(std::count(_array.cbegin(), _array.cend(), value));
+        }
+
         container_type& u_container() {
+            u_invalidate_value_index();
+            u_mark_modified();
             return _array;
         }
 
@@ -151,11 +286,20 @@ namespace collections {
         }
 
         template<class T> void u_push(T&& item) {
+            u_mark_modified();
             _array.emplace_back(std::forward<T>(item));
+            if (_u_value_index_maintained()) {
+                _valueIndex->emplace(item_hasher()(_array.back()), static_cast<uint32_t>(_array.size() - 1));
+            }
         }
 
         void u_clear() override {
+            u_mark_modified();
             _array.clear();
+            if (_valueIndex) {
+                _valueIndex->clear();
+                _valueIndexOutdated = false;
+            }
         }
 
         SInt32 u_count() const override {
@@ -186,12 +330,25 @@ namespace collections {
         }
 
         item* u_get(int32_t index) {
-            return const_cast<item*>( const_cast<const array*>(this)->u_get(index) );
+            auto itm = const_cast<item*>( const_cast<const array*>(this)->u_get(index) );
+            if (itm) {
+                u_invalidate_value_index();
+                u_mark_modified();
+            }
+            return itm;
         }
 
         bool u_erase(int32_t index) {
             auto idx = u_convertIndex(index);
             if (idx) {
+                u_mark_modified();
+                // erasing the last item is the only case which doesn't shift indexed positions
+                if (_u_value_index_maintained() && *idx == _array.size() - 1) {
+                    _u_unindex_position(*idx);
+                }
+                else {
+                    u_invalidate_value_index();
+                }
                 _array.erase(_array.begin() + *idx);
                 return true;
             }
@@ -202,7 +359,16 @@ namespace collections {
         item* u_set(int32_t index, T&& itm) {
             auto idx = u_convertIndex(index);
             if (idx) {
-                return &(_array[*idx] = std::forward<T>(itm));
+                u_mark_modified();
+                const bool maintained = _u_value_index_maintained();
+                if (maintained) {
+                    _u_unindex_position(*idx);
+                }
+                item& assigned = (_array[*idx] = std::forward<T>(itm));
+                if (maintained) {
+                    _valueIndex->emplace(item_hasher()(assigned), static_cast<uint32_t>(*idx));
+                }
+                return &assigned;
             }
             return nullptr;
         }
@@ -218,7 +384,11 @@ namespace collections {
             return t ? boost::optional<T>(*t) : boost::none;
         }
 
-        item& operator [] (int32_t index) { return const_cast<item&>(const_cast<const array*>(this)->operator[](index)); }
+        item& operator [] (int32_t index) {
+            u_invalidate_value_index();
+            u_mark_modified();
+            return const_cast<item&>(const_cast<const array*>(this)->operator[](index));
+        }
         const item& operator [] (int32_t index) const {
             auto idx = u_convertIndex(index);
             assert(idx);
@@ -230,11 +400,11 @@ namespace collections {
             return _opt_from_pointer(u_get(index));
         }
 
-        iterator begin() { return _array.begin();}
-        iterator end() { return _array.end(); }
+        iterator begin() { u_invalidate_value_index(); u_mark_modified(); return _array.begin();}
+        iterator end() { u_invalidate_value_index(); u_mark_modified(); return _array.end(); }
 
-        reverse_iterator rbegin() { return _array.rbegin();}
-        reverse_iterator rend() { return _array.rend(); }
+        reverse_iterator rbegin() { u_invalidate_value_index(); u_mark_modified(); return _array.rbegin();}
+        reverse_iterator rend() { u_invalidate_value_index(); u_mark_modified(); return _array.rend(); }
 
 
         //////////////////////////////////////////////////////////////////////////
@@ -264,6 +434,7 @@ namespace collections {
         }
 
         container_type& u_container() {
+            this->u_mark_modified();
             return cnt;
         }
 
@@ -287,6 +458,7 @@ namespace collections {
         }
 
         item& u_get_or_create(const key_type& key) {
+            this->u_mark_modified();
             return cnt[key];
         }
 
@@ -298,7 +470,11 @@ namespace collections {
 
         template<class Key>
         item* u_get(const Key& key) {
-            return const_cast<item*>( const_cast<const basic_map_collection*>(this)->u_get(key) );
+            auto itm = const_cast<item*>( const_cast<const basic_map_collection*>(this)->u_get(key) );
+            if (itm) {
+                this->u_mark_modified();
+            }
+            return itm;
         }
 
         template<class Key>
@@ -313,14 +489,16 @@ namespace collections {
         template<class Key>
         bool u_erase(const Key& key) {
             typename container_type::iterator itr = RealType::_find(cnt, key);
-            return itr != cnt.end() ? (cnt.erase(itr), true) : false;
+            return itr != cnt.end() ? (this->u_mark_modified(), cnt.erase(itr), true) : false;
         }
 
         void u_clear() override {
+            this->u_mark_modified();
             cnt.clear();
         }
 
         template<class T, class Key> item* u_set(const Key& key, T&& value) {
+            this->u_mark_modified();
             return &(cnt[key] = std::forward<T>(value));
         }
 
@@ -335,6 +513,7 @@ namespace collections {
 
         template<class Key>
         item& operator [] (const Key& key) {
+            this->u_mark_modified();
             return const_cast<item&>(const_cast<const basic_map_collection&>(*this)[key]);
         }
 
@@ -346,7 +525,7 @@ namespace collections {
         }
         
         void u_visit_referenced_objects(const std::function<void(object_base&)>& visitor) override {
-            for (auto& pair : u_container()) {
+            for (auto& pair : cnt) {
                 if (auto obj = pair.second.object()) {
                     visitor(*obj);
                 }
@@ -404,6 +583,7 @@ namespace collections {
         }
 
         item& u_get_or_create(const form_ref_lightweight& key) {
+            u_mark_modified();
             return cnt[key.to_form_ref()];
         }
 
@@ -435,4 +615,340 @@ namespace collections {
         template<class Archive>
         void serialize(Archive & ar, const unsigned int version);
     };
+
+    // Contiguous array of plain numbers - JIntArray and JFltArray.
+    // Values aren't items, so they can't reference other containers and
+    // aren't reachable through key-paths (except path operators, like @sumNum)
+    template<class T, CollectionType Type>
+    class typed_array : public collection_base< typed_array<T, Type> >
+    {
+        typed_array(const typed_array&);
+        typed_array& operator=(const typed_array&);
+
+    public:
+
+        typed_array() {}
+
+        enum {
+            TypeId = Type,
+        };
+
+        typedef SInt32 Index;
+
+        typedef T value_type;
+        typedef std::vector<T> container_type;
+        typedef int32_t key_type;
+
+        // read directly, written through u_container() or the other u_ mutators: they mark the array modified
+        // before it gets modified (see object_base::u_mark_modified)
+        container_type _array;
+
+        container_type& u_container() {
+            this->u_mark_modified();
+            return _array;
+        }
+
+        const container_type& u_container() const {
+            return _array;
+        }
+
+        container_type container_copy() const {
+            object_lock g(this);
+            return _array;
+        }
+
+        void u_push(T value) {
+            this->u_mark_modified();
+            _array.push_back(value);
+        }
+
+        void u_clear() override {
+            this->u_mark_modified();
+            _array.clear();
+        }
+
+        SInt32 u_count() const override {
+            return _array.size();
+        }
+
+        // plain numbers - nothing to nullify
+        void u_nullifyObjects() override {}
+
+        //////////////////////////////////////////////////////////////////////////
+
+        boost::optional<int32_t> u_convertIndex(int32_t pyIndex) const {
+            int32_t count = (int32_t)_array.size();
+            int32_t index = (pyIndex >= 0 ? pyIndex : (count + pyIndex));
+            return{ index >= 0 && index < count, index };
+        }
+
+        const T* u_get(int32_t index) const {
+            auto idx = u_convertIndex(index);
+            return idx ? &_array[*idx] : nullptr;
+        }
+
+        T* u_get(int32_t index) {
+            auto value = const_cast<T*>( const_cast<const typed_array*>(this)->u_get(index) );
+            if (value) {
+                this->u_mark_modified();
+            }
+            return value;
+        }
+
+        bool u_erase(int32_t index) {
+            auto idx = u_convertIndex(index);
+            if (idx) {
+                this->u_mark_modified();
+                _array.erase(_array.begin() + *idx);
+                return true;
+            }
+            return false;
+        }
+
+        T* u_set(int32_t index, T value) {
+            auto idx = u_convertIndex(index);
+            if (idx) {
+                this->u_mark_modified();
+                return &(_array[*idx] = value);
+            }
+            return nullptr;
+        }
+
+        //////////////////////////////////////////////////////////////////////////
+
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version);
+    };
+
+    // Unordered collection of unique values - JSet. Values are kept in a vector
+    // (removal moves the last value into the freed slot), a hash index maps values to their positions.
+    // Direct access to the values (non-const u_container, u_get, u_set) invalidates the index,
+    // it gets rebuilt (and duplicates get removed) on next lookup
+    class set : public collection_base< set >
+    {
+        set(const set&);
+        set& operator=(const set&);
+
+    public:
+
+        set() {}
+
+        enum {
+            TypeId = CollectionType::Set,
+        };
+
+        typedef SInt32 Index;
+
+        typedef std::vector<item> container_type;
+        typedef int32_t key_type;
+        // value hash -> position in _array
+        typedef std::unordered_multimap<size_t, uint32_t> index_type;
+
+    private:
+
+        container_type _array;
+        index_type _index;
+        bool _index_outdated = false;
+
+        template<class Pred>
+        index_type::iterator _u_find_in_index(size_t hash, Pred&& pred) {
+            auto range = _index.equal_range(hash);
+            for (auto itr = range.first; itr != range.second; ++itr) {
+                if (pred(_array[itr->second])) {
+                    return itr;
+                }
+            }
+            return _index.end();
+        }
+
+        index_type::iterator _u_find_in_index(const item& value) {
+            return _u_find_in_index(item_hasher()(value), [&value](const item& itm) {
+                return item_hash_equal()(itm, value);
+            });
+        }
+
+        index_type::iterator _u_find_form_in_index(FormId id) {
+            return _u_find_in_index(item_hasher::hash_form(id), [id](const item& itm) {
+                auto form = itm.get<form_ref>();
+                return form && form->get_raw() == id;
+            });
+        }
+
+        void _u_remove_found(index_type::iterator found) {
+            u_mark_modified();
+            const uint32_t position = found->second, last = static_cast<uint32_t>(_array.size() - 1);
+            _index.erase(found);
+
+            if (position != last) {
+                // move the last value into the freed slot
+                auto lastInIndex = _index.equal_range(item_hasher()(_array[last]));
+                for (auto itr = lastInIndex.first; itr != lastInIndex.second; ++itr) {
+                    if (itr->second == last) {
+                        itr->second = position;
+                        break;
+                    }
+                }
+                _array[position] = std::move(_array[last]);
+            }
+            _array.pop_back();
+        }
+
+        // removes the duplicates, so it's a modification too
+        void _u_rebuild_index() {
+            u_mark_modified();
+            _index.clear();
+            _index.reserve(_array.size());
+
+            container_type unique;
+            unique.reserve(_array.size());
+
+            for (auto& value : _array) {
+                const size_t hash = item_hasher()(value);
+                bool duplicate = false;
+                auto range = _index.equal_range(hash);
+                for (auto itr = range.first; itr != range.second && !duplicate; ++itr) {
+                    duplicate = item_hash_equal()(unique[itr->second], value);
+                }
+                if (!duplicate) {
+                    _index.emplace(hash, static_cast<uint32_t>(unique.size()));
+                    unique.push_back(std::move(value));
+                }
+            }
+
+            _array.swap(unique);
+            _index_outdated = false;
+        }
+
+    public:
+
+        void u_ensure_index() {
+            if (_index_outdated) {
+                _u_rebuild_index();
+            }
+        }
+
+        container_type& u_container() {
+            _index_outdated = true;
+            u_mark_modified();
+            return _array;
+        }
+
+        const container_type& u_container() const {
+            return _array;
+        }
+
+        container_type container_copy() const {
+            object_lock g(this);
+            return _array;
+        }
+
+        // returns false if the value was already in the set
+        bool u_add(item&& value) {
+            u_ensure_index();
+            if (_u_find_in_index(value) != _index.end()) {
+                return false;
+            }
+            u_mark_modified();
+            _index.emplace(item_hasher()(value), static_cast<uint32_t>(_array.size()));
+            _array.push_back(std::move(value));
+            return true;
+        }
+
+        bool u_add(const item& value) {
+            return u_add(item(value));
+        }
+
+        bool u_contains(const item& value) {
+            u_ensure_index();
+            return _u_find_in_index(value) != _index.end();
+        }
+
+        // form lookup without constructing form_ref (which is costly)
+        bool u_contains_form(FormId id) {
+            u_ensure_index();
+            return _u_find_form_in_index(id) != _index.end();
+        }
+
+        // returns false if there was no such value
+        bool u_remove(const item& value) {
+            u_ensure_index();
+            auto found = _u_find_in_index(value);
+            return found != _index.end() ? (_u_remove_found(found), true) : false;
+        }
+
+        bool u_remove_form(FormId id) {
+            u_ensure_index();
+            auto found = _u_find_form_in_index(id);
+            return found != _index.end() ? (_u_remove_found(found), true) : false;
+        }
+
+        void u_clear() override {
+            u_mark_modified();
+            _array.clear();
+            _index.clear();
+            _index_outdated = false;
+        }
+
+        SInt32 u_count() const override {
+            return _array.size();
+        }
+
+        void u_onLoaded() override;
+
+        void u_nullifyObjects() override;
+
+        void u_visit_referenced_objects(const std::function<void(object_base&)>& visitor) override {
+            for (auto& item : _array) {
+                if (auto obj = item.object()) {
+                    visitor(*obj);
+                }
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////
+        // index-based access. Needed for key-paths (to reference objects contained in the set)
+
+        boost::optional<int32_t> u_convertIndex(int32_t pyIndex) const {
+            int32_t count = (int32_t)_array.size();
+            int32_t index = (pyIndex >= 0 ? pyIndex : (count + pyIndex));
+            return{ index >= 0 && index < count, index };
+        }
+
+        const item* u_get(int32_t index) const {
+            auto idx = u_convertIndex(index);
+            return idx ? &_array[*idx] : nullptr;
+        }
+
+        item* u_get(int32_t index) {
+            auto idx = u_convertIndex(index);
+            if (idx) {
+                _index_outdated = true;
+                u_mark_modified();
+                return &_array[*idx];
+            }
+            return nullptr;
+        }
+
+        template<class T>
+        item* u_set(int32_t index, T&& itm) {
+            auto itmPtr = u_get(index);
+            return itmPtr ? &(*itmPtr = std::forward<T>(itm)) : nullptr;
+        }
+
+        bool u_erase(int32_t index) {
+            auto idx = u_convertIndex(index);
+            if (idx) {
+                u_mark_modified();
+                _array.erase(_array.begin() + *idx);
+                _index_outdated = true;
+                return true;
+            }
+            return false;
+        }
+
+        //////////////////////////////////////////////////////////////////////////
+
+        template<class Archive>
+        void serialize(Archive & ar, const unsigned int version);
+    };
 }
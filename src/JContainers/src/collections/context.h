@@ -1,6 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <string>
 
 #include "meta.h"
 #include "util/spinlock.h"
@@ -10,6 +13,11 @@
 #include "forms/form_observer.h"
 #include "collections/collections.h"
 
+namespace util {
+    class record_reader;
+    class record_writer;
+}
+
 namespace collections
 {
     class map;
@@ -51,6 +59,16 @@ namespace collections
         void set_root(object_base *db);
         map& root();
 
+        // JDB's identifier, as saves store it
+        Handle u_root_object_id() const {
+            return _root_object_id.load(std::memory_order_relaxed);
+        }
+
+        void u_set_root_object_id(Handle id) {
+            _root_object_id.store(id, std::memory_order_relaxed);
+            _cached_root = nullptr;
+        }
+
     public:
 
         template<class T>
@@ -65,6 +83,12 @@ namespace collections
 
         // to attach lua context
         std::shared_ptr<dependent_context>     lua_context;
+        // asynchronous JSON file reading and writing, see json_file_requests
+        std::shared_ptr<dependent_context>     file_requests;
+        // memory-mapped read-only data packs, see data_packs
+        std::shared_ptr<dependent_context>     data_packs;
+        // the base snapshot of delta saves, see flat_delta_tracker
+        std::shared_ptr<dependent_context>     delta_tracker;
 
         forms::form_observer& _form_watcher;
 
@@ -72,7 +96,12 @@ namespace collections
     public:
 
         void read_from_stream(std::istream & stream);
-        void write_to_stream(std::ostream& stream);
+        // writes in the current format, pre_flat_format is the other one supported
+        void write_to_stream(std::ostream& stream, serialization_version version = serialization_version::current);
+
+        // the same, but through the buffered record reader and writer (see util/record_stream.h). The writer gets flushed
+        void read_from(util::record_reader& in);
+        void write_to(util::record_writer& out, serialization_version version = serialization_version::current);
 
         void read_from_string(const std::string & data);
         std::string write_to_string();
@@ -85,6 +114,45 @@ namespace collections
         // complete shutdown, this context shouldn't be used for now
         void shutdown();
 
+        // The data of a context, read from a save but not decoded: a context written by flat_serialization::write_context,
+        // the form table resolved already (see flat_serialization::resolve_forms). Saves write it as it is
+        struct encoded_state {
+            std::string data;
+            serialization_version version = serialization_version::current;
+            // the base snapshot of delta saves has the same data
+            std::atomic<bool> inBase{ false };
+        };
+
+        // Deferred loading: the context keeps the state encoded until used, the API decodes it before each call.
+        // Replaces the state of the context
+        void u_defer_loading(std::shared_ptr<encoded_state> state);
+
+        void ensure_loaded() {
+            if (_has_deferred_state.load(std::memory_order_acquire)) {
+                load_deferred_state();
+            }
+        }
+
+        // keeps the deferred state from getting decoded meanwhile
+        std::unique_lock<std::mutex> deferred_state_lock() {
+            return std::unique_lock<std::mutex>(_deferred_state_mutex);
+        }
+
+        // null if not deferred or decoded already, requires deferred_state_lock
+        const std::shared_ptr<encoded_state>& u_deferred_state() const {
+            return _deferred_state;
+        }
+
+    private:
+
+        std::mutex _deferred_state_mutex;
+        std::shared_ptr<encoded_state> _deferred_state;
+        std::atomic<bool> _has_deferred_state{ false };
+
+        void load_deferred_state();
+
+    public:
+
         friend class boost::serialization::access;
         BOOST_SERIALIZATION_SPLIT_MEMBER();
 
@@ -93,6 +161,8 @@ namespace collections
         void u_clearState() {
             _root_object_id.store(Handle::Null, std::memory_order_relaxed);
             _cached_root = nullptr;
+            _deferred_state.reset();
+            _has_deferred_state.store(false, std::memory_order_release);
             //_form_watcher.u_clearState();
 
             base::u_clearState();
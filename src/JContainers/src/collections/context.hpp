@@ -1,6 +1,6 @@
-#include <boost/iostreams/stream.hpp>
-#include <boost/iostreams/device/array.hpp>
 #include "util/singleton.h"
+#include "util/record_stream.h"
+#include "collections/flat_serialization.h"
 
 #include "jansson.h"
 
@@ -27,15 +27,20 @@ namespace collections {
 
         static const char *common_version_key() { return "commonVersion"; }
 
-        static header read_from_stream(std::istream & stream) {
+        // the size of the JSON in decimal digits, then the JSON
+        static header read_from(util::record_reader& in) {
 
             uint32_t hdrSize = 0;
-            stream >> hdrSize;
+            if (!util::read_decimal(in, hdrSize)) {
+                return imitate_old_header();
+            }
 
             std::vector<char> buffer(hdrSize);
-            stream.read(&buffer.front(), buffer.size());
+            if (in.read(buffer.data(), buffer.size()) != buffer.size()) {
+                return imitate_old_header();
+            }
 
-            auto js = make_unique_ptr(json_loadb(&buffer.front(), buffer.size(), 0, nullptr), &json_decref);
+            auto js = make_unique_ptr(json_loadb(buffer.data(), buffer.size(), 0, nullptr), &json_decref);
             if (!js) { // parsing failed
                 return imitate_old_header();
             }
@@ -43,37 +48,31 @@ namespace collections {
             return{ (serialization_version)json_integer_value(json_object_get(js.get(), common_version_key())) };
         }
 
-        static auto write_to_json() -> decltype(make_unique_ptr((json_t *)nullptr, &json_decref)) {
+        static auto write_to_json(serialization_version version) -> decltype(make_unique_ptr((json_t *)nullptr, &json_decref)) {
             auto header = make_unique_ptr(json_object(), &json_decref);
 
-            json_object_set(header.get(), common_version_key(), json_integer((json_int_t)serialization_version::current));
+            json_object_set(header.get(), common_version_key(), json_integer((json_int_t)version));
 
             return header;
         }
 
-        static void write_to_stream(std::ostream & stream) {
-            auto header = write_to_json();
+        static void write_to(util::record_writer& out, serialization_version version = serialization_version::current) {
+            auto header = write_to_json(version);
             auto data = make_unique_ptr(json_dumps(header.get(), 0), free);
 
             uint32_t hdrSize = strlen(data.get());
-            stream << (uint32_t)hdrSize;
-            stream.write(data.get(), hdrSize);
+            util::write_decimal(out, hdrSize);
+            out.write(data.get(), hdrSize);
         }
     };
 
     void tes_context::read_from_stream(std::istream & stream) {
+        util::stream_record_source source(stream);
+        util::record_reader reader(source);
+        read_from(reader);
+    }
 
-        stream.flags(stream.flags() | std::ios::binary);
-
-#       if 0
-        std::ofstream file("dump", std::ios::binary | std::ios::out);
-        std::copy(
-            std::istreambuf_iterator<char>(stream),
-            std::istreambuf_iterator<char>(),
-            std::ostreambuf_iterator<char>(file)
-            );
-        file.close();
-#       endif
+    void tes_context::read_from(util::record_reader& in) {
 
         activity_stopper stopper{ *this };
         {
@@ -82,11 +81,11 @@ namespace collections {
 
             u_clearState();
 
-            if (stream.peek() != std::istream::traits_type::eof()) {
+            if (!in.at_end()) {
 
                 try {
 
-                    auto hdr = header::read_from_stream(stream);
+                    auto hdr = header::read_from(in);
                     bool isNotSupported = serialization_version::current < hdr.commonVersion
                         || hdr.commonVersion <= serialization_version::no_header;
 
@@ -97,7 +96,16 @@ namespace collections {
                         throw std::logic_error(error.str());
                     }
 
-                    {
+                    const bool flatFormat = hdr.commonVersion > serialization_version::pre_flat_format;
+                    if (flatFormat) {
+                        std::string data;
+                        in.read_rest(data);
+                        flat_reader reader(data.data(), data.data() + data.size());
+                        flat_serialization::read_context(*this, reader, util::hardware_threads());
+                    }
+                    else {
+                        util::record_streambuf buffer(in);
+                        std::istream stream(&buffer);
                         hack::iarchive_with_blob real_archive(stream, *this, *this);
                         boost::archive::binary_iarchive& archive = real_archive;
 
@@ -108,7 +116,9 @@ namespace collections {
                         }
                     }
 
-                    u_postLoadInitializations();
+                    if (!flatFormat) { // the flat format reader does it while reading
+                        u_postLoadInitializations();
+                    }
                     u_applyUpdates(hdr.commonVersion);
                     u_postLoadMaintenance(hdr.commonVersion);
                 }
@@ -133,10 +143,15 @@ namespace collections {
         }
     }
 
-    void tes_context::write_to_stream(std::ostream& stream) {
+    void tes_context::write_to_stream(std::ostream& stream, serialization_version version) {
+        util::stream_record_sink sink(stream);
+        util::record_writer writer(sink);
+        write_to(writer, version);
+    }
 
-        stream.flags(stream.flags() | std::ios::binary);
+    void tes_context::write_to(util::record_writer& out, serialization_version version) {
 
+        ensure_loaded();
         activity_stopper s{ *this };
         {
             // we can also cleanup objects here
@@ -144,9 +159,19 @@ namespace collections {
                 _form_watcher.u_remove_expired_forms();
             }
 
-            header::write_to_stream(stream);
-            boost::archive::binary_oarchive arch{ stream };
-            arch << *this;
+            header::write_to(out, version);
+            if (version == serialization_version::pre_flat_format) {
+                util::record_streambuf buffer(out);
+                std::ostream stream(&buffer);
+                boost::archive::binary_oarchive arch{ stream };
+                arch << *this;
+            }
+            else {
+                flat_writer writer;
+                flat_serialization::write_context(*this, writer);
+                out.write(writer.data());
+            }
+            out.flush();
             u_print_stats();
         }
     }
@@ -156,15 +181,17 @@ namespace collections {
     }
 
     void tes_context::read_from_string(const std::string & data) {
-        namespace io = boost::iostreams;
-        io::stream<io::array_source> stream(io::array_source(data.c_str(), data.size()));
-        read_from_stream(stream);
+        util::memory_record_source source(data);
+        util::record_reader reader(source);
+        read_from(reader);
     }
 
     std::string tes_context::write_to_string() {
-        std::ostringstream stream;
-        write_to_stream(stream);
-        return stream.str();
+        std::string data;
+        util::string_record_sink sink(data);
+        util::record_writer writer(sink);
+        write_to(writer);
+        return data;
     }
 
     template<class Archive> void tes_context::load_data_in_old_way(Archive& ar) {
@@ -200,6 +227,35 @@ namespace collections {
 
     ////////////////////////
 
+    void tes_context::u_defer_loading(std::shared_ptr<encoded_state> state) {
+        u_clearState();
+        _deferred_state = std::move(state);
+        _has_deferred_state.store(_deferred_state != nullptr, std::memory_order_release);
+    }
+
+    void tes_context::load_deferred_state() {
+        std::lock_guard<std::mutex> g(_deferred_state_mutex);
+        if (!_has_deferred_state.load(std::memory_order_acquire)) { // decoded meanwhile
+            return;
+        }
+
+        activity_stopper stopper{ *this };
+        const auto state = std::move(_deferred_state);
+        try {
+            util::do_with_timing("Deferred loading", [&]() {
+                flat_reader reader(state->data.data(), state->data.data() + state->data.size());
+                flat_serialization::read_context(*this, reader, util::hardware_threads(), state->inBase.load(), true);
+                u_applyUpdates(state->version);
+                u_postLoadMaintenance(state->version);
+            });
+        }
+        catch (const std::exception& exc) {
+            _FATALERROR("caught exception (%s) during deferred load - '%s'", typeid(exc).name(), exc.what());
+            u_clearState();
+        }
+        _has_deferred_state.store(false, std::memory_order_release);
+    }
+
     void tes_context::shutdown() {
         stop_activity();
         u_clearState();
@@ -79,6 +79,14 @@ namespace collections {
                     copy_child(itm);
                 }
             }
+            void operator () (set& st) {
+                object_lock lock(st);
+                for (auto& itm : st.u_container()) {
+                    copy_child(itm);
+                }
+            }
+            template<class T, CollectionType Type>
+            void operator () (typed_array<T, Type>&) {} // plain numbers, no child objects
             template<class T> void operator () (T& map) {
                 object_lock lock(map);
                 for (auto& pair : map.u_container()) {
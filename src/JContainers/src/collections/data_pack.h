@@ -0,0 +1,800 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "forms/form_handling.h"
+#include "forms/form_observer.h"
+#include "collections/collections.h"
+#include "collections/context.h"
+#include "collections/item.h"
+#include "collections/json_serialization.h"
+#include "util/flat_pointer_map.h"
+
+namespace collections {
+
+    // Data pack: an immutable object graph laid out to be used right from a memory-mapped file.
+    // Numbers are 32-bit little-endian ones, everything is 4-byte aligned:
+    //
+    //  header:     "JCDP", version, root value slot, offset of the mod table
+    //  mod table:  count, string offsets
+    //  string:     length, bytes, null terminator, padding
+    //  value slot: item_type, payload - the number itself or an offset of a string, form or container
+    //  form:       mod index (no_mod for dynamic forms), form id relative to the mod
+    //  container:  CollectionType, count, offset of the entries:
+    //              JArray, JSet - value slots; JIntArray, JFltArray - numbers;
+    //              JMap - <string offset, value slot> in JMap's (case-insensitive) key order;
+    //              JIntMap - <key, value slot>, ascending; JFormMap - <form, value slot>, ascending
+    //
+    // A container met more than once is stored once, so shared and cyclic references are kept
+    namespace data_pack_format {
+
+        const char magic[4] = { 'J', 'C', 'D', 'P' };
+
+        enum : uint32_t {
+            version = 1,
+            no_mod = UINT32_MAX,
+        };
+
+        struct value_slot {
+            uint32_t type;      // item_type
+            uint32_t payload;
+        };
+
+        struct header {
+            char magic[4];
+            uint32_t version;
+            value_slot root;
+            uint32_t mods;
+        };
+
+        struct string_header { uint32_t length; };
+        struct form_record { uint32_t mod; uint32_t id; };
+        struct container_header { uint32_t type; uint32_t count; uint32_t entries; };
+
+        struct map_entry { uint32_t key; value_slot value; };
+        struct integer_map_entry { int32_t key; value_slot value; };
+        struct form_map_entry { form_record key; value_slot value; };
+
+        inline bool operator < (const form_record& l, const form_record& r) {
+            return l.mod < r.mod || (l.mod == r.mod && l.id < r.id);
+        }
+
+        static_assert(sizeof(value_slot) == 8 && sizeof(header) == 20 && sizeof(form_map_entry) == 16, "unexpected layout");
+    }
+
+    // Lays out an object graph as a data pack
+    class data_pack_writer {
+        using value_slot = data_pack_format::value_slot;
+
+        std::string _data;
+        util::flat_pointer_map<const object_base*, uint32_t> _containers;
+        // containers, which headers are written, but entries aren't
+        std::deque<std::pair<const object_base*, uint32_t> > _toFill;
+        std::unordered_map<std::string, uint32_t> _strings;
+        std::unordered_map<uint32_t, uint32_t> _forms;
+        std::unordered_map<std::string, uint32_t> _modIndexes;
+        std::vector<uint32_t> _modNames;
+
+    public:
+
+        static std::string pack(const object_base& root) {
+            namespace fmt = data_pack_format;
+
+            data_pack_writer writer;
+            const uint32_t headerOffset = writer.allocate(sizeof(fmt::header));
+            fmt::header header = {};
+            memcpy(header.magic, fmt::magic, sizeof header.magic);
+            header.version = fmt::version;
+            header.root = value_slot{ item_type::object, writer.container(root) };
+
+            while (!writer._toFill.empty()) {
+                auto next = writer._toFill.front();
+                writer._toFill.pop_front();
+                writer.fill(*next.first, next.second);
+            }
+
+            header.mods = writer.allocate(sizeof(uint32_t) * (writer._modNames.size() + 1));
+            writer.put(header.mods, static_cast<uint32_t>(writer._modNames.size()));
+            for (size_t i = 0; i < writer._modNames.size(); ++i) {
+                writer.put(header.mods + static_cast<uint32_t>(sizeof(uint32_t) * (i + 1)), writer._modNames[i]);
+            }
+
+            writer.put(headerOffset, header);
+            return std::move(writer._data);
+        }
+
+        // Reads JSON file, packs it into another file. Returns false if either file can't be read or written
+        static bool pack_json_file(const char *jsonPath, const char *packPath) {
+            tes_context_standalone context;
+            object_stack_ref root = json_deserializer::object_from_file(context, jsonPath);
+            if (!root) {
+                return false;
+            }
+
+            const std::string data = pack(*root);
+            auto file = make_unique_file(fopen(packPath, "wb"));
+            return file && fwrite(data.data(), 1, data.size(), file.get()) == data.size();
+        }
+
+    private:
+
+        uint32_t allocate(size_t size) {
+            const uint32_t offset = static_cast<uint32_t>(_data.size());
+            _data.append((size + 3) & ~size_t(3), '\0');
+            return offset;
+        }
+
+        // the buffer may grow between the calls, so the data is addressed by offsets
+        template<class T>
+        void put(uint32_t offset, const T& value) {
+            memcpy(&_data[offset], &value, sizeof value);
+        }
+
+        uint32_t string(const std::string& str) {
+            auto found = _strings.find(str);
+            if (found != _strings.end()) {
+                return found->second;
+            }
+            const uint32_t offset = allocate(sizeof(data_pack_format::string_header) + str.size() + 1);
+            put(offset, data_pack_format::string_header{ static_cast<uint32_t>(str.size()) });
+            memcpy(&_data[offset + sizeof(data_pack_format::string_header)], str.data(), str.size());
+            _strings.emplace(str, offset);
+            return offset;
+        }
+
+        std::optional<data_pack_format::form_record> form_record(FormId id) {
+            auto origin = forms::form_origin(id);
+            if (!origin) {
+                return std::nullopt;
+            }
+            if (origin->first.empty()) {
+                return data_pack_format::form_record{ data_pack_format::no_mod, origin->second };
+            }
+
+            auto index = _modIndexes.emplace(std::string(origin->first), static_cast<uint32_t>(_modNames.size()));
+            if (index.second) {
+                _modNames.push_back(string(index.first->first));
+            }
+            return data_pack_format::form_record{ index.first->second, origin->second };
+        }
+
+        uint32_t container(const object_base& obj) {
+            if (auto offset = _containers.find(&obj)) {
+                return *offset;
+            }
+            const uint32_t offset = allocate(sizeof(data_pack_format::container_header));
+            put(offset, data_pack_format::container_header{ static_cast<uint32_t>(obj.type()), 0, 0 });
+            _containers.emplace(&obj, offset);
+            _toFill.emplace_back(&obj, offset);
+            return offset;
+        }
+
+        value_slot slot(const item& value) {
+            struct slot_maker : boost::static_visitor<value_slot> {
+                data_pack_writer& self;
+
+                explicit slot_maker(data_pack_writer& s) : self(s) {}
+
+                value_slot operator()(const std::string& val) const {
+                    return{ item_type::string, self.string(val) };
+                }
+                value_slot operator()(const boost::blank&) const {
+                    return{ item_type::none, 0 };
+                }
+                value_slot operator()(const SInt32& val) const {
+                    return{ item_type::integer, static_cast<uint32_t>(val) };
+                }
+                value_slot operator()(const item::Real& val) const {
+                    uint32_t bits;
+                    memcpy(&bits, &val, sizeof bits);
+                    return{ item_type::real, bits };
+                }
+                value_slot operator()(const form_ref& val) const {
+                    const uint32_t raw = static_cast<uint32_t>(val.get());
+                    auto found = self._forms.find(raw);
+                    if (found != self._forms.end()) {
+                        return{ item_type::form, found->second };
+                    }
+                    auto record = self.form_record(val.get());
+                    if (!record) {
+                        return{ item_type::none, 0 };
+                    }
+                    const uint32_t offset = self.allocate(sizeof(data_pack_format::form_record));
+                    self.put(offset, *record);
+                    self._forms.emplace(raw, offset);
+                    return{ item_type::form, offset };
+                }
+                value_slot operator()(const internal_object_ref& val) const {
+                    return val.get() ? value_slot{ item_type::object, self.container(*val.get()) } : value_slot{ item_type::none, 0 };
+                }
+            };
+
+            return value.var().apply_visitor(slot_maker{ *this });
+        }
+
+        template<class Entry>
+        void put_entries(uint32_t containerOffset, const std::vector<Entry>& entries) {
+            const uint32_t offset = allocate(sizeof(Entry) * entries.size());
+            if (!entries.empty()) {
+                memcpy(&_data[offset], entries.data(), sizeof(Entry) * entries.size());
+            }
+            data_pack_format::container_header header;
+            memcpy(&header, &_data[containerOffset], sizeof header);
+            header.count = static_cast<uint32_t>(entries.size());
+            header.entries = offset;
+            put(containerOffset, header);
+        }
+
+        void fill(const object_base& obj, uint32_t offset) {
+            namespace fmt = data_pack_format;
+
+            struct filler {
+                data_pack_writer& self;
+                uint32_t offset;
+
+                void values(const std::vector<item>& items) {
+                    std::vector<value_slot> entries;
+                    entries.reserve(items.size());
+                    for (auto& itm : items) {
+                        entries.push_back(self.slot(itm));
+                    }
+                    self.put_entries(offset, entries);
+                }
+
+                void operator () (const array& cnt) { values(cnt.u_container()); }
+                void operator () (const set& cnt) { values(cnt.u_container()); }
+
+                template<class T, CollectionType Type>
+                void operator () (const typed_array<T, Type>& cnt) {
+                    self.put_entries(offset, cnt.u_container());
+                }
+
+                void operator () (const map& cnt) {
+                    std::vector<fmt::map_entry> entries;
+                    entries.reserve(cnt.u_container().size());
+                    for (auto& pair : cnt.u_container()) {
+                        // JMap compares keys as null-terminated strings
+                        entries.push_back(fmt::map_entry{ self.string(pair.first.c_str()), self.slot(pair.second) });
+                    }
+                    self.put_entries(offset, entries);
+                }
+                void operator () (const integer_map& cnt) {
+                    std::vector<fmt::integer_map_entry> entries;
+                    entries.reserve(cnt.u_container().size());
+                    for (auto& pair : cnt.u_container()) {
+                        entries.push_back(fmt::integer_map_entry{ pair.first, self.slot(pair.second) });
+                    }
+                    self.put_entries(offset, entries);
+                }
+                void operator () (const form_map& cnt) {
+                    std::vector<fmt::form_map_entry> entries;
+                    entries.reserve(cnt.u_container().size());
+                    for (auto& pair : cnt.u_container()) {
+                        if (auto key = self.form_record(pair.first.get())) {
+                            entries.push_back(fmt::form_map_entry{ *key, self.slot(pair.second) });
+                        }
+                    }
+                    std::sort(entries.begin(), entries.end(), [](const fmt::form_map_entry& l, const fmt::form_map_entry& r) {
+                        return l.key < r.key;
+                    });
+                    self.put_entries(offset, entries);
+                }
+            };
+
+            object_lock lock(obj);
+            perform_on_object(obj, filler{ *this, offset });
+        }
+    };
+
+    // Memory-mapped data pack. Lookups read the mapped file as is, nothing gets allocated until a container
+    // is requested - the container gets materialized then, as a new object owned by the caller.
+    // Every access is bounds-checked, a damaged pack yields missing values rather than crashes
+    class data_pack {
+    public:
+
+        using value_slot = data_pack_format::value_slot;
+
+    private:
+
+        boost::interprocess::file_mapping _file;
+        boost::interprocess::mapped_region _region;
+        // the pack, created from a string, owns its data
+        std::string _buffer;
+        const char *_data = nullptr;
+        size_t _size = 0;
+        value_slot _root = {};
+        std::vector<std::string> _mods;
+        std::unordered_map<std::string, uint32_t> _modIndexes;
+
+        data_pack() {}
+
+    public:
+
+        // Returns nothing if the file can't be mapped or isn't a data pack
+        static std::unique_ptr<data_pack> open(const char *path) {
+            if (!path) {
+                return nullptr;
+            }
+
+            std::unique_ptr<data_pack> pack(new data_pack());
+            try {
+                namespace bip = boost::interprocess;
+                pack->_file = bip::file_mapping(path, bip::read_only);
+                pack->_region = bip::mapped_region(pack->_file, bip::read_only);
+            }
+            catch (const std::exception& exc) {
+                JC_LOG_ERROR("Can't map data pack '%s': %s", path, exc.what());
+                return nullptr;
+            }
+
+            pack->_data = static_cast<const char *>(pack->_region.get_address());
+            pack->_size = pack->_region.get_size();
+            if (!pack->read_header()) {
+                JC_LOG_ERROR("'%s' is not a data pack or is damaged", path);
+                return nullptr;
+            }
+            return pack;
+        }
+
+        static std::unique_ptr<data_pack> from_data(std::string data) {
+            std::unique_ptr<data_pack> pack(new data_pack());
+            pack->_buffer = std::move(data);
+            pack->_data = pack->_buffer.data();
+            pack->_size = pack->_buffer.size();
+            return pack->read_header() ? std::move(pack) : nullptr;
+        }
+
+        size_t size() const { return _size; }
+
+        value_slot root() const { return _root; }
+
+        // Finds the value at @path, relative to the root. The path syntax is that of solve* functions:
+        // ".key", "[index]", "[intKey]", "[__formData|mod|0xid]"; operators aren't supported
+        std::optional<value_slot> find(const char *path) const {
+            if (!path) {
+                return std::nullopt;
+            }
+
+            value_slot current = _root;
+            const char *p = path;
+            while (*p) {
+                if (*p == '.') {
+                    const char *begin = ++p;
+                    while (*p && *p != '.' && *p != '[') {
+                        ++p;
+                    }
+                    if (p == begin) {
+                        return std::nullopt;
+                    }
+                    auto next = find_key(current, std::string(begin, p));
+                    if (!next) {
+                        return std::nullopt;
+                    }
+                    current = *next;
+                }
+                else if (*p == '[') {
+                    const char *begin = ++p;
+                    while (*p && *p != ']') {
+                        ++p;
+                    }
+                    if (!*p || p == begin) {
+                        return std::nullopt;
+                    }
+                    auto next = find_index(current, std::string(begin, p));
+                    if (!next) {
+                        return std::nullopt;
+                    }
+                    current = *next;
+                    ++p;
+                }
+                else {
+                    return std::nullopt;
+                }
+            }
+            return current;
+        }
+
+        // the number of items in the container, 0 if @value isn't a container
+        SInt32 count(const value_slot& value) const {
+            auto header = container_header(value);
+            return header ? static_cast<SInt32>(header->count) : 0;
+        }
+
+        // the string, which the pack holds, or nullptr
+        const char * string_value(const value_slot& value) const {
+            return value.type == item_type::string ? string_at(value.payload) : nullptr;
+        }
+
+        // Converts the value into an item. A container is materialized with everything it contains
+        item to_item(const value_slot& value, tes_context& context) const {
+            std::unordered_map<uint32_t, object_base*> materialized;
+            std::deque<std::pair<object_base*, uint32_t> > toFill;
+
+            auto result = to_item(value, context, materialized, toFill);
+            while (!toFill.empty()) {
+                auto next = toFill.front();
+                toFill.pop_front();
+                fill(*next.first, next.second, context, materialized, toFill);
+            }
+            return result;
+        }
+
+    private:
+
+        template<class T>
+        const T* at(uint32_t offset, size_t count = 1) const {
+            if ((offset & 3) != 0 || offset > _size || count > (_size - offset) / sizeof(T)) {
+                return nullptr;
+            }
+            return reinterpret_cast<const T*>(_data + offset);
+        }
+
+        const char * string_at(uint32_t offset) const {
+            auto header = at<data_pack_format::string_header>(offset);
+            if (!header) {
+                return nullptr;
+            }
+            const uint32_t begin = offset + sizeof(data_pack_format::string_header);
+            // the terminator has to be inside the pack
+            if (header->length >= _size - begin || _data[begin + header->length] != '\0') {
+                return nullptr;
+            }
+            return _data + begin;
+        }
+
+        bool read_header() {
+            namespace fmt = data_pack_format;
+
+            auto header = at<fmt::header>(0);
+            if (!header || memcmp(header->magic, fmt::magic, sizeof fmt::magic) != 0 || header->version != fmt::version) {
+                return false;
+            }
+            _root = header->root;
+
+            auto modCount = at<uint32_t>(header->mods);
+            auto modOffsets = modCount ? at<uint32_t>(header->mods + static_cast<uint32_t>(sizeof(uint32_t)), *modCount) : nullptr;
+            if (!modOffsets && (!modCount || *modCount != 0)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < *modCount; ++i) {
+                auto name = string_at(modOffsets[i]);
+                if (!name) {
+                    return false;
+                }
+                _mods.emplace_back(name);
+                _modIndexes.emplace(name, i);
+            }
+            return container_header(_root) != nullptr;
+        }
+
+        const data_pack_format::container_header * container_header(const value_slot& value) const {
+            return value.type == item_type::object ? at<data_pack_format::container_header>(value.payload) : nullptr;
+        }
+
+        template<class Entry>
+        const Entry* entries(const data_pack_format::container_header& header) const {
+            return at<Entry>(header.entries, header.count);
+        }
+
+        std::optional<FormId> form_at(uint32_t offset) const {
+            auto record = at<data_pack_format::form_record>(offset);
+            if (!record) {
+                return std::nullopt;
+            }
+            return form(*record);
+        }
+
+        std::optional<FormId> form(const data_pack_format::form_record& record) const {
+            if (record.mod == data_pack_format::no_mod) {
+                return forms::form_from_file("", record.id);
+            }
+            return record.mod < _mods.size() ? forms::form_from_file(_mods[record.mod], record.id) : std::nullopt;
+        }
+
+        // the key of @id, as the packer has written it
+        std::optional<data_pack_format::form_record> form_key(FormId id) const {
+            auto origin = forms::form_origin(id);
+            if (!origin) {
+                return std::nullopt;
+            }
+            if (origin->first.empty()) {
+                return data_pack_format::form_record{ data_pack_format::no_mod, origin->second };
+            }
+            auto index = _modIndexes.find(std::string(origin->first));
+            if (index == _modIndexes.end()) {
+                return std::nullopt;
+            }
+            return data_pack_format::form_record{ index->second, origin->second };
+        }
+
+        std::optional<value_slot> find_key(const value_slot& container, const std::string& key) const {
+            namespace fmt = data_pack_format;
+
+            auto header = container_header(container);
+            if (!header || header->type != CollectionType::Map) {
+                return std::nullopt;
+            }
+            auto items = entries<fmt::map_entry>(*header);
+            if (!items) {
+                return std::nullopt;
+            }
+
+            // the entries are in JMap's order
+            size_t low = 0, high = header->count;
+            while (low < high) {
+                const size_t middle = low + (high - low) / 2;
+                const char *middleKey = string_at(items[middle].key);
+                if (!middleKey) {
+                    return std::nullopt;
+                }
+                const int comparison = _stricmp(middleKey, key.c_str());
+                if (comparison == 0) {
+                    return items[middle].value;
+                }
+                if (comparison < 0) {
+                    low = middle + 1;
+                }
+                else {
+                    high = middle;
+                }
+            }
+            return std::nullopt;
+        }
+
+        // compares the entries of sorted containers with their keys
+        struct entry_less {
+            using integer_entry = data_pack_format::integer_map_entry;
+            using form_entry = data_pack_format::form_map_entry;
+            using form_record = data_pack_format::form_record;
+
+            bool operator () (const integer_entry& e, int32_t k) const { return e.key < k; }
+            bool operator () (int32_t k, const integer_entry& e) const { return k < e.key; }
+            bool operator () (const form_entry& e, const form_record& k) const { return e.key < k; }
+            bool operator () (const form_record& k, const form_entry& e) const { return k < e.key; }
+        };
+
+        template<class Entry, class Key, class Less>
+        static std::optional<value_slot> find_sorted(const Entry* items, uint32_t count, const Key& key, Less less) {
+            auto found = std::lower_bound(items, items + count, key, less);
+            if (found == items + count || less(key, *found)) {
+                return std::nullopt;
+            }
+            return found->value;
+        }
+
+        std::optional<value_slot> find_index(const value_slot& container, const std::string& index) const {
+            namespace fmt = data_pack_format;
+
+            auto header = container_header(container);
+            if (!header) {
+                return std::nullopt;
+            }
+
+            if (forms::is_form_string(index.c_str())) {
+                auto id = forms::string_to_form(index.c_str());
+                auto key = id ? form_key(*id) : std::nullopt;
+                auto items = header->type == CollectionType::FormMap ? entries<fmt::form_map_entry>(*header) : nullptr;
+                if (!key || !items) {
+                    return std::nullopt;
+                }
+                return find_sorted(items, header->count, *key, entry_less());
+            }
+
+            int32_t number = 0;
+            try {
+                number = std::stoi(index, nullptr, 0);
+            }
+            catch (const std::invalid_argument&) {
+                return std::nullopt;
+            }
+            catch (const std::out_of_range&) {
+                return std::nullopt;
+            }
+
+            switch (header->type) {
+            case CollectionType::Array: {
+                // negative indices count from the end, as JArray's ones do
+                const int64_t position = number >= 0 ? number : int64_t(header->count) + number;
+                auto items = entries<value_slot>(*header);
+                if (!items || position < 0 || position >= header->count) {
+                    return std::nullopt;
+                }
+                return items[position];
+            }
+            case CollectionType::IntegerMap: {
+                auto items = entries<fmt::integer_map_entry>(*header);
+                if (!items) {
+                    return std::nullopt;
+                }
+                return find_sorted(items, header->count, number, entry_less());
+            }
+            default:
+                return std::nullopt;
+            }
+        }
+
+        using materialized_map = std::unordered_map<uint32_t, object_base*>;
+        using fill_queue = std::deque<std::pair<object_base*, uint32_t> >;
+
+        item to_item(const value_slot& value, tes_context& context, materialized_map& materialized, fill_queue& toFill) const {
+            switch (value.type) {
+            case item_type::integer:
+                return item(static_cast<SInt32>(value.payload));
+            case item_type::real: {
+                item::Real real;
+                memcpy(&real, &value.payload, sizeof real);
+                return item(real);
+            }
+            case item_type::string: {
+                auto str = string_at(value.payload);
+                return str ? item(str) : item();
+            }
+            case item_type::form:
+                return item(make_weak_form_id(form_at(value.payload).value_or(FormId::Zero), context));
+            case item_type::object: {
+                auto found = materialized.find(value.payload);
+                if (found != materialized.end()) {
+                    return item(found->second);
+                }
+                auto header = container_header(value);
+                object_base *obj = nullptr;
+                switch (header ? header->type : CollectionType::None) {
+                case CollectionType::Array: obj = &array::object(context); break;
+                case CollectionType::Map: obj = &map::object(context); break;
+                case CollectionType::FormMap: obj = &form_map::object(context); break;
+                case CollectionType::IntegerMap: obj = &integer_map::object(context); break;
+                case CollectionType::Set: obj = &set::object(context); break;
+                case CollectionType::IntArray: obj = &int_array::object(context); break;
+                case CollectionType::FloatArray: obj = &float_array::object(context); break;
+                default: return item();
+                }
+                materialized.emplace(value.payload, obj);
+                toFill.emplace_back(obj, value.payload);
+                return item(obj);
+            }
+            default:
+                return item();
+            }
+        }
+
+        void fill(object_base& obj, uint32_t offset, tes_context& context, materialized_map& materialized, fill_queue& toFill) const {
+            namespace fmt = data_pack_format;
+
+            auto header = at<fmt::container_header>(offset);
+            if (!header) {
+                return;
+            }
+
+            struct filler {
+                const data_pack& self;
+                const fmt::container_header& header;
+                tes_context& context;
+                materialized_map& materialized;
+                fill_queue& toFill;
+
+                item value(const value_slot& slot) {
+                    return self.to_item(slot, context, materialized, toFill);
+                }
+
+                void operator () (array& cnt) {
+                    if (auto items = self.entries<value_slot>(header)) {
+                        for (uint32_t i = 0; i < header.count; ++i) {
+                            cnt.u_push(value(items[i]));
+                        }
+                    }
+                }
+                void operator () (set& cnt) {
+                    if (auto items = self.entries<value_slot>(header)) {
+                        for (uint32_t i = 0; i < header.count; ++i) {
+                            cnt.u_container().push_back(value(items[i]));
+                        }
+                        cnt.u_ensure_index();
+                    }
+                }
+                template<class T, CollectionType Type>
+                void operator () (typed_array<T, Type>& cnt) {
+                    if (auto items = self.entries<T>(header)) {
+                        cnt.u_container().assign(items, items + header.count);
+                    }
+                }
+                void operator () (map& cnt) {
+                    if (auto items = self.entries<fmt::map_entry>(header)) {
+                        for (uint32_t i = 0; i < header.count; ++i) {
+                            if (auto key = self.string_at(items[i].key)) {
+                                cnt.u_set(std::string(key), value(items[i].value));
+                            }
+                        }
+                    }
+                }
+                void operator () (integer_map& cnt) {
+                    if (auto items = self.entries<fmt::integer_map_entry>(header)) {
+                        for (uint32_t i = 0; i < header.count; ++i) {
+                            cnt.u_container()[items[i].key] = value(items[i].value);
+                        }
+                    }
+                }
+                void operator () (form_map& cnt) {
+                    if (auto items = self.entries<fmt::form_map_entry>(header)) {
+                        for (uint32_t i = 0; i < header.count; ++i) {
+                            // the forms of the mods, not loaded now, are skipped - as JSON reader does
+                            if (auto key = self.form(items[i].key)) {
+                                cnt.u_set(make_weak_form_id(*key, context), value(items[i].value));
+                            }
+                        }
+                    }
+                }
+            };
+
+            object_lock lock(obj);
+            perform_on_object(obj, filler{ *this, *header, context, materialized, toFill });
+        }
+    };
+
+    // The data packs, opened in the context. A pack is mapped on first use and stays mapped until
+    // unloaded or until the context's state gets cleared
+    class data_packs : public dependent_context {
+        tes_context& _context;
+        mutable std::mutex _mutex;
+        std::map<std::string, std::shared_ptr<const data_pack> > _packs;
+
+    public:
+
+        explicit data_packs(tes_context& context) : _context(context) {
+            context.add_dependent_context(*this);
+        }
+
+        ~data_packs() {
+            _context.remove_dependent_context(*this);
+        }
+
+        static data_packs& of(tes_context& context) {
+            return static_cast<data_packs&>(*context.data_packs);
+        }
+
+        // A pack that fails to open isn't remembered, so a fixed file can be tried again
+        std::shared_ptr<const data_pack> get(const char *path) {
+            if (!path) {
+                return nullptr;
+            }
+
+            std::lock_guard<std::mutex> g(_mutex);
+            auto& pack = _packs[path];
+            if (!pack) {
+                pack = data_pack::open(path);
+                if (!pack) {
+                    _packs.erase(path);
+                    return nullptr;
+                }
+            }
+            return pack;
+        }
+
+        // the pack is unmapped once the last lookup using it completes
+        bool unload(const char *path) {
+            std::lock_guard<std::mutex> g(_mutex);
+            return path && _packs.erase(path) != 0;
+        }
+
+        void clear_state() override {
+            std::lock_guard<std::mutex> g(_mutex);
+            _packs.clear();
+        }
+    };
+
+    // inline: the header is included by more than one translation unit, the packs are created once per context
+    inline tes_context::post_init g_data_packs_init([](tes_context& ctx) {
+        ctx.data_packs = std::make_shared<data_packs>(ctx);
+    });
+}
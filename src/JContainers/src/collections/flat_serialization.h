@@ -0,0 +1,1339 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "skse/skse.h"
+#include "forms/form_observer.h"
+#include "collections/collections.h"
+#include "collections/context.h"
+#include "collections/persistence_profile.h"
+#include "util/flat_pointer_map.h"
+#include "util/concurrency.h"
+
+namespace collections {
+
+    // The save format of serialization_version::current, a purpose-built replacement of boost::serialization archive.
+    // A context is written as:
+    //  - the string table: map keys, string values and tags, each distinct string is written once
+    //  - the form table: raw form identifiers, resolved once on load
+    //  - the object table: type, identifier, tag and counters of each object. The objects are ordered by type
+    //  - free identifier ranges, the autorelease queue and JDB's identifier
+    //  - the contents of the objects. Objects, strings and forms are table indices
+    // The object table and the contents are split into length-prefixed chunks of adjacent objects. All the objects
+    // are known before any contents get read, so that the chunks are decoded independently, on several threads.
+    // Integers are LEB128 varints (zigzag-encoded if signed), floats are written as is.
+    // All reads are bounds-checked, malformed data throws flat_format_error
+    //
+    // A delta is written against a base snapshot - a context, written in whole earlier. It has the same sections, except that:
+    //  - it begins with the number of objects the base has
+    //  - the object table has a slot for each object of the base, in the base's order, then the new objects follow.
+    //    The slot of a removed object holds removed_object only, the slot of an unchanged one - unchanged_object only
+    //  - the contents of an object, which haven't changed since the base got written, are not written but read from the base
+    namespace flat_format {
+
+        enum item_tag : uint8_t {
+            tag_none = 0,
+            tag_integer,
+            tag_real,
+            tag_form,       // index in the form table, 0 is an expired form
+            tag_object,     // index in the object table + 1, 0 is no object
+            tag_string,     // index in the string table
+        };
+
+        enum object_flags : uint8_t {
+            flag_value_index = 1, // JArray with value index enabled
+            flag_contents_from_base = 2, // delta only: the contents are the ones the base has
+        };
+
+        // delta only: the object table slots of the base's objects, which are removed or are the same as the base has them
+        enum : uint8_t {
+            removed_object = 0xFF,
+            unchanged_object = 0xFE,
+        };
+
+        // a chunk is closed once it has that many objects or that much data
+        enum : size_t {
+            chunk_objects = 4096,
+            chunk_bytes = 256 * 1024,
+        };
+    }
+
+    class flat_format_error : public std::runtime_error {
+    public:
+        explicit flat_format_error(const char *what) : std::runtime_error(what) {}
+    };
+
+    class flat_writer {
+    public:
+
+        std::string& data() { return _data; }
+        const std::string& data() const { return _data; }
+
+        void byte(uint8_t value) {
+            _data.push_back(static_cast<char>(value));
+        }
+
+        void varint(uint64_t value) {
+            char buffer[10];
+            size_t length = 0;
+            while (value >= 0x80) {
+                buffer[length++] = static_cast<char>(value | 0x80);
+                value >>= 7;
+            }
+            buffer[length++] = static_cast<char>(value);
+            _data.append(buffer, length);
+        }
+
+        void signed_varint(int64_t value) {
+            varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+        }
+
+        void fixed32(uint32_t value) {
+            const char buffer[4] = {
+                static_cast<char>(value), static_cast<char>(value >> 8), static_cast<char>(value >> 16), static_cast<char>(value >> 24) };
+            _data.append(buffer, sizeof buffer);
+        }
+
+        void real(float value) {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof bits);
+            fixed32(bits);
+        }
+
+        // length-prefixed string or block of data
+        void bytes(std::string_view str) {
+            varint(str.size());
+            _data.append(str.data(), str.size());
+        }
+
+        void append(const flat_writer& other) {
+            _data.append(other._data);
+        }
+
+    private:
+        std::string _data;
+    };
+
+    class flat_reader {
+    public:
+
+        flat_reader() : _cur(nullptr), _end(nullptr) {}
+        flat_reader(const char *begin, const char *end) : _cur(begin), _end(end) {}
+
+        bool at_end() const { return _cur == _end; }
+        size_t remaining() const { return _end - _cur; }
+        const char *position() const { return _cur; }
+
+        uint8_t byte() {
+            ensure(1);
+            return static_cast<uint8_t>(*_cur++);
+        }
+
+        uint64_t varint() {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                const uint8_t next = byte();
+                value |= uint64_t(next & 0x7F) << shift;
+                if ((next & 0x80) == 0) {
+                    return value;
+                }
+            }
+            throw flat_format_error("varint is too long");
+        }
+
+        uint32_t varint32() {
+            const uint64_t value = varint();
+            if (value > UINT32_MAX) {
+                throw flat_format_error("value is out of range");
+            }
+            return static_cast<uint32_t>(value);
+        }
+
+        int32_t signed_varint32() {
+            const uint32_t value = varint32();
+            return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+        }
+
+        uint32_t fixed32() {
+            ensure(4);
+            const auto bytes = reinterpret_cast<const unsigned char *>(_cur);
+            _cur += 4;
+            return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+        }
+
+        float real() {
+            const uint32_t bits = fixed32();
+            float value;
+            memcpy(&value, &bits, sizeof value);
+            return value;
+        }
+
+        std::string_view bytes() {
+            const size_t length = varint32();
+            ensure(length);
+            std::string_view str(_cur, length);
+            _cur += length;
+            return str;
+        }
+
+        flat_reader block() {
+            auto content = bytes();
+            return flat_reader(content.data(), content.data() + content.size());
+        }
+
+        // the number of the items which follow, each occupies @itemSize bytes at least
+        size_t count(size_t itemSize = 1) {
+            const size_t value = varint32();
+            if (value > remaining() / itemSize) {
+                throw flat_format_error("count exceeds the data size");
+            }
+            return value;
+        }
+
+    private:
+        const char *_cur;
+        const char *_end;
+
+        void ensure(size_t length) const {
+            if (length > remaining()) {
+                throw flat_format_error("unexpected end of data");
+            }
+        }
+    };
+
+    // The base snapshot the deltas of a context are written against: the table index each object of the base had
+    // and the modification count the object had then. Removed objects are forgotten via the registry's removal journal,
+    // so that an object, which took the address of a removed one, is a new one
+    class flat_delta_tracker : public dependent_context {
+    public:
+
+        // what the object table has of an object, besides the type. The tag is compared by hash
+        struct table_entry {
+            Handle id;
+            int32_t tesRefCount;
+            object_base::time_point pushTime;
+            size_t tagHash;
+            bool valueIndex;
+
+            static table_entry of(const object_base& obj) {
+                auto arr = obj.as<array>();
+                return{ obj._uid(), obj._tes_refCount.load(std::memory_order_relaxed), obj._aqueue_push_time,
+                    std::hash<std::string_view>()(std::string_view(obj._tag.data(), obj._tag.size())),
+                    arr && arr->u_value_index_enabled() };
+            }
+
+            bool operator == (const table_entry& other) const {
+                return id == other.id && tesRefCount == other.tesRefCount && pushTime == other.pushTime
+                    && tagHash == other.tagHash && valueIndex == other.valueIndex;
+            }
+        };
+
+        struct base_object {
+            uint32_t index;
+            uint32_t modificationCount;
+            table_entry entry;
+            // false if read from a delta: the entry the base has is not known then, or the contents are not the base's
+            bool entryAsInBase;
+            bool contentsAsInBase;
+
+            // the object, modified @count times since created, has the contents the base has
+            bool contents_as_in_base(uint32_t count) const {
+                return contentsAsInBase && modificationCount == count;
+            }
+
+            // the contents and the object table entry are the base's
+            bool unchanged(uint32_t count, const table_entry& currentEntry) const {
+                return entryAsInBase && contents_as_in_base(count) && entry == currentEntry;
+            }
+        };
+
+        explicit flat_delta_tracker(tes_context& context) : _context(context) {
+            context.add_dependent_context(*this);
+        }
+
+        ~flat_delta_tracker() {
+            _context.remove_dependent_context(*this);
+        }
+
+        static flat_delta_tracker& of(tes_context& context) {
+            return static_cast<flat_delta_tracker&>(*context.delta_tracker);
+        }
+
+        void clear_state() override {
+            u_reset();
+        }
+
+        bool u_has_base() const { return _hasBase; }
+        uint32_t u_base_object_count() const { return _baseObjectCount; }
+
+        void u_reset() {
+            _objects.clear();
+            _baseObjectCount = 0;
+            _hasBase = false;
+            _context.u_journal_removals(false);
+        }
+
+        void u_start(uint32_t baseObjectCount) {
+            u_reset();
+            _baseObjectCount = baseObjectCount;
+            _hasBase = true;
+            _context.u_journal_removals(true);
+        }
+
+        void u_add(const object_base& obj, uint32_t index, bool entryAsInBase, bool contentsAsInBase) {
+            u_add(obj, base_object{ index, obj.u_modification_count(), table_entry::of(obj), entryAsInBase, contentsAsInBase });
+        }
+
+        // adds the object as it was when the base got written, which may be not the way it is now
+        void u_add(const object_base& obj, const base_object& baseObj) {
+            _objects[&obj] = baseObj;
+        }
+
+        void u_forget_removed_objects() {
+            u_forget(_context.u_take_removed_objects());
+        }
+
+        void u_forget(const std::vector<object_base*>& removed) {
+            for (auto obj : removed) {
+                _objects.erase(obj);
+            }
+        }
+
+        const base_object* u_find(const object_base& obj) const {
+            auto itr = _objects.find(&obj);
+            return itr != _objects.end() ? &itr->second : nullptr;
+        }
+
+    private:
+        tes_context& _context;
+        std::unordered_map<const object_base*, base_object> _objects;
+        uint32_t _baseObjectCount = 0;
+        bool _hasBase = false;
+    };
+
+    inline tes_context::post_init g_flat_delta_tracker_init([](tes_context& ctx) {
+        ctx.delta_tracker = std::make_shared<flat_delta_tracker>(ctx);
+    });
+
+    //////////////////////////////////////////////////////////////////////////
+
+    class flat_serialization {
+    public:
+
+        class snapshot;
+
+        // Writes the whole context. With @makeBase the context becomes the base snapshot of the deltas written next
+        static void write_context(tes_context& context, flat_writer& out, bool makeBase = false) {
+            snapshot taken(context, makeBase);
+            write_snapshot(taken, out);
+            if (makeBase) {
+                make_base(taken);
+            }
+        }
+
+        // Writes the changes made since the base snapshot. A context without a base gets written as a delta of an empty one
+        static void write_context_delta(tes_context& context, flat_writer& out) {
+            snapshot taken(context);
+            write_snapshot_delta(taken, out);
+        }
+
+        // Same as write_context and write_context_delta, but write the context as it was when @taken got taken.
+        // Other threads may modify the objects meanwhile. A snapshot written whole becomes the base via make_base
+        static void write_snapshot(const snapshot& taken, flat_writer& out) {
+            context_writer(taken, context_writer::full).write(out);
+        }
+
+        static void write_snapshot_delta(const snapshot& taken, flat_writer& out) {
+            context_writer(taken, context_writer::delta).write(out);
+        }
+
+        // Makes the context, as it was when @taken got taken, the base snapshot of the deltas written next, once @taken
+        // got written by write_snapshot. @taken must journal the removals. The objects must not be modified or removed meanwhile,
+        // as the tracker and the removal journal are not locked - the objects removed since @taken got taken are forgotten
+        static void make_base(const snapshot& taken) {
+            auto& tracker = flat_delta_tracker::of(taken.context());
+            const auto removed = taken.context().u_take_removed_objects();
+            const auto objects = objects_by_type(taken);
+            tracker.u_start(static_cast<uint32_t>(objects.size()));
+            for (uint32_t i = 0; i < objects.size(); ++i) {
+                const snapshot::object_info& info = *objects[i];
+                tracker.u_add(*info.object, flat_delta_tracker::base_object{ i, info.modificationCount, info.entry, true, true });
+            }
+            tracker.u_forget(removed);
+        }
+
+        // Reads into a cleared context on up to @threadCount threads. The strings are copied, so @in may be released afterwards.
+        // The objects get attached to the context and u_onLoaded gets called here, so u_postLoadInitializations is not needed.
+        // With @isBase the context becomes the base snapshot, as if it was written with makeBase
+        // With @formsResolved the form table is resolved already, see resolve_forms
+        static void read_context(tes_context& context, flat_reader& in, size_t threadCount = 1, bool isBase = false,
+            bool formsResolved = false)
+        {
+            context_reader(context, threadCount, formsResolved).read(in, isBase);
+        }
+
+        // Reads a delta written against @base, a context written with makeBase, or against an empty context if @base is null.
+        // The base snapshot stays the base of the context: the objects of the base are tracked, the new ones are not
+        static void read_context_delta(tes_context& context, flat_reader *base, flat_reader& delta, size_t threadCount = 1) {
+            context_reader(context, threadCount).read_delta(base, delta);
+        }
+
+        // Resolves the form table of a context written by write_context in place, the way reading does (see form_ref::load_old_id),
+        // so that the data can be written again as it is - by the next saves, without getting read ever
+        static void resolve_forms(std::string& data) {
+            persistence_profile::timer formsTimer{ persistence_profile::forms };
+            flat_reader in(data.data(), data.data() + data.size());
+            for (size_t count = in.count(); count > 0; --count) { // the string table
+                in.bytes();
+            }
+            const size_t formCount = in.count(4);
+            char *formTable = &data[data.size() - in.remaining()];
+            for (size_t i = 0; i < formCount; ++i) {
+                const uint32_t id = static_cast<uint32_t>(skse::resolve_handle(static_cast<FormId>(in.fixed32())));
+                char *at = formTable + i * 4;
+                at[0] = static_cast<char>(id);
+                at[1] = static_cast<char>(id >> 8);
+                at[2] = static_cast<char>(id >> 16);
+                at[3] = static_cast<char>(id >> 24);
+            }
+        }
+
+        // The context as it is when taken, to be written afterwards - while the objects get modified on other threads.
+        // Taking copies the object table and marks the objects as pending. The contents of a pending object get copied
+        // only if it's about to be modified before the snapshot is released (copy-on-write), the rest are read in place.
+        // The objects must not be modified while a snapshot is being taken. No object gets deleted until it's released
+        class snapshot : public snapshot_observer {
+        public:
+
+            enum : uint32_t { not_in_base = UINT32_MAX };
+
+            struct object_info {
+                object_base *object;
+                uint32_t modificationCount;
+                flat_delta_tracker::table_entry entry;
+                std::string tag;
+                // the object's index in the base snapshot, see flat_delta_tracker
+                uint32_t baseIndex;
+                bool contentsAsInBase;
+                bool unchanged;
+            };
+
+            // With @journalRemovals the removals get journaled from now on, so that the snapshot may become the base
+            // (see make_base) after the objects have been modified
+            explicit snapshot(tes_context& context, bool journalRemovals = false) : _context(context) {
+                context.begin_snapshot(*this);
+
+                auto& tracker = flat_delta_tracker::of(context);
+                tracker.u_forget_removed_objects();
+                _baseObjectCount = tracker.u_base_object_count();
+                if (journalRemovals) {
+                    context.u_journal_removals(true);
+                }
+
+                _state = context.u_flat_state();
+                _rootId = context.u_root_object_id();
+                _objects.reserve(_state.objects.size());
+                for (auto obj : _state.objects) {
+                    object_info info{ obj, obj->u_modification_count(), flat_delta_tracker::table_entry::of(*obj),
+                        std::string(obj->_tag.data(), obj->_tag.size()), not_in_base, false, false };
+                    if (auto baseObj = tracker.u_find(*obj)) {
+                        info.baseIndex = baseObj->index;
+                        info.contentsAsInBase = baseObj->contents_as_in_base(info.modificationCount);
+                        info.unchanged = baseObj->unchanged(info.modificationCount, info.entry);
+                    }
+                    _objects.push_back(std::move(info));
+                    obj->u_set_snapshot_pending(true);
+                }
+            }
+
+            ~snapshot() {
+                for (auto& info : _objects) {
+                    object_lock g(info.object);
+                    info.object->u_set_snapshot_pending(false);
+                }
+                // the copies release the objects they reference while no object can be deleted yet
+                _preserved.clear();
+                _context.end_snapshot();
+            }
+
+            void u_preserve(const object_base& obj) override {
+                std::unique_ptr<object_base> copy(create_object(static_cast<uint8_t>(obj.type())));
+                perform_on_object(*copy, [&obj](auto& cnt) {
+                    cnt.u_container() = obj.as_link<std::decay_t<decltype(cnt)> >().u_container();
+                });
+                std::lock_guard<std::mutex> g(_preservedMutex);
+                _preserved.emplace(&obj, std::move(copy));
+            }
+
+            // calls @func with the contents the object had when the snapshot got taken
+            template<class Func>
+            void visit_contents(object_base& obj, Func&& func) const {
+                {
+                    object_lock g(obj);
+                    if (obj.u_snapshot_pending()) {
+                        perform_on_object(static_cast<const object_base&>(obj), func);
+                        return;
+                    }
+                }
+                const object_base *copy = nullptr;
+                {
+                    std::lock_guard<std::mutex> g(_preservedMutex);
+                    copy = _preserved.at(&obj).get();
+                }
+                perform_on_object(*copy, func);
+            }
+
+            tes_context& context() const { return _context; }
+            const object_context::flat_state& state() const { return _state; }
+            Handle root_id() const { return _rootId; }
+            const std::vector<object_info>& objects() const { return _objects; }
+            uint32_t base_object_count() const { return _baseObjectCount; }
+
+        private:
+            tes_context& _context;
+            object_context::flat_state _state;
+            Handle _rootId = Handle::Null;
+            std::vector<object_info> _objects;
+            uint32_t _baseObjectCount = 0;
+
+            mutable std::mutex _preservedMutex;
+            std::unordered_map<const object_base*, std::unique_ptr<object_base> > _preserved;
+        };
+
+    private:
+
+        // the order of the objects in the table of a full context: grouped by type, so that each section holds
+        // the contents of adjacent objects
+        static std::vector<const snapshot::object_info*> objects_by_type(const snapshot& taken) {
+            std::vector<const snapshot::object_info*> objects;
+            objects.reserve(taken.objects().size());
+            for (auto& info : taken.objects()) {
+                objects.push_back(&info);
+            }
+            std::sort(objects.begin(), objects.end(), [](const snapshot::object_info *l, const snapshot::object_info *r) {
+                return l->object->type() != r->object->type() ? l->object->type() < r->object->type() : l->object < r->object;
+            });
+            return objects;
+        }
+
+        static object_base* create_object(uint8_t type) {
+            switch (type) {
+            case CollectionType::Array: return new array();
+            case CollectionType::Map: return new map();
+            case CollectionType::FormMap: return new form_map();
+            case CollectionType::IntegerMap: return new integer_map();
+            case CollectionType::IntArray: return new int_array();
+            case CollectionType::FloatArray: return new float_array();
+            case CollectionType::Set: return new set();
+            default: return nullptr;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////
+
+        class context_writer {
+        public:
+            enum mode { full, delta };
+
+        private:
+            using object_info = snapshot::object_info;
+
+            const snapshot& _snapshot;
+            mode _mode;
+            // the object table: the objects of the base in the base's order, if a delta, null if removed
+            std::vector<const object_info*> _slots;
+            util::flat_pointer_map<object_base*, uint32_t> _objectIndices;
+            // the strings are copied, as the objects may change once their contents are written
+            std::deque<std::string> _strings;
+            std::unordered_map<std::string_view, uint32_t> _stringIndices;
+            std::unordered_map<FormId, uint32_t> _formIndices;
+            std::vector<FormId> _forms;
+
+        public:
+
+            context_writer(const snapshot& taken, mode writeMode) : _snapshot(taken), _mode(writeMode) {}
+
+            void write(flat_writer& out) {
+                namespace ff = flat_format;
+                persistence_profile::timer registryTimer{ persistence_profile::registry };
+
+                std::vector<const object_info*> objects = objects_by_type(_snapshot);
+
+                // a delta has the contents of the changed and new objects only
+                std::vector<object_base*> withContents;
+                if (_mode == delta) {
+                    _slots.resize(_snapshot.base_object_count());
+                    std::vector<const object_info*> added;
+                    for (auto info : objects) {
+                        if (info->baseIndex != snapshot::not_in_base) {
+                            _slots[info->baseIndex] = info;
+                        }
+                        else {
+                            added.push_back(info);
+                        }
+                    }
+                    _slots.insert(_slots.end(), added.begin(), added.end());
+                }
+                else {
+                    _slots.swap(objects);
+                }
+
+                _objectIndices.reserve(_slots.size());
+                for (uint32_t i = 0; i < _slots.size(); ++i) {
+                    if (auto info = _slots[i]) {
+                        _objectIndices.emplace(info->object, i);
+                        if (_mode != delta || !info->contentsAsInBase) {
+                            withContents.push_back(info->object);
+                        }
+                    }
+                }
+
+                flat_writer table;
+                table.varint(_slots.size());
+                write_chunks(table, _slots, [&](flat_writer& chunk, const object_info *info) {
+                    if (!info) {
+                        chunk.byte(ff::removed_object);
+                        return;
+                    }
+                    if (_mode == delta && info->unchanged) {
+                        chunk.byte(ff::unchanged_object);
+                        return;
+                    }
+                    chunk.byte(static_cast<uint8_t>(info->object->type()));
+                    chunk.varint(static_cast<HandleT>(info->entry.id));
+                    chunk.varint(info->tag.empty() ? 0 : string_index(info->tag) + 1);
+                    chunk.signed_varint(info->entry.tesRefCount);
+                    chunk.varint(info->entry.pushTime);
+                    uint8_t flags = info->entry.valueIndex ? ff::flag_value_index : 0;
+                    if (_mode == delta && info->contentsAsInBase) {
+                        flags |= ff::flag_contents_from_base;
+                    }
+                    chunk.byte(flags);
+                });
+                registryTimer.stop();
+
+                persistence_profile::timer aqueueTimer{ persistence_profile::aqueue };
+                const auto& state = _snapshot.state();
+                table.varint(state.freeHandles.size());
+                for (auto& range : state.freeHandles) {
+                    table.varint(range.first);
+                    table.varint(range.second);
+                }
+                table.varint(state.currentFreeHandles);
+
+                table.varint(state.aqueueTickCounter);
+                table.varint(state.aqueue.size());
+                for (auto obj : state.aqueue) {
+                    table.varint(*_objectIndices.find(obj));
+                }
+                table.varint(static_cast<HandleT>(_snapshot.root_id()));
+                aqueueTimer.stop();
+
+                flat_writer contents;
+                {
+                    persistence_profile::type_meter meter;
+                    write_chunks(contents, withContents, [&](flat_writer& chunk, object_base *obj) {
+                        const size_t size = chunk.data().size();
+                        meter.next(obj->type());
+                        _snapshot.visit_contents(*obj, contents_writer{ *this, chunk });
+                        meter.add_bytes(chunk.data().size() - size);
+                    });
+                }
+
+                persistence_profile::timer formsTimer{ persistence_profile::forms };
+
+                if (_mode == delta) {
+                    out.varint(_snapshot.base_object_count());
+                }
+                out.varint(_strings.size());
+                for (auto& str : _strings) {
+                    out.bytes(str);
+                }
+                out.varint(_forms.size());
+                for (auto id : _forms) {
+                    out.fixed32(static_cast<uint32_t>(id));
+                }
+                formsTimer.stop();
+                out.append(table);
+                out.append(contents);
+            }
+
+        private:
+
+            // the chunk count, then the number of objects and the data of each chunk
+            template<class T, class Func>
+            static void write_chunks(flat_writer& out, const std::vector<T>& objects, Func&& writeObject) {
+                std::vector<std::pair<size_t, flat_writer> > chunks;
+                for (auto obj : objects) {
+                    if (chunks.empty() || chunks.back().first == flat_format::chunk_objects ||
+                        chunks.back().second.data().size() >= flat_format::chunk_bytes)
+                    {
+                        chunks.emplace_back();
+                    }
+                    writeObject(chunks.back().second, obj);
+                    ++chunks.back().first;
+                }
+
+                out.varint(chunks.size());
+                for (auto& chunk : chunks) {
+                    out.varint(chunk.first);
+                    out.bytes(chunk.second.data());
+                }
+            }
+
+            uint32_t string_index(std::string_view str) {
+                auto found = _stringIndices.find(str);
+                if (found != _stringIndices.end()) {
+                    return found->second;
+                }
+                const auto index = static_cast<uint32_t>(_strings.size());
+                _strings.emplace_back(str);
+                _stringIndices.emplace(_strings.back(), index);
+                return index;
+            }
+
+            uint32_t form_index(const form_ref& form) {
+                if (form.is_expired()) {
+                    return 0;
+                }
+                auto inserted = _formIndices.emplace(form.get_raw(), static_cast<uint32_t>(_forms.size() + 1));
+                if (inserted.second) {
+                    _forms.push_back(form.get_raw());
+                }
+                return inserted.first->second;
+            }
+
+            uint32_t object_index(object_base *obj) {
+                auto index = obj ? _objectIndices.find(obj) : nullptr;
+                return index ? *index + 1 : 0;
+            }
+
+            void write_item(flat_writer& out, const item& itm) {
+                namespace ff = flat_format;
+
+                switch (itm.type()) {
+                case item_type::integer:
+                    out.byte(ff::tag_integer);
+                    out.signed_varint(*itm.get<SInt32>());
+                    break;
+                case item_type::real:
+                    out.byte(ff::tag_real);
+                    out.real(*itm.get<Float32>());
+                    break;
+                case item_type::form:
+                    out.byte(ff::tag_form);
+                    out.varint(form_index(*itm.get<form_ref>()));
+                    break;
+                case item_type::object:
+                    out.byte(ff::tag_object);
+                    out.varint(object_index(itm.object()));
+                    break;
+                case item_type::string:
+                    out.byte(ff::tag_string);
+                    out.varint(string_index(*itm.get<std::string>()));
+                    break;
+                default:
+                    out.byte(ff::tag_none);
+                    break;
+                }
+            }
+
+            struct contents_writer {
+                context_writer& self;
+                flat_writer& out;
+
+                void operator()(const array& arr) {
+                    out.varint(arr.u_container().size());
+                    for (auto& itm : arr.u_container()) {
+                        self.write_item(out, itm);
+                    }
+                }
+                void operator()(const map& cnt) {
+                    out.varint(cnt.u_container().size());
+                    for (auto& pair : cnt.u_container()) {
+                        out.varint(self.string_index(pair.first));
+                        self.write_item(out, pair.second);
+                    }
+                }
+                void operator()(const form_map& cnt) {
+                    out.varint(cnt.u_container().size());
+                    for (auto& pair : cnt.u_container()) {
+                        out.varint(self.form_index(pair.first));
+                        self.write_item(out, pair.second);
+                    }
+                }
+                void operator()(const integer_map& cnt) {
+                    out.varint(cnt.u_container().size());
+                    for (auto& pair : cnt.u_container()) {
+                        out.signed_varint(pair.first);
+                        self.write_item(out, pair.second);
+                    }
+                }
+                void operator()(const int_array& arr) {
+                    out.varint(arr.u_container().size());
+                    for (auto value : arr.u_container()) {
+                        out.signed_varint(value);
+                    }
+                }
+                void operator()(const float_array& arr) {
+                    out.varint(arr.u_container().size());
+                    for (auto value : arr.u_container()) {
+                        out.real(value);
+                    }
+                }
+                void operator()(const set& cnt) {
+                    out.varint(cnt.u_container().size());
+                    for (auto& itm : cnt.u_container()) {
+                        self.write_item(out, itm);
+                    }
+                }
+            };
+        };
+
+        //////////////////////////////////////////////////////////////////////////
+
+        class context_reader {
+            tes_context& _context;
+            size_t _threadCount;
+            bool _formsResolved;
+            std::vector<std::string_view> _strings;
+            std::vector<form_ref> _forms;
+            // the object table, null slots are removed objects of a delta's base
+            std::vector<object_base*> _objects;
+
+            struct chunk {
+                size_t first;
+                size_t count;
+                flat_reader data;
+            };
+
+            struct table_entry {
+                uint8_t type;
+                Handle id;
+                uint32_t tag; // index in the string table + 1, 0 is no tag
+                int32_t tesRefCount;
+                object_base::time_point pushTime;
+                uint8_t flags;
+            };
+
+            // the base of a delta, located but not decoded yet
+            struct base_snapshot {
+                std::unique_ptr<context_reader> reader;
+                std::vector<table_entry> entries;
+                std::vector<chunk> contentChunks;
+            };
+
+            // what a delta's object has from the base
+            enum from_base : char {
+                nothing_from_base = 0,
+                contents_from_base,
+                all_from_base, // the contents and the object table entry
+            };
+
+            // delta only
+            bool _isDelta = false;
+            size_t _baseObjectCount = 0;
+            const base_snapshot *_base = nullptr;
+            std::vector<char> _fromBase;
+            std::vector<object_base*> _changedObjects;
+
+        public:
+
+            context_reader(tes_context& context, size_t threadCount, bool formsResolved = false)
+                : _context(context), _threadCount(threadCount), _formsResolved(formsResolved) {}
+
+            void read(flat_reader& in, bool isBase) {
+                // the contents, then the attachment to the context and the post-load fixes
+                auto contentChunks = read_tables(in);
+                util::for_each_concurrently(contentChunks.size(), _threadCount, [&](size_t idx) {
+                    chunk& ch = contentChunks[idx];
+                    {
+                        persistence_profile::type_meter meter;
+                        for (size_t i = ch.first; i < ch.first + ch.count; ++i) {
+                            object_base& obj = *_objects[i];
+                            const size_t remaining = ch.data.remaining();
+                            meter.next(obj.type());
+                            perform_on_object(obj, contents_reader{ *this, ch.data });
+                            meter.add_bytes(remaining - ch.data.remaining());
+                        }
+                    }
+                    ensure_chunk_end(ch);
+                });
+                finish_loading();
+
+                if (isBase) {
+                    auto& tracker = flat_delta_tracker::of(_context);
+                    tracker.u_start(static_cast<uint32_t>(_objects.size()));
+                    for (uint32_t i = 0; i < _objects.size(); ++i) {
+                        tracker.u_add(*_objects[i], i, true, true);
+                    }
+                }
+            }
+
+            void read_delta(flat_reader *baseIn, flat_reader& in) {
+                _isDelta = true;
+                _baseObjectCount = in.varint32();
+
+                base_snapshot base;
+                if (baseIn && _baseObjectCount > 0) {
+                    base = locate_base(*baseIn);
+                }
+                if (base.entries.size() != _baseObjectCount) {
+                    throw flat_format_error("delta doesn't match the base");
+                }
+                _base = &base;
+
+                auto contentChunks = read_tables(in);
+
+                // the base's contents are read with the base's strings and forms, but into the delta's objects
+                if (base.reader) {
+                    base.reader->_objects = _objects;
+                }
+                util::for_each_concurrently(contentChunks.size() + base.contentChunks.size(), _threadCount, [&](size_t idx) {
+                    persistence_profile::type_meter meter;
+                    if (idx < contentChunks.size()) {
+                        chunk& ch = contentChunks[idx];
+                        for (size_t i = ch.first; i < ch.first + ch.count; ++i) {
+                            const size_t remaining = ch.data.remaining();
+                            meter.next(_changedObjects[i]->type());
+                            perform_on_object(*_changedObjects[i], contents_reader{ *this, ch.data });
+                            meter.add_bytes(remaining - ch.data.remaining());
+                        }
+                        ensure_chunk_end(ch);
+                    }
+                    else {
+                        chunk& ch = base.contentChunks[idx - contentChunks.size()];
+                        for (size_t i = ch.first; i < ch.first + ch.count; ++i) {
+                            object_base *obj = _objects[i];
+                            if (obj && _fromBase[i] != nothing_from_base) {
+                                if (obj->type() != base.entries[i].type) {
+                                    throw flat_format_error("delta doesn't match the base");
+                                }
+                                const size_t remaining = ch.data.remaining();
+                                meter.next(obj->type());
+                                perform_on_object(*obj, contents_reader{ *base.reader, ch.data });
+                                meter.add_bytes(remaining - ch.data.remaining());
+                            }
+                            else {
+                                skip_contents(base.entries[i].type, ch.data);
+                            }
+                        }
+                        ensure_chunk_end(ch);
+                    }
+                });
+
+                finish_loading();
+
+                // the new objects aren't the base's ones and get written in whole by each delta
+                auto& tracker = flat_delta_tracker::of(_context);
+                tracker.u_start(static_cast<uint32_t>(_baseObjectCount));
+                for (uint32_t i = 0; i < _baseObjectCount; ++i) {
+                    if (_objects[i]) {
+                        tracker.u_add(*_objects[i], i, _fromBase[i] == all_from_base, _fromBase[i] != nothing_from_base);
+                    }
+                }
+                _base = nullptr;
+            }
+
+        private:
+
+            // attaches every object to the context and only then does the post-load fixes: u_onLoaded may release
+            // the objects of the other chunks, which have to know their context by then
+            void finish_loading() {
+                const size_t chunkCount = (_objects.size() + flat_format::chunk_objects - 1) / flat_format::chunk_objects;
+                auto for_each_object = [&](auto&& func) {
+                    util::for_each_concurrently(chunkCount, _threadCount, [&](size_t idx) {
+                        persistence_profile::timer postLoadTimer{ persistence_profile::post_load };
+                        const size_t end = (std::min)(_objects.size(), (idx + 1) * flat_format::chunk_objects);
+                        for (size_t i = idx * flat_format::chunk_objects; i < end; ++i) {
+                            if (object_base *obj = _objects[i]) {
+                                func(*obj);
+                            }
+                        }
+                    });
+                };
+                for_each_object([&](object_base& obj) { obj.set_context(_context); });
+                for_each_object([](object_base& obj) { obj.u_onLoaded(); });
+            }
+
+            // reads everything but the contents: the objects get created and registered. Returns the chunks of the contents
+            std::vector<chunk> read_tables(flat_reader& in) {
+                {
+                    persistence_profile::timer formsTimer{ persistence_profile::forms };
+                    read_strings_and_forms(in);
+                }
+
+                // owned here until registered
+                persistence_profile::timer registryTimer{ persistence_profile::registry };
+                const size_t objectCount = in.count();
+                if (objectCount < _baseObjectCount) {
+                    throw flat_format_error("delta has less objects than the base");
+                }
+                std::vector<std::unique_ptr<object_base> > objects(objectCount);
+                _fromBase.resize(_isDelta ? objectCount : 0, nothing_from_base);
+                auto tableChunks = read_chunks(in, objectCount, _isDelta ? 1 : 6);
+                util::for_each_concurrently(tableChunks.size(), _threadCount, [&](size_t idx) {
+                    chunk& ch = tableChunks[idx];
+                    for (size_t i = ch.first; i < ch.first + ch.count; ++i) {
+                        objects[i] = read_object(ch.data, i);
+                    }
+                    ensure_chunk_end(ch);
+                });
+                _objects.reserve(objects.size());
+                for (auto& obj : objects) {
+                    _objects.push_back(obj.get());
+                }
+                registryTimer.stop();
+
+                persistence_profile::timer aqueueTimer{ persistence_profile::aqueue };
+                object_context::flat_state state;
+                const size_t rangeCount = in.count(2);
+                for (size_t i = 0; i < rangeCount; ++i) {
+                    const HandleT first = in.varint32();
+                    state.freeHandles.emplace_back(first, in.varint32());
+                }
+                state.currentFreeHandles = in.varint32();
+
+                state.aqueueTickCounter = in.varint32();
+                const size_t queueCount = in.count();
+                for (size_t i = 0; i < queueCount; ++i) {
+                    state.aqueue.push_back(object_at(in.varint32()));
+                }
+                const Handle rootId = static_cast<Handle>(in.varint32());
+                aqueueTimer.stop();
+
+                // from now on the objects are the context's
+                registryTimer.start();
+                for (auto& obj : objects) {
+                    if (obj) {
+                        state.objects.push_back(obj.release());
+                    }
+                }
+                if (!_context.u_load_flat_state(state)) {
+                    throw flat_format_error("duplicate identifiers or invalid identifier ranges");
+                }
+                _context.u_set_root_object_id(rootId);
+                registryTimer.stop();
+
+                // a delta has the contents of the objects, which don't take them from the base, in the order of the table
+                if (_isDelta) {
+                    for (size_t i = 0; i < _objects.size(); ++i) {
+                        if (_objects[i] && _fromBase[i] == nothing_from_base) {
+                            _changedObjects.push_back(_objects[i]);
+                        }
+                    }
+                }
+                auto contentChunks = read_chunks(in, _isDelta ? _changedObjects.size() : _objects.size(), 1);
+                if (!in.at_end()) {
+                    throw flat_format_error("trailing data");
+                }
+                return contentChunks;
+            }
+
+            void read_strings_and_forms(flat_reader& in) {
+                const size_t stringCount = in.count();
+                _strings.reserve(stringCount);
+                for (size_t i = 0; i < stringCount; ++i) {
+                    _strings.push_back(in.bytes());
+                }
+
+                const size_t formCount = in.count(4);
+                _forms.reserve(formCount + 1);
+                _forms.emplace_back();
+                for (size_t i = 0; i < formCount; ++i) {
+                    const auto id = static_cast<FormId>(in.fixed32());
+                    if (_formsResolved) {
+                        _forms.emplace_back(id, _context._form_watcher);
+                    }
+                    else {
+                        _forms.emplace_back(id, _context._form_watcher, form_ref::load_old_id);
+                    }
+                }
+            }
+
+            // reads the base's strings, forms and object table, locates the chunks of its contents
+            base_snapshot locate_base(flat_reader& in) const {
+                persistence_profile::timer baseTimer{ persistence_profile::base_snapshot };
+                base_snapshot base;
+                base.reader = std::make_unique<context_reader>(_context, _threadCount);
+                base.reader->read_strings_and_forms(in);
+
+                base.entries.resize(in.count());
+                auto tableChunks = read_chunks(in, base.entries.size(), 6);
+                util::for_each_concurrently(tableChunks.size(), _threadCount, [&](size_t idx) {
+                    chunk& ch = tableChunks[idx];
+                    for (size_t i = ch.first; i < ch.first + ch.count; ++i) {
+                        base.entries[i] = read_entry(ch.data.byte(), ch.data);
+                    }
+                    ensure_chunk_end(ch);
+                });
+
+                for (size_t count = in.count(2) * 2 + 1; count > 0; --count) { // identifier ranges
+                    in.varint32();
+                }
+                in.varint32();
+                for (size_t count = in.count(); count > 0; --count) { // autorelease queue
+                    in.varint32();
+                }
+                in.varint32();
+
+                base.contentChunks = read_chunks(in, base.entries.size(), 1);
+                if (!in.at_end()) {
+                    throw flat_format_error("trailing data");
+                }
+                return base;
+            }
+
+            // locates the chunks, which cover @objectCount objects, each one occupies @minObjectSize bytes at least
+            static std::vector<chunk> read_chunks(flat_reader& in, size_t objectCount, size_t minObjectSize) {
+                std::vector<chunk> chunks(in.count(2));
+                size_t next = 0;
+                for (auto& ch : chunks) {
+                    ch.first = next;
+                    ch.count = in.varint32();
+                    ch.data = in.block();
+                    if (ch.count > objectCount - next || ch.count > ch.data.remaining() / minObjectSize) {
+                        throw flat_format_error("chunk size is out of range");
+                    }
+                    next += ch.count;
+                }
+                if (next != objectCount) {
+                    throw flat_format_error("chunks don't cover all the objects");
+                }
+                return chunks;
+            }
+
+            static void ensure_chunk_end(const chunk& ch) {
+                if (!ch.data.at_end()) {
+                    throw flat_format_error("chunk has trailing data");
+                }
+            }
+
+            static table_entry read_entry(uint8_t type, flat_reader& in) {
+                table_entry entry;
+                entry.type = type;
+                entry.id = static_cast<Handle>(in.varint32());
+                entry.tag = in.varint32();
+                entry.tesRefCount = in.signed_varint32();
+                entry.pushTime = in.varint32();
+                entry.flags = in.byte();
+                return entry;
+            }
+
+            std::unique_ptr<object_base> make_object(const table_entry& entry) const {
+                std::unique_ptr<object_base> obj(create_object(entry.type));
+                if (!obj) {
+                    throw flat_format_error("unknown object type");
+                }
+                obj->_id.store(entry.id, std::memory_order_relaxed);
+                if (entry.tag) {
+                    const auto str = string_at(entry.tag - 1);
+                    obj->_tag.assign(str.data(), str.size());
+                }
+                obj->_tes_refCount.store(entry.tesRefCount, std::memory_order_relaxed);
+                obj->_aqueue_push_time = entry.pushTime;
+                if (entry.flags & flat_format::flag_value_index) {
+                    if (auto arr = obj->as<array>()) {
+                        arr->u_enable_value_index(true);
+                    }
+                }
+                return obj;
+            }
+
+            // returns null for a removed object of a delta's base
+            std::unique_ptr<object_base> read_object(flat_reader& in, size_t index) {
+                namespace ff = flat_format;
+
+                const uint8_t type = in.byte();
+                if (index < _baseObjectCount) {
+                    switch (type) {
+                    case ff::removed_object:
+                        return nullptr;
+                    case ff::unchanged_object:
+                        _fromBase[index] = all_from_base;
+                        return _base->reader->make_object(_base->entries[index]);
+                    }
+                }
+
+                const table_entry entry = read_entry(type, in);
+                if (entry.flags & ff::flag_contents_from_base) {
+                    if (index >= _baseObjectCount) {
+                        throw flat_format_error("new object has the contents of the base");
+                    }
+                    _fromBase[index] = contents_from_base;
+                }
+                return make_object(entry);
+            }
+
+            std::string_view string_at(uint32_t index) const {
+                if (index >= _strings.size()) {
+                    throw flat_format_error("string index is out of range");
+                }
+                return _strings[index];
+            }
+
+            const form_ref& form_at(uint32_t index) const {
+                if (index >= _forms.size()) {
+                    throw flat_format_error("form index is out of range");
+                }
+                return _forms[index];
+            }
+
+            object_base* object_at(uint32_t index) const {
+                if (index >= _objects.size() || !_objects[index]) {
+                    throw flat_format_error("object index is out of range");
+                }
+                return _objects[index];
+            }
+
+            item read_item(flat_reader& in) const {
+                namespace ff = flat_format;
+
+                switch (in.byte()) {
+                case ff::tag_none:
+                    return item();
+                case ff::tag_integer:
+                    return item(in.signed_varint32());
+                case ff::tag_real:
+                    return item(in.real());
+                case ff::tag_form:
+                    return item(form_at(in.varint32()));
+                case ff::tag_object: {
+                    const uint32_t index = in.varint32();
+                    return index ? item(object_at(index - 1)) : item();
+                }
+                case ff::tag_string:
+                    return item(std::string(string_at(in.varint32())));
+                default:
+                    throw flat_format_error("unknown item type");
+                }
+            }
+
+            // the contents of a base's object, which is removed or has changed. Nothing gets resolved
+            static void skip_contents(uint8_t type, flat_reader& in) {
+                switch (type) {
+                case CollectionType::Array:
+                case CollectionType::Set:
+                    for (size_t count = in.count(); count > 0; --count) {
+                        skip_item(in);
+                    }
+                    break;
+                case CollectionType::Map:
+                case CollectionType::FormMap:
+                    for (size_t count = in.count(2); count > 0; --count) {
+                        in.varint32();
+                        skip_item(in);
+                    }
+                    break;
+                case CollectionType::IntegerMap:
+                    for (size_t count = in.count(2); count > 0; --count) {
+                        in.signed_varint32();
+                        skip_item(in);
+                    }
+                    break;
+                case CollectionType::IntArray:
+                    for (size_t count = in.count(); count > 0; --count) {
+                        in.signed_varint32();
+                    }
+                    break;
+                case CollectionType::FloatArray:
+                    for (size_t count = in.count(4); count > 0; --count) {
+                        in.real();
+                    }
+                    break;
+                default:
+                    throw flat_format_error("unknown object type");
+                }
+            }
+
+            static void skip_item(flat_reader& in) {
+                namespace ff = flat_format;
+
+                switch (in.byte()) {
+                case ff::tag_none:
+                    break;
+                case ff::tag_real:
+                    in.fixed32();
+                    break;
+                case ff::tag_integer:
+                case ff::tag_form:
+                case ff::tag_object:
+                case ff::tag_string:
+                    in.varint32();
+                    break;
+                default:
+                    throw flat_format_error("unknown item type");
+                }
+            }
+
+            // the keys are written in order, so each goes to the end of the map
+            struct contents_reader {
+                const context_reader& self;
+                flat_reader& in;
+
+                void operator()(array& arr) {
+                    auto& items = arr.u_container();
+                    for (size_t count = in.count(); count > 0; --count) {
+                        items.push_back(self.read_item(in));
+                    }
+                }
+                void operator()(map& cnt) {
+                    auto& items = cnt.u_container();
+                    for (size_t count = in.count(2); count > 0; --count) {
+                        auto key = self.string_at(in.varint32());
+                        items.emplace_hint(items.end(), std::string(key), self.read_item(in));
+                    }
+                }
+                void operator()(form_map& cnt) {
+                    // resolved identifiers may go in another order, expired keys get erased by u_onLoaded
+                    auto& items = cnt.u_container();
+                    for (size_t count = in.count(2); count > 0; --count) {
+                        const form_ref& key = self.form_at(in.varint32());
+                        items.emplace_hint(items.end(), key, self.read_item(in));
+                    }
+                }
+                void operator()(integer_map& cnt) {
+                    auto& items = cnt.u_container();
+                    for (size_t count = in.count(2); count > 0; --count) {
+                        const int32_t key = in.signed_varint32();
+                        items.emplace_hint(items.end(), key, self.read_item(in));
+                    }
+                }
+                void operator()(int_array& arr) {
+                    auto& values = arr.u_container();
+                    const size_t count = in.count();
+                    values.reserve(count);
+                    for (size_t i = 0; i < count; ++i) {
+                        values.push_back(in.signed_varint32());
+                    }
+                }
+                void operator()(float_array& arr) {
+                    auto& values = arr.u_container();
+                    const size_t count = in.count(4);
+                    values.reserve(count);
+                    for (size_t i = 0; i < count; ++i) {
+                        values.push_back(in.real());
+                    }
+                }
+                void operator()(set& cnt) {
+                    auto& items = cnt.u_container();
+                    for (size_t count = in.count(); count > 0; --count) {
+                        items.push_back(self.read_item(in));
+                    }
+                }
+            };
+        };
+    };
+}
@@ -113,7 +113,7 @@ namespace collections {
         static R doReadOpR(T * obj, const key_type& key, R default, Op& operation) {
             if (obj && key_checker::check(key)) {
                 object_lock g(obj);
-                item *itm = obj->u_get(key);
+                const item *itm = static_cast<const T*>(obj)->u_get(key);
                 return itm ? operation(*itm) : default;
             }
             else {
@@ -125,7 +125,7 @@ namespace collections {
         static void doReadOp(T * obj, const key_type& key, Op& operation) {
             if (obj && key_checker::check(key)) {
                 object_lock g(obj);
-                item *itm = obj->u_get(key);
+                const item *itm = static_cast<const T*>(obj)->u_get(key);
                 if (itm) {
                     operation(*itm);
                 }
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <functional>
+
+#include "collections/item.h"
+
+namespace collections {
+
+    // Hash of an item, consistent with item equality (are_strict_equals):
+    // strings are hashed case-insensitively, -0.0 and 0.0 hash equally.
+    // Forms are hashed by their raw identifiers, so use @item_hash_equal to compare items
+    // hashed this way: unlike item::operator == it doesn't treat all expired forms as equal
+    struct item_hasher {
+
+        size_t operator () (const item& itm) const {
+            return with_type(boost::apply_visitor(visitor(), itm.var()), itm.type());
+        }
+
+        // the same as hashing of an item containing form with given identifier
+        static size_t hash_form(FormId id) {
+            return with_type(std::hash<uint32_t>()(static_cast<uint32_t>(id)), item_type::form);
+        }
+
+        static size_t hash_string_case_insensitive(const char *str, size_t length) {
+            // FNV-1a over ASCII-folded characters, the same folding _stricmp does in "C" locale
+            size_t hash = 2166136261u;
+            for (size_t i = 0; i < length; ++i) {
+                unsigned char c = static_cast<unsigned char>(str[i]);
+                hash ^= (c >= 'A' && c <= 'Z') ? (c + ('a' - 'A')) : c;
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+    private:
+
+        static size_t with_type(size_t valueHash, item_type type) {
+            return valueHash ^ (size_t(type) * 0x9E3779B9u);
+        }
+
+        struct visitor : boost::static_visitor<size_t> {
+
+            size_t operator () (const boost::blank&) const {
+                return 0;
+            }
+
+            size_t operator () (const SInt32& val) const {
+                return std::hash<SInt32>()(val);
+            }
+
+            size_t operator () (const item::Real& val) const {
+                return val == 0 ? 0 : std::hash<item::Real>()(val);
+            }
+
+            size_t operator () (const form_ref& val) const {
+                return std::hash<uint32_t>()(static_cast<uint32_t>(val.get_raw()));
+            }
+
+            size_t operator () (const internal_object_ref& val) const {
+                return std::hash<const object_base*>()(val.get());
+            }
+
+            size_t operator () (const std::string& val) const {
+                return hash_string_case_insensitive(val.c_str(), val.size());
+            }
+        };
+    };
+
+    struct item_hash_equal {
+
+        bool operator () (const item& left, const item& right) const {
+            const auto lf = left.get<form_ref>(), rf = right.get<form_ref>();
+            if (lf && rf) {
+                return lf->get_raw() == rf->get_raw();
+            }
+            return left == right;
+        }
+    };
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "collections/item.h"
+#include "util/radix_sort.h"
+
+namespace collections {
+
+    // Sorts items into item::operator < order (none < int < float < form < object < string) without
+    // comparing them pair by pair (a type dispatch plus _stricmp per comparison):
+    // items are partitioned by type, numbers get radix-sorted, forms and objects are sorted by integer keys
+    // and strings by keys folded once per item. The sort is stable
+    namespace item_sort {
+
+        // the same folding _stricmp does in "C" locale
+        inline std::string folded(const std::string& str) {
+            std::string result(str);
+            for (auto& c : result) {
+                if (c >= 'A' && c <= 'Z') {
+                    c += 'a' - 'A';
+                }
+            }
+            return result;
+        }
+
+        // Returns positions of @keys, ordered by their values
+        inline std::vector<uint32_t> sorted_order(const std::vector<item>& keys) {
+            const uint32_t count = static_cast<uint32_t>(keys.size());
+
+            // pairs of sort key and position in @keys. Unique positions make std::sort stable here
+            std::vector<uint32_t> nones;
+            std::vector<std::pair<uint32_t, uint32_t>> integers, reals;
+            std::vector<std::pair<uint64_t, uint32_t>> forms, objects;
+            std::vector<std::pair<std::string, uint32_t>> strings;
+
+            for (uint32_t i = 0; i < count; ++i) {
+                const item& itm = keys[i];
+                switch (itm.type()) {
+                case item_type::integer:
+                    integers.emplace_back(util::radix_key(*itm.get<SInt32>()), i);
+                    break;
+                case item_type::real:
+                    reals.emplace_back(util::radix_key(*itm.get<item::Real>()), i);
+                    break;
+                case item_type::form: {
+                    // form_ref's order: by identifier, then by expiration
+                    const form_ref& form = *itm.get<form_ref>();
+                    forms.emplace_back((uint64_t(static_cast<uint32_t>(form.get_raw())) << 1) | (form.is_expired() ? 1 : 0), i);
+                    break;
+                }
+                case item_type::object:
+                    objects.emplace_back(reinterpret_cast<uintptr_t>(itm.object()), i);
+                    break;
+                case item_type::string:
+                    strings.emplace_back(folded(*itm.get<std::string>()), i);
+                    break;
+                default:
+                    nones.push_back(i);
+                    break;
+                }
+            }
+
+            auto radixKey = [](const std::pair<uint32_t, uint32_t>& p) { return p.first; };
+            util::radix_sort(integers, radixKey);
+            util::radix_sort(reals, radixKey);
+            std::sort(forms.begin(), forms.end());
+            std::sort(objects.begin(), objects.end());
+            std::sort(strings.begin(), strings.end());
+
+            std::vector<uint32_t> order(std::move(nones));
+            order.reserve(count);
+            for (auto& p : integers) order.push_back(p.second);
+            for (auto& p : reals) order.push_back(p.second);
+            for (auto& p : forms) order.push_back(p.second);
+            for (auto& p : objects) order.push_back(p.second);
+            for (auto& p : strings) order.push_back(p.second);
+            return order;
+        }
+
+        // Reorders @values, @order is a permutation of @values positions
+        inline void apply_order(std::vector<item>& values, const std::vector<uint32_t>& order) {
+            std::vector<item> sorted;
+            sorted.reserve(values.size());
+            for (auto position : order) {
+                sorted.push_back(std::move(values[position]));
+            }
+            values.swap(sorted);
+        }
+
+        inline void sort(std::vector<item>& values) {
+            apply_order(values, sorted_order(values));
+        }
+    }
+}
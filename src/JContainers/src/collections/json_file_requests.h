@@ -0,0 +1,346 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <boost/filesystem.hpp>
+
+#include "object/object_staging_arena.h"
+#include "util/flat_pointer_map.h"
+#include "collections/context.h"
+#include "collections/copying.h"
+#include "collections/json_serialization.h"
+
+namespace collections {
+
+    // JSON files, read and written on a worker thread of their own. The calling thread only takes a deep snapshot
+    // of the object being written, so the object can be modified right after the request is made.
+    // A request is identified by a positive number and lives until its result is taken
+    class json_file_requests : public dependent_context {
+    public:
+
+        enum class request_state : SInt32 {
+            unknown = 0,
+            pending,
+            succeeded,
+            failed,
+        };
+
+    private:
+
+        struct request {
+            request_state state = request_state::pending;
+            // the snapshot being written or the object that has been read
+            object_stack_ref object;
+        };
+
+        using request_ref = std::shared_ptr<request>;
+
+        tes_context& _context;
+        mutable std::mutex _mutex;
+        mutable std::condition_variable _completed;
+        std::map<SInt32, request_ref> _requests;
+        SInt32 _lastId = 0;
+        size_t _pendingCount = 0;
+
+        // the requests run one after another on the worker - not on the autorelease queues' thread, which
+        // mustn't wait for the file I/O. The worker starts with the first request
+        std::deque<std::function<void()>> _tasks;
+        std::condition_variable _tasksQueued;
+        bool _stopping = false;
+        std::thread _worker;
+
+        // directory path -> file name -> fingerprint of the subtree the file has been written from, see write_directory
+        std::mutex _directoriesMutex;
+        std::map<std::string, std::map<std::string, uint64_t> > _writtenDirectories;
+
+    public:
+
+        explicit json_file_requests(tes_context& context) : _context(context) {
+            context.add_dependent_context(*this);
+        }
+
+        ~json_file_requests() {
+            wait_all();
+            {
+                std::lock_guard<std::mutex> g(_mutex);
+                _stopping = true;
+            }
+            _tasksQueued.notify_all();
+            if (_worker.joinable()) {
+                _worker.join();
+            }
+            _context.remove_dependent_context(*this);
+        }
+
+        static json_file_requests& of(tes_context& context) {
+            return static_cast<json_file_requests&>(*context.file_requests);
+        }
+
+        // creates missing directories of the file
+        static bool create_directories_of(const char *path) {
+            boost::filesystem::path dir(path);
+            dir.remove_filename();
+
+            boost::system::error_code error;
+            if (!dir.empty() && !boost::filesystem::exists(dir, error)) {
+                boost::filesystem::create_directories(dir, error);
+                if (!boost::filesystem::exists(dir, error)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // creates missing directories, writes the file
+        static bool write_file(const object_base& root, const char *path) {
+            return create_directories_of(path) && json_serializer::write_json_file(root, path, JSON_INDENT(2));
+        }
+
+        // the same, in binary format
+        static bool write_binary_file(const object_base& root, const char *path) {
+            return create_directories_of(path) && json_serializer::write_cbor_file(root, path);
+        }
+
+        // Changes once any object of the subtree gets modified: combines the modification counters of the objects.
+        // The objects get locked one by one, so the subtree may be modified concurrently
+        static uint64_t subtree_fingerprint(object_base& root) {
+            uint64_t fingerprint = 0;
+            auto combine = [&fingerprint](uint64_t value) {
+                fingerprint ^= value + 0x9E3779B97F4A7C15ull + (fingerprint << 6) + (fingerprint >> 2);
+            };
+
+            util::flat_pointer_set<object_base*> visited;
+            std::vector<object_stack_ref> toVisit{ &root };
+            visited.insert(&root);
+
+            while (!toVisit.empty()) {
+                object_stack_ref obj = std::move(toVisit.back());
+                toVisit.pop_back();
+
+                object_lock g(obj);
+                combine(reinterpret_cast<uintptr_t>(obj.get()));
+                combine(obj->u_modification_count());
+                obj->u_visit_referenced_objects([&](object_base& referenced) {
+                    if (visited.insert(&referenced)) {
+                        toVisit.push_back(&referenced);
+                    }
+                });
+            }
+            return fingerprint;
+        }
+
+        // a key of write_directory must name a file inside the directory: not absolute and not going up
+        static bool is_path_inside_directory(const boost::filesystem::path& relative) {
+            if (relative.empty() || relative.has_root_path()) {
+                return false;
+            }
+            for (auto& element : relative) {
+                if (element == "..") {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Writes each container of the map into its own file, a key is the file path relative to @dirPath -
+        // the layout readFromDirectory reads. Only the files whose subtrees have changed since the last write
+        // into the same directory get rewritten. The files of the removed keys, written earlier, get deleted.
+        // The keys, which are absolute paths or go up with '..', are skipped. Returns the number of files written
+        size_t write_directory(const map& root, const char *dirPath) {
+            const boost::filesystem::path dir(dirPath);
+
+            std::vector<std::pair<std::string, object_stack_ref> > subtrees;
+            {
+                object_lock g(root);
+                subtrees.reserve(root.u_container().size());
+                for (auto& pair : root.u_container()) {
+                    if (auto obj = pair.second.object()) {
+                        subtrees.emplace_back(pair.first, obj);
+                    }
+                }
+            }
+
+            std::lock_guard<std::mutex> g(_directoriesMutex);
+            auto& written = _writtenDirectories[dir.generic_string()];
+            std::map<std::string, uint64_t> current;
+            size_t writtenCount = 0;
+
+            for (auto& subtree : subtrees) {
+                if (!is_path_inside_directory(subtree.first)) {
+                    JC_LOG_ERROR("Can't write '%s': the path isn't inside '%s'", subtree.first.c_str(), dir.generic_string().c_str());
+                    continue;
+                }
+                const uint64_t fingerprint = subtree_fingerprint(*subtree.second);
+                auto previous = written.find(subtree.first);
+                if (previous != written.end() && previous->second == fingerprint) {
+                    current.emplace(subtree.first, fingerprint);
+                }
+                else if (write_file(*subtree.second, (dir / subtree.first).generic_string().c_str())) {
+                    current.emplace(subtree.first, fingerprint);
+                    ++writtenCount;
+                }
+                else {
+                    JC_LOG_ERROR("Can't write '%s'", (dir / subtree.first).generic_string().c_str());
+                }
+            }
+
+            // a file, which couldn't be rewritten, is kept and gets rewritten next time
+            std::set<std::string> keys;
+            for (auto& subtree : subtrees) {
+                keys.insert(subtree.first);
+            }
+            for (auto& file : written) {
+                if (keys.count(file.first) == 0) {
+                    boost::system::error_code error;
+                    boost::filesystem::remove(dir / file.first, error);
+                }
+            }
+
+            written.swap(current);
+            return writtenCount;
+        }
+
+        SInt32 write_async(const object_base& root, const char *path) {
+            auto writing = std::make_shared<request>();
+            writing->object = &copying::deep_copy(_context, root);
+            std::string filePath(path);
+
+            return start(writing, [filePath](request& req) {
+                const bool written = write_file(*req.object, filePath.c_str());
+                req.object = nullptr;
+                return written;
+            });
+        }
+
+        SInt32 read_async(const char *path) {
+            std::string filePath(path);
+            tes_context& context = _context;
+
+            return start(std::make_shared<request>(), [&context, filePath](request& req) {
+                object_staging_arena arena(context);
+                {
+                    object_staging_arena::scope scope(arena);
+                    req.object = json_deserializer::object_from_file(context, filePath.c_str());
+                }
+                arena.commit();
+                return req.object != nullptr;
+            });
+        }
+
+        request_state state(SInt32 id) const {
+            std::lock_guard<std::mutex> g(_mutex);
+            auto itr = _requests.find(id);
+            return itr != _requests.end() ? itr->second->state : request_state::unknown;
+        }
+
+        // Forgets a completed request. Returns the object a read request has read
+        object_stack_ref take_result(SInt32 id) {
+            std::lock_guard<std::mutex> g(_mutex);
+            auto itr = _requests.find(id);
+            if (itr == _requests.end() || itr->second->state == request_state::pending) {
+                return nullptr;
+            }
+            object_stack_ref result = std::move(itr->second->object);
+            _requests.erase(itr);
+            return result;
+        }
+
+        // blocks until the request completes
+        void wait(SInt32 id) const {
+            std::unique_lock<std::mutex> g(_mutex);
+            _completed.wait(g, [&]() {
+                auto itr = _requests.find(id);
+                return itr == _requests.end() || itr->second->state != request_state::pending;
+            });
+        }
+
+        void wait_all() const {
+            std::unique_lock<std::mutex> g(_mutex);
+            _completed.wait(g, [this]() { return _pendingCount == 0; });
+        }
+
+        // the requests are bound to the objects of the current state: they get completed before the state
+        // gets cleared and are forgotten then
+        void wait_pending() override {
+            wait_all();
+        }
+
+        void clear_state() override {
+            wait_all(); // a request, made since wait_pending
+            {
+                std::lock_guard<std::mutex> g(_mutex);
+                _requests.clear();
+            }
+            std::lock_guard<std::mutex> g(_directoriesMutex);
+            _writtenDirectories.clear();
+        }
+
+    private:
+
+        // the task must release the objects it has referenced before it returns:
+        // once the last request is completed, the state may get cleared
+        template<class Task>
+        SInt32 start(const request_ref& req, Task task) {
+            SInt32 id;
+            {
+                std::lock_guard<std::mutex> g(_mutex);
+                id = ++_lastId;
+                _requests[id] = req;
+                ++_pendingCount;
+            }
+
+            auto run = [this, req, task]() {
+                bool succeeded = false;
+                try {
+                    succeeded = task(*req);
+                }
+                catch (const std::exception& exc) {
+                    req->object = nullptr;
+                    JC_LOG_ERROR("JSON file request failed: '%s'", exc.what());
+                }
+
+                std::lock_guard<std::mutex> g(_mutex);
+                req->state = succeeded ? request_state::succeeded : request_state::failed;
+                --_pendingCount;
+                _completed.notify_all();
+            };
+
+            {
+                std::lock_guard<std::mutex> g(_mutex);
+                _tasks.push_back(std::move(run));
+                if (!_worker.joinable()) {
+                    _worker = std::thread([this]() { run_tasks(); });
+                }
+            }
+            _tasksQueued.notify_one();
+
+            return id;
+        }
+
+        void run_tasks() {
+            std::unique_lock<std::mutex> g(_mutex);
+            for (;;) {
+                _tasksQueued.wait(g, [this]() { return _stopping || !_tasks.empty(); });
+                if (_tasks.empty()) {
+                    return;
+                }
+                auto task = std::move(_tasks.front());
+                _tasks.pop_front();
+                g.unlock();
+                task();
+                g.lock();
+            }
+        }
+    };
+
+    static tes_context::post_init g_json_file_requests_init([](tes_context& ctx) {
+        ctx.file_requests = std::make_shared<json_file_requests>(ctx);
+    });
+}
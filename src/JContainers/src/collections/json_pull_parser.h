@@ -0,0 +1,514 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "collections/json_structural_index.h"
+
+namespace collections {
+
+    // Pull (SAX-like) JSON parser over an in-memory UTF-8 text. Returns tokens one by one and doesn't build any DOM.
+    // Follows jansson's default decoding rules: the root is an object or an array, strings must be valid UTF-8
+    // without \u0000, integers must fit into int64_t, nesting depth is limited.
+    // Given the text's json_structural_index, jumps from token to token and scans strings with SIMD instructions
+    class json_pull_parser {
+    public:
+
+        enum token {
+            error,
+            end_of_input,
+            object_begin,
+            object_end,
+            array_begin,
+            array_end,
+            key,            // object key, see string_value()
+            string,
+            integer,
+            real,
+            boolean,
+            null,
+        };
+
+        enum { max_depth = 2048 };
+
+        json_pull_parser(const char *begin, const char *end, const json_structural_index *index = nullptr)
+            : _begin(begin), _cur(begin), _end(end), _index(index)
+        {
+            _stack.reserve(32);
+            if (_index) {
+                _nextToken = _index->positions().data();
+                _lastToken = _nextToken + _index->positions().size();
+            }
+        }
+
+        token next() {
+            skip_whitespace();
+            _tokenOffset = _cur - _begin;
+
+            if (_state == state::after_value) {
+                if (_cur == _end) {
+                    return fail();
+                }
+                const bool inObject = _stack.back() == '{';
+                if (*_cur == ',') {
+                    ++_cur;
+                    skip_whitespace();
+                    _tokenOffset = _cur - _begin;
+                    _state = inObject ? state::key : state::value;
+                }
+                else if (*_cur == (inObject ? '}' : ']')) {
+                    ++_cur;
+                    _stack.pop_back();
+                    value_read();
+                    return inObject ? object_end : array_end;
+                }
+                else {
+                    return fail();
+                }
+            }
+
+            switch (_state) {
+            case state::root:
+                if (_cur == _end || (*_cur != '{' && *_cur != '[')) {
+                    return fail();
+                }
+                return read_value();
+            case state::key_or_end:
+                if (_cur != _end && *_cur == '}') {
+                    ++_cur;
+                    _stack.pop_back();
+                    value_read();
+                    return object_end;
+                }
+                // fall through
+            case state::key:
+                if (_cur == _end || *_cur != '"' || !read_string()) {
+                    return fail();
+                }
+                skip_whitespace();
+                if (_cur == _end || *_cur != ':') {
+                    return fail();
+                }
+                ++_cur;
+                _state = state::value;
+                return key;
+            case state::value_or_end:
+                if (_cur != _end && *_cur == ']') {
+                    ++_cur;
+                    _stack.pop_back();
+                    value_read();
+                    return array_end;
+                }
+                // fall through
+            case state::value:
+                return read_value();
+            case state::done:
+                return _cur == _end ? end_of_input : fail();
+            default:
+                return error;
+            }
+        }
+
+        // Skips the value, which first token is @first. Returns false if the value is malformed
+        bool skip_value(token first) {
+            if (first != object_begin && first != array_begin) {
+                return first != error && first != end_of_input && first != key && first != object_end && first != array_end;
+            }
+            const size_t depth = _stack.size() - 1;
+            for (token t = next(); t != error; t = next()) {
+                if ((t == object_end || t == array_end) && _stack.size() == depth) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // the value of the last key or string token
+        const std::string& string_value() const { return _string; }
+        int64_t integer_value() const { return _integer; }
+        double real_value() const { return _real; }
+        bool boolean_value() const { return _boolean; }
+
+        // offset of the last token from the beginning of the text
+        size_t token_offset() const { return _tokenOffset; }
+
+        // nesting level, 1 inside the root container
+        size_t depth() const { return _stack.size(); }
+
+    private:
+
+        enum class state {
+            root,
+            key_or_end,
+            key,
+            value_or_end,
+            value,
+            after_value,
+            done,
+            failed,
+        };
+
+        const char *_begin;
+        const char *_cur;
+        const char *_end;
+        const json_structural_index *_index;
+        const uint32_t *_nextToken = nullptr;
+        const uint32_t *_lastToken = nullptr;
+        size_t _tokenOffset = 0;
+        state _state = state::root;
+        std::vector<char> _stack;
+
+        std::string _string;
+        int64_t _integer = 0;
+        double _real = 0;
+        bool _boolean = false;
+
+        token fail() {
+            _state = state::failed;
+            return error;
+        }
+
+        void value_read() {
+            _state = _stack.empty() ? state::done : state::after_value;
+        }
+
+        void skip_whitespace() {
+            if (_index) {
+                // everything between the tokens is whitespace
+                _cur = _nextToken != _lastToken ? _begin + *_nextToken++ : _end;
+                return;
+            }
+            while (_cur != _end && (*_cur == ' ' || *_cur == '\t' || *_cur == '\n' || *_cur == '\r')) {
+                ++_cur;
+            }
+        }
+
+        bool match_literal(const char *literal, size_t length) {
+            if (size_t(_end - _cur) < length || memcmp(_cur, literal, length) != 0) {
+                return false;
+            }
+            _cur += length;
+            return scalar_ends_here();
+        }
+
+        // Whether the number or literal, just read, isn't followed by other characters - the index has no
+        // token for the rest of them: they would be skipped as whitespace
+        bool scalar_ends_here() const {
+            if (!_index || _cur == _end) {
+                return true;
+            }
+            switch (*_cur) {
+            case ' ': case '\t': case '\n': case '\r':
+            case '{': case '}': case '[': case ']': case ':': case ',': case '"':
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        token read_value() {
+            if (_cur == _end) {
+                return fail();
+            }
+
+            switch (*_cur) {
+            case '{':
+            case '[':
+                if (_stack.size() >= max_depth) {
+                    return fail();
+                }
+                _stack.push_back(*_cur);
+                _state = *_cur == '{' ? state::key_or_end : state::value_or_end;
+                ++_cur;
+                return _stack.back() == '{' ? object_begin : array_begin;
+            case '"':
+                if (!read_string()) {
+                    return fail();
+                }
+                value_read();
+                return string;
+            case 't':
+                if (!match_literal("true", 4)) {
+                    return fail();
+                }
+                _boolean = true;
+                value_read();
+                return boolean;
+            case 'f':
+                if (!match_literal("false", 5)) {
+                    return fail();
+                }
+                _boolean = false;
+                value_read();
+                return boolean;
+            case 'n':
+                if (!match_literal("null", 4)) {
+                    return fail();
+                }
+                value_read();
+                return null;
+            default: {
+                token t = read_number();
+                if (t == error || !scalar_ends_here()) {
+                    return fail();
+                }
+                value_read();
+                return t;
+            }
+            }
+        }
+
+        static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+        token read_number() {
+            const char *start = _cur;
+            bool isReal = false;
+
+            if (_cur != _end && *_cur == '-') {
+                ++_cur;
+            }
+            if (_cur == _end || !is_digit(*_cur)) {
+                return error;
+            }
+            if (*_cur == '0') {
+                ++_cur;
+            }
+            else {
+                while (_cur != _end && is_digit(*_cur)) ++_cur;
+            }
+            if (_cur != _end && *_cur == '.') {
+                isReal = true;
+                ++_cur;
+                if (_cur == _end || !is_digit(*_cur)) {
+                    return error;
+                }
+                while (_cur != _end && is_digit(*_cur)) ++_cur;
+            }
+            if (_cur != _end && (*_cur == 'e' || *_cur == 'E')) {
+                isReal = true;
+                ++_cur;
+                if (_cur != _end && (*_cur == '+' || *_cur == '-')) {
+                    ++_cur;
+                }
+                if (_cur == _end || !is_digit(*_cur)) {
+                    return error;
+                }
+                while (_cur != _end && is_digit(*_cur)) ++_cur;
+            }
+
+            const size_t length = _cur - start;
+
+            // up to 18 digits always fit into int64_t
+            if (!isReal && length <= 18) {
+                const bool negative = *start == '-';
+                int64_t value = 0;
+                for (const char *digit = start + (negative ? 1 : 0); digit != _cur; ++digit) {
+                    value = value * 10 + (*digit - '0');
+                }
+                _integer = negative ? -value : value;
+                return integer;
+            }
+
+            // the text isn't null-terminated
+            char buffer[64];
+            std::string longNumber;
+            const char *number = buffer;
+            if (length < sizeof buffer) {
+                memcpy(buffer, start, length);
+                buffer[length] = '\0';
+            }
+            else {
+                longNumber.assign(start, length);
+                number = longNumber.c_str();
+            }
+
+            errno = 0;
+            if (isReal) {
+                _real = strtod(number, nullptr);
+                // jansson treats overflow as an error, underflow as zero
+                if (errno == ERANGE && _real != 0) {
+                    return error;
+                }
+                return real;
+            }
+            else {
+                _integer = strtoll(number, nullptr, 10);
+                if (errno == ERANGE) {
+                    return error;
+                }
+                return integer;
+            }
+        }
+
+        static int hex_value(char c) {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        bool read_hex4(uint32_t& value) {
+            if (_end - _cur < 4) {
+                return false;
+            }
+            value = 0;
+            for (int i = 0; i < 4; ++i) {
+                int h = hex_value(*_cur++);
+                if (h < 0) {
+                    return false;
+                }
+                value = (value << 4) | h;
+            }
+            return true;
+        }
+
+        void append_utf8(uint32_t codepoint) {
+            if (codepoint < 0x80) {
+                _string.push_back(static_cast<char>(codepoint));
+            }
+            else if (codepoint < 0x800) {
+                _string.push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+                _string.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+            }
+            else if (codepoint < 0x10000) {
+                _string.push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+                _string.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+                _string.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+            }
+            else {
+                _string.push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+                _string.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+                _string.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+                _string.push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+            }
+        }
+
+        // validates UTF-8 sequence that starts at _cur (a byte >= 0x80) and moves past it
+        bool skip_utf8_sequence() {
+            const unsigned char lead = static_cast<unsigned char>(*_cur);
+            size_t length;
+            uint32_t codepoint;
+            if (lead >= 0xC2 && lead <= 0xDF) { length = 2; codepoint = lead & 0x1F; }
+            else if (lead >= 0xE0 && lead <= 0xEF) { length = 3; codepoint = lead & 0x0F; }
+            else if (lead >= 0xF0 && lead <= 0xF4) { length = 4; codepoint = lead & 0x07; }
+            else {
+                return false;
+            }
+
+            if (size_t(_end - _cur) < length) {
+                return false;
+            }
+            for (size_t i = 1; i < length; ++i) {
+                const unsigned char c = static_cast<unsigned char>(_cur[i]);
+                if ((c & 0xC0) != 0x80) {
+                    return false;
+                }
+                codepoint = (codepoint << 6) | (c & 0x3F);
+            }
+            // overlong forms, surrogates and out of range code points
+            if ((length == 3 && codepoint < 0x800) || (length == 4 && codepoint < 0x10000)
+                || (codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF) {
+                return false;
+            }
+            _cur += length;
+            return true;
+        }
+
+        // moves _cur to the next '"', '\\' or control character of the string, validating UTF-8 on the way
+        bool skip_plain_characters() {
+            if (_index) {
+                const bool validateUtf8 = !_index->ascii_only();
+                while (true) {
+                    _cur = json_structural_index::find_string_special(_cur, _end, _index->isa(), validateUtf8);
+                    if (_cur == _end || static_cast<unsigned char>(*_cur) < 0x80) {
+                        return true;
+                    }
+                    if (!skip_utf8_sequence()) {
+                        return false;
+                    }
+                }
+            }
+
+            while (_cur != _end && *_cur != '"' && *_cur != '\\' && static_cast<unsigned char>(*_cur) >= 0x20) {
+                if (static_cast<unsigned char>(*_cur) >= 0x80) {
+                    if (!skip_utf8_sequence()) {
+                        return false;
+                    }
+                }
+                else {
+                    ++_cur;
+                }
+            }
+            return true;
+        }
+
+        // reads the string which starts at _cur ('"') into _string
+        bool read_string() {
+            ++_cur;
+            _string.clear();
+
+            while (true) {
+                // copy the longest run of plain characters at once
+                const char *run = _cur;
+                if (!skip_plain_characters()) {
+                    return false;
+                }
+                _string.append(run, _cur);
+
+                if (_cur == _end) {
+                    return false;
+                }
+                if (*_cur == '"') {
+                    ++_cur;
+                    return true;
+                }
+                if (*_cur != '\\') { // control character
+                    return false;
+                }
+
+                ++_cur;
+                if (_cur == _end) {
+                    return false;
+                }
+                switch (*_cur++) {
+                case '"': _string.push_back('"'); break;
+                case '\\': _string.push_back('\\'); break;
+                case '/': _string.push_back('/'); break;
+                case 'b': _string.push_back('\b'); break;
+                case 'f': _string.push_back('\f'); break;
+                case 'n': _string.push_back('\n'); break;
+                case 'r': _string.push_back('\r'); break;
+                case 't': _string.push_back('\t'); break;
+                case 'u': {
+                    uint32_t codepoint;
+                    if (!read_hex4(codepoint) || codepoint == 0) {
+                        return false;
+                    }
+                    if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                        uint32_t low;
+                        if (_end - _cur < 2 || _cur[0] != '\\' || _cur[1] != 'u') {
+                            return false;
+                        }
+                        _cur += 2;
+                        if (!read_hex4(low) || low < 0xDC00 || low > 0xDFFF) {
+                            return false;
+                        }
+                        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+                        return false;
+                    }
+                    append_utf8(codepoint);
+                    break;
+                }
+                default:
+                    return false;
+                }
+            }
+        }
+    };
+}
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <limits>
 #include <set>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <jansson.h>
 #include <memory>
 
@@ -12,6 +17,11 @@
 #include "forms/form_handling.h"
 #include "collections/collections.h"
 #include "collections/access.h"
+#include "collections/cbor.h"
+#include "collections/json_pull_parser.h"
+#include "collections/json_structural_index.h"
+#include "collections/json_writer.h"
+#include "util/flat_pointer_map.h"
 
 namespace collections {
 
@@ -57,11 +67,16 @@ namespace collections {
         static const char * kMetaInfo = "__metaInfo";
         static const char * kMetaInfoLegacy = "__formData";
         static const char * kTypeName = "typeName";
+        // JIntArray, JFltArray, JSet are stored as {"__metaInfo": {...}, "__values": [...]}
+        static const char * kValues = "__values";
 
         template<class T> inline const char* type2name();
 
         template<> inline const char* type2name<form_map>() { return "JFormMap"; }
         template<> inline const char* type2name<integer_map>() { return "JIntMap"; }
+        template<> inline const char* type2name<int_array>() { return "JIntArray"; }
+        template<> inline const char* type2name<float_array>() { return "JFltArray"; }
+        template<> inline const char* type2name<set>() { return "JSet"; }
 
         template<class T> inline void put_metainfo(json_t* object) {
             auto metaInfo = json_object();
@@ -70,19 +85,61 @@ namespace collections {
         }
     }
 
+    // How JSON text gets parsed, see json_deserializer::set_reading_backend
+    enum class json_reading_backend {
+        jansson,            // builds jansson's DOM first
+        pull_parser,        // json_pull_parser, scans the text byte by byte
+        structural_index,   // json_pull_parser driven by SIMD-built json_structural_index
+    };
+
+    // How JSON gets applied onto an existing container, see json_deserializer::apply_json
+    enum class json_apply_mode {
+        replace,        // the container ends up with exactly the JSON contents
+        merge,          // maps keep the keys the JSON doesn't have, their values are merged recursively
+        merge_patch,    // JSON Merge Patch (RFC 7396): merge, where null removes the key
+    };
+
     class json_deserializer {
         typedef std::vector<std::pair<object_base*, json_ref> > objects_to_fill;
 
         typedef ca::key_variant key_variant;
-        // path - <container, key> pairs relationship
-        typedef std::map<std::string, std::vector<std::pair<object_base*, key_variant > > > key_info_map;
+        typedef std::vector<std::pair<object_base*, key_variant > > reference_sites;
 
         tes_context& _context;
         objects_to_fill _toFill;
-        key_info_map _toResolve;
+        // path - <container, key> pairs relationship
+        std::vector<std::pair<std::string, reference_sites> > _toResolve;
+        std::unordered_map<std::string, size_t> _toResolveIndex;
+        // sets are filled as is, their duplicates are removed once references are resolved
+        std::vector<set*> _setsToIndex;
+        // streaming reader: offset of object's '{' -> the type its __metaInfo declares. Maps aren't listed
+        typedef std::unordered_map<size_t, CollectionType> declared_types_map;
+        declared_types_map _declaredTypes;
 
         explicit json_deserializer(tes_context& context) : _context(context) {}
 
+        // The numbers read, narrowed into what the items and the typed arrays store. The integers wrap, the way (int) does.
+        // The reals out of the range saturate, as the conversion would be undefined, NaN becomes a zero integer
+        template<class T>
+        static T narrow_number(int64_t value) {
+            return static_cast<T>(value);
+        }
+
+        template<class T>
+        static T narrow_number(double value) {
+            using limits = std::numeric_limits<T>;
+            if (std::isnan(value) || (!limits::is_integer && std::isinf(value))) {
+                return limits::is_integer ? T(0) : static_cast<T>(value);
+            }
+            if (value <= static_cast<double>(limits::lowest())) {
+                return limits::lowest();
+            }
+            if (value >= static_cast<double>((limits::max)())) {
+                return (limits::max)();
+            }
+            return static_cast<T>(value);
+        }
+
     public:
 
         static json_unique_ref json_from_file(const char *path) {
@@ -109,7 +166,48 @@ namespace collections {
             return make_unique_ptr(ref, json_decref);
         }
 
+        static json_reading_backend reading_backend() {
+            return reading_backend_setting().load(std::memory_order_relaxed);
+        }
+
+        // Selects the parser the functions below use, the "jsonReadingBackend" of JCData/settings.json (see
+        // domain_master::apply_settings). Malformed text always gets re-read by jansson, to report errors
+        static void set_reading_backend(json_reading_backend backend) {
+            reading_backend_setting().store(backend, std::memory_order_relaxed);
+        }
+
+        // Creates objects right while parsing the @text, without building jansson DOM first.
+        // Returns none if the text is malformed or if jansson backend is selected
+        static boost::optional<object_base*> object_from_json_text(tes_context& context, const char *begin, const char *end) {
+            switch (reading_backend()) {
+            case json_reading_backend::pull_parser:
+                return json_deserializer(context)._object_from_text(begin, end, nullptr);
+            case json_reading_backend::structural_index: {
+                json_structural_index index;
+                if (!index.build(begin, end)) {
+                    return boost::none;
+                }
+                return object_from_json_text(context, begin, end, index);
+            }
+            default:
+                return boost::none;
+            }
+        }
+
+        // The same, with the text's index built already
+        static boost::optional<object_base*> object_from_json_text(tes_context& context, const char *begin, const char *end,
+            const json_structural_index& index)
+        {
+            return json_deserializer(context)._object_from_text(begin, end, &index);
+        }
+
         static object_base* object_from_json_data(tes_context& context, const char *data) {
+            if (data) {
+                if (auto result = object_from_json_text(context, data, data + strlen(data))) {
+                    return *result;
+                }
+            }
+            // jansson reports what's wrong
             auto json = json_from_data(data);
             return json_deserializer(context)._object_from_json( json.get() );
         }
@@ -119,6 +217,13 @@ namespace collections {
         }
 
         static object_base* object_from_file(tes_context& context, const char *path) {
+            std::string text;
+            if (reading_backend() != json_reading_backend::jansson && read_file(path, text)) {
+                if (auto result = object_from_json_text(context, text.data(), text.data() + text.size())) {
+                    return *result;
+                }
+            }
+            // jansson reports what's wrong
             auto json = json_from_file(path);
             return json_deserializer(context)._object_from_json( json.get() );
         }
@@ -127,8 +232,60 @@ namespace collections {
             return object_from_file(context, path.generic_string().c_str());
         }
 
+        // Applies the JSON onto the existing @target instead of creating a new container: a value, stored under
+        // the same key (or index) as a container of the same type, gets applied recursively and is kept,
+        // the rest gets created anew. Arrays, sets and typed arrays take the JSON values as is, in any mode.
+        // Reference paths are relative to @target. Returns false if the JSON doesn't describe a container of @target's type
+        static bool apply_json(tes_context& context, object_base& target, json_ref val, json_apply_mode mode) {
+            if (!val || described_type(val) != target.type()) {
+                return false;
+            }
+
+            json_deserializer deserializer(context);
+            deserializer.apply_objects(target, val, mode);
+            deserializer.fill_placeholders();
+            deserializer.finish_reading(&target);
+            return true;
+        }
+
+        static bool apply_json_data(tes_context& context, object_base& target, const char *data, json_apply_mode mode) {
+            auto json = json_from_data(data);
+            return apply_json(context, target, json.get(), mode);
+        }
+
+        static bool apply_json_file(tes_context& context, object_base& target, const char *path, json_apply_mode mode) {
+            auto json = json_from_file(path);
+            return apply_json(context, target, json.get(), mode);
+        }
+
+        // Reads the data write_cbor writes. The data gets validated first, nothing is created if it's malformed
+        static object_base* object_from_cbor(tes_context& context, const char *begin, const char *end) {
+            cbor_reader validator(begin, end);
+            if (!validator.skip_value() || !validator.at_end()) {
+                JC_LOG_ERROR("Binary data is malformed or truncated at offset %u", (unsigned)validator.offset());
+                return nullptr;
+            }
+
+            json_deserializer deserializer(context);
+            cbor_reader reader(begin, end);
+            return deserializer.finish_reading(deserializer.read_cbor_root(reader));
+        }
+
+        static object_base* object_from_cbor_file(tes_context& context, const char *path) {
+            std::string data;
+            if (!read_file(path, data)) {
+                return nullptr;
+            }
+            return object_from_cbor(context, data.data(), data.data() + data.size());
+        }
+
     private:
 
+        static std::atomic<json_reading_backend>& reading_backend_setting() {
+            static std::atomic<json_reading_backend> backend{ json_reading_backend::pull_parser };
+            return backend;
+        }
+
         object_base* _object_from_json(json_ref ref) {
             if (!ref) {
                 return nullptr;
@@ -139,6 +296,11 @@ namespace collections {
                 return nullptr;
             }
 
+            fill_placeholders();
+            return finish_reading(root);
+        }
+
+        void fill_placeholders() {
             while (_toFill.empty() == false) {
                 objects_to_fill toFill;
                 toFill.swap(_toFill);
@@ -147,20 +309,37 @@ namespace collections {
                     fill_object(*pair.first, pair.second);
                 }
             }
+        }
+
+        object_base* finish_reading(object_base* root) {
+            if (!root) {
+                return nullptr;
+            }
 
             resolve_references(*root);
 
+            for (auto st : _setsToIndex) {
+                object_lock l(st);
+                st->u_ensure_index();
+            }
+
             return root;
         }
 
         void resolve_references(object_base& root) {
 
+            // lexicographic order: a path precedes the paths it is a prefix of
+            std::sort(_toResolve.begin(), _toResolve.end(), [](const std::pair<std::string, reference_sites>& l,
+                const std::pair<std::string, reference_sites>& r) {
+                return l.first < r.first;
+            });
+
             for (const auto& pair : _toResolve) {
                 auto& path = pair.first;
                 object_base *resolvedObject = nullptr;
 
                 if (path.empty() == false) {
-                    ca::visit_value(root, path.c_str(), ca::constant, [&resolvedObject](item& itm) {
+                    ca::visit_value(root, path.c_str(), ca::constant, [&resolvedObject](const item& itm) {
                         resolvedObject = itm.object();
                     });
                 }
@@ -224,47 +403,243 @@ namespace collections {
                         catch (const std::out_of_range&) {}
                     }
                 }
+                void operator()(set& cnt) {
+                    size_t index = 0;
+                    json_t *value = nullptr;
+                    json_t *values = json_object_get(val, json_object_serialization_consts::kValues);
+                    // references are resolved later, by index, so values are pushed as is
+                    json_array_foreach(values, index, value) {
+                        cnt.u_container().push_back(self->make_item(value, cnt, static_cast<int32_t>(index)));
+                    }
+                    self->_setsToIndex.push_back(&cnt);
+                }
+                void operator()(int_array& arr) {
+                    self->fill_typed_array(arr, val);
+                }
+                void operator()(float_array& arr) {
+                    self->fill_typed_array(arr, val);
+                }
             };
 
             object_lock lock(object);
             perform_on_object(object, helper{ this, val });
         }
 
-        object_base* make_placeholder(json_ref val) {
-            object_base *object = nullptr;
-            auto type = json_typeof(val);
-
-            if (type == JSON_ARRAY) {
-                object = &array::object(_context);
+        template<class T, CollectionType Type>
+        static void fill_typed_array(typed_array<T, Type>& arr, json_ref val) {
+            size_t index = 0;
+            json_t *value = nullptr;
+            json_t *values = json_object_get(val, json_object_serialization_consts::kValues);
+            arr.u_container().reserve(json_array_size(values));
+            json_array_foreach(values, index, value) {
+                arr.u_push(json_is_integer(value) ? narrow_number<T>(static_cast<int64_t>(json_integer_value(value)))
+                    : narrow_number<T>(json_number_value(value)));
             }
-            else if (type == JSON_OBJECT) {
-                namespace jsc = json_object_serialization_consts;
+        }
 
+        // The type of the container @val describes: arrays are JArrays, objects are JMaps unless their __metaInfo
+        // says otherwise. None for unknown types and for the values that aren't containers
+        static CollectionType described_type(json_ref val) {
+            namespace jsc = json_object_serialization_consts;
+
+            switch (json_typeof(val)) {
+            case JSON_ARRAY:
+                return CollectionType::Array;
+            case JSON_OBJECT: {
                 json_t* metaInfo = json_object_get(val, jsc::kMetaInfo);
                 if (!metaInfo) { // legacy key
                     metaInfo = json_object_get(val, jsc::kMetaInfoLegacy);
                 }
 
                 if (json_is_null(metaInfo)) { // legacy format
-                    object = &form_map::object(_context);
+                    return CollectionType::FormMap;
                 }
                 else if (json_is_object(metaInfo)) { // handle metaInfo
                     auto typeName = json_string_value(json_object_get(metaInfo, jsc::kTypeName));
-                    if (strcmp(jsc::type2name<form_map>(), typeName) == 0) {
-                        object = &form_map::object(_context);
+                    return typeName ? declared_type(typeName) : CollectionType::None;
+                }
+                return CollectionType::Map;
+            }
+            default:
+                return CollectionType::None;
+            }
+        }
+
+        object_base* create_object(CollectionType type) {
+            switch (type) {
+            case CollectionType::Array: return &array::object(_context);
+            case CollectionType::Map: return &map::object(_context);
+            case CollectionType::FormMap: return &form_map::object(_context);
+            case CollectionType::IntegerMap: return &integer_map::object(_context);
+            case CollectionType::Set: return &set::object(_context);
+            case CollectionType::IntArray: return &int_array::object(_context);
+            case CollectionType::FloatArray: return &float_array::object(_context);
+            default: return nullptr;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////
+        // Applying JSON onto existing containers
+
+        struct object_to_apply {
+            object_stack_ref object;
+            json_ref value;
+            json_apply_mode mode;
+        };
+        typedef std::vector<object_to_apply> objects_to_apply;
+
+        // the containers are applied one by one, so no container gets locked twice, even if it contains itself
+        void apply_objects(object_base& target, json_ref val, json_apply_mode mode) {
+            objects_to_apply toApply{ object_to_apply{ &target, val, mode } };
+            while (!toApply.empty()) {
+                object_to_apply next = std::move(toApply.back());
+                toApply.pop_back();
+                apply_object(*next.object, next.value, next.mode, toApply);
+            }
+        }
+
+        void apply_object(object_base& object, json_ref val, json_apply_mode mode, objects_to_apply& toApply) {
+            namespace jsc = json_object_serialization_consts;
+
+            struct helper {
+                json_deserializer* self;
+                json_ref val;
+                json_apply_mode mode;
+                objects_to_apply& toApply;
+
+                static bool is_metainfo_key(const char *key) {
+                    return strcmp(key, jsc::kMetaInfo) == 0 || strcmp(key, jsc::kMetaInfoLegacy) == 0;
+                }
+
+                // the JSON object's keys are parsed by @key_of, the ones it can't parse are skipped
+                template<class Cnt, class KeyOf>
+                void apply_entries(Cnt& cnt, KeyOf key_of) {
+                    using key_type = typename Cnt::key_type;
+
+                    std::vector<std::pair<key_type, json_ref> > entries;
+                    const char *key;
+                    json_t *value;
+                    json_object_foreach(val, key, value) {
+                        if (!is_metainfo_key(key)) {
+                            if (auto parsed = key_of(key)) {
+                                entries.emplace_back(std::move(*parsed), value);
+                            }
+                        }
+                    }
+
+                    if (mode == json_apply_mode::replace) {
+                        auto& items = cnt.u_container();
+                        std::set<key_type, typename Cnt::container_type::key_compare> present(items.key_comp());
+                        for (auto& entry : entries) {
+                            present.insert(entry.first);
+                        }
+                        for (auto itr = items.begin(); itr != items.end();) {
+                            itr = present.count(itr->first) ? std::next(itr) : items.erase(itr);
+                        }
                     }
-                    else if (strcmp(jsc::type2name<integer_map>(), typeName) == 0) {
-                        object = &integer_map::object(_context);
+
+                    for (auto& entry : entries) {
+                        if (mode == json_apply_mode::merge_patch && json_is_null(entry.second)) {
+                            cnt.u_erase(entry.first);
+                        }
+                        else if (auto existing = cnt.u_get(entry.first)) {
+                            apply_value(*existing, entry.second, cnt, entry.first, mode);
+                        }
+                        else {
+                            apply_value(*cnt.u_set(entry.first, item()), entry.second, cnt, entry.first, mode);
+                        }
                     }
                 }
-                else {
-                    object = &map::object(_context);
+
+                // applies the JSON value onto the item, stored in @cnt under @key
+                template<class Key>
+                void apply_value(item& existing, json_ref value, object_base& cnt, const Key& key, json_apply_mode childMode) {
+                    const bool isContainer = json_is_object(value) || json_is_array(value);
+                    auto obj = existing.object();
+                    if (obj && isContainer && described_type(value) == obj->type()) {
+                        toApply.push_back(object_to_apply{ obj, value, childMode });
+                    }
+                    else if (childMode == json_apply_mode::merge_patch && isContainer && described_type(value) == CollectionType::Map) {
+                        // a patch is applied onto an empty map, so that the nulls it has get dropped
+                        auto& patched = map::object(self->_context);
+                        existing = item(patched);
+                        toApply.push_back(object_to_apply{ &patched, value, childMode });
+                    }
+                    else {
+                        existing = self->make_item(value, cnt, key);
+                    }
                 }
 
-                if (metaInfo) {
-                    json_object_del(val, jsc::kMetaInfo);
-                    json_object_del(val, jsc::kMetaInfoLegacy);
+                void operator()(array& arr) {
+                    // the elements are replaced, the containers among them are reused
+                    auto& items = arr.u_container();
+                    const size_t count = json_array_size(val);
+                    if (items.size() > count) {
+                        items.resize(count);
+                    }
+                    for (size_t index = 0; index < count; ++index) {
+                        json_t *value = json_array_get(val, index);
+                        if (index < items.size()) {
+                            apply_value(items[index], value, arr, static_cast<int32_t>(index), json_apply_mode::replace);
+                        }
+                        else {
+                            arr.u_push(self->make_item(value, arr, static_cast<int32_t>(index)));
+                        }
+                    }
+                }
+                void operator()(map& cnt) {
+                    apply_entries(cnt, [](const char *key) { return boost::optional<std::string>(key); });
+                }
+                void operator()(form_map& cnt) {
+                    auto& context = self->_context;
+                    apply_entries(cnt, [&context](const char *key) -> boost::optional<form_ref> {
+                        if (auto fkey = forms::string_to_form(key)) {
+                            return make_weak_form_id(*fkey, context);
+                        }
+                        return boost::none;
+                    });
+                }
+                void operator()(integer_map& cnt) {
+                    apply_entries(cnt, [](const char *key) -> boost::optional<int32_t> {
+                        try {
+                            return std::stoi(std::string(key), nullptr, 0);
+                        }
+                        catch (const std::invalid_argument&) {}
+                        catch (const std::out_of_range&) {}
+                        return boost::none;
+                    });
+                }
+                void operator()(set& cnt) {
+                    size_t index = 0;
+                    json_t *value = nullptr;
+                    cnt.u_clear();
+                    json_array_foreach(json_object_get(val, jsc::kValues), index, value) {
+                        cnt.u_container().push_back(self->make_item(value, cnt, static_cast<int32_t>(index)));
+                    }
+                    self->_setsToIndex.push_back(&cnt);
+                }
+                void operator()(int_array& arr) {
+                    arr.u_clear();
+                    self->fill_typed_array(arr, val);
                 }
+                void operator()(float_array& arr) {
+                    arr.u_clear();
+                    self->fill_typed_array(arr, val);
+                }
+            };
+
+            object_lock lock(object);
+            perform_on_object(object, helper{ this, val, mode, toApply });
+        }
+
+        object_base* make_placeholder(json_ref val) {
+            namespace jsc = json_object_serialization_consts;
+
+            object_base *object = create_object(described_type(val));
+
+            if (json_is_object(val)) {
+                json_object_del(val, jsc::kMetaInfo);
+                json_object_del(val, jsc::kMetaInfoLegacy);
             }
 
             if (object) {
@@ -282,10 +657,19 @@ namespace collections {
                 return false;
             }
 
-            _toResolve[path].push_back( std::make_pair(&container, item_key) );
+            schedule_path_resolving(path, container, item_key);
             return true;
         }
 
+        template<class K>
+        void schedule_path_resolving(const char *path, object_base& container, const K& item_key) {
+            auto index = _toResolveIndex.emplace(path, _toResolve.size());
+            if (index.second) {
+                _toResolve.emplace_back(path, reference_sites());
+            }
+            _toResolve[index.first->second].second.push_back( std::make_pair(&container, item_key) );
+        }
+
         template<class K>
         item make_item(json_ref val, object_base& container, const K& item_key) {
             item item;
@@ -296,35 +680,14 @@ namespace collections {
             case JSON_ARRAY:
                 item = make_placeholder(val);
                 break;
-            case JSON_STRING:{
-                auto string = json_string_value(val);
-
-                if (!reference_serialization::is_special_string(string)) {
-                    item = string;
-                } else {
-                    if (forms::is_form_string(string)) {
-                        /*  having dilemma here:
-                            if the string looks like form-string and plugin name can't be resolved:
-                            a. lost info and convert it to FormZero
-                            b. save info and convert it to string
-                        */
-                        item = make_weak_form_id (forms::string_to_form (string).value_or (FormId::Zero), _context);
-                    }
-                    else if (schedule_ref_resolving(string, container, item_key)) { // otherwise it's reference string?
-                        ;
-                    }
-                    else {  // otherwise it's just a string, although it starts with "__"
-                        item = string;
-                    }
-                }
-
-            }
+            case JSON_STRING:
+                item = make_string_item(json_string_value(val), container, item_key);
                 break;
             case JSON_INTEGER:
-                item = (int)json_integer_value(val);
+                item = narrow_number<SInt32>(static_cast<int64_t>(json_integer_value(val)));
                 break;
             case JSON_REAL:
-                item = json_real_value(val);
+                item = narrow_number<Float32>(json_real_value(val));
                 break;
             case JSON_TRUE:
             case JSON_FALSE:
@@ -337,100 +700,795 @@ namespace collections {
 
             return item;
         }
-    };
 
+        template<class K>
+        item make_string_item(const char *string, object_base& container, const K& item_key) {
+            item item;
 
-    class json_serializer {
-
-        using object_cref = std::reference_wrapper<const object_base>;
-        struct object_cref_cmp {
-            bool operator()(const object_cref& l, const object_cref& r) const {
-                return &l.get() < &r.get();
+            if (!reference_serialization::is_special_string(string)) {
+                item = string;
+            } else {
+                if (forms::is_form_string(string)) {
+                    /*  having dilemma here:
+                        if the string looks like form-string and plugin name can't be resolved:
+                        a. lost info and convert it to FormZero
+                        b. save info and convert it to string
+                    */
+                    item = make_weak_form_id (forms::string_to_form (string).value_or (FormId::Zero), _context);
+                }
+                else if (schedule_ref_resolving(string, container, item_key)) { // otherwise it's reference string?
+                    ;
+                }
+                else {  // otherwise it's just a string, although it starts with "__"
+                    item = string;
+                }
             }
-        };
 
-        typedef std::set<object_cref, object_cref_cmp> collection_set;
-        typedef std::vector<std::pair<object_cref, json_ref> > objects_to_fill;
+            return item;
+        }
 
-        const object_base& _root;
-        collection_set _serializedObjects;
-        objects_to_fill _toFill;
+        //////////////////////////////////////////////////////////////////////////
+        // Streaming reader. The text gets scanned twice: the first pass validates it and finds
+        // __metaInfo-declared types (__metaInfo may follow any other key of the object),
+        // the second one creates and fills the objects as their tokens are read
 
-        typedef ca::key_variant key_variant;
-        // contained-object to <container-owner, key> relation
-        typedef std::map<object_cref, std::pair<object_cref, key_variant>, object_cref_cmp> key_info_map;
-        key_info_map _keyInfo;
+        static bool read_file(const char *path, std::string& text) {
+            if (!path) {
+                return false;
+            }
+            auto file = make_unique_file(fopen(path, "rb"));
+            if (!file) {
+                return false;
+            }
 
-        explicit json_serializer(const object_base& root) : _root(root) {}
+            if (fseek(file.get(), 0, SEEK_END) == 0) {
+                long size = ftell(file.get());
+                if (size > 0) {
+                    text.reserve(size);
+                }
+                fseek(file.get(), 0, SEEK_SET);
+            }
 
-    public:
+            char buffer[64 * 1024];
+            size_t read = 0;
+            while ((read = fread(buffer, 1, sizeof buffer, file.get())) > 0) {
+                text.append(buffer, read);
+            }
+            return ferror(file.get()) == 0;
+        }
 
-        static json_unique_ref create_json_value(const object_base &root) {
-            return make_unique_ptr( json_serializer(root)._write_json(root), &json_decref);
+        static CollectionType declared_type(const std::string& typeName) {
+            namespace jsc = json_object_serialization_consts;
+
+            if (typeName == jsc::type2name<form_map>()) {
+                return CollectionType::FormMap;
+            }
+            else if (typeName == jsc::type2name<integer_map>()) {
+                return CollectionType::IntegerMap;
+            }
+            else if (typeName == jsc::type2name<set>()) {
+                return CollectionType::Set;
+            }
+            else if (typeName == jsc::type2name<int_array>()) {
+                return CollectionType::IntArray;
+            }
+            else if (typeName == jsc::type2name<float_array>()) {
+                return CollectionType::FloatArray;
+            }
+            return CollectionType::None; // unknown types are read as nulls
         }
 
-        static auto create_json_data(const object_base &root) -> decltype(make_unique_ptr((char*)nullptr, free)) {
+        // reads the value of __metaInfo key, the same way make_placeholder interprets it
+        static bool read_metainfo(json_pull_parser& parser, CollectionType& type) {
+            using parser_t = json_pull_parser;
 
-            auto jvalue = create_json_value(root);
+            auto t = parser.next();
+            if (t == parser_t::null) { // legacy format
+                type = CollectionType::FormMap;
+                return true;
+            }
+            if (t != parser_t::object_begin) {
+                type = CollectionType::Map;
+                return parser.skip_value(t);
+            }
 
-            return make_unique_ptr(
-                jvalue ? json_dumps(jvalue.get(), JSON_INDENT(2)) : nullptr,
-                free
-            );
+            type = CollectionType::None;
+            for (t = parser.next(); t == parser_t::key; t = parser.next()) {
+                const bool isTypeName = parser.string_value() == json_object_serialization_consts::kTypeName;
+                t = parser.next();
+                if (isTypeName && t == parser_t::string) {
+                    type = declared_type(parser.string_value());
+                }
+                else if (!parser.skip_value(t)) {
+                    return false;
+                }
+            }
+            return t == parser_t::object_end;
         }
 
-    private:
+        bool scan_declared_types(const char *begin, const char *end, const json_structural_index *index) {
+            namespace jsc = json_object_serialization_consts;
+            using parser_t = json_pull_parser;
 
-        // writes to json
-        json_ref _write_json(const object_base &root) {
+            struct frame {
+                size_t offset;
+                // 0 - no metainfo, 1 - legacy key only, 2 - __metaInfo key
+                int metaInfoKind;
+                CollectionType type;
+            };
+            std::vector<frame> frames;
+            parser_t parser(begin, end, index);
+
+            for (auto t = parser.next(); t != parser_t::end_of_input; t = parser.next()) {
+                switch (t) {
+                case parser_t::error:
+                    return false;
+                case parser_t::object_begin:
+                case parser_t::array_begin:
+                    frames.push_back(frame{ parser.token_offset(), 0, CollectionType::Map });
+                    break;
+                case parser_t::object_end:
+                case parser_t::array_end:
+                    if (frames.back().metaInfoKind != 0) {
+                        _declaredTypes[frames.back().offset] = frames.back().type;
+                    }
+                    frames.pop_back();
+                    break;
+                case parser_t::key: {
+                    auto& top = frames.back();
+                    const bool isMetaInfo = parser.string_value() == jsc::kMetaInfo;
+                    if (isMetaInfo || (parser.string_value() == jsc::kMetaInfoLegacy && top.metaInfoKind < 2)) {
+                        if (!read_metainfo(parser, top.type)) {
+                            return false;
+                        }
+                        top.metaInfoKind = isMetaInfo ? 2 : 1;
+                    }
+                    break;
+                }
+                default:
+                    break;
+                }
+            }
+            return true;
+        }
 
-            auto root_value = create_placeholder(root);
+        boost::optional<object_base*> _object_from_text(const char *begin, const char *end, const json_structural_index *index) {
+            if (!scan_declared_types(begin, end, index)) {
+                return boost::none;
+            }
 
-            while (_toFill.empty() == false) {
+            json_pull_parser parser(begin, end, index);
+            auto root = read_container(parser, parser.next());
+            return finish_reading(root);
+        }
 
-                objects_to_fill toFill;
-                toFill.swap(_toFill);
+        static bool is_metainfo_key(const std::string& key) {
+            namespace jsc = json_object_serialization_consts;
+            return key == jsc::kMetaInfo || key == jsc::kMetaInfoLegacy;
+        }
 
-                for (auto& pair : toFill) {
-                    fill_json_object(pair.first, pair.second);
+        // calls @entry(key, first token of the value) for each entry of the object which '{' was just read.
+        // @entry have to read (or skip) the value
+        template<class F>
+        static void read_object_entries(json_pull_parser& parser, F&& entry) {
+            std::string key;
+            for (auto t = parser.next(); t == json_pull_parser::key; t = parser.next()) {
+                key = parser.string_value();
+                auto valueToken = parser.next();
+                if (is_metainfo_key(key)) {
+                    parser.skip_value(valueToken);
+                }
+                else {
+                    entry(key, valueToken);
                 }
             }
-
-            return root_value;
         }
 
-        json_ref create_placeholder(const object_base& object) {
+        // calls @value(index, first token of the value) for each value of the array which '[' was just read
+        template<class F>
+        static void read_array_values(json_pull_parser& parser, F&& value) {
+            int32_t index = 0;
+            for (auto t = parser.next(); t != json_pull_parser::array_end && t != json_pull_parser::error; t = parser.next()) {
+                value(index++, t);
+            }
+        }
 
-            json_ref placeholder = nullptr;
-            auto obj_cref = std::cref(object);
+        // reads the value of "__values" key of JSet, JIntArray, JFltArray objects
+        template<class F>
+        static void read_values_entry(json_pull_parser& parser, F&& value) {
+            read_object_entries(parser, [&](const std::string& key, json_pull_parser::token t) {
+                if (t == json_pull_parser::array_begin && key == json_object_serialization_consts::kValues) {
+                    read_array_values(parser, value);
+                }
+                else {
+                    parser.skip_value(t);
+                }
+            });
+        }
 
-            if (_serializedObjects.find(obj_cref) == _serializedObjects.end()) {
-                placeholder = object.as<array>() ? json_array() : json_object();
-                _toFill.push_back(objects_to_fill::value_type(obj_cref, placeholder));
-                _serializedObjects.insert(obj_cref);
-            }
-            else {
-                placeholder = json_string(path_to_object(object).c_str());
+        template<class K>
+        item read_item(json_pull_parser& parser, json_pull_parser::token t, object_base& container, const K& item_key) {
+            using parser_t = json_pull_parser;
+
+            switch (t) {
+            case parser_t::object_begin:
+            case parser_t::array_begin:
+                return item(read_container(parser, t));
+            case parser_t::string:
+                return make_string_item(parser.string_value().c_str(), container, item_key);
+            case parser_t::integer:
+                return item(narrow_number<SInt32>(parser.integer_value()));
+            case parser_t::real:
+                return item(narrow_number<Float32>(parser.real_value()));
+            case parser_t::boolean:
+                return item(parser.boolean_value());
+            default:
+                return item();
             }
-
-            return placeholder;
         }
 
-        void fill_json_object(const object_base& cnt, json_ref object) {
-            struct helper {
-                json_serializer * self;
-                json_ref object;
+        template<class T, CollectionType Type>
+        static void read_typed_array(json_pull_parser& parser, typed_array<T, Type>& arr) {
+            using parser_t = json_pull_parser;
 
-                void operator () (const array& cnt) {
-                    size_t index = 0;
-                    for (auto& itm : cnt.u_container()) {
-                        self->fill_key_info(itm, cnt, index++);
-                        json_array_append_new(object, self->create_value(itm));
-                    }
+            object_lock l(arr);
+            read_values_entry(parser, [&](int32_t, parser_t::token t) {
+                T value = 0;
+                if (t == parser_t::integer) {
+                    value = narrow_number<T>(parser.integer_value());
                 }
-                void operator () (const map& cnt) {
-                    for (auto& pair : cnt.u_container()) {
-                        self->fill_key_info(pair.second, cnt, pair.first);
+                else if (t == parser_t::real) {
+                    value = narrow_number<T>(parser.real_value());
+                }
+                else {
+                    parser.skip_value(t);
+                }
+                arr.u_push(value);
+            });
+        }
+
+        // creates the container which '{' or '[' (the @first token) was just read, and fills it
+        object_base* read_container(json_pull_parser& parser, json_pull_parser::token first) {
+            using parser_t = json_pull_parser;
+
+            if (first == parser_t::array_begin) {
+                auto& arr = array::object(_context);
+                read_array_values(parser, [&](int32_t index, parser_t::token t) {
+                    auto value = read_item(parser, t, arr, index);
+                    object_lock l(arr);
+                    arr.u_push(std::move(value));
+                });
+                return &arr;
+            }
+
+            if (first != parser_t::object_begin) {
+                return nullptr;
+            }
+
+            auto declared = _declaredTypes.find(parser.token_offset());
+            const auto type = declared != _declaredTypes.end() ? declared->second : CollectionType::Map;
+
+            switch (type) {
+            case CollectionType::Map: {
+                auto& cnt = map::object(_context);
+                read_object_entries(parser, [&](const std::string& key, parser_t::token t) {
+                    auto value = read_item(parser, t, cnt, key);
+                    object_lock l(cnt);
+                    cnt.u_set(key, std::move(value));
+                });
+                return &cnt;
+            }
+            case CollectionType::FormMap: {
+                auto& cnt = form_map::object(_context);
+                read_object_entries(parser, [&](const std::string& key, parser_t::token t) {
+                    if (auto fkey = forms::string_to_form(key.c_str())) {
+                        form_ref weak_key = make_weak_form_id(*fkey, _context);
+                        auto value = read_item(parser, t, cnt, weak_key);
+                        object_lock l(cnt);
+                        cnt.u_set(weak_key, std::move(value));
+                    }
+                    else {
+                        parser.skip_value(t);
+                    }
+                });
+                return &cnt;
+            }
+            case CollectionType::IntegerMap: {
+                auto& cnt = integer_map::object(_context);
+                read_object_entries(parser, [&](const std::string& key, parser_t::token t) {
+                    int32_t intKey = 0;
+                    try {
+                        intKey = std::stoi(key, nullptr, 0);
+                    }
+                    catch (const std::invalid_argument&) {
+                        parser.skip_value(t);
+                        return;
+                    }
+                    catch (const std::out_of_range&) {
+                        parser.skip_value(t);
+                        return;
+                    }
+
+                    auto value = read_item(parser, t, cnt, intKey);
+                    object_lock l(cnt);
+                    cnt.u_container()[intKey] = std::move(value);
+                });
+                return &cnt;
+            }
+            case CollectionType::Set: {
+                auto& cnt = set::object(_context);
+                // references are resolved later, by index, so values are pushed as is
+                read_values_entry(parser, [&](int32_t index, parser_t::token t) {
+                    auto value = read_item(parser, t, cnt, index);
+                    object_lock l(cnt);
+                    cnt.u_container().push_back(std::move(value));
+                });
+                _setsToIndex.push_back(&cnt);
+                return &cnt;
+            }
+            case CollectionType::IntArray: {
+                auto& cnt = int_array::object(_context);
+                read_typed_array(parser, cnt);
+                return &cnt;
+            }
+            case CollectionType::FloatArray: {
+                auto& cnt = float_array::object(_context);
+                read_typed_array(parser, cnt);
+                return &cnt;
+            }
+            default:
+                parser.skip_value(first);
+                return nullptr;
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////
+        // CBOR reader. The data is validated by the time it's read, so the reads below can't fail on
+        // the structure (nor recurse deeper than cbor_reader::max_depth), they only tolerate the values of unexpected types
+
+        // mod names of the forms read so far, the later forms refer to them by index
+        std::vector<std::string> _cborMods;
+
+        object_base* read_cbor_root(cbor_reader& reader) {
+            cbor_reader::head h;
+            uint64_t tag = 0;
+            if (!reader.read_head(h)) {
+                return nullptr;
+            }
+            while (h.major == cbor::major_tag) {
+                if (h.value != cbor::tag_self_described) {
+                    tag = h.value;
+                }
+                if (!reader.read_head(h)) {
+                    return nullptr;
+                }
+            }
+            return h.major == cbor::major_array || h.major == cbor::major_map ? read_cbor_container(reader, h, tag) : nullptr;
+        }
+
+        // calls @value(index, head of the value) for each value of the array which head @h has been read
+        template<class F>
+        static void read_cbor_values(cbor_reader& reader, const cbor_reader::head& h, F&& value) {
+            for (uint64_t i = 0; h.indefinite() ? !reader.read_break() : i < h.value; ++i) {
+                cbor_reader::head valueHead;
+                if (!reader.read_head(valueHead)) {
+                    return;
+                }
+                value(static_cast<int32_t>(i), valueHead);
+            }
+        }
+
+        // calls @entry(head of the key) for each entry of the map which head @h has been read.
+        // @entry have to read the key and read (or skip) the value
+        template<class F>
+        static void read_cbor_entries(cbor_reader& reader, const cbor_reader::head& h, F&& entry) {
+            for (uint64_t i = 0; h.indefinite() ? !reader.read_break() : i < h.value; ++i) {
+                cbor_reader::head keyHead;
+                if (!reader.read_head(keyHead)) {
+                    return;
+                }
+                entry(keyHead);
+            }
+        }
+
+        static bool is_cbor_string(const cbor_reader::head& h) {
+            return h.major == cbor::major_text || h.major == cbor::major_bytes;
+        }
+
+        static bool is_cbor_integer(const cbor_reader::head& h) {
+            return h.major == cbor::major_unsigned || h.major == cbor::major_negative;
+        }
+
+        // the validation rejects the integers out of the int64_t range, as json_pull_parser does. Clamped anyway
+        static int64_t cbor_integer(const cbor_reader::head& h) {
+            const int64_t value = static_cast<int64_t>((std::min)(h.value, static_cast<uint64_t>(INT64_MAX)));
+            return h.major == cbor::major_unsigned ? value : -1 - value;
+        }
+
+        // reads the [mod, relative id] pair of the form which tag has been read
+        std::optional<FormId> read_cbor_form(cbor_reader& reader) {
+            cbor_reader::head pair, modHead, idHead;
+            if (!reader.read_head(pair)) {
+                return std::nullopt;
+            }
+            if (pair.major != cbor::major_array || pair.indefinite() || pair.value != 2) {
+                reader.skip_rest(pair);
+                return std::nullopt;
+            }
+
+            const std::string *mod = nullptr;
+            std::string modName;
+            if (!reader.read_head(modHead)) {
+                return std::nullopt;
+            }
+            if (is_cbor_string(modHead)) {
+                reader.read_string(modHead, modName);
+                _cborMods.push_back(modName);
+                mod = &_cborMods.back();
+            }
+            else if (modHead.major == cbor::major_unsigned && modHead.value < _cborMods.size()) {
+                mod = &_cborMods[static_cast<size_t>(modHead.value)];
+            }
+            else {
+                reader.skip_rest(modHead);
+            }
+
+            if (!reader.read_head(idHead)) {
+                return std::nullopt;
+            }
+            if (idHead.major != cbor::major_unsigned || idHead.value > UINT32_MAX) {
+                reader.skip_rest(idHead);
+                return std::nullopt;
+            }
+
+            return mod ? forms::form_from_file(*mod, static_cast<uint32_t>(idHead.value)) : std::nullopt;
+        }
+
+        template<class K>
+        item read_cbor_item(cbor_reader& reader, const cbor_reader::head& h, object_base& container, const K& item_key) {
+            switch (h.major) {
+            case cbor::major_unsigned:
+            case cbor::major_negative:
+                return item(narrow_number<SInt32>(cbor_integer(h)));
+            case cbor::major_bytes:
+            case cbor::major_text: {
+                std::string string;
+                reader.read_string(h, string);
+                return item(std::move(string));
+            }
+            case cbor::major_array:
+            case cbor::major_map:
+                return item(read_cbor_container(reader, h, 0));
+            case cbor::major_tag: {
+                if (h.value == cbor::tag_form) {
+                    return item(make_weak_form_id(read_cbor_form(reader).value_or(FormId::Zero), _context));
+                }
+
+                cbor_reader::head inner;
+                if (!reader.read_head(inner)) {
+                    return item();
+                }
+                if (h.value == cbor::tag_reference && is_cbor_string(inner)) {
+                    std::string path;
+                    reader.read_string(inner, path);
+                    schedule_path_resolving(path.c_str(), container, item_key);
+                    return item();
+                }
+                if (inner.major == cbor::major_array || inner.major == cbor::major_map) {
+                    return item(read_cbor_container(reader, inner, h.value));
+                }
+                // unknown tags are ignored
+                return read_cbor_item(reader, inner, container, item_key);
+            }
+            case cbor::major_simple:
+                if (cbor_reader::is_real(h)) {
+                    return item(narrow_number<Float32>(cbor_reader::real_value(h)));
+                }
+                if (h.value == cbor::simple_true || h.value == cbor::simple_false) {
+                    return item(h.value == cbor::simple_true);
+                }
+                return item();
+            default:
+                return item();
+            }
+        }
+
+        template<class T, CollectionType Type>
+        static void read_cbor_typed_array(cbor_reader& reader, const cbor_reader::head& h, typed_array<T, Type>& arr) {
+            object_lock l(arr);
+            read_cbor_values(reader, h, [&](int32_t, const cbor_reader::head& valueHead) {
+                T value = 0;
+                if (is_cbor_integer(valueHead)) {
+                    value = narrow_number<T>(cbor_integer(valueHead));
+                }
+                else if (cbor_reader::is_real(valueHead)) {
+                    value = narrow_number<T>(cbor_reader::real_value(valueHead));
+                }
+                else {
+                    reader.skip_rest(valueHead);
+                }
+                arr.u_push(value);
+            });
+        }
+
+        // creates the container which array or map head @h (tagged with @tag, if non-zero) has been read, and fills it
+        object_base* read_cbor_container(cbor_reader& reader, const cbor_reader::head& h, uint64_t tag) {
+            if (h.major == cbor::major_array) {
+                switch (tag) {
+                case cbor::tag_set: {
+                    auto& cnt = set::object(_context);
+                    // references are resolved later, by index, so values are pushed as is
+                    read_cbor_values(reader, h, [&](int32_t index, const cbor_reader::head& valueHead) {
+                        auto value = read_cbor_item(reader, valueHead, cnt, index);
+                        object_lock l(cnt);
+                        cnt.u_container().push_back(std::move(value));
+                    });
+                    _setsToIndex.push_back(&cnt);
+                    return &cnt;
+                }
+                case cbor::tag_int_array: {
+                    auto& cnt = int_array::object(_context);
+                    read_cbor_typed_array(reader, h, cnt);
+                    return &cnt;
+                }
+                case cbor::tag_float_array: {
+                    auto& cnt = float_array::object(_context);
+                    read_cbor_typed_array(reader, h, cnt);
+                    return &cnt;
+                }
+                default: {
+                    auto& arr = array::object(_context);
+                    read_cbor_values(reader, h, [&](int32_t index, const cbor_reader::head& valueHead) {
+                        auto value = read_cbor_item(reader, valueHead, arr, index);
+                        object_lock l(arr);
+                        arr.u_push(std::move(value));
+                    });
+                    return &arr;
+                }
+                }
+            }
+
+            switch (tag) {
+            case cbor::tag_form_map: {
+                auto& cnt = form_map::object(_context);
+                read_cbor_entries(reader, h, [&](const cbor_reader::head& keyHead) {
+                    std::optional<FormId> fkey;
+                    if (keyHead.major == cbor::major_tag && keyHead.value == cbor::tag_form) {
+                        fkey = read_cbor_form(reader);
+                    }
+                    else {
+                        reader.skip_rest(keyHead);
+                    }
+
+                    if (fkey) {
+                        form_ref weak_key = make_weak_form_id(*fkey, _context);
+                        cbor_reader::head valueHead;
+                        if (reader.read_head(valueHead)) {
+                            auto value = read_cbor_item(reader, valueHead, cnt, weak_key);
+                            object_lock l(cnt);
+                            cnt.u_set(weak_key, std::move(value));
+                        }
+                    }
+                    else {
+                        reader.skip_value();
+                    }
+                });
+                return &cnt;
+            }
+            case cbor::tag_integer_map: {
+                auto& cnt = integer_map::object(_context);
+                read_cbor_entries(reader, h, [&](const cbor_reader::head& keyHead) {
+                    if (!is_cbor_integer(keyHead)) {
+                        reader.skip_rest(keyHead);
+                        reader.skip_value();
+                        return;
+                    }
+
+                    const int32_t intKey = narrow_number<int32_t>(cbor_integer(keyHead));
+                    cbor_reader::head valueHead;
+                    if (reader.read_head(valueHead)) {
+                        auto value = read_cbor_item(reader, valueHead, cnt, intKey);
+                        object_lock l(cnt);
+                        cnt.u_container()[intKey] = std::move(value);
+                    }
+                });
+                return &cnt;
+            }
+            default: {
+                auto& cnt = map::object(_context);
+                std::string key;
+                read_cbor_entries(reader, h, [&](const cbor_reader::head& keyHead) {
+                    if (!is_cbor_string(keyHead)) {
+                        reader.skip_rest(keyHead);
+                        reader.skip_value();
+                        return;
+                    }
+
+                    reader.read_string(keyHead, key);
+                    cbor_reader::head valueHead;
+                    if (reader.read_head(valueHead)) {
+                        auto value = read_cbor_item(reader, valueHead, cnt, key);
+                        object_lock l(cnt);
+                        cnt.u_set(key, std::move(value));
+                    }
+                });
+                return &cnt;
+            }
+            }
+        }
+    };
+
+
+    class json_serializer {
+
+        using object_cref = std::reference_wrapper<const object_base>;
+        typedef std::vector<std::pair<object_cref, json_ref> > objects_to_fill;
+        typedef ca::key_variant key_variant;
+
+        struct identity_tables {
+            // objects, written (or about to be written) in place
+            util::flat_pointer_set<const object_base*> serialized;
+            // contained-object to <container-owner, key> relation
+            util::flat_pointer_map<const object_base*, std::pair<const object_base*, key_variant> > keyInfo;
+            // reference paths, computed for the objects met more than once
+            util::flat_pointer_map<const object_base*, std::string> paths;
+            // the contents of the objects as the text plan has seen them, see plan_text
+            util::flat_pointer_map<const object_base*, std::unique_ptr<object_base> > contents;
+
+            void clear() {
+                serialized.clear();
+                keyInfo.clear();
+                paths.clear();
+                contents.clear();
+            }
+        };
+
+        enum {
+            // the tables grown above this number of slots aren't kept for reuse
+            max_spare_tables_capacity = 1 << 16,
+        };
+
+        // Serializations on the same thread reuse the same tables, a nested serialization allocates own ones
+        static std::unique_ptr<identity_tables>& spare_tables() {
+            static thread_local std::unique_ptr<identity_tables> tables;
+            return tables;
+        }
+
+        const object_base& _root;
+        std::unique_ptr<identity_tables> _tables;
+        objects_to_fill _toFill;
+
+        explicit json_serializer(const object_base& root)
+            : _root(root)
+            , _tables(spare_tables() ? std::move(spare_tables()) : std::unique_ptr<identity_tables>(new identity_tables()))
+        {}
+
+        ~json_serializer() {
+            _tables->clear();
+            if (!spare_tables() && _tables->keyInfo.capacity() <= max_spare_tables_capacity) {
+                spare_tables() = std::move(_tables);
+            }
+        }
+
+    public:
+
+        static json_unique_ref create_json_value(const object_base &root) {
+            return make_unique_ptr( json_serializer(root)._write_json(root), &json_decref);
+        }
+
+        static auto create_json_data(const object_base &root) -> decltype(make_unique_ptr((char*)nullptr, free)) {
+
+            json_text_output output;
+            write_json(root, output, JSON_INDENT(2));
+
+            auto& text = output.text();
+            auto data = make_unique_ptr((char*)malloc(text.size() + 1), free);
+            if (data) {
+                memcpy(data.get(), text.c_str(), text.size() + 1);
+            }
+            return data;
+        }
+
+        // Writes the same text json_dump*(create_json_value(@root), @flags) would write, but without
+        // building jansson values: objects are written straight into @output as the graph gets walked.
+        // Returns false if @output has failed to write
+        static bool write_json(const object_base &root, json_text_output& output, size_t flags) {
+            json_serializer serializer(root);
+            json_writer writer(output, flags);
+
+            serializer.plan_text(root);
+            serializer.write_text(root, writer);
+            return output.flush();
+        }
+
+        static bool write_json_file(const object_base &root, const char *path, size_t flags) {
+            // text mode, as json_dump_file opens the file
+            auto file = make_unique_file(fopen(path, "w"));
+            if (!file) {
+                return false;
+            }
+            json_text_output output(file.get());
+            return write_json(root, output, flags);
+        }
+
+        // Writes the graph as CBOR: the same objects are written in place, as write_json does, but the
+        // values keep their types - forms, references and container kinds are tagged data items.
+        // Returns false if @output has failed to write
+        static bool write_cbor(const object_base &root, json_text_output& output) {
+            json_serializer serializer(root);
+            cbor_writer writer(output);
+
+            writer.self_described();
+            serializer.plan_text(root);
+            serializer.write_binary(root, writer);
+            return output.flush();
+        }
+
+        static bool write_cbor_file(const object_base &root, const char *path) {
+            auto file = make_unique_file(fopen(path, "wb"));
+            if (!file) {
+                return false;
+            }
+            json_text_output output(file.get());
+            return write_cbor(root, output);
+        }
+
+        static std::string create_cbor_data(const object_base &root) {
+            json_text_output output;
+            write_cbor(root, output);
+            return std::move(output.text());
+        }
+
+    private:
+
+        // writes to json
+        json_ref _write_json(const object_base &root) {
+
+            auto root_value = create_placeholder(root);
+
+            while (_toFill.empty() == false) {
+
+                objects_to_fill toFill;
+                toFill.swap(_toFill);
+
+                for (auto& pair : toFill) {
+                    fill_json_object(pair.first, pair.second);
+                }
+            }
+
+            return root_value;
+        }
+
+        json_ref create_placeholder(const object_base& object) {
+
+            json_ref placeholder = nullptr;
+
+            if (_tables->serialized.insert(&object)) {
+                placeholder = object.as<array>() ? json_array() : json_object();
+                _toFill.push_back(objects_to_fill::value_type(std::cref(object), placeholder));
+            }
+            else {
+                placeholder = json_string(path_to_object(object).c_str());
+            }
+
+            return placeholder;
+        }
+
+        void fill_json_object(const object_base& cnt, json_ref object) {
+            struct helper {
+                json_serializer * self;
+                json_ref object;
+
+                void operator () (const array& cnt) {
+                    size_t index = 0;
+                    for (auto& itm : cnt.u_container()) {
+                        self->fill_key_info(itm, cnt, index++);
+                        json_array_append_new(object, self->create_value(itm));
+                    }
+                }
+                void operator () (const map& cnt) {
+                    for (auto& pair : cnt.u_container()) {
+                        self->fill_key_info(pair.second, cnt, pair.first);
                         json_object_set_new(object, pair.first.c_str(), self->create_value(pair.second));
                     }
                 }
@@ -457,16 +1515,46 @@ namespace collections {
                         json_object_set_new(object, key_string, self->create_value(pair.second));
                     }
                 }
+                void operator () (const set& cnt) {
+                    namespace jsc = json_object_serialization_consts;
+                    jsc::put_metainfo<set>(object);
+
+                    auto values = json_array();
+                    int32_t index = 0;
+                    for (auto& itm : cnt.u_container()) {
+                        self->fill_key_info(itm, cnt, index++);
+                        json_array_append_new(values, self->create_value(itm));
+                    }
+                    json_object_set_new(object, jsc::kValues, values);
+                }
+                void operator () (const int_array& cnt) {
+                    self->fill_typed_array(cnt, object);
+                }
+                void operator () (const float_array& cnt) {
+                    self->fill_typed_array(cnt, object);
+                }
             };
 
             object_lock lock(cnt);
             perform_on_object(cnt, helper{ this, object });
         }
 
+        template<class T, CollectionType Type>
+        void fill_typed_array(const typed_array<T, Type>& cnt, json_ref object) {
+            namespace jsc = json_object_serialization_consts;
+            jsc::put_metainfo<typed_array<T, Type>>(object);
+
+            auto values = json_array();
+            for (auto value : cnt.u_container()) {
+                json_array_append_new(values, create_value(item(value)));
+            }
+            json_object_set_new(object, jsc::kValues, values);
+        }
+
         template<class Key>
         void fill_key_info(const item& value, const object_base& in_object, const Key& key) {
             if (auto obj = value.object()) {
-                _keyInfo.emplace(key_info_map::value_type{ std::cref(*obj), { std::cref(in_object), key } });
+                _tables->keyInfo.emplace(obj, std::pair<const object_base*, key_variant>{ &in_object, key });
             }
         }
 
@@ -519,12 +1607,392 @@ namespace collections {
             return val;
         }
 
+        // Text writing is done in two passes. The first one walks the graph breadth-first, the way _write_json does,
+        // to find out where each object gets written in place (keyInfo) - all its other occurrences are written as
+        // reference paths. The second pass walks the graph depth-first and writes the text.
+        // The first pass copies the contents of each object, locking one object at a time, and both passes walk
+        // the copies: scripts may modify the objects meanwhile, the text is what the plan has seen. The second pass
+        // takes no locks, the copies keep the objects they reference alive
+
+        struct text_planner {
+            json_serializer& self;
+            const object_base& cnt;
+            std::deque<object_cref>& toVisit;
+
+            template<class Key>
+            void visit(const item& value, const Key& key) {
+                if (auto obj = value.object()) {
+                    self.fill_key_info(value, cnt, key);
+                    if (self._tables->serialized.insert(obj)) {
+                        toVisit.push_back(std::cref(*obj));
+                    }
+                }
+            }
+
+            void operator () (const array& cnt) {
+                int32_t index = 0;
+                for (auto& itm : cnt.u_container()) {
+                    visit(itm, index++);
+                }
+            }
+            void operator () (const map& cnt) {
+                for (auto& pair : cnt.u_container()) {
+                    if (json_writer::is_valid_utf8(pair.first.c_str(), strlen(pair.first.c_str()))) {
+                        visit(pair.second, pair.first);
+                    }
+                }
+            }
+            void operator () (const form_map& cnt) {
+                for (auto& pair : cnt.u_container()) {
+                    auto key = forms::form_to_string(pair.first.get());
+                    if (key && json_writer::is_valid_utf8(key->c_str(), key->size())) {
+                        visit(pair.second, pair.first);
+                    }
+                }
+            }
+            void operator () (const integer_map& cnt) {
+                for (auto& pair : cnt.u_container()) {
+                    visit(pair.second, pair.first);
+                }
+            }
+            void operator () (const set& cnt) {
+                int32_t index = 0;
+                for (auto& itm : cnt.u_container()) {
+                    visit(itm, index++);
+                }
+            }
+            template<class T, CollectionType Type>
+            void operator () (const typed_array<T, Type>&) {}
+        };
+
+        static std::unique_ptr<object_base> copy_contents(const object_base& cnt) {
+            std::unique_ptr<object_base> copy;
+            object_lock lock(cnt);
+            perform_on_object(cnt, [&copy](const auto& origin) {
+                auto contents = new std::decay_t<decltype(origin)>();
+                copy.reset(contents);
+                contents->u_container() = origin.u_container();
+            });
+            return copy;
+        }
+
+        void plan_text(const object_base& root) {
+            std::deque<object_cref> toVisit{ std::cref(root) };
+            _tables->serialized.insert(&root);
+
+            while (!toVisit.empty()) {
+                const object_base& cnt = toVisit.front();
+                toVisit.pop_front();
+
+                auto contents = copy_contents(cnt);
+                perform_on_object(static_cast<const object_base&>(*contents), text_planner{ *this, cnt, toVisit });
+                _tables->contents.emplace(&cnt, std::move(contents));
+            }
+        }
+
+        // the contents of planned @cnt
+        const object_base& planned_contents(const object_base& cnt) const {
+            auto contents = _tables->contents.find(&cnt);
+            jc_assert(contents);
+            return **contents;
+        }
+
+        // whether @obj, stored in @cnt under @key, is written in place there
+        template<class Key>
+        bool written_in_place(const object_base& obj, const object_base& cnt, const Key& key) const {
+            if (&obj == &_root) {
+                return false;
+            }
+            auto info = _tables->keyInfo.find(&obj);
+            if (!info || info->first != &cnt) {
+                return false;
+            }
+            auto ownerKey = boost::get<Key>(&info->second);
+            return ownerKey && *ownerKey == key;
+        }
+
+        struct text_value_writer : boost::static_visitor<> {
+            json_writer& writer;
+
+            explicit text_value_writer(json_writer& w) : writer(w) {}
+
+            void operator()(const std::string & val) const {
+                writer.string(val.c_str(), val.size());
+            }
+            void operator()(const boost::blank&) const {
+                writer.null();
+            }
+            void operator()(const SInt32 & val) const {
+                writer.integer(val);
+            }
+            void operator()(const item::Real & val) const {
+                writer.real(val);
+            }
+            void operator()(const form_ref& val) const {
+                auto formStr = forms::form_to_string(val.get());
+                if (formStr) {
+                    (*this)(*formStr);
+                }
+                else {
+                    writer.null();
+                }
+            }
+            // non-null objects are written by text_writer
+            void operator()(const internal_object_ref &) const {
+                writer.null();
+            }
+        };
+
+        struct text_writer {
+            json_serializer& self;
+            json_writer& writer;
+            const object_base& cnt;
+
+            template<class Key>
+            void write_item(const item& value, const Key& key) {
+                if (auto obj = value.object()) {
+                    if (self.written_in_place(*obj, cnt, key)) {
+                        self.write_text(*obj, writer);
+                    }
+                    else {
+                        const auto& path = self.path_to_object(*obj);
+                        writer.string(path.c_str(), path.size());
+                    }
+                }
+                else {
+                    value.var().apply_visitor(text_value_writer{ writer });
+                }
+            }
+
+            template<class T>
+            void write_metainfo() {
+                namespace jsc = json_object_serialization_consts;
+                writer.key(jsc::kMetaInfo, strlen(jsc::kMetaInfo));
+                writer.begin_object();
+                const char *typeName = jsc::type2name<T>();
+                writer.key(jsc::kTypeName, strlen(jsc::kTypeName));
+                writer.string(typeName, strlen(typeName));
+                writer.end_object();
+            }
+
+            void begin_values() {
+                namespace jsc = json_object_serialization_consts;
+                writer.key(jsc::kValues, strlen(jsc::kValues));
+                writer.begin_array();
+            }
+
+            void operator () (const array& cnt) {
+                writer.begin_array();
+                int32_t index = 0;
+                for (auto& itm : cnt.u_container()) {
+                    write_item(itm, index++);
+                }
+                writer.end_array();
+            }
+            void operator () (const map& cnt) {
+                writer.begin_object();
+                for (auto& pair : cnt.u_container()) {
+                    // jansson takes keys as null-terminated strings
+                    if (writer.key(pair.first.c_str(), strlen(pair.first.c_str()))) {
+                        write_item(pair.second, pair.first);
+                    }
+                }
+                writer.end_object();
+            }
+            void operator () (const form_map& cnt) {
+                writer.begin_object();
+                write_metainfo<form_map>();
+                for (auto& pair : cnt.u_container()) {
+                    auto key = forms::form_to_string(pair.first.get());
+                    if (key && writer.key(key->c_str(), key->size())) {
+                        write_item(pair.second, pair.first);
+                    }
+                }
+                writer.end_object();
+            }
+            void operator () (const integer_map& cnt) {
+                writer.begin_object();
+                write_metainfo<integer_map>();
+                char key_string[number_to_string_buffer_size] = { '\0' };
+                for (auto& pair : cnt.u_container()) {
+                    int length = sprintf_s(key_string, "%d", pair.first);
+                    assert(-1 != length);
+                    writer.key(key_string, length);
+                    write_item(pair.second, pair.first);
+                }
+                writer.end_object();
+            }
+            void operator () (const set& cnt) {
+                writer.begin_object();
+                write_metainfo<set>();
+                begin_values();
+                int32_t index = 0;
+                for (auto& itm : cnt.u_container()) {
+                    write_item(itm, index++);
+                }
+                writer.end_array();
+                writer.end_object();
+            }
+            void operator () (const int_array& cnt) {
+                writer.begin_object();
+                write_metainfo<int_array>();
+                begin_values();
+                for (auto value : cnt.u_container()) {
+                    writer.integer(value);
+                }
+                writer.end_array();
+                writer.end_object();
+            }
+            void operator () (const float_array& cnt) {
+                writer.begin_object();
+                write_metainfo<float_array>();
+                begin_values();
+                for (auto value : cnt.u_container()) {
+                    writer.real(value);
+                }
+                writer.end_array();
+                writer.end_object();
+            }
+        };
+
+        void write_text(const object_base& cnt, json_writer& writer) {
+            perform_on_object(planned_contents(cnt), text_writer{ *this, writer, cnt });
+        }
+
+        // CBOR writing reuses the text plan: the keys the text can't have are skipped as well,
+        // so both formats reference an object by the same path
+
+        struct binary_value_writer : boost::static_visitor<> {
+            cbor_writer& writer;
+
+            explicit binary_value_writer(cbor_writer& w) : writer(w) {}
+
+            void operator()(const std::string & val) const {
+                writer.string(val.c_str(), val.size());
+            }
+            void operator()(const boost::blank&) const {
+                writer.null();
+            }
+            void operator()(const SInt32 & val) const {
+                writer.integer(val);
+            }
+            void operator()(const item::Real & val) const {
+                writer.real(val);
+            }
+            void operator()(const form_ref& val) const {
+                if (auto origin = forms::form_origin(val.get())) {
+                    writer.form(origin->first, origin->second);
+                }
+                else {
+                    writer.null();
+                }
+            }
+            // non-null objects are written by binary_writer
+            void operator()(const internal_object_ref &) const {
+                writer.null();
+            }
+        };
+
+        struct binary_writer {
+            json_serializer& self;
+            cbor_writer& writer;
+            const object_base& cnt;
+
+            template<class Key>
+            void write_item(const item& value, const Key& key) {
+                if (auto obj = value.object()) {
+                    if (self.written_in_place(*obj, cnt, key)) {
+                        self.write_binary(*obj, writer);
+                    }
+                    else {
+                        const auto& path = self.path_to_object(*obj);
+                        const size_t prefixLength = sizeof reference_serialization::prefix - 1;
+                        writer.tag(cbor::tag_reference);
+                        writer.string(path.c_str() + prefixLength, path.size() - prefixLength);
+                    }
+                }
+                else {
+                    value.var().apply_visitor(binary_value_writer{ writer });
+                }
+            }
+
+            void operator () (const array& cnt) {
+                writer.begin_array(cnt.u_container().size());
+                int32_t index = 0;
+                for (auto& itm : cnt.u_container()) {
+                    write_item(itm, index++);
+                }
+            }
+            void operator () (const map& cnt) {
+                writer.begin_map();
+                for (auto& pair : cnt.u_container()) {
+                    const size_t length = strlen(pair.first.c_str());
+                    if (json_writer::is_valid_utf8(pair.first.c_str(), length)) {
+                        writer.string(pair.first.c_str(), length);
+                        write_item(pair.second, pair.first);
+                    }
+                }
+                writer.end_map();
+            }
+            void operator () (const form_map& cnt) {
+                writer.tag(cbor::tag_form_map);
+                writer.begin_map();
+                for (auto& pair : cnt.u_container()) {
+                    auto key = forms::form_to_string(pair.first.get());
+                    auto origin = forms::form_origin(pair.first.get());
+                    if (key && origin && json_writer::is_valid_utf8(key->c_str(), key->size())) {
+                        writer.form(origin->first, origin->second);
+                        write_item(pair.second, pair.first);
+                    }
+                }
+                writer.end_map();
+            }
+            void operator () (const integer_map& cnt) {
+                writer.tag(cbor::tag_integer_map);
+                writer.begin_map();
+                for (auto& pair : cnt.u_container()) {
+                    writer.integer(pair.first);
+                    write_item(pair.second, pair.first);
+                }
+                writer.end_map();
+            }
+            void operator () (const set& cnt) {
+                writer.tag(cbor::tag_set);
+                writer.begin_array(cnt.u_container().size());
+                int32_t index = 0;
+                for (auto& itm : cnt.u_container()) {
+                    write_item(itm, index++);
+                }
+            }
+            void operator () (const int_array& cnt) {
+                writer.tag(cbor::tag_int_array);
+                writer.begin_array(cnt.u_container().size());
+                for (auto value : cnt.u_container()) {
+                    writer.integer(value);
+                }
+            }
+            void operator () (const float_array& cnt) {
+                writer.tag(cbor::tag_float_array);
+                writer.begin_array(cnt.u_container().size());
+                for (auto value : cnt.u_container()) {
+                    writer.real(value);
+                }
+            }
+        };
+
+        void write_binary(const object_base& cnt, cbor_writer& writer) {
+            perform_on_object(planned_contents(cnt), binary_writer{ *this, writer, cnt });
+        }
+
         enum  {
             number_to_string_buffer_size = 20,
         };
 
-        std::string path_to_object(const object_base& obj) const {
-
+        // the path gets computed once per object, only for objects referenced more than once
+        const std::string& path_to_object(const object_base& obj) {
+            if (auto path = _tables->paths.find(&obj)) {
+                return *path;
+            }
 
             struct path_appender : boost::static_visitor<> {
                 std::string& p;
@@ -550,16 +2018,15 @@ namespace collections {
             };
 
             std::deque<std::reference_wrapper<const key_variant>> keys;
-            auto child = std::cref(obj);
+            const object_base *child = &obj;
 
-            while (&child.get() != &_root) {
+            while (child != &_root) {
 
-                auto itr = _keyInfo.find(child);
+                auto info = _tables->keyInfo.find(child);
 
-                if (itr != _keyInfo.end()) {
-                    auto& pair = itr->second;
-                    child = pair.first;
-                    keys.push_front(pair.second);
+                if (info) {
+                    child = info->first;
+                    keys.push_front(info->second);
                 }
                 else {
                     break;
@@ -573,7 +2040,7 @@ namespace collections {
                 boost::apply_visitor(pa, key_var.get());
             }
 
-            return path;
+            return *_tables->paths.emplace(&obj, std::move(path)).first;
         }
 
     };
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#   define JC_TARGET_AVX2
+#else
+#   include <cpuid.h>
+#   define JC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace collections {
+
+    // First stage of simdjson-like parsing: classifies the text 64 bytes at a time with SIMD instructions and
+    // lists the offsets where JSON tokens start - structural characters, opening quotes and the first characters
+    // of numbers and literals. json_pull_parser then jumps from token to token instead of skipping whitespace
+    // byte by byte. Strings get validated for unescaped control characters along the way
+    class json_structural_index {
+    public:
+
+        enum class instruction_set {
+            scalar,
+            sse2,
+            avx2,
+        };
+
+        // the best instruction set the CPU (and the OS) supports
+        static instruction_set best_instruction_set() {
+            static const instruction_set best = detect_instruction_set();
+            return best;
+        }
+
+        // Returns false if the text has an unterminated string or a control character in a string,
+        // or if it is too large to be indexed
+        bool build(const char *begin, const char *end, instruction_set isa = best_instruction_set()) {
+            _positions.clear();
+            _asciiOnly = true;
+            _isa = isa;
+
+            const size_t size = end - begin;
+            if (size >= UINT32_MAX) {
+                return false;
+            }
+            // about one token per 6 bytes of an indented text
+            _positions.reserve(size / 6 + 16);
+
+            const unsigned char *text = reinterpret_cast<const unsigned char *>(begin);
+            block_state state;
+            size_t offset = 0;
+
+            for (; offset + 64 <= size; offset += 64) {
+                if (!index_block(text + offset, static_cast<uint32_t>(offset), state)) {
+                    return false;
+                }
+            }
+            if (offset < size) {
+                // spaces don't start tokens and don't change the string state
+                unsigned char tail[64];
+                memset(tail, ' ', sizeof tail);
+                memcpy(tail, text + offset, size - offset);
+                if (!index_block(tail, static_cast<uint32_t>(offset), state)) {
+                    return false;
+                }
+            }
+            return state.inString == 0;
+        }
+
+        const std::vector<uint32_t>& positions() const { return _positions; }
+        // whether there are no bytes above 0x7F, so strings need no UTF-8 validation
+        bool ascii_only() const { return _asciiOnly; }
+        instruction_set isa() const { return _isa; }
+
+        // Finds the first '"', '\\', control character or, if @stopAtNonAscii, a byte above 0x7F in [@cur, @end)
+        static const char* find_string_special(const char *cur, const char *end, instruction_set isa, bool stopAtNonAscii) {
+            switch (isa) {
+            case instruction_set::avx2:
+                cur = find_string_special_avx2(cur, end, stopAtNonAscii);
+                break;
+            case instruction_set::sse2:
+                cur = find_string_special_sse2(cur, end, stopAtNonAscii);
+                break;
+            default:
+                break;
+            }
+            while (cur != end && !is_string_special(static_cast<unsigned char>(*cur), stopAtNonAscii)) {
+                ++cur;
+            }
+            return cur;
+        }
+
+    private:
+
+        std::vector<uint32_t> _positions;
+        bool _asciiOnly = true;
+        instruction_set _isa = instruction_set::scalar;
+
+        // one bit per byte of a 64-byte block
+        struct block_masks {
+            uint64_t quote = 0;
+            uint64_t backslash = 0;
+            uint64_t whitespace = 0;
+            uint64_t op = 0;        // {}[]:,
+            uint64_t control = 0;   // below 0x20
+            uint64_t nonAscii = 0;
+        };
+
+        // carried from block to block
+        struct block_state {
+            uint64_t nextIsEscaped = 0;
+            uint64_t inString = 0;      // all ones if the previous block ended inside a string
+            uint64_t tokenMayStart = 1; // whether the last byte of the previous block ends a token
+        };
+
+        static bool is_string_special(unsigned char c, bool stopAtNonAscii) {
+            return c == '"' || c == '\\' || c < 0x20 || (stopAtNonAscii && c >= 0x80);
+        }
+
+        static uint64_t prefix_xor(uint64_t bits) {
+            bits ^= bits << 1;
+            bits ^= bits << 2;
+            bits ^= bits << 4;
+            bits ^= bits << 8;
+            bits ^= bits << 16;
+            bits ^= bits << 32;
+            return bits;
+        }
+
+        static uint32_t trailing_zeros(uint64_t bits) {
+#if defined(_MSC_VER)
+            unsigned long index;
+            if (_BitScanForward(&index, static_cast<uint32_t>(bits))) {
+                return index;
+            }
+            _BitScanForward(&index, static_cast<uint32_t>(bits >> 32));
+            return index + 32;
+#else
+            return __builtin_ctzll(bits);
+#endif
+        }
+
+        // characters preceded by an odd number of backslashes
+        static uint64_t escaped_characters(uint64_t backslash, block_state& state) {
+            if (!backslash) {
+                const uint64_t escaped = state.nextIsEscaped;
+                state.nextIsEscaped = 0;
+                return escaped;
+            }
+            const uint64_t oddBits = 0xAAAAAAAAAAAAAAAAULL;
+            // a backslash, escaped by the previous block, doesn't escape anything
+            const uint64_t potentialEscape = backslash & ~state.nextIsEscaped;
+            // subtraction flips the bits up to the end of each backslash run, the odd bits tell the run's parity
+            const uint64_t escapeAndTerminal = (((potentialEscape << 1) | oddBits) - potentialEscape) ^ oddBits;
+            const uint64_t escaped = escapeAndTerminal ^ (backslash | state.nextIsEscaped);
+            state.nextIsEscaped = (escapeAndTerminal & backslash) >> 63;
+            return escaped;
+        }
+
+        bool index_block(const unsigned char *block, uint32_t offset, block_state& state) {
+            block_masks masks;
+            switch (_isa) {
+            case instruction_set::avx2:
+                classify_avx2(block, masks);
+                break;
+            case instruction_set::sse2:
+                classify_sse2(block, masks);
+                break;
+            default:
+                classify_scalar(block, masks);
+                break;
+            }
+
+            const uint64_t quote = masks.quote & ~escaped_characters(masks.backslash, state);
+            // includes opening quotes, excludes closing ones
+            const uint64_t inString = prefix_xor(quote) ^ state.inString;
+            state.inString = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+
+            if (masks.control & inString) {
+                return false;
+            }
+            _asciiOnly = _asciiOnly && masks.nonAscii == 0;
+
+            // numbers and literals start right after whitespace, an operator or a closing quote
+            const uint64_t tokenEnds = masks.op | masks.whitespace | quote;
+            const uint64_t afterTokenEnd = (tokenEnds << 1) | state.tokenMayStart;
+            state.tokenMayStart = tokenEnds >> 63;
+            const uint64_t scalarStarts = afterTokenEnd & ~(masks.whitespace | masks.op | quote | inString);
+
+            uint64_t starts = (masks.op & ~inString) | (quote & inString) | scalarStarts;
+            while (starts) {
+                _positions.push_back(offset + trailing_zeros(starts));
+                starts &= starts - 1;
+            }
+            return true;
+        }
+
+        static void classify_scalar(const unsigned char *block, block_masks& masks) {
+            for (int i = 0; i < 64; ++i) {
+                const unsigned char c = block[i];
+                const uint64_t bit = uint64_t(1) << i;
+                switch (c) {
+                case '"': masks.quote |= bit; break;
+                case '\\': masks.backslash |= bit; break;
+                case ' ': case '\t': case '\n': case '\r': masks.whitespace |= bit; break;
+                case '{': case '}': case '[': case ']': case ':': case ',': masks.op |= bit; break;
+                default: break;
+                }
+                if (c < 0x20) {
+                    masks.control |= bit;
+                }
+                else if (c >= 0x80) {
+                    masks.nonAscii |= bit;
+                }
+            }
+        }
+
+        static uint64_t bits_sse2(int shift, __m128i mask) {
+            return uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(mask))) << shift;
+        }
+
+        static void classify_sse2(const unsigned char *block, block_masks& masks) {
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i space = _mm_set1_epi8(' ');
+            const __m128i tab = _mm_set1_epi8('\t');
+            const __m128i lineFeed = _mm_set1_epi8('\n');
+            const __m128i carriageReturn = _mm_set1_epi8('\r');
+            // '[' and ']' differ from '{' and '}' by 0x20 only
+            const __m128i caseBit = _mm_set1_epi8(0x20);
+            const __m128i openBrace = _mm_set1_epi8('{');
+            const __m128i closeBrace = _mm_set1_epi8('}');
+            const __m128i colon = _mm_set1_epi8(':');
+            const __m128i comma = _mm_set1_epi8(',');
+            const __m128i lastControl = _mm_set1_epi8(0x1F);
+
+            for (int i = 0; i < 4; ++i) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i * 16));
+                const int shift = i * 16;
+                const __m128i folded = _mm_or_si128(v, caseBit);
+                masks.quote |= bits_sse2(shift, _mm_cmpeq_epi8(v, quote));
+                masks.backslash |= bits_sse2(shift, _mm_cmpeq_epi8(v, backslash));
+                masks.whitespace |= bits_sse2(shift, _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, lineFeed), _mm_cmpeq_epi8(v, carriageReturn))));
+                masks.op |= bits_sse2(shift, _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(folded, openBrace), _mm_cmpeq_epi8(folded, closeBrace)),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma))));
+                masks.control |= bits_sse2(shift, _mm_cmpeq_epi8(_mm_min_epu8(v, lastControl), v));
+                masks.nonAscii |= bits_sse2(shift, v);
+            }
+        }
+
+        JC_TARGET_AVX2 static uint64_t bits_avx2(int shift, __m256i mask) {
+            return uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(mask))) << shift;
+        }
+
+        JC_TARGET_AVX2 static void classify_avx2(const unsigned char *block, block_masks& masks) {
+            const __m256i quote = _mm256_set1_epi8('"');
+            const __m256i backslash = _mm256_set1_epi8('\\');
+            const __m256i space = _mm256_set1_epi8(' ');
+            const __m256i tab = _mm256_set1_epi8('\t');
+            const __m256i lineFeed = _mm256_set1_epi8('\n');
+            const __m256i carriageReturn = _mm256_set1_epi8('\r');
+            const __m256i caseBit = _mm256_set1_epi8(0x20);
+            const __m256i openBrace = _mm256_set1_epi8('{');
+            const __m256i closeBrace = _mm256_set1_epi8('}');
+            const __m256i colon = _mm256_set1_epi8(':');
+            const __m256i comma = _mm256_set1_epi8(',');
+            const __m256i lastControl = _mm256_set1_epi8(0x1F);
+
+            for (int i = 0; i < 2; ++i) {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + i * 32));
+                const int shift = i * 32;
+                const __m256i folded = _mm256_or_si256(v, caseBit);
+                masks.quote |= bits_avx2(shift, _mm256_cmpeq_epi8(v, quote));
+                masks.backslash |= bits_avx2(shift, _mm256_cmpeq_epi8(v, backslash));
+                masks.whitespace |= bits_avx2(shift, _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, lineFeed), _mm256_cmpeq_epi8(v, carriageReturn))));
+                masks.op |= bits_avx2(shift, _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(folded, openBrace), _mm256_cmpeq_epi8(folded, closeBrace)),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma))));
+                masks.control |= bits_avx2(shift, _mm256_cmpeq_epi8(_mm256_min_epu8(v, lastControl), v));
+                masks.nonAscii |= bits_avx2(shift, v);
+            }
+        }
+
+        static const char* find_string_special_sse2(const char *cur, const char *end, bool stopAtNonAscii) {
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i lastControl = _mm_set1_epi8(0x1F);
+
+            while (end - cur >= 16) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+                int mask = _mm_movemask_epi8(_mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                    _mm_cmpeq_epi8(_mm_min_epu8(v, lastControl), v)));
+                if (stopAtNonAscii) {
+                    mask |= _mm_movemask_epi8(v);
+                }
+                if (mask) {
+                    return cur + trailing_zeros(static_cast<uint32_t>(mask));
+                }
+                cur += 16;
+            }
+            return cur;
+        }
+
+        JC_TARGET_AVX2 static const char* find_string_special_avx2(const char *cur, const char *end, bool stopAtNonAscii) {
+            const __m256i quote = _mm256_set1_epi8('"');
+            const __m256i backslash = _mm256_set1_epi8('\\');
+            const __m256i lastControl = _mm256_set1_epi8(0x1F);
+
+            while (end - cur >= 32) {
+                const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur));
+                uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+                    _mm256_cmpeq_epi8(_mm256_min_epu8(v, lastControl), v))));
+                if (stopAtNonAscii) {
+                    mask |= static_cast<uint32_t>(_mm256_movemask_epi8(v));
+                }
+                if (mask) {
+                    return cur + trailing_zeros(mask);
+                }
+                cur += 32;
+            }
+            return cur;
+        }
+
+        static instruction_set detect_instruction_set() {
+            int info[4] = { 0 };
+            cpuid(info, 0, 0);
+            const int maxLeaf = info[0];
+
+            cpuid(info, 1, 0);
+            const bool sse2 = (info[3] & (1 << 26)) != 0;
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx = (info[2] & (1 << 28)) != 0;
+
+            if (maxLeaf >= 7 && osxsave && avx) {
+                // the OS saves YMM registers
+                if ((xgetbv0() & 0x6) == 0x6) {
+                    cpuid(info, 7, 0);
+                    if (info[1] & (1 << 5)) {
+                        return instruction_set::avx2;
+                    }
+                }
+            }
+            return sse2 ? instruction_set::sse2 : instruction_set::scalar;
+        }
+
+        static void cpuid(int info[4], int leaf, int subleaf) {
+#if defined(_MSC_VER)
+            __cpuidex(info, leaf, subleaf);
+#else
+            unsigned int regs[4] = { 0 };
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+            for (int i = 0; i < 4; ++i) {
+                info[i] = static_cast<int>(regs[i]);
+            }
+#endif
+        }
+
+        static uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+            return _xgetbv(0);
+#else
+            uint32_t eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (uint64_t(edx) << 32) | eax;
+#endif
+        }
+    };
+}
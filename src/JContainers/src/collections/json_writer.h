@@ -0,0 +1,337 @@
+#pragma once
+
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace collections {
+
+    // Buffered sink for JSON text: either flushes into a file or accumulates the whole text in memory
+    class json_text_output {
+    public:
+
+        enum { flush_threshold = 64 * 1024 };
+
+        // accumulates the text, see text()
+        json_text_output() {}
+
+        explicit json_text_output(FILE *file) : _file(file) {
+            _buffer.reserve(flush_threshold + 1024);
+        }
+
+        ~json_text_output() {
+            flush();
+        }
+
+        json_text_output(const json_text_output&) = delete;
+        json_text_output& operator = (const json_text_output&) = delete;
+
+        void write(const char *data, size_t length) {
+            _buffer.append(data, length);
+            if (_file && _buffer.size() >= flush_threshold) {
+                flush();
+            }
+        }
+
+        void put(char c) {
+            _buffer.push_back(c);
+        }
+
+        // returns false if any write into the file has failed
+        bool flush() {
+            if (_file && !_buffer.empty()) {
+                _failed = _failed || fwrite(_buffer.data(), 1, _buffer.size(), _file) != _buffer.size();
+                _buffer.clear();
+            }
+            return !_failed;
+        }
+
+        // the accumulated text, if there is no file
+        std::string& text() { return _buffer; }
+
+    private:
+        FILE *_file = nullptr;
+        std::string _buffer;
+        bool _failed = false;
+    };
+
+    // Emits JSON text token by token, formatted exactly as jansson's json_dump* functions do with the same flags.
+    // Supported flags: JSON_INDENT, JSON_COMPACT, JSON_ENSURE_ASCII, JSON_ESCAPE_SLASH, JSON_REAL_PRECISION.
+    // Like jansson's constructors, key(), string() and real() reject invalid UTF-8 and non-finite numbers -
+    // nothing gets written then, and the whole object entry or array element is omitted
+    class json_writer {
+    public:
+
+        json_writer(json_text_output& output, size_t flags)
+            : _output(output)
+            , _indent(flags & 0x1F)
+            , _precision((flags >> 11) & 0x1F)
+            , _compact((flags & 0x20) != 0)
+            , _ensureAscii((flags & 0x40) != 0)
+            , _escapeSlash((flags & 0x400) != 0)
+        {
+            _hasItems.reserve(32);
+        }
+
+        void begin_object() {
+            begin_value();
+            _output.put('{');
+            _hasItems.push_back(false);
+        }
+
+        void end_object() {
+            end_container('}');
+        }
+
+        void begin_array() {
+            begin_value();
+            _output.put('[');
+            _hasItems.push_back(false);
+        }
+
+        void end_array() {
+            end_container(']');
+        }
+
+        // sets the key of the next value
+        bool key(const char *str, size_t length) {
+            if (!is_valid_utf8(str, length)) {
+                return false;
+            }
+            _key = str;
+            _keyLength = length;
+            return true;
+        }
+
+        bool string(const char *str, size_t length) {
+            if (!is_valid_utf8(str, length)) {
+                _key = nullptr;
+                return false;
+            }
+            begin_value();
+            write_string(str, length);
+            return true;
+        }
+
+        void integer(int64_t value) {
+            begin_value();
+            char buffer[32];
+            int length = snprintf(buffer, sizeof buffer, "%lld", static_cast<long long>(value));
+            _output.write(buffer, length);
+        }
+
+        bool real(double value) {
+            if (!std::isfinite(value)) {
+                _key = nullptr;
+                return false;
+            }
+            begin_value();
+            write_real(value);
+            return true;
+        }
+
+        void null() {
+            begin_value();
+            _output.write("null", 4);
+        }
+
+        // the same check json_string and json_object_set do
+        static bool is_valid_utf8(const char *str, size_t length) {
+            const unsigned char *cur = reinterpret_cast<const unsigned char *>(str);
+            const unsigned char *end = cur + length;
+
+            while (cur != end) {
+                const unsigned char lead = *cur;
+                if (lead < 0x80) {
+                    ++cur;
+                    continue;
+                }
+
+                size_t count;
+                uint32_t codepoint;
+                if (lead >= 0xC2 && lead <= 0xDF) { count = 2; codepoint = lead & 0x1F; }
+                else if (lead >= 0xE0 && lead <= 0xEF) { count = 3; codepoint = lead & 0x0F; }
+                else if (lead >= 0xF0 && lead <= 0xF4) { count = 4; codepoint = lead & 0x07; }
+                else {
+                    return false;
+                }
+
+                if (size_t(end - cur) < count) {
+                    return false;
+                }
+                for (size_t i = 1; i < count; ++i) {
+                    if ((cur[i] & 0xC0) != 0x80) {
+                        return false;
+                    }
+                    codepoint = (codepoint << 6) | (cur[i] & 0x3F);
+                }
+                // overlong forms, surrogates and out of range code points
+                if ((count == 3 && codepoint < 0x800) || (count == 4 && codepoint < 0x10000)
+                    || (codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF) {
+                    return false;
+                }
+                cur += count;
+            }
+            return true;
+        }
+
+    private:
+
+        json_text_output& _output;
+        const size_t _indent;
+        const int _precision;
+        const bool _compact;
+        const bool _ensureAscii;
+        const bool _escapeSlash;
+
+        // whether an item has been written into each of the open containers
+        std::vector<bool> _hasItems;
+        const char *_key = nullptr;
+        size_t _keyLength = 0;
+
+        void write_indent(size_t depth, bool space) {
+            if (_indent > 0) {
+                _output.put('\n');
+                for (size_t i = 0, count = depth * _indent; i < count; ++i) {
+                    _output.put(' ');
+                }
+            }
+            else if (space && !_compact) {
+                _output.put(' ');
+            }
+        }
+
+        // separators, indentation and the key of the value about to be written
+        void begin_value() {
+            if (_hasItems.empty()) {
+                return;
+            }
+            if (_hasItems.back()) {
+                _output.put(',');
+                write_indent(_hasItems.size(), true);
+            }
+            else {
+                write_indent(_hasItems.size(), false);
+                _hasItems.back() = true;
+            }
+            if (_key) {
+                write_string(_key, _keyLength);
+                _output.write(": ", _compact ? 1 : 2);
+                _key = nullptr;
+            }
+        }
+
+        void end_container(char bracket) {
+            const bool hasItems = _hasItems.back();
+            _hasItems.pop_back();
+            if (hasItems) {
+                write_indent(_hasItems.size(), false);
+            }
+            _output.put(bracket);
+        }
+
+        void write_real(double value) {
+            char buffer[100];
+            int length = snprintf(buffer, sizeof buffer, "%.*g", _precision ? _precision : 17, value);
+
+            // jansson converts locale's decimal point back into '.'
+            const char point = *localeconv()->decimal_point;
+            if (point != '.') {
+                if (char *pos = strchr(buffer, point)) {
+                    *pos = '.';
+                }
+            }
+
+            // a dot or an exponent makes sure the number is read back as real
+            if (!strchr(buffer, '.') && !strchr(buffer, 'e')) {
+                buffer[length++] = '.';
+                buffer[length++] = '0';
+                buffer[length] = '\0';
+            }
+
+            // no '+' sign and leading zeros in the exponent
+            if (char *exponent = strchr(buffer, 'e')) {
+                char *start = exponent + 1;
+                char *end = start + 1;
+                if (*start == '-') {
+                    ++start;
+                }
+                while (*end == '0') {
+                    ++end;
+                }
+                if (end != start) {
+                    memmove(start, end, length - (end - buffer) + 1);
+                    length -= static_cast<int>(end - start);
+                }
+            }
+
+            _output.write(buffer, length);
+        }
+
+        static uint32_t decode_utf8(const unsigned char *&cur) {
+            const unsigned char lead = *cur++;
+            size_t count;
+            uint32_t codepoint;
+            if (lead < 0xE0) { count = 1; codepoint = lead & 0x1F; }
+            else if (lead < 0xF0) { count = 2; codepoint = lead & 0x0F; }
+            else { count = 3; codepoint = lead & 0x07; }
+            while (count--) {
+                codepoint = (codepoint << 6) | (*cur++ & 0x3F);
+            }
+            return codepoint;
+        }
+
+        // @str is valid UTF-8
+        void write_string(const char *str, size_t length) {
+            const unsigned char *cur = reinterpret_cast<const unsigned char *>(str);
+            const unsigned char *end = cur + length;
+
+            _output.put('"');
+            while (true) {
+                // the longest run that needs no escaping
+                const unsigned char *run = cur;
+                while (cur != end && *cur >= 0x20 && *cur != '"' && *cur != '\\'
+                    && !(_escapeSlash && *cur == '/') && !(_ensureAscii && *cur >= 0x80)) {
+                    ++cur;
+                }
+                _output.write(reinterpret_cast<const char *>(run), cur - run);
+
+                if (cur == end) {
+                    break;
+                }
+
+                const uint32_t codepoint = *cur >= 0x80 ? decode_utf8(cur) : *cur++;
+                char sequence[13];
+                const char *text = sequence;
+                size_t textLength = 2;
+
+                switch (codepoint) {
+                case '\\': text = "\\\\"; break;
+                case '"': text = "\\\""; break;
+                case '\b': text = "\\b"; break;
+                case '\f': text = "\\f"; break;
+                case '\n': text = "\\n"; break;
+                case '\r': text = "\\r"; break;
+                case '\t': text = "\\t"; break;
+                case '/': text = "\\/"; break;
+                default:
+                    if (codepoint < 0x10000) {
+                        textLength = snprintf(sequence, sizeof sequence, "\\u%04X", codepoint);
+                    }
+                    else {
+                        const uint32_t offset = codepoint - 0x10000;
+                        textLength = snprintf(sequence, sizeof sequence, "\\u%04X\\u%04X",
+                            0xD800 | ((offset & 0xFFC00) >> 10), 0xDC00 | (offset & 0x3FF));
+                    }
+                    break;
+                }
+                _output.write(text, textLength);
+            }
+            _output.put('"');
+        }
+    };
+}
@@ -194,7 +194,7 @@ namespace lua { namespace api {
     cexport JCToLuaValue JArray_getValue(array* obj, index key) {
         JCToLuaValue v(JCToLuaValue_None());
         array_functions::doReadOp(obj, key, [=, &v](index idx) {
-            v = JCToLuaValue_fromItem(obj->u_container()[idx]);
+            v = JCToLuaValue_fromItem(static_cast<const array&>(*obj).u_container()[idx]);
         });
         //std::cout << "value returned: " << JCValue_toString(v) << std::endl;
         return v;
@@ -227,7 +227,7 @@ namespace lua { namespace api {
     }
 
     cexport JCToLuaValue JMap_getValue(map *obj, cstring key) {
-        return map_functions::doReadOpR(obj, key, JCToLuaValue_None(), [](item& itm) { return JCToLuaValue_fromItem(itm); });
+        return map_functions::doReadOpR(obj, key, JCToLuaValue_None(), [](const item& itm) { return JCToLuaValue_fromItem(itm); });
     }
     //////////////////////////////////////////////////////////////////////////
 
@@ -244,7 +244,7 @@ namespace lua { namespace api {
     }
 
     cexport JCToLuaValue JFormMap_getValue(form_map *obj, FormId key) {
-        return formmap_functions::doReadOpR(obj, make_weak_form_id(key, HACK_get_tcontext(*obj)), JCToLuaValue_None(), [](item& itm) { return JCToLuaValue_fromItem(itm); });
+        return formmap_functions::doReadOpR(obj, make_weak_form_id(key, HACK_get_tcontext(*obj)), JCToLuaValue_None(), [](const item& itm) { return JCToLuaValue_fromItem(itm); });
     }
 
     cexport void JFormMap_removeKey(form_map *obj, FormId key) {
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+
+#include "collections/item.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#   define JC_NUMERIC_KERNELS_SSE2
+#   include <emmintrin.h>
+#endif
+
+namespace collections {
+
+    // Kernels used by reducing collection operators (@sumNum, @avgNum, ...).
+    // Items are scanned by type tag only, numbers are gathered into fixed-size
+    // batches of doubles and each batch is processed by a (SSE2 if available) kernel.
+    namespace numeric_kernels {
+
+        enum { batch_size = 256 };
+
+        enum number_filter {
+            any_number,
+            integers_only,
+            reals_only,
+        };
+
+        // Feeds every number accepted by @filter to @consume(const double *values, size_t count)
+        // in batches of up to batch_size values. Returns total amount of consumed numbers
+        template<class F>
+        inline size_t for_each_batch(const item* begin, const item* end, number_filter filter, F&& consume) {
+            double buffer[batch_size];
+            size_t filled = 0, total = 0;
+
+            for (auto itr = begin; itr != end; ++itr) {
+                const auto type = itr->type();
+                if (type == item_type::integer && filter != reals_only) {
+                    buffer[filled++] = *itr->get<SInt32>();
+                }
+                else if (type == item_type::real && filter != integers_only) {
+                    buffer[filled++] = *itr->get<item::Real>();
+                }
+                else {
+                    continue;
+                }
+
+                if (filled == batch_size) {
+                    consume(static_cast<const double*>(buffer), filled);
+                    total += filled;
+                    filled = 0;
+                }
+            }
+
+            if (filled) {
+                consume(static_cast<const double*>(buffer), filled);
+                total += filled;
+            }
+
+            return total;
+        }
+
+#ifdef JC_NUMERIC_KERNELS_SSE2
+        inline double _horizontal(__m128d v, double (*combine)(double, double)) {
+            double lanes[2];
+            _mm_storeu_pd(lanes, v);
+            return combine(lanes[0], lanes[1]);
+        }
+#endif
+
+        inline double sum(const double* values, size_t count) {
+            size_t i = 0;
+            double result = 0.0;
+#ifdef JC_NUMERIC_KERNELS_SSE2
+            __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+            for (; i + 4 <= count; i += 4) {
+                acc0 = _mm_add_pd(acc0, _mm_loadu_pd(values + i));
+                acc1 = _mm_add_pd(acc1, _mm_loadu_pd(values + i + 2));
+            }
+            result = _horizontal(_mm_add_pd(acc0, acc1), [](double a, double b) { return a + b; });
+#endif
+            for (; i < count; ++i) {
+                result += values[i];
+            }
+            return result;
+        }
+
+        inline double product(const double* values, size_t count) {
+            size_t i = 0;
+            double result = 1.0;
+#ifdef JC_NUMERIC_KERNELS_SSE2
+            __m128d acc0 = _mm_set1_pd(1.0), acc1 = _mm_set1_pd(1.0);
+            for (; i + 4 <= count; i += 4) {
+                acc0 = _mm_mul_pd(acc0, _mm_loadu_pd(values + i));
+                acc1 = _mm_mul_pd(acc1, _mm_loadu_pd(values + i + 2));
+            }
+            result = _horizontal(_mm_mul_pd(acc0, acc1), [](double a, double b) { return a * b; });
+#endif
+            for (; i < count; ++i) {
+                result *= values[i];
+            }
+            return result;
+        }
+
+        // @count must be greater than zero
+        inline double min_value(const double* values, size_t count) {
+            size_t i = 0;
+            double result = values[0];
+#ifdef JC_NUMERIC_KERNELS_SSE2
+            if (count >= 2) {
+                __m128d acc = _mm_loadu_pd(values);
+                for (i = 2; i + 2 <= count; i += 2) {
+                    acc = _mm_min_pd(acc, _mm_loadu_pd(values + i));
+                }
+                result = _horizontal(acc, [](double a, double b) { return (std::min)(a, b); });
+            }
+#endif
+            for (; i < count; ++i) {
+                result = (std::min)(result, values[i]);
+            }
+            return result;
+        }
+
+        // @count must be greater than zero
+        inline double max_value(const double* values, size_t count) {
+            size_t i = 0;
+            double result = values[0];
+#ifdef JC_NUMERIC_KERNELS_SSE2
+            if (count >= 2) {
+                __m128d acc = _mm_loadu_pd(values);
+                for (i = 2; i + 2 <= count; i += 2) {
+                    acc = _mm_max_pd(acc, _mm_loadu_pd(values + i));
+                }
+                result = _horizontal(acc, [](double a, double b) { return (std::max)(a, b); });
+            }
+#endif
+            for (; i < count; ++i) {
+                result = (std::max)(result, values[i]);
+            }
+            return result;
+        }
+
+        // sum of (value - mean)^2
+        inline double sum_of_squared_deviations(const double* values, size_t count, double mean) {
+            size_t i = 0;
+            double result = 0.0;
+#ifdef JC_NUMERIC_KERNELS_SSE2
+            const __m128d m = _mm_set1_pd(mean);
+            __m128d acc = _mm_setzero_pd();
+            for (; i + 2 <= count; i += 2) {
+                __m128d d = _mm_sub_pd(_mm_loadu_pd(values + i), m);
+                acc = _mm_add_pd(acc, _mm_mul_pd(d, d));
+            }
+            result = _horizontal(acc, [](double a, double b) { return a + b; });
+#endif
+            for (; i < count; ++i) {
+                const double d = values[i] - mean;
+                result += d * d;
+            }
+            return result;
+        }
+
+        //////////////////////////////////////////////////////////////////////////
+        // kernels over plain number arrays (JIntArray, JFltArray). Sums are accumulated in doubles
+
+        inline double sum(const SInt32* values, size_t count) {
+            size_t i = 0;
+            double result = 0.0;
+#ifdef JC_NUMERIC_KERNELS_SSE2
+            __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+            for (; i + 4 <= count; i += 4) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+                acc0 = _mm_add_pd(acc0, _mm_cvtepi32_pd(v));
+                acc1 = _mm_add_pd(acc1, _mm_cvtepi32_pd(_mm_srli_si128(v, 8)));
+            }
+            result = _horizontal(_mm_add_pd(acc0, acc1), [](double a, double b) { return a + b; });
+#endif
+            for (; i < count; ++i) {
+                result += values[i];
+            }
+            return result;
+        }
+
+        inline double sum(const Float32* values, size_t count) {
+            size_t i = 0;
+            double result = 0.0;
+#ifdef JC_NUMERIC_KERNELS_SSE2
+            __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+            for (; i + 4 <= count; i += 4) {
+                __m128 v = _mm_loadu_ps(values + i);
+                acc0 = _mm_add_pd(acc0, _mm_cvtps_pd(v));
+                acc1 = _mm_add_pd(acc1, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+            }
+            result = _horizontal(_mm_add_pd(acc0, acc1), [](double a, double b) { return a + b; });
+#endif
+            for (; i < count; ++i) {
+                result += values[i];
+            }
+            return result;
+        }
+
+        // @count must be greater than zero
+        inline void min_max(const SInt32* values, size_t count, SInt32& minOut, SInt32& maxOut) {
+            size_t i = 0;
+            SInt32 mn = values[0], mx = values[0];
+#ifdef JC_NUMERIC_KERNELS_SSE2
+            if (count >= 4) {
+                // SSE2 has no _mm_min_epi32, select lanes by comparison mask instead
+                __m128i vmin = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+                __m128i vmax = vmin;
+                for (i = 4; i + 4 <= count; i += 4) {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+                    __m128i lt = _mm_cmplt_epi32(v, vmin);
+                    vmin = _mm_or_si128(_mm_and_si128(lt, v), _mm_andnot_si128(lt, vmin));
+                    __m128i gt = _mm_cmpgt_epi32(v, vmax);
+                    vmax = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, vmax));
+                }
+                SInt32 lanes[4];
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), vmin);
+                mn = *std::min_element(lanes, lanes + 4);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), vmax);
+                mx = *std::max_element(lanes, lanes + 4);
+            }
+#endif
+            for (; i < count; ++i) {
+                mn = (std::min)(mn, values[i]);
+                mx = (std::max)(mx, values[i]);
+            }
+            minOut = mn;
+            maxOut = mx;
+        }
+
+        // @count must be greater than zero
+        inline void min_max(const Float32* values, size_t count, Float32& minOut, Float32& maxOut) {
+            size_t i = 0;
+            Float32 mn = values[0], mx = values[0];
+#ifdef JC_NUMERIC_KERNELS_SSE2
+            if (count >= 4) {
+                __m128 vmin = _mm_loadu_ps(values);
+                __m128 vmax = vmin;
+                for (i = 4; i + 4 <= count; i += 4) {
+                    __m128 v = _mm_loadu_ps(values + i);
+                    vmin = _mm_min_ps(vmin, v);
+                    vmax = _mm_max_ps(vmax, v);
+                }
+                Float32 lanes[4];
+                _mm_storeu_ps(lanes, vmin);
+                mn = *std::min_element(lanes, lanes + 4);
+                _mm_storeu_ps(lanes, vmax);
+                mx = *std::max_element(lanes, lanes + 4);
+            }
+#endif
+            for (; i < count; ++i) {
+                mn = (std::min)(mn, values[i]);
+                mx = (std::max)(mx, values[i]);
+            }
+            minOut = mn;
+            maxOut = mx;
+        }
+    }
+}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "collections/collections.h"
+#include "collections/numeric_kernels.h"
 
 #include <thread>
+#include <vector>
 #include "meta.h"
 #include "util/istring.h"
 
@@ -12,14 +14,22 @@ namespace collections {
     {
         using istring = util::istring;
         typedef void (*operator_func)(const item& val, item& state);
+        // reducing operator: receives all visited values at once
+        typedef void (*reduce_func)(object_context& context, const item* begin, const item* end, item& result);
 
         struct coll_operator {
             operator_func func;
+            reduce_func reduce;
             const char *func_name;
             const char *description;
 
             static coll_operator make(operator_func _func, const char *_func_name, const char *_description) {
-                coll_operator op = {_func, _func_name, _description};
+                coll_operator op = {_func, nullptr, _func_name, _description};
+                return op;
+            }
+
+            static coll_operator make(reduce_func _reduce, const char *_func_name, const char *_description) {
+                coll_operator op = {nullptr, _reduce, _func_name, _description};
                 return op;
             }
         };
@@ -105,6 +115,127 @@ namespace collections {
         }
         COLLECTION_OPERATOR(minInt, "returns minimum int number in collection");
 
+        //////////////////////////////////////////////////////////////////////////
+        // reducing operators
+
+        namespace nk = numeric_kernels;
+
+        // the values out of the int32 range get clamped, a float may be out of the range, but not a sum of ints
+        inline SInt32 _clamp_to_int32(double value) {
+            return static_cast<SInt32>((std::max)(double(INT32_MIN), (std::min)(double(INT32_MAX), value)));
+        }
+
+        // NaN, the infinities and the floats out of the int32 range can't be rounded down into an int32
+        inline bool _floors_to_int32(double value) {
+            return value >= double(INT32_MIN) && value < double(INT32_MAX) + 1.0;
+        }
+
+        inline double _sum_of(const item* begin, const item* end, nk::number_filter filter, size_t& count) {
+            double total = 0.0;
+            count = nk::for_each_batch(begin, end, filter, [&](const double* values, size_t n) {
+                total += nk::sum(values, n);
+            });
+            return total;
+        }
+
+        void sumNum(object_context&, const item* begin, const item* end, item& result) {
+            size_t count = 0;
+            double total = _sum_of(begin, end, nk::any_number, count);
+            if (count) {
+                result = item::Real(total);
+            }
+        }
+        COLLECTION_OPERATOR(sumNum, "returns sum of all numbers (int or float) in collection, as float");
+
+        void sumInt(object_context&, const item* begin, const item* end, item& result) {
+            size_t count = 0;
+            double total = _sum_of(begin, end, nk::integers_only, count);
+            if (count) {
+                result = _clamp_to_int32(total);
+            }
+        }
+        COLLECTION_OPERATOR(sumInt, "returns sum of all int numbers in collection");
+
+        void sumFlt(object_context&, const item* begin, const item* end, item& result) {
+            size_t count = 0;
+            double total = _sum_of(begin, end, nk::reals_only, count);
+            if (count) {
+                result = item::Real(total);
+            }
+        }
+        COLLECTION_OPERATOR(sumFlt, "returns sum of all float numbers in collection");
+
+        void avgNum(object_context&, const item* begin, const item* end, item& result) {
+            size_t count = 0;
+            double total = _sum_of(begin, end, nk::any_number, count);
+            if (count) {
+                result = item::Real(total / count);
+            }
+        }
+        COLLECTION_OPERATOR(avgNum, "returns average of all numbers (int or float) in collection");
+
+        void productNum(object_context&, const item* begin, const item* end, item& result) {
+            double total = 1.0;
+            size_t count = nk::for_each_batch(begin, end, nk::any_number, [&](const double* values, size_t n) {
+                total *= nk::product(values, n);
+            });
+            if (count) {
+                result = item::Real(total);
+            }
+        }
+        COLLECTION_OPERATOR(productNum, "returns product of all numbers (int or float) in collection");
+
+        void stddevNum(object_context&, const item* begin, const item* end, item& result) {
+            size_t count = 0;
+            double mean = _sum_of(begin, end, nk::any_number, count);
+            if (!count) {
+                return;
+            }
+            mean /= count;
+            double deviations = 0.0;
+            nk::for_each_batch(begin, end, nk::any_number, [&](const double* values, size_t n) {
+                deviations += nk::sum_of_squared_deviations(values, n, mean);
+            });
+            result = item::Real(std::sqrt(deviations / count));
+        }
+        COLLECTION_OPERATOR(stddevNum, "returns population standard deviation of all numbers (int or float) in collection");
+
+        void count(object_context&, const item* begin, const item* end, item& result) {
+            result = static_cast<SInt32>(end - begin);
+        }
+        COLLECTION_OPERATOR(count, "returns amount of values in collection");
+
+        void countNonNull(object_context&, const item* begin, const item* end, item& result) {
+            result = static_cast<SInt32>(std::count_if(begin, end, [](const item& itm) { return !itm.isNull(); }));
+        }
+        COLLECTION_OPERATOR(countNonNull, "returns amount of non-None values in collection");
+
+        void distinctCount(object_context&, const item* begin, const item* end, item& result) {
+            std::vector<item> values(begin, end);
+            std::sort(values.begin(), values.end());
+            result = static_cast<SInt32>(std::unique(values.begin(), values.end()) - values.begin());
+        }
+        COLLECTION_OPERATOR(distinctCount, "returns amount of distinct values in collection");
+
+        void histogram(object_context& context, const item* begin, const item* end, item& result) {
+            std::map<int32_t, int32_t> buckets;
+            for (auto itr = begin; itr != end; ++itr) {
+                if (auto value = itr->get<SInt32>()) {
+                    ++buckets[*value];
+                }
+                else if (itr->isNumber() && _floors_to_int32(itr->fltValue())) {
+                    ++buckets[static_cast<int32_t>(std::floor(itr->fltValue()))];
+                }
+            }
+
+            auto& hist = integer_map::object(context);
+            for (auto& pair : buckets) {
+                hist.u_set(pair.first, pair.second);
+            }
+            result = &hist;
+        }
+        COLLECTION_OPERATOR(histogram, "returns JIntMap where keys are numbers (rounded down) in collection and values are amount of their occurrences, numbers out of int range are skipped");
+
 
 #undef COLLECTION_OPERATOR
     };
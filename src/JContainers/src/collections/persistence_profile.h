@@ -0,0 +1,320 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "jansson.h"
+#include "object/object_base.h"
+
+namespace collections {
+
+    // The breakdown of a save or a load: the time of each phase, the objects and the bytes of each object type
+    // and of each domain. domain_master profiles each save and load, the flat format readers and writers report
+    // into the profile being collected (see scope). The phases run concurrently, so that the time of a phase
+    // is summed over the threads and may exceed the wall time
+    class persistence_profile {
+    public:
+
+        enum phase : size_t {
+            header,
+            snapshot,       // taking copy-on-write snapshots of the domains
+            base_snapshot,  // reading the base snapshot of a delta
+            compression,    // LZ4 compression or decompression
+            stream,         // writing to or reading from the co-save record
+            forms,          // the string and form tables. Loading resolves the forms here
+            registry,       // the object table, loading registers the objects here
+            aqueue,         // the free identifiers and the autorelease queue
+            contents,       // the contents of the objects, see the types
+            post_load,      // attaching the loaded objects to the contexts and the post-load fixes
+            garbage_collection,
+            phase_count
+        };
+
+        enum : size_t { type_count = CollectionType::Set + 1 };
+
+        struct domain_stats {
+            std::string name;
+            uint64_t objects;
+            uint64_t bytes;
+            uint64_t nanoseconds;
+            bool encoded;
+        };
+
+        explicit persistence_profile(const char *operation) : _operation(operation) {}
+
+        const std::string& operation() const { return _operation; }
+
+        void add_time(phase ph, std::chrono::steady_clock::duration time) {
+            _phases[ph].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count(), std::memory_order_relaxed);
+        }
+
+        void add_type(uint8_t type, uint64_t objects, uint64_t bytes, std::chrono::steady_clock::duration time) {
+            if (type < type_count) {
+                auto& stats = _types[type];
+                stats.objects.fetch_add(objects, std::memory_order_relaxed);
+                stats.bytes.fetch_add(bytes, std::memory_order_relaxed);
+                stats.nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count(), std::memory_order_relaxed);
+            }
+        }
+
+        // a domain written or read: the default one has no name. An encoded one is kept as it is, not decoded or written
+        void add_domain(std::string name, uint64_t objects, uint64_t bytes, std::chrono::steady_clock::duration time, bool encoded = false) {
+            std::lock_guard<std::mutex> g(_domainsMutex);
+            _domains.push_back({ std::move(name), objects, bytes,
+                static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count()), encoded });
+        }
+
+        // Discards the object and the byte counts of a payload which has been written, but not used: the time spent stays
+        void discard_counts() {
+            for (auto& stats : _types) {
+                stats.objects.store(0, std::memory_order_relaxed);
+                stats.bytes.store(0, std::memory_order_relaxed);
+            }
+            std::lock_guard<std::mutex> g(_domainsMutex);
+            _domains.clear();
+        }
+
+        // the objects the garbage collection has found unreachable after loading
+        void add_garbage(uint64_t objects) {
+            _garbageObjects.fetch_add(objects, std::memory_order_relaxed);
+        }
+
+        uint64_t garbage_objects() const { return _garbageObjects.load(std::memory_order_relaxed); }
+
+        // the size of the data as it is in the co-save, the size before the compression
+        void set_sizes(uint64_t stored, uint64_t payload) {
+            _storedBytes = stored;
+            _payloadBytes = payload;
+        }
+
+        void set_wall_time(std::chrono::steady_clock::duration time) {
+            _wallNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+        }
+
+        std::vector<domain_stats> domains() const {
+            std::lock_guard<std::mutex> g(_domainsMutex);
+            return _domains;
+        }
+
+        uint64_t type_objects(uint8_t type) const { return _types[type].objects.load(std::memory_order_relaxed); }
+        uint64_t type_bytes(uint8_t type) const { return _types[type].bytes.load(std::memory_order_relaxed); }
+
+        static const char *phase_name(phase ph) {
+            static const char *names[phase_count] = { "header", "snapshot", "baseSnapshot", "compression", "stream", "forms",
+                "registry", "aqueue", "contents", "postLoad", "garbageCollection" };
+            return names[ph];
+        }
+
+        static const char *type_name(uint8_t type) {
+            static const char *names[type_count] = { "none", "JArray", "JMap", "JFormMap", "JIntMap", "JIntArray", "JFltArray", "JSet" };
+            return type < type_count ? names[type] : "unknown";
+        }
+
+        // {"operation", "wallMs", "storedBytes", "payloadBytes", "garbageObjects", "phasesMs": {phase: ms},
+        //  "types": {type: {"objects", "bytes", "ms"}}, "domains": [{"name", "objects", "bytes", "ms", "encoded"}]}
+        json_t *to_json() const {
+            auto ms = [](uint64_t nanoseconds) { return json_real(nanoseconds / 1e6); };
+
+            json_t *profile = json_object();
+            json_object_set_new(profile, "operation", json_string(_operation.c_str()));
+            json_object_set_new(profile, "wallMs", ms(_wallNanoseconds));
+            json_object_set_new(profile, "storedBytes", json_integer(static_cast<json_int_t>(_storedBytes)));
+            json_object_set_new(profile, "payloadBytes", json_integer(static_cast<json_int_t>(_payloadBytes)));
+            json_object_set_new(profile, "garbageObjects", json_integer(static_cast<json_int_t>(garbage_objects())));
+
+            json_t *phases = json_object();
+            for (size_t ph = 0; ph < phase_count; ++ph) {
+                uint64_t time = _phases[ph].load(std::memory_order_relaxed);
+                if (ph == contents) {
+                    for (auto& stats : _types) {
+                        time += stats.nanoseconds.load(std::memory_order_relaxed);
+                    }
+                }
+                json_object_set_new(phases, phase_name(static_cast<phase>(ph)), ms(time));
+            }
+            json_object_set_new(profile, "phasesMs", phases);
+
+            json_t *types = json_object();
+            for (uint8_t type = 1; type < type_count; ++type) {
+                const auto& stats = _types[type];
+                json_t *entry = json_object();
+                json_object_set_new(entry, "objects", json_integer(static_cast<json_int_t>(stats.objects.load(std::memory_order_relaxed))));
+                json_object_set_new(entry, "bytes", json_integer(static_cast<json_int_t>(stats.bytes.load(std::memory_order_relaxed))));
+                json_object_set_new(entry, "ms", ms(stats.nanoseconds.load(std::memory_order_relaxed)));
+                json_object_set_new(types, type_name(type), entry);
+            }
+            json_object_set_new(profile, "types", types);
+
+            json_t *domains = json_array();
+            std::lock_guard<std::mutex> g(_domainsMutex);
+            for (auto& domain : _domains) {
+                json_t *entry = json_object();
+                json_object_set_new(entry, "name", json_string(domain.name.c_str()));
+                json_object_set_new(entry, "objects", json_integer(static_cast<json_int_t>(domain.objects)));
+                json_object_set_new(entry, "bytes", json_integer(static_cast<json_int_t>(domain.bytes)));
+                json_object_set_new(entry, "ms", ms(domain.nanoseconds));
+                json_object_set_new(entry, "encoded", json_boolean(domain.encoded));
+                json_array_append_new(domains, entry);
+            }
+            json_object_set_new(profile, "domains", domains);
+            return profile;
+        }
+
+        //////////////////////////////////////////////////////////////////////////
+
+        // the profile being collected, null if none
+        static persistence_profile *current() {
+            return current_slot().load(std::memory_order_acquire);
+        }
+
+        // The profile gets collected while the scope lives, then it becomes the last one of its operation
+        class scope {
+            std::shared_ptr<persistence_profile> _profile;
+            std::chrono::steady_clock::time_point _started = std::chrono::steady_clock::now();
+        public:
+            explicit scope(std::shared_ptr<persistence_profile> profile) : _profile(std::move(profile)) {
+                current_slot().store(_profile.get(), std::memory_order_release);
+            }
+            ~scope() {
+                current_slot().store(nullptr, std::memory_order_release);
+                _profile->set_wall_time(std::chrono::steady_clock::now() - _started);
+                std::lock_guard<std::mutex> g(last_mutex());
+                (_profile->operation() == "save" ? last_save() : last_load()) = std::move(_profile);
+            }
+            scope(const scope&) = delete;
+            scope& operator = (const scope&) = delete;
+        };
+
+        // Measures a phase while alive, unless stopped. No-op if no profile is being collected
+        class timer {
+            persistence_profile *_profile = current();
+            phase _phase;
+            bool _running = false;
+            std::chrono::steady_clock::time_point _started;
+        public:
+            explicit timer(phase ph) : _phase(ph) {
+                start();
+            }
+            ~timer() {
+                stop();
+            }
+
+            void start() {
+                if (_profile && !_running) {
+                    _started = std::chrono::steady_clock::now();
+                    _running = true;
+                }
+            }
+
+            void stop() {
+                if (_running) {
+                    _profile->add_time(_phase, std::chrono::steady_clock::now() - _started);
+                    _running = false;
+                }
+            }
+            timer(const timer&) = delete;
+            timer& operator = (const timer&) = delete;
+        };
+
+        // Measures the contents of adjacent objects, which are grouped by type: next() goes before each object,
+        // add_bytes() after it. The counts are reported on destruction. No-op if no profile is being collected
+        class type_meter {
+            persistence_profile *_profile = current();
+            uint8_t _type = CollectionType::None;
+            std::chrono::steady_clock::time_point _started;
+            uint64_t _objects = 0;
+            uint64_t _bytes = 0;
+
+            void report(std::chrono::steady_clock::time_point now) {
+                if (_objects > 0) {
+                    _profile->add_type(_type, _objects, _bytes, now - _started);
+                }
+                _started = now;
+                _objects = 0;
+                _bytes = 0;
+            }
+
+        public:
+            type_meter() = default;
+            ~type_meter() {
+                if (_profile) {
+                    report(std::chrono::steady_clock::now());
+                }
+            }
+            type_meter(const type_meter&) = delete;
+            type_meter& operator = (const type_meter&) = delete;
+
+            void next(uint8_t type) {
+                if (_profile) {
+                    if (type != _type || _objects == 0) {
+                        report(std::chrono::steady_clock::now());
+                        _type = type;
+                    }
+                    ++_objects;
+                }
+            }
+
+            void add_bytes(size_t bytes) {
+                _bytes += bytes;
+            }
+        };
+
+        // the last profile of the operation, "save" or "load". Null if none yet
+        static std::shared_ptr<persistence_profile> last(const std::string& operation) {
+            std::lock_guard<std::mutex> g(last_mutex());
+            return operation == "save" ? last_save() : last_load();
+        }
+
+        // {"save": the last save's profile, "load": the last load's one}, a profile is null until collected
+        static json_t *last_to_json() {
+            std::lock_guard<std::mutex> g(last_mutex());
+            json_t *profiles = json_object();
+            json_object_set_new(profiles, "save", last_save() ? last_save()->to_json() : json_null());
+            json_object_set_new(profiles, "load", last_load() ? last_load()->to_json() : json_null());
+            return profiles;
+        }
+
+    private:
+
+        struct type_stats {
+            std::atomic<uint64_t> objects{ 0 };
+            std::atomic<uint64_t> bytes{ 0 };
+            std::atomic<uint64_t> nanoseconds{ 0 };
+        };
+
+        std::string _operation;
+        uint64_t _wallNanoseconds = 0;
+        uint64_t _storedBytes = 0;
+        uint64_t _payloadBytes = 0;
+        std::atomic<uint64_t> _garbageObjects{ 0 };
+        std::atomic<uint64_t> _phases[phase_count] = {};
+        type_stats _types[type_count];
+        mutable std::mutex _domainsMutex;
+        std::vector<domain_stats> _domains;
+
+        static std::atomic<persistence_profile*>& current_slot() {
+            static std::atomic<persistence_profile*> profile{ nullptr };
+            return profile;
+        }
+
+        static std::mutex& last_mutex() {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        static std::shared_ptr<persistence_profile>& last_save() {
+            static std::shared_ptr<persistence_profile> profile;
+            return profile;
+        }
+
+        static std::shared_ptr<persistence_profile>& last_load() {
+            static std::shared_ptr<persistence_profile> profile;
+            return profile;
+        }
+    };
+}
@@ -480,6 +480,1509 @@ namespace collections { namespace {
         validateGraph(root2);
     }
 
+    JC_TEST(json_handling, streaming_reader_matches_jansson_reader)
+    {
+        const char *documents[] = {
+            STR({ "b": [1, 2.5, true, null, "str", "__formData|D|0x4", -12, 1e10], "a": { "__metaInfo": { "typeName": "JFormMap" }, "__formData|D|0x4": 1 } }),
+            STR({ "x": 1, "__metaInfo": { "typeName": "JIntMap" }, "0x10": [2], "7": { "r": "__reference|" } }),
+            STR({ "__values": [3, 1.5, "no", { "a": [] }], "__metaInfo": { "typeName": "JFltArray" } }),
+            STR({ "__metaInfo": { "typeName": "JSet" }, "__values": [1, 1, "a", "A", { "k": "__reference|" }] }),
+            STR([{ "__metaInfo": { "typeName": "Unknown" }, "a": [1] }, { "r": "__reference|[2]" }, []]),
+            STR({ "__formData": null, "__formData|D|0x4": [] }),
+            STR({ "escaped": "a\"b\\c\u00e9\ud83d\ude00\n" }),
+        };
+
+        for (auto doc : documents) {
+            auto viaStream = json_deserializer::object_from_json_text(context, doc, doc + strlen(doc));
+            auto viaJansson = json_deserializer::object_from_json(context, json_deserializer::json_from_data(doc).get());
+
+            EXPECT_TRUE(viaStream.is_initialized());
+            EXPECT_NOT_NIL(viaJansson);
+            if (viaStream.is_initialized() && *viaStream && viaJansson) {
+                auto streamJson = json_serializer::create_json_value(**viaStream);
+                auto janssonJson = json_serializer::create_json_value(*viaJansson);
+                EXPECT_TRUE(json_equal(streamJson.get(), janssonJson.get()) == 1);
+            }
+        }
+
+        const char *malformed[] = { "", "[1,]", "{\"a\" 1}", "[1] 2", "\"root\"", "[\"\\u0000\"]", "[99999999999999999999]" };
+        for (auto doc : malformed) {
+            EXPECT_FALSE(json_deserializer::object_from_json_text(context, doc, doc + strlen(doc)).is_initialized());
+            EXPECT_NIL(json_deserializer::object_from_json_data(context, doc));
+        }
+    }
+
+    namespace {
+        // compares time and peak memory usage of reading a @megabytes sized file with and without jansson DOM
+        void json_reading_perft(size_t megabytes) {
+            namespace fs = boost::filesystem;
+
+            const auto path = (fs::temp_directory_path() / "jc_json_reading_perft.json").generic_string();
+            {
+                std::string text = "[";
+                for (int i = 0; text.size() < megabytes * 1024 * 1024; ++i) {
+                    text += (i ? ",\n" : "\n");
+                    text += "{\"name\": \"item" + std::to_string(i) + "\", \"level\": " + std::to_string(i % 100)
+                        + ", \"weight\": " + std::to_string(i * 0.25) + ", \"tags\": [\"a\", \"b\", " + std::to_string(i) + "]"
+                        + ", \"self\": \"__reference|[" + std::to_string(i) + "]\"}";
+                }
+                text += "\n]";
+
+                auto file = make_unique_file(fopen(path.c_str(), "wb"));
+                ASSERT_TRUE(file && fwrite(text.data(), 1, text.size(), file.get()) == text.size());
+            }
+
+            // the peak only grows, so the streaming reader goes first and its growth is its own peak
+            auto measure = [&](const char *name, const std::function<object_base* (tes_context&)>& read) {
+                tes_context_standalone ctx;
+                const size_t peakBefore = util::peak_memory_usage();
+                object_base *root = nullptr;
+                util::do_with_timing(name, [&]() { root = read(ctx); });
+                EXPECT_NOT_NIL(root);
+                JC_log("%s: peak working set grew by %u KB", name, (uint32_t)((util::peak_memory_usage() - peakBefore) / 1024));
+            };
+
+            measure("streaming JSON reader", [&](tes_context& ctx) {
+                return json_deserializer::object_from_file(ctx, path.c_str());
+            });
+            measure("jansson DOM JSON reader", [&](tes_context& ctx) {
+                return json_deserializer::object_from_json(ctx, json_deserializer::json_from_file(path.c_str()).get());
+            });
+
+            fs::remove(path);
+        }
+    }
+
+    TEST(json_handling, streaming_reader_perft_10mb) {
+        json_reading_perft(10);
+    }
+
+    TEST(json_handling, DISABLED_streaming_reader_perft_100mb) {
+        json_reading_perft(100);
+    }
+
+    JC_TEST(json_handling, structural_index_matches_jansson_reader)
+    {
+        namespace fs = boost::filesystem;
+        using isa = json_structural_index::instruction_set;
+
+        std::vector<std::string> texts = {
+            // escapes and strings crossing 64-byte blocks
+            "[ \"0123456789012345678901234567890123456789012345678901234567\\\"\\\\\", \"\\\\\\\"{[:,\", { \"k\\u00e9y\": \"\xc3\xa9\" } ]",
+            std::string("[") + std::string(200, ' ') + "1,true,  null ,\"" + std::string(100, '\\') + "\"]",
+        };
+
+        const char *dirs[] = { "test_data/json_loading_test", "test_data/path_resolving", "test_data/tes_string" };
+        for (auto dir : dirs) {
+            for (fs::directory_iterator itr(util::relative_to_dll_path(dir)), end; itr != end; ++itr) {
+                std::string text;
+                auto file = make_unique_file(fopen(itr->path().generic_string().c_str(), "rb"));
+                char buffer[1024];
+                size_t count = 0;
+                while (file && (count = fread(buffer, 1, sizeof buffer, file.get())) > 0) {
+                    text.append(buffer, count);
+                }
+                texts.push_back(text);
+            }
+        }
+        EXPECT_TRUE(texts.size() > 2);
+
+        for (auto& text : texts) {
+            auto viaJansson = json_deserializer::object_from_json(context, json_deserializer::json_from_data(text.c_str()).get());
+            ASSERT_TRUE(viaJansson != nullptr);
+            auto expected = json_serializer::create_json_value(*viaJansson);
+
+            for (int i = (int)isa::scalar; i <= (int)json_structural_index::best_instruction_set(); ++i) {
+                json_structural_index index;
+                EXPECT_TRUE(index.build(text.data(), text.data() + text.size(), (isa)i));
+
+                auto viaIndex = json_deserializer::object_from_json_text(context, text.data(), text.data() + text.size(), index);
+                EXPECT_TRUE(viaIndex.is_initialized() && *viaIndex);
+                if (viaIndex.is_initialized() && *viaIndex) {
+                    EXPECT_TRUE(json_equal(expected.get(), json_serializer::create_json_value(**viaIndex).get()) == 1);
+                }
+            }
+        }
+
+        // stage one rejects unterminated strings and raw control characters, stage two - the rest
+        const char *malformed[] = { "[\"abc]", "[\"a\tb\"]", "[1x]", "[truex]", "[\"a\"1]", "[1,]", "[1] 2", "[\"\\\"]" };
+        for (auto doc : malformed) {
+            json_structural_index index;
+            EXPECT_FALSE(index.build(doc, doc + strlen(doc))
+                && json_deserializer::object_from_json_text(context, doc, doc + strlen(doc), index).is_initialized());
+        }
+
+        const auto previous = json_deserializer::reading_backend();
+        json_deserializer::set_reading_backend(json_reading_backend::structural_index);
+        EXPECT_NOT_NIL(json_deserializer::object_from_json_data(context, texts.front().c_str()));
+        EXPECT_NIL(json_deserializer::object_from_json_data(context, "[1,]"));
+        json_deserializer::set_reading_backend(previous);
+    }
+
+    // reads the same ~20 MB file with each backend
+    TEST(json_handling, reading_backends_perft)
+    {
+        namespace fs = boost::filesystem;
+
+        const auto path = (fs::temp_directory_path() / "jc_reading_backends_perft.json").generic_string();
+        {
+            std::string text = "[";
+            for (int i = 0; text.size() < 20 * 1024 * 1024; ++i) {
+                text += (i ? ",\n  " : "\n  ");
+                text += "{\n    \"name\": \"item" + std::to_string(i) + " with a longer description\",\n    \"level\": " + std::to_string(i % 100)
+                    + ",\n    \"weight\": " + std::to_string(i * 0.25) + ",\n    \"tags\": [\n      \"a\",\n      " + std::to_string(i) + "\n    ]\n  }";
+            }
+            text += "\n]";
+
+            auto file = make_unique_file(fopen(path.c_str(), "wb"));
+            ASSERT_TRUE(file && fwrite(text.data(), 1, text.size(), file.get()) == text.size());
+        }
+
+        const std::pair<json_reading_backend, const char *> backends[] = {
+            { json_reading_backend::jansson, "jansson backend" },
+            { json_reading_backend::pull_parser, "pull parser backend" },
+            { json_reading_backend::structural_index, "structural index backend" },
+        };
+
+        const auto previous = json_deserializer::reading_backend();
+        for (auto& backend : backends) {
+            json_deserializer::set_reading_backend(backend.first);
+            tes_context_standalone ctx;
+            util::do_with_timing(backend.second, [&]() {
+                EXPECT_NOT_NIL(json_deserializer::object_from_file(ctx, path.c_str()));
+            });
+        }
+        json_deserializer::set_reading_backend(previous);
+
+        fs::remove(path);
+    }
+
+    JC_TEST(json_serializer, text_writer_matches_jansson)
+    {
+        object_base *root = json_deserializer::object_from_json_data(context, STR({
+            "array": [1, -2.5, 1e20, "str", null, "__formData|D|0x4", [], {}],
+            "formMap": { "__metaInfo": { "typeName": "JFormMap" }, "__formData|D|0x4": { "inner": [0.1] } },
+            "intMap": { "__metaInfo": { "typeName": "JIntMap" }, "-3": "minus three", "10": [] },
+            "ints": { "__metaInfo": { "typeName": "JIntArray" }, "__values": [1, 2, 3] },
+            "flts": { "__metaInfo": { "typeName": "JFltArray" }, "__values": [0.5, -1] },
+            "set": { "__metaInfo": { "typeName": "JSet" }, "__values": [1, "a", { "k": "v" }] },
+            "refs": ["__reference|.array", "__reference|.set", "__reference|"]
+        }));
+        ASSERT_TRUE(root && root->as<map>());
+        map& rootMap = *root->as<map>();
+
+        // shared objects are written once, at the first place found breadth-first
+        map& shared = map::object(context);
+        array& twice = array::object(context);
+        twice.u_push(item(shared));
+        twice.u_push(item(shared));
+        shared.u_set("back", item(twice));
+        rootMap.u_set("twice", item(twice));
+        rootMap.u_set("shared", item(shared));
+
+        // escaping; values jansson rejects are omitted
+        rootMap.u_set("escapes", item("\"quoted\"\t\x01\x7f / \xc3\xa9 \xf0\x9f\x98\x80"));
+        rootMap.u_set("invalidUtf8", item("\xff"));
+        float_array& flts = float_array::object(context);
+        flts.u_push(0.25f);
+        flts.u_push(std::numeric_limits<float>::quiet_NaN());
+        flts.u_push(std::numeric_limits<float>::infinity());
+        rootMap.u_set("nonFinite", item(flts));
+
+        const size_t flagsList[] = { JSON_INDENT(2), 0, JSON_COMPACT, JSON_INDENT(4) | JSON_ENSURE_ASCII | JSON_ESCAPE_SLASH };
+        auto jvalue = json_serializer::create_json_value(*root);
+        for (auto flags : flagsList) {
+            auto expected = make_unique_ptr(json_dumps(jvalue.get(), flags), free);
+
+            json_text_output output;
+            EXPECT_TRUE(json_serializer::write_json(*root, output, flags));
+            EXPECT_EQ(std::string(expected.get()), output.text());
+        }
+
+        auto data = json_serializer::create_json_data(shared);
+        EXPECT_EQ(std::string(make_unique_ptr(json_dumps(json_serializer::create_json_value(shared).get(), JSON_INDENT(2)), free).get()),
+            std::string(data.get()));
+    }
+
+    JC_TEST(json_serializer, text_writer_file_matches_jansson)
+    {
+        namespace fs = boost::filesystem;
+
+        object_base *root = json_deserializer::object_from_json_data(context, STR({
+            "a": [1, 2.5, "three", { "nested": "__reference|.a" }],
+            "b": { "__metaInfo": { "typeName": "JIntMap" }, "1": "__reference|.a[3]" }
+        }));
+        ASSERT_TRUE(root != nullptr);
+
+        auto read_all = [](const std::string& path) {
+            std::string text;
+            auto file = make_unique_file(fopen(path.c_str(), "rb"));
+            char buffer[1024];
+            size_t count = 0;
+            while (file && (count = fread(buffer, 1, sizeof buffer, file.get())) > 0) {
+                text.append(buffer, count);
+            }
+            return text;
+        };
+
+        const auto streamed = (fs::temp_directory_path() / "jc_text_writer_streamed.json").generic_string();
+        const auto dumped = (fs::temp_directory_path() / "jc_text_writer_dumped.json").generic_string();
+
+        EXPECT_TRUE(json_serializer::write_json_file(*root, streamed.c_str(), JSON_INDENT(2)));
+        json_dump_file(json_serializer::create_json_value(*root).get(), dumped.c_str(), JSON_INDENT(2));
+        EXPECT_EQ(read_all(dumped), read_all(streamed));
+
+        fs::remove(streamed);
+        fs::remove(dumped);
+    }
+
+    // Another thread keeps replacing the children while the graph gets written: each child is met once,
+    // so that whatever the text has caught, it has no references - a child never becomes the reference to the root
+    JC_TEST(json_serializer, text_writer_while_modified)
+    {
+        map& root = map::object(context);
+        for (int32_t i = 0; i < 100; ++i) {
+            root.set(std::to_string(i), item(array::object(context)));
+        }
+
+        std::atomic_bool done{ false };
+        std::thread modifier([&]() {
+            for (int32_t i = 0; i < 20000; ++i) {
+                map& child = map::object(context);
+                child.set("value", item(i));
+                root.set(std::to_string(i % 100), item(child));
+            }
+            done = true;
+        });
+
+        do {
+            json_text_output output;
+            EXPECT_TRUE(json_serializer::write_json(root, output, JSON_COMPACT));
+            EXPECT_EQ(std::string::npos, output.text().find("__reference|"));
+
+            const std::string data = json_serializer::create_cbor_data(root);
+            object_base *restored = json_deserializer::object_from_cbor(context, data.data(), data.data() + data.size());
+            EXPECT_TRUE(restored && restored->as<map>());
+            if (restored && restored->as<map>()) {
+                EXPECT_EQ(100, restored->s_count());
+                for (auto& pair : restored->as<map>()->container_copy()) {
+                    EXPECT_TRUE(pair.second.object() && pair.second.object() != restored);
+                }
+            }
+        } while (!done);
+        modifier.join();
+    }
+
+    // dumps a graph of 500k objects into a file with and without building jansson values
+    TEST(json_serializer, text_writer_perft)
+    {
+        namespace fs = boost::filesystem;
+
+        tes_context_standalone ctx;
+        array& root = array::object(ctx);
+        map& shared = map::object(ctx);
+        shared.u_set("name", item("shared"));
+
+        const int objectCount = 500000;
+        for (int i = 0; i < objectCount / 2; ++i) {
+            map& entry = map::object(ctx);
+            entry.u_set("name", item("entry" + std::to_string(i)));
+            entry.u_set("level", item(i % 100));
+            entry.u_set("weight", item(i * 0.25f));
+            entry.u_set("shared", item(shared));
+
+            array& tags = array::object(ctx);
+            tags.u_push(item("a"));
+            tags.u_push(item(i));
+            entry.u_set("tags", item(tags));
+
+            root.u_push(item(entry));
+        }
+
+        const auto streamed = (fs::temp_directory_path() / "jc_text_writer_perft_streamed.json").generic_string();
+        const auto dumped = (fs::temp_directory_path() / "jc_text_writer_perft_dumped.json").generic_string();
+
+        // the peak only grows, so the streaming writer goes first and its growth is its own peak
+        size_t peakBefore = util::peak_memory_usage();
+        util::do_with_timing("streaming JSON writer", [&]() {
+            json_serializer::write_json_file(root, streamed.c_str(), JSON_INDENT(2));
+        });
+        JC_log("streaming JSON writer: peak working set grew by %u KB", (uint32_t)((util::peak_memory_usage() - peakBefore) / 1024));
+
+        peakBefore = util::peak_memory_usage();
+        util::do_with_timing("jansson JSON writer", [&]() {
+            json_dump_file(json_serializer::create_json_value(root).get(), dumped.c_str(), JSON_INDENT(2));
+        });
+        JC_log("jansson JSON writer: peak working set grew by %u KB", (uint32_t)((util::peak_memory_usage() - peakBefore) / 1024));
+
+        EXPECT_EQ(fs::file_size(dumped), fs::file_size(streamed));
+
+        fs::remove(streamed);
+        fs::remove(dumped);
+    }
+
+    TEST(flat_pointer_map, insert_find_clear)
+    {
+        std::vector<int> values(10000);
+        util::flat_pointer_map<const int*, std::string> pointerMap;
+        util::flat_pointer_set<const int*> pointerSet;
+
+        for (int pass = 0; pass < 2; ++pass) {
+            for (size_t i = 0; i < values.size(); i += 3) {
+                EXPECT_TRUE(pointerMap.emplace(&values[i], std::to_string(i)).second);
+                EXPECT_TRUE(pointerSet.insert(&values[i]));
+            }
+            EXPECT_FALSE(pointerMap.emplace(&values[0], std::string("other")).second);
+            EXPECT_FALSE(pointerSet.insert(&values[0]));
+            EXPECT_EQ((values.size() + 2) / 3, pointerMap.size());
+
+            for (size_t i = 0; i < values.size(); ++i) {
+                auto found = pointerMap.find(&values[i]);
+                EXPECT_EQ(i % 3 == 0, found != nullptr);
+                EXPECT_EQ(i % 3 == 0, pointerSet.contains(&values[i]));
+                if (found) {
+                    EXPECT_EQ(std::to_string(i), *found);
+                }
+            }
+
+            const size_t capacity = pointerMap.capacity();
+            pointerMap.clear();
+            pointerSet.clear();
+            EXPECT_TRUE(pointerMap.size() == 0);
+            EXPECT_EQ(capacity, pointerMap.capacity());
+            EXPECT_TRUE(pointerMap.find(&values[0]) == nullptr);
+        }
+    }
+
+    TEST(json_serializer, shared_references_perft)
+    {
+        tes_context_standalone ctx;
+        array& root = array::object(ctx);
+
+        // deeply nested shared objects, so that each reference path is long
+        array& pool = array::object(ctx);
+        root.u_push(item(pool));
+        std::vector<object_base*> shared;
+        for (int i = 0; i < 1000; ++i) {
+            map *level = &map::object(ctx);
+            pool.u_push(item(level));
+            for (int depth = 0; depth < 8; ++depth) {
+                map& next = map::object(ctx);
+                level->u_set("level" + std::to_string(depth), item(next));
+                level = &next;
+            }
+            shared.push_back(level);
+        }
+
+        const int entryCount = 200000;
+        for (int i = 0; i < entryCount; ++i) {
+            map& entry = map::object(ctx);
+            entry.u_set("first", item(shared[i % shared.size()]));
+            entry.u_set("second", item(shared[(i * 7) % shared.size()]));
+            entry.u_set("index", item(i));
+            root.u_push(item(entry));
+        }
+
+        std::string text;
+        for (int run = 0; run < 2; ++run) {
+            json_text_output output;
+            // the second run reuses the identity tables of the first one
+            util::do_with_timing(run ? "text writer, shared references, warm tables" : "text writer, shared references", [&]() {
+                json_serializer::write_json(root, output, JSON_INDENT(2));
+            });
+            text = std::move(output.text());
+        }
+        util::do_with_timing("jansson values, shared references", [&]() {
+            json_serializer::create_json_value(root);
+        });
+
+        auto restored = json_deserializer::object_from_json_data(ctx, text.c_str());
+        ASSERT_TRUE(restored != nullptr);
+        auto entry = restored->as<array>()->u_get(1)->object();
+        auto shared0 = restored->as<array>()->u_get(0)->object()->as<array>()->u_get(0)->object();
+        ASSERT_TRUE(entry && shared0);
+        for (int depth = 0; depth < 8; ++depth) {
+            shared0 = shared0->as<map>()->u_get(std::string("level") + std::to_string(depth))->object();
+        }
+        EXPECT_EQ(shared0, entry->as<map>()->u_get(std::string("first"))->object());
+    }
+
+    JC_TEST(cbor, round_trip_matches_json)
+    {
+        object_base *root = json_deserializer::object_from_json_data(context, STR({
+            "array": [1, -2.5, 1e20, "str", null, "__formData|D|0x4", [], {}],
+            "formMap": { "__metaInfo": { "typeName": "JFormMap" }, "__formData|D|0x4": { "inner": [0.1] }, "__formData||0x123": 2 },
+            "intMap": { "__metaInfo": { "typeName": "JIntMap" }, "-3": "minus three", "10": [], "2147483647": 1 },
+            "ints": { "__metaInfo": { "typeName": "JIntArray" }, "__values": [1, -2147483648, 3] },
+            "flts": { "__metaInfo": { "typeName": "JFltArray" }, "__values": [0.5, -1] },
+            "set": { "__metaInfo": { "typeName": "JSet" }, "__values": [1, "a", { "k": "v" }, "__reference|.array"] },
+            "refs": ["__reference|.array", "__reference|.set", "__reference|", "__reference|.formMap[__formData|D|0x4]"],
+            "notRef": "__just a string"
+        }));
+        ASSERT_TRUE(root && root->as<map>());
+        map& rootMap = *root->as<map>();
+
+        // shared and cyclic references
+        map& shared = map::object(context);
+        array& twice = array::object(context);
+        twice.u_push(item(shared));
+        twice.u_push(item(shared));
+        shared.u_set("back", item(twice));
+        rootMap.u_set("twice", item(twice));
+        rootMap.u_set("shared", item(shared));
+
+        // the values JSON can't keep
+        rootMap.u_set("invalidUtf8", item("\xff\xfe"));
+        float_array& flts = float_array::object(context);
+        flts.u_push(std::numeric_limits<float>::quiet_NaN());
+        flts.u_push(std::numeric_limits<float>::infinity());
+        rootMap.u_set("nonFinite", item(flts));
+        rootMap.u_set("form", item(make_weak_form_id((FormId)('A' << 24 | 0x14), context)));
+
+        const std::string data = json_serializer::create_cbor_data(*root);
+        EXPECT_TRUE(cbor::starts_with_magic(data.data(), data.data() + data.size()));
+
+        object_base *restored = json_deserializer::object_from_cbor(context, data.data(), data.data() + data.size());
+        ASSERT_TRUE(restored && restored->as<map>());
+        EXPECT_EQ(std::string(json_serializer::create_json_data(*root).get()), std::string(json_serializer::create_json_data(*restored).get()));
+
+        map& restoredMap = *restored->as<map>();
+        EXPECT_EQ(std::string("\xff\xfe"), restoredMap.u_get(std::string("invalidUtf8"))->strValue());
+        auto restoredFlts = restoredMap.u_get(std::string("nonFinite"))->object()->as<float_array>();
+        ASSERT_TRUE(restoredFlts != nullptr);
+        EXPECT_TRUE(std::isnan(restoredFlts->u_container()[0]));
+        EXPECT_TRUE(std::isinf(restoredFlts->u_container()[1]));
+        EXPECT_TRUE((FormId)('A' << 24 | 0x14) == restoredMap.u_get(std::string("form"))->formId());
+
+        auto restoredTwice = restoredMap.u_get(std::string("twice"))->object();
+        auto restoredShared = restoredMap.u_get(std::string("shared"))->object();
+        ASSERT_TRUE(restoredTwice && restoredShared);
+        EXPECT_EQ(restoredShared, restoredTwice->as<array>()->u_get(0)->object());
+        EXPECT_EQ(restoredShared, restoredTwice->as<array>()->u_get(1)->object());
+        EXPECT_EQ(restoredTwice, restoredShared->as<map>()->u_get(std::string("back"))->object());
+        EXPECT_EQ(restored, restoredMap.u_get(std::string("refs"))->object()->as<array>()->u_get(2)->object());
+
+        // the whole file
+        namespace fs = boost::filesystem;
+        const auto path = (fs::temp_directory_path() / "jc_cbor_round_trip.jcb").generic_string();
+        EXPECT_TRUE(json_serializer::write_cbor_file(*root, path.c_str()));
+        EXPECT_EQ(data.size(), fs::file_size(path));
+        object_base *fromFile = json_deserializer::object_from_cbor_file(context, path.c_str());
+        ASSERT_TRUE(fromFile != nullptr);
+        EXPECT_EQ(data, json_serializer::create_cbor_data(*fromFile));
+        fs::remove(path);
+    }
+
+    JC_TEST(cbor, malformed_data)
+    {
+        object_base *root = json_deserializer::object_from_json_data(context, STR({
+            "a": [1, 2.5, "three", "__formData|D|0x4", { "nested": "__reference|.a" }],
+            "b": { "__metaInfo": { "typeName": "JIntMap" }, "1": "__reference|.a[4]" }
+        }));
+        ASSERT_TRUE(root != nullptr);
+        const std::string data = json_serializer::create_cbor_data(*root);
+
+        // every truncation is rejected
+        for (size_t length = 0; length < data.size(); ++length) {
+            EXPECT_NIL(json_deserializer::object_from_cbor(context, data.data(), data.data() + length));
+        }
+
+        const std::string trailing = data + '\0';
+        EXPECT_NIL(json_deserializer::object_from_cbor(context, trailing.data(), trailing.data() + trailing.size()));
+
+        const char *documents[] = {
+            "\xff",                    // break outside of a container
+            "\x1c",                    // reserved additional info
+            "\x9b\xff\xff\xff\xff\xff\xff\xff\xff", // huge array
+            "\x81\x3b\xff\xff\xff\xff\xff\xff\xff\xff", // negative integer out of the int64_t range
+            "\x81\x1b\xff\xff\xff\xff\xff\xff\xff\xff", // unsigned one
+            "\x7a\xff\xff\xff\xff",       // huge string
+            "\x81\x5f\x61\x61\xff",      // text chunk in a byte string
+            "\x01",                    // not a container
+        };
+        for (auto doc : documents) {
+            EXPECT_NIL(json_deserializer::object_from_cbor(context, doc, doc + strlen(doc)));
+        }
+        EXPECT_NIL(json_deserializer::object_from_cbor_file(context, ""));
+        EXPECT_NIL(json_deserializer::object_from_cbor_file(context, nullptr));
+
+        // too deep nesting is rejected before anything gets built: arrays and tags nest
+        auto nested = [](char head, size_t depth) {
+            return std::string(depth, head) + "\x80";
+        };
+        for (const std::string& doc : { nested('\x81', cbor_reader::max_depth + 1), nested('\xc6', cbor_reader::max_depth + 1),
+                                        nested('\x81', 1000000) }) {
+            EXPECT_NIL(json_deserializer::object_from_cbor(context, doc.data(), doc.data() + doc.size()));
+        }
+        const std::string deep = nested('\x81', 64);
+        EXPECT_NOT_NIL(json_deserializer::object_from_cbor(context, deep.data(), deep.data() + deep.size()));
+
+        // unknown tags are ignored, the values of unexpected types are read the way they would be read in JSON
+        const char tolerated[] = "\xbf\x61\x61\xd8\x20\x01\x01\x02\xff";
+        object_base *read = json_deserializer::object_from_cbor(context, tolerated, tolerated + sizeof tolerated - 1);
+        ASSERT_TRUE(read && read->as<map>());
+        EXPECT_EQ(1, read->as<map>()->u_count());
+        EXPECT_EQ(1, read->as<map>()->u_get(std::string("a"))->intValue());
+
+        // the reals out of the range of what's stored saturate: [1e300, -1e300, JIntArray [1e300, -1e300]]
+        const char saturated[] = "\x83\xfb\x7e\x37\xe4\x3c\x88\x00\x75\x9c\xfb\xfe\x37\xe4\x3c\x88\x00\x75\x9c"
+            "\xd9\x4a\x43\x82\xfb\x7e\x37\xe4\x3c\x88\x00\x75\x9c\xfb\xfe\x37\xe4\x3c\x88\x00\x75\x9c";
+        auto numbers = json_deserializer::object_from_cbor(context, saturated, saturated + sizeof saturated - 1);
+        ASSERT_TRUE(numbers && numbers->as<array>() && numbers->as<array>()->_array.size() == 3);
+        auto& values = numbers->as<array>()->_array;
+        EXPECT_EQ((std::numeric_limits<float>::max)(), values[0].fltValue());
+        EXPECT_EQ(std::numeric_limits<float>::lowest(), values[1].fltValue());
+        auto ints = values[2].object() ? values[2].object()->as<int_array>() : nullptr;
+        EXPECT_TRUE(ints && ints->_array == (std::vector<SInt32>{ INT32_MAX, INT32_MIN }));
+    }
+
+    TEST(cbor, test_data_round_trip)
+    {
+        namespace fs = boost::filesystem;
+
+        auto dir = util::relative_to_dll_path("test_data/json_loading_test");
+        bool atLeastOneTested = false;
+
+        for (fs::directory_iterator itr(dir), end; itr != end; ++itr) {
+            if (!fs::is_regular_file(*itr)) {
+                continue;
+            }
+            atLeastOneTested = true;
+
+            tes_context_standalone ctx;
+            auto root = json_deserializer::object_from_file(ctx, itr->path());
+            ASSERT_TRUE(root != nullptr);
+
+            const std::string data = json_serializer::create_cbor_data(*root);
+            auto restored = json_deserializer::object_from_cbor(ctx, data.data(), data.data() + data.size());
+            ASSERT_TRUE(restored != nullptr);
+            EXPECT_TRUE(json_equal(json_serializer::create_json_value(*root).get(), json_serializer::create_json_value(*restored).get()) == 1);
+        }
+
+        EXPECT_TRUE(atLeastOneTested);
+    }
+
+    // a form-heavy graph of 400k objects: JSON and CBOR files compared by size and by write and read times
+    TEST(cbor, size_and_speed_perft)
+    {
+        namespace fs = boost::filesystem;
+
+        tes_context_standalone ctx;
+        map& root = map::object(ctx);
+        form_map& byForm = form_map::object(ctx);
+        root.u_set("byForm", item(byForm));
+
+        const int entryCount = 100000;
+        for (int i = 0; i < entryCount; ++i) {
+            const auto form = make_weak_form_id((FormId)(('A' + i % 26) << 24 | (0x800 + i)), ctx);
+
+            map& entry = map::object(ctx);
+            entry.u_set("form", item(form));
+            entry.u_set("count", item(i % 1000));
+            entry.u_set("weight", item(i * 0.25f));
+            entry.u_set("name", item("entry" + std::to_string(i)));
+
+            form_map& keywords = form_map::object(ctx);
+            keywords.u_set(make_weak_form_id((FormId)('D' << 24 | (0x10 + i % 64)), ctx), item(1));
+            entry.u_set("keywords", item(keywords));
+
+            int_array& ranks = int_array::object(ctx);
+            ranks.u_push(i);
+            ranks.u_push(-i);
+            entry.u_set("ranks", item(ranks));
+
+            byForm.u_set(form, item(entry));
+        }
+
+        const auto jsonPath = (fs::temp_directory_path() / "jc_cbor_perft.json").generic_string();
+        const auto cborPath = (fs::temp_directory_path() / "jc_cbor_perft.jcb").generic_string();
+
+        util::do_with_timing("JSON writing, 100k form entries", [&]() {
+            json_serializer::write_json_file(root, jsonPath.c_str(), JSON_INDENT(2));
+        });
+        util::do_with_timing("CBOR writing, 100k form entries", [&]() {
+            json_serializer::write_cbor_file(root, cborPath.c_str());
+        });
+        JC_log("JSON file size: %u KB, CBOR file size: %u KB",
+            (uint32_t)(fs::file_size(jsonPath) / 1024), (uint32_t)(fs::file_size(cborPath) / 1024));
+        EXPECT_TRUE(fs::file_size(cborPath) < fs::file_size(jsonPath));
+
+        object_base *fromJson = nullptr, *fromCbor = nullptr;
+        util::do_with_timing("JSON reading, 100k form entries", [&]() {
+            fromJson = json_deserializer::object_from_file(ctx, jsonPath.c_str());
+        });
+        util::do_with_timing("CBOR reading, 100k form entries", [&]() {
+            fromCbor = json_deserializer::object_from_cbor_file(ctx, cborPath.c_str());
+        });
+        ASSERT_TRUE(fromJson && fromCbor);
+        EXPECT_EQ(entryCount, fromCbor->as<map>()->u_get(std::string("byForm"))->object()->s_count());
+
+        fs::remove(jsonPath);
+        fs::remove(cborPath);
+    }
+
+    JC_TEST(data_pack, matches_materialized_graph)
+    {
+        object_base *root = json_deserializer::object_from_json_data(context, STR({
+            "array": [1, -2.5, "str", null, "__formData|D|0x4", [], {}],
+            "formMap": { "__metaInfo": { "typeName": "JFormMap" }, "__formData|D|0x4": { "inner": [0.1] }, "__formData|A|0x14": 2 },
+            "intMap": { "__metaInfo": { "typeName": "JIntMap" }, "-3": "minus three", "10": [], "7": 7 },
+            "ints": { "__metaInfo": { "typeName": "JIntArray" }, "__values": [1, -2, 3] },
+            "flts": { "__metaInfo": { "typeName": "JFltArray" }, "__values": [0.5, -1] },
+            "set": { "__metaInfo": { "typeName": "JSet" }, "__values": [1, "a", { "k": "v" }] },
+            "Key": "upper", "key2": "lower",
+            "refs": ["__reference|.array", "__reference|"]
+        }));
+        ASSERT_TRUE(root != nullptr);
+
+        auto pack = data_pack::from_data(data_pack_writer::pack(*root));
+        ASSERT_TRUE(pack != nullptr);
+
+        auto value = [&](const char *path) {
+            auto slot = pack->find(path);
+            return slot ? pack->to_item(*slot, context) : item();
+        };
+
+        EXPECT_EQ(-2.5f, value(".array[1]").fltValue());
+        EXPECT_EQ(std::string("str"), value(".array[-5]").strValue());
+        EXPECT_TRUE((FormId)('D' << 24 | 0x4) == value(".array[4]").formId());
+        EXPECT_EQ(std::string("minus three"), value(".intMap[-3]").strValue());
+        EXPECT_EQ(7, value(".intMap[0x7]").intValue());
+        EXPECT_EQ(2, value(".formMap[__formData|A|0x14]").intValue());
+        EXPECT_EQ(0.1f, value(".formMap[__formData|D|0x4].inner[0]").fltValue());
+        EXPECT_EQ(std::string("upper"), value(".KEY").strValue());
+        EXPECT_EQ(std::string("lower"), value(".KEY2").strValue());
+        EXPECT_EQ(7, pack->count(*pack->find(".array")));
+        EXPECT_EQ(3, pack->count(*pack->find(".ints")));
+        EXPECT_EQ(0, pack->count(*pack->find(".Key")));
+
+        const char *missing[] = { ".nope", ".array[7]", ".array[-8]", ".array.x", "[0]", ".intMap[8]", ".formMap[__formData|B|0x1]",
+            ".ints[0]", "..", ".array[", ".array[]", "array", ".refs[1].refs[1].Key.x" };
+        for (auto path : missing) {
+            EXPECT_FALSE(pack->find(path).has_value());
+        }
+        EXPECT_EQ(std::string("upper"), value(".refs[1].refs[1].Key").strValue());
+
+        // the materialized copy is the same graph
+        object_base *materialized = pack->to_item(pack->root(), context).object();
+        ASSERT_TRUE(materialized != nullptr);
+        EXPECT_EQ(std::string(json_serializer::create_json_data(*root).get()), std::string(json_serializer::create_json_data(*materialized).get()));
+        auto refs = materialized->as<map>()->u_get(std::string("refs"))->object()->as<array>();
+        EXPECT_EQ(materialized->as<map>()->u_get(std::string("array"))->object(), refs->u_get(0)->object());
+        EXPECT_EQ(materialized, refs->u_get(1)->object());
+
+        // a damaged pack yields missing values
+        const std::string data = data_pack_writer::pack(*root);
+        for (size_t length = 0; length < data.size(); length += 4) {
+            EXPECT_TRUE(data_pack::from_data(data.substr(0, length)) == nullptr);
+        }
+        for (size_t i = sizeof(data_pack_format::header); i < data.size(); ++i) {
+            std::string damaged = data;
+            damaged[i] = static_cast<char>(damaged[i] ^ 0xA5);
+            if (auto damagedPack = data_pack::from_data(damaged)) {
+                damagedPack->to_item(damagedPack->root(), context);
+                damagedPack->find(".formMap[__formData|D|0x4].inner[0]");
+            }
+        }
+        EXPECT_TRUE(data_pack::from_data(std::string("JCDP")) == nullptr);
+
+        // mapped from a file
+        namespace fs = boost::filesystem;
+        const auto path = (fs::temp_directory_path() / "jc_data_pack_test.jcpack").generic_string();
+        {
+            auto file = make_unique_file(fopen(path.c_str(), "wb"));
+            ASSERT_TRUE(file != nullptr);
+            fwrite(data.data(), 1, data.size(), file.get());
+        }
+        {
+            auto mapped = data_pack::open(path.c_str());
+            ASSERT_TRUE(mapped != nullptr);
+            EXPECT_EQ(data.size(), mapped->size());
+            EXPECT_EQ(std::string("minus three"), mapped->string_value(*mapped->find(".intMap[-3]")));
+        }
+        EXPECT_TRUE(data_pack::open((fs::temp_directory_path() / "jc_no_such_pack.jcpack").generic_string().c_str()) == nullptr);
+        fs::remove(path);
+    }
+
+    JC_TEST(json_apply, modes)
+    {
+        object_base *root = json_deserializer::object_from_json_data(context, STR({
+            "a": 1, "keep": "k", "child": { "x": 1, "y": 2 }, "list": [{ "k": 1 }, 2], "ints": { "__metaInfo": { "typeName": "JIntArray" }, "__values": [1, 2] }
+        }));
+        ASSERT_TRUE(root != nullptr);
+        map& cnt = *root->as<map>();
+        auto child = cnt.u_get(std::string("child"))->object();
+        auto list = cnt.u_get(std::string("list"))->object();
+        auto listMap = list->as<array>()->u_get(0)->object();
+        auto ints = cnt.u_get(std::string("ints"))->object();
+
+        // merge: the containers are updated in place, absent keys are kept
+        EXPECT_TRUE(json_deserializer::apply_json_data(context, cnt, STR({
+            "A": 2, "child": { "y": 3, "z": 4 }, "list": [{ "k": 5 }], "new": {},
+            "ints": { "__metaInfo": { "typeName": "JIntArray" }, "__values": [7] }
+        }), json_apply_mode::merge));
+        EXPECT_EQ(2, cnt.u_get(std::string("a"))->intValue());
+        EXPECT_EQ(std::string("k"), cnt.u_get(std::string("keep"))->strValue());
+        EXPECT_EQ(child, cnt.u_get(std::string("child"))->object());
+        EXPECT_EQ(1, child->as<map>()->u_get(std::string("x"))->intValue());
+        EXPECT_EQ(3, child->as<map>()->u_get(std::string("y"))->intValue());
+        EXPECT_EQ(4, child->as<map>()->u_get(std::string("z"))->intValue());
+        EXPECT_EQ(list, cnt.u_get(std::string("list"))->object());
+        EXPECT_EQ(1, list->s_count());
+        EXPECT_EQ(listMap, list->as<array>()->u_get(0)->object());
+        EXPECT_EQ(5, listMap->as<map>()->u_get(std::string("k"))->intValue());
+        EXPECT_EQ(ints, cnt.u_get(std::string("ints"))->object());
+        EXPECT_EQ(1, ints->s_count());
+        EXPECT_EQ(7, *ints->as<int_array>()->u_get(0));
+        ASSERT_TRUE(cnt.u_get(std::string("new"))->object() != nullptr);
+
+        // references are relative to the container being applied onto
+        EXPECT_TRUE(json_deserializer::apply_json_data(context, cnt, STR({
+            "self": "__reference|", "alias": "__reference|.child"
+        }), json_apply_mode::merge));
+        EXPECT_EQ(root, cnt.u_get(std::string("self"))->object());
+        EXPECT_EQ(child, cnt.u_get(std::string("alias"))->object());
+
+        // replace: only the JSON's keys are left, a container of another type gets replaced
+        EXPECT_TRUE(json_deserializer::apply_json_data(context, cnt, STR({
+            "child": { "x": 10 }, "list": {}
+        }), json_apply_mode::replace));
+        EXPECT_EQ(2, cnt.s_count());
+        EXPECT_EQ(child, cnt.u_get(std::string("child"))->object());
+        EXPECT_EQ(1, child->s_count());
+        EXPECT_EQ(10, child->as<map>()->u_get(std::string("x"))->intValue());
+        ASSERT_TRUE(cnt.u_get(std::string("list"))->object() != nullptr);
+        EXPECT_TRUE(cnt.u_get(std::string("list"))->object()->as<map>() != nullptr);
+
+        // merge patch: nulls remove the keys
+        EXPECT_TRUE(json_deserializer::apply_json_data(context, cnt, STR({
+            "child": { "x": null, "w": { "n": null, "m": 1 } }, "list": null, "absent": null
+        }), json_apply_mode::merge_patch));
+        EXPECT_EQ(1, cnt.s_count());
+        EXPECT_EQ(child, cnt.u_get(std::string("child"))->object());
+        EXPECT_EQ(1, child->s_count());
+        EXPECT_EQ(1, child->as<map>()->u_get(std::string("w"))->object()->s_count());
+
+        // the root must be of the same type
+        EXPECT_FALSE(json_deserializer::apply_json_data(context, cnt, "[1]", json_apply_mode::merge));
+        EXPECT_FALSE(json_deserializer::apply_json_data(context, cnt, STR({ "__metaInfo": { "typeName": "JIntMap" } }), json_apply_mode::merge));
+        EXPECT_FALSE(json_deserializer::apply_json_data(context, cnt, "{", json_apply_mode::merge));
+        EXPECT_EQ(1, cnt.s_count());
+
+        form_map& forms = form_map::object(context);
+        EXPECT_TRUE(json_deserializer::apply_json_data(context, forms, STR({
+            "__metaInfo": { "typeName": "JFormMap" }, "__formData|D|0x4": 1, "__formData|A|0x14": { "k": 1 }
+        }), json_apply_mode::merge));
+        EXPECT_EQ(2, forms.s_count());
+        auto formChild = forms.u_get(make_weak_form_id((FormId)('A' << 24 | 0x14), context))->object();
+        EXPECT_TRUE(json_deserializer::apply_json_data(context, forms, STR({
+            "__metaInfo": { "typeName": "JFormMap" }, "__formData|A|0x14": { "k": 2 }
+        }), json_apply_mode::replace));
+        EXPECT_EQ(1, forms.s_count());
+        EXPECT_EQ(formChild, forms.u_get(make_weak_form_id((FormId)('A' << 24 | 0x14), context))->object());
+        EXPECT_EQ(2, formChild->as<map>()->u_get(std::string("k"))->intValue());
+
+        integer_map& intMap = integer_map::object(context);
+        EXPECT_TRUE(json_deserializer::apply_json_data(context, intMap, STR({
+            "__metaInfo": { "typeName": "JIntMap" }, "-3": 1, "0x10": 2, "nan": 3
+        }), json_apply_mode::merge_patch));
+        EXPECT_EQ(2, intMap.s_count());
+        EXPECT_EQ(2, intMap.u_get(16)->intValue());
+    }
+
+    JC_TEST(json_apply, merge_patch_rfc_examples)
+    {
+        // RFC 7396, appendix A. Keys are case-insensitive and arrays are JArrays, so the examples are adjusted
+        const char *examples[][3] = {
+            { STR({"a":"b"}), STR({"a":"c"}), STR({"a":"c"}) },
+            { STR({"a":"b"}), STR({"b":"c"}), STR({"a":"b","b":"c"}) },
+            { STR({"a":"b"}), STR({"a":null}), STR({}) },
+            { STR({"a":"b","b":"c"}), STR({"a":null}), STR({"b":"c"}) },
+            { STR({"a":["b"]}), STR({"a":"c"}), STR({"a":"c"}) },
+            { STR({"a":"c"}), STR({"a":["b"]}), STR({"a":["b"]}) },
+            { STR({"a":{"b":"c"}}), STR({"a":{"b":"d","c":null}}), STR({"a":{"b":"d"}}) },
+            { STR({"a":[{"b":"c"}]}), STR({"a":[1]}), STR({"a":[1]}) },
+            { STR({"e":null}), STR({"a":1}), STR({"e":null,"a":1}) },
+            { STR({}), STR({"a":{"bb":{"ccc":null}}}), STR({"a":{"bb":{}}}) },
+        };
+
+        for (auto& example : examples) {
+            object_base *target = json_deserializer::object_from_json_data(context, example[0]);
+            ASSERT_TRUE(target != nullptr);
+            EXPECT_TRUE(json_deserializer::apply_json_data(context, *target, example[1], json_apply_mode::merge_patch));
+
+            auto expected = json_deserializer::json_from_data(example[2]);
+            auto result = json_serializer::create_json_value(*target);
+            EXPECT_TRUE(json_equal(expected.get(), result.get()) == 1);
+        }
+    }
+
+    TEST(json_apply, reapply_config_perft)
+    {
+        tes_context_standalone ctx;
+
+        const int keyCount = 10000;
+        std::string config = "{";
+        for (int i = 0; i < keyCount; ++i) {
+            config += (i ? ",\"entry" : "\"entry") + std::to_string(i) + "\": { \"value\": " + std::to_string(i) +
+                ", \"name\": \"entry\", \"tags\": [1, 2, 3] }";
+        }
+        config += "}";
+
+        object_base *target = json_deserializer::object_from_json_data(ctx, config.c_str());
+        ASSERT_TRUE(target != nullptr);
+        map& settings = *target->as<map>();
+        auto firstEntry = settings.u_get(std::string("entry0"))->object();
+
+        const int runs = 10;
+        util::do_with_timing("reading a new copy, replacing the pairs", [&]() {
+            for (int run = 0; run < runs; ++run) {
+                object_base *fresh = json_deserializer::object_from_json_data(ctx, config.c_str());
+                for (auto& pair : fresh->as<map>()->u_container()) {
+                    settings.u_set(pair.first, pair.second);
+                }
+            }
+        });
+        EXPECT_NE(firstEntry, settings.u_get(std::string("entry0"))->object());
+
+        firstEntry = settings.u_get(std::string("entry0"))->object();
+        util::do_with_timing("applying onto the existing container", [&]() {
+            for (int run = 0; run < runs; ++run) {
+                EXPECT_TRUE(json_deserializer::apply_json_data(ctx, settings, config.c_str(), json_apply_mode::merge));
+            }
+        });
+        EXPECT_EQ(firstEntry, settings.u_get(std::string("entry0"))->object());
+        EXPECT_EQ(keyCount, settings.s_count());
+        EXPECT_EQ(keyCount - 1, settings.u_get(std::string("entry9999"))->object()->as<map>()->u_get(std::string("value"))->intValue());
+    }
+
+    namespace flat_format_testing {
+
+        // JDB referencing containers of all types, tagged and value-indexed ones, shared references, forms
+        // and a container kept alive only by the autorelease queue
+        static map& fill_context(tes_context& ctx, int entryCount) {
+            object_base *data = json_deserializer::object_from_json_data(ctx, STR({
+                "array": [1, -2.5, "str", null, "__formData|D|0x4", [], {}],
+                "formMap": { "__metaInfo": { "typeName": "JFormMap" }, "__formData|D|0x4": { "inner": [0.1] }, "__formData|A|0x14": 2 },
+                "intMap": { "__metaInfo": { "typeName": "JIntMap" }, "-3": "minus three", "10": [], "2147483647": 1 },
+                "ints": { "__metaInfo": { "typeName": "JIntArray" }, "__values": [1, -2147483648, 3] },
+                "flts": { "__metaInfo": { "typeName": "JFltArray" }, "__values": [0.5, -1] },
+                "set": { "__metaInfo": { "typeName": "JSet" }, "__values": [1, "a", "__formData|D|0x4", "__reference|.array"] },
+                "refs": ["__reference|.array", "__reference|.set", "__reference|"]
+            }));
+            map& root = data->as_link<map>();
+            ctx.root().u_set("data", item(root));
+
+            array& entries = array::object(ctx);
+            entries.u_enable_value_index(true);
+            entries.set_tag("entries");
+            for (int i = 0; i < entryCount; ++i) {
+                map& entry = map::object(ctx);
+                entry.u_set("form", item(make_weak_form_id((FormId)(('A' + i % 26) << 24 | (0x800 + i)), ctx)));
+                entry.u_set("count", item(i % 1000));
+                entry.u_set("name", item("entry" + std::to_string(i % 100)));
+                entries.u_push(item(entry));
+            }
+            root.u_set("entries", item(entries));
+
+            map::object(ctx).set_tag("unreferenced");
+            return root;
+        }
+
+        static std::string write_state(tes_context& ctx, serialization_version version) {
+            std::ostringstream stream;
+            ctx.write_to_stream(stream, version);
+            return stream.str();
+        }
+
+        static std::string jdb_json(tes_context& ctx) {
+            return json_serializer::create_json_data(ctx.root()).get();
+        }
+    }
+
+    JC_TEST(flat_format, round_trip)
+    {
+        using namespace flat_format_testing;
+
+        map& root = fill_context(context, 1000);
+        const Handle rootId = root.uid();
+        const Handle entriesId = root.u_get(std::string("entries"))->object()->uid();
+        const std::string expectedJson = jdb_json(context);
+        const size_t objectCount = context.object_count();
+
+        for (auto version : { serialization_version::current, serialization_version::pre_flat_format }) {
+            const std::string state = write_state(context, version);
+
+            tes_context_standalone restored;
+            restored.read_from_string(state);
+
+            EXPECT_EQ(objectCount, restored.object_count());
+            EXPECT_EQ(expectedJson, jdb_json(restored));
+            EXPECT_EQ(&restored.root(), restored.getObject(context.root().uid()));
+
+            object_base *restoredRoot = restored.getObject(rootId);
+            ASSERT_TRUE(restoredRoot && restoredRoot->as<map>());
+            object_base *entries = restored.getObject(entriesId);
+            ASSERT_TRUE(entries && entries->as<array>());
+            EXPECT_EQ(entries, restoredRoot->as<map>()->u_get(std::string("entries"))->object());
+            EXPECT_TRUE(entries->has_equal_tag("entries"));
+            EXPECT_TRUE(entries->as<array>()->u_value_index_enabled());
+            EXPECT_EQ(1, restored.filter_objects([](object_base& obj) { return obj.has_equal_tag("unreferenced"); }).size());
+
+            // identifiers of the new objects don't collide with the loaded ones
+            map& fresh = map::object(restored);
+            EXPECT_EQ(&fresh, restored.getObject(fresh.uid()));
+            EXPECT_EQ(restoredRoot, restored.getObject(rootId));
+        }
+    }
+
+    JC_TEST(flat_format, malformed_data)
+    {
+        using namespace flat_format_testing;
+
+        fill_context(context, 10);
+        const std::string state = write_state(context, serialization_version::current);
+
+        tes_context_standalone restored;
+        restored.read_from_string(state);
+        EXPECT_EQ(context.object_count(), restored.object_count());
+
+        // every truncation is rejected and leaves the context empty
+        for (size_t length = 1; length < state.size(); ++length) {
+            restored.read_from_string(state.substr(0, length));
+            EXPECT_EQ(0, restored.object_count());
+        }
+
+        restored.read_from_string(state + '\0');
+        EXPECT_EQ(0, restored.object_count());
+    }
+
+    JC_TEST(flat_format, chunks_decoded_concurrently)
+    {
+        using namespace flat_format_testing;
+
+        fill_context(context, 20000);
+        const std::string expectedJson = jdb_json(context);
+        flat_writer writer;
+        flat_serialization::write_context(context, writer);
+
+        for (size_t threadCount : { 1, 3, 8 }) {
+            tes_context_standalone restored;
+            flat_reader reader(writer.data().data(), writer.data().data() + writer.data().size());
+            flat_serialization::read_context(restored, reader, threadCount);
+
+            EXPECT_EQ(context.object_count(), restored.object_count());
+            EXPECT_EQ(expectedJson, jdb_json(restored));
+            EXPECT_EQ(0, restored.filter_objects([&restored](object_base& obj) { return &obj.context() != &restored; }).size());
+        }
+    }
+
+    // 400k objects read on 1 to 8 threads
+    TEST(flat_format, concurrent_loading_perft)
+    {
+        using namespace flat_format_testing;
+
+        tes_context_standalone ctx;
+        fill_context(ctx, 400000);
+        flat_writer writer;
+        flat_serialization::write_context(ctx, writer);
+
+        for (size_t threadCount : { 1, 2, 4, 8 }) {
+            tes_context_standalone restored;
+            const std::string operation = "flat format loading, 400k objects, " + std::to_string(threadCount) + " threads";
+            util::do_with_timing(operation.c_str(), [&]() {
+                flat_reader reader(writer.data().data(), writer.data().data() + writer.data().size());
+                flat_serialization::read_context(restored, reader, threadCount);
+            });
+            EXPECT_EQ(ctx.object_count(), restored.object_count());
+        }
+    }
+
+    // 400k objects: the flat format against boost::serialization archive by size and by save and load times
+    TEST(flat_format, save_load_perft)
+    {
+        using namespace flat_format_testing;
+
+        tes_context_standalone ctx;
+        fill_context(ctx, 400000);
+
+        std::string flatState, boostState;
+        util::do_with_timing("flat format saving, 400k objects", [&]() {
+            flatState = write_state(ctx, serialization_version::current);
+        });
+        util::do_with_timing("boost archive saving, 400k objects", [&]() {
+            boostState = write_state(ctx, serialization_version::pre_flat_format);
+        });
+        JC_log("flat format size: %u KB, boost archive size: %u KB",
+            (uint32_t)(flatState.size() / 1024), (uint32_t)(boostState.size() / 1024));
+        EXPECT_TRUE(flatState.size() < boostState.size());
+
+        tes_context_standalone restored;
+        util::do_with_timing("flat format loading, 400k objects", [&]() {
+            restored.read_from_string(flatState);
+        });
+        EXPECT_EQ(ctx.object_count(), restored.object_count());
+        util::do_with_timing("boost archive loading, 400k objects", [&]() {
+            restored.read_from_string(boostState);
+        });
+        EXPECT_EQ(ctx.object_count(), restored.object_count());
+    }
+
+    TEST(lz4, round_trip)
+    {
+        std::vector<std::string> samples = { "", "a", "abcdefghijklm", std::string(100000, 'x') };
+        std::string text;
+        for (int i = 0; i < 100000; ++i) {
+            text += "entry" + std::to_string(i % 1000) + (i % 7 ? "," : "\n");
+        }
+        samples.push_back(text);
+        std::string noise(300000, '\0');
+        uint32_t seed = 1;
+        for (auto& c : noise) {
+            seed = seed * 1103515245 + 12345;
+            c = char(seed >> 16);
+        }
+        samples.push_back(noise);
+        samples.push_back(text + noise + text); // more than a frame block, compressible and not
+
+        for (auto& sample : samples) {
+            for (int level : { 1, 4, 9 }) {
+                std::string compressed;
+                util::lz4::compress_block(sample.data(), sample.size(), compressed, level);
+                EXPECT_TRUE(compressed.size() <= util::lz4::max_compressed_size(sample.size()));
+                std::string decompressed(sample.size(), '\0');
+                EXPECT_TRUE(util::lz4::decompress_block(compressed.data(), compressed.size(), &decompressed[0], decompressed.size()));
+                EXPECT_EQ(sample, decompressed);
+
+                std::ostringstream stream;
+                util::lz4::write_frames(stream, sample, level);
+                std::string framed;
+                EXPECT_TRUE(util::lz4::read_frames(stream.str(), framed));
+                EXPECT_EQ(sample, framed);
+            }
+        }
+
+        // a truncated or damaged input is rejected, never read or written out of bounds
+        std::string compressed;
+        util::lz4::compress_block(text.data(), text.size(), compressed);
+        std::string decompressed(text.size(), '\0');
+        for (size_t length = 0; length < compressed.size(); length += 1 + length / 16) {
+            EXPECT_FALSE(util::lz4::decompress_block(compressed.data(), length, &decompressed[0], decompressed.size()));
+        }
+        EXPECT_FALSE(util::lz4::decompress_block(compressed.data(), compressed.size(), &decompressed[0], decompressed.size() - 1));
+        const char backReferenceBeforeStart[] = "\x10" "a" "\x05\x00";
+        EXPECT_FALSE(util::lz4::decompress_block(backReferenceBeforeStart, 4, &decompressed[0], 5));
+
+        std::ostringstream stream;
+        util::lz4::write_frames(stream, text);
+        const std::string frames = stream.str();
+        std::string framed;
+        EXPECT_FALSE(util::lz4::read_frames(std::string_view(frames).substr(0, frames.size() - 1), framed));
+        EXPECT_FALSE(util::lz4::read_frames(std::string_view(frames).substr(0, 6), framed));
+    }
+
+    // the state of 400k objects compressed at several levels: the ratio and the throughput
+    TEST(lz4, save_compression_perft)
+    {
+        tes_context_standalone ctx;
+        flat_format_testing::fill_context(ctx, 400000);
+        const std::string state = flat_format_testing::write_state(ctx, serialization_version::current);
+
+        namespace chr = std::chrono;
+        auto megabytesPerSecond = [&state](chr::steady_clock::duration time) {
+            return state.size() * 1e6 / (1 + chr::duration_cast<chr::microseconds>(time).count()) / (1 << 20);
+        };
+
+        for (int level : { 1, 3, 6, 9 }) {
+            std::ostringstream stream;
+            auto started = chr::steady_clock::now();
+            util::lz4::write_frames(stream, state, level);
+            const auto compressionTime = chr::steady_clock::now() - started;
+            const std::string compressed = stream.str();
+
+            std::string decompressed;
+            started = chr::steady_clock::now();
+            EXPECT_TRUE(util::lz4::read_frames(compressed, decompressed));
+            const auto decompressionTime = chr::steady_clock::now() - started;
+            EXPECT_EQ(state, decompressed);
+
+            JC_log("level %d: %u KB -> %u KB (%.1f%%), compression %.0f MB/s, decompression %.0f MB/s", level,
+                (uint32_t)(state.size() / 1024), (uint32_t)(compressed.size() / 1024), 100.0 * compressed.size() / state.size(),
+                megabytesPerSecond(compressionTime), megabytesPerSecond(decompressionTime));
+            EXPECT_TRUE(compressed.size() < state.size());
+        }
+    }
+
+    TEST(record_stream, round_trip)
+    {
+        std::string data;
+        uint32_t seed = 1;
+        for (size_t size : { 0, 1, 7, 100, 4096, 5000, 100000, 3 }) {
+            for (size_t i = 0; i < size; ++i) {
+                seed = seed * 1103515245 + 12345;
+                data += char(seed >> 16);
+            }
+        }
+
+        // small buffers, so the writes and reads are both buffered and direct
+        const size_t bufferSizes[] = { 1, 16, 4096, util::record_buffer_size };
+        for (size_t bufferSize : bufferSizes) {
+            std::string written;
+            util::string_record_sink sink(written);
+            util::record_writer writer(sink, bufferSize);
+            util::write_decimal(writer, 4294967295u);
+            writer.put(' ');
+            util::write_decimal(writer, 0);
+            writer.put(' ');
+            size_t offset = 0;
+            for (size_t size : { 0, 1, 7, 100, 4096, 5000, 100000 }) {
+                writer.write(data.data() + offset, size);
+                offset += size;
+            }
+            writer.write(std::string_view(data).substr(offset));
+            EXPECT_EQ(13u + data.size(), writer.written());
+            writer.flush();
+            EXPECT_EQ("4294967295 0 " + data, written);
+
+            util::memory_record_source source(written);
+            util::record_reader reader(source, bufferSize);
+            uint32_t number = 1;
+            EXPECT_TRUE(util::read_decimal(reader, number));
+            EXPECT_EQ(4294967295u, number);
+            EXPECT_TRUE(util::read_decimal(reader, number));
+            EXPECT_EQ(0u, number);
+            EXPECT_EQ(' ', reader.get());
+
+            std::string read(5000, '\0');
+            EXPECT_EQ((unsigned char)data[0], reader.peek());
+            EXPECT_EQ(read.size(), reader.read(&read[0], read.size()));
+            std::string rest;
+            reader.read_rest(rest);
+            EXPECT_EQ(data, read + rest);
+            EXPECT_TRUE(reader.at_end());
+            EXPECT_EQ(-1, reader.get());
+            EXPECT_EQ(0u, reader.read(&read[0], read.size()));
+        }
+
+        {
+            const std::string text = " \n 123abc";
+            util::memory_record_source source(text);
+            util::record_reader reader(source, 2);
+            uint32_t number = 0;
+            EXPECT_TRUE(util::read_decimal(reader, number));
+            EXPECT_EQ(123u, number);
+            EXPECT_EQ('a', reader.get());
+            EXPECT_FALSE(util::read_decimal(reader, number));
+        }
+        {
+            const std::string text = "42949672960";
+            util::memory_record_source source(text);
+            util::record_reader reader(source);
+            uint32_t number = 0;
+            EXPECT_FALSE(util::read_decimal(reader, number)); // too large
+        }
+
+        // through std::ostream and std::istream, as boost archives use it
+        std::string written;
+        {
+            util::string_record_sink sink(written);
+            util::record_writer writer(sink, 64);
+            util::record_streambuf buffer(writer);
+            std::ostream stream(&buffer);
+            stream << 12345 << ' ';
+            stream.write(data.data(), data.size());
+            stream.flush();
+            writer.flush();
+        }
+        util::memory_record_source source(written);
+        util::record_reader reader(source, 64);
+        util::record_streambuf buffer(reader);
+        std::istream stream(&buffer);
+        int number = 0;
+        stream >> number;
+        EXPECT_EQ(12345, number);
+        EXPECT_EQ(' ', stream.get());
+        std::string read(data.size(), '\0');
+        stream.read(&read[0], read.size());
+        EXPECT_EQ(data.size(), (size_t)stream.gcount());
+        EXPECT_EQ(data, read);
+        EXPECT_EQ(std::istream::traits_type::eof(), stream.peek());
+    }
+
+    // 100 MB written and read back in 4 KB records through the file-backed record writer and reader, against std::fstream
+    TEST(record_stream, throughput_perft)
+    {
+        namespace fs = boost::filesystem;
+        namespace chr = std::chrono;
+
+        const size_t totalSize = 100 << 20;
+        std::string record(4096, '\0');
+        for (size_t i = 0; i < record.size(); ++i) {
+            record[i] = char(i * 31 + 7);
+        }
+        auto megabytesPerSecond = [&](chr::steady_clock::duration time) {
+            return totalSize * 1e6 / (1 + chr::duration_cast<chr::microseconds>(time).count()) / (1 << 20);
+        };
+        auto measure = [&](const char *name, const std::function<void()>& action) {
+            const auto started = chr::steady_clock::now();
+            action();
+            JC_log("%s: %.0f MB/s", name, megabytesPerSecond(chr::steady_clock::now() - started));
+        };
+
+        const auto path = (fs::temp_directory_path() / "jc_record_stream_perft.bin").generic_string();
+
+        measure("record writer, file", [&]() {
+            util::file_record_sink sink(path.c_str());
+            ASSERT_TRUE(sink.is_open());
+            util::record_writer writer(sink);
+            for (size_t done = 0; done < totalSize; done += record.size()) {
+                writer.write(record);
+            }
+            writer.flush();
+            EXPECT_FALSE(sink.failed());
+        });
+        EXPECT_EQ(totalSize, fs::file_size(path));
+
+        measure("record reader, file", [&]() {
+            util::file_record_source source(path.c_str());
+            ASSERT_TRUE(source.is_open());
+            util::record_reader reader(source);
+            std::string read(record.size(), '\0');
+            size_t total = 0;
+            for (size_t count; (count = reader.read(&read[0], read.size())) > 0; total += count) {}
+            EXPECT_EQ(totalSize, total);
+            EXPECT_EQ(record, read);
+        });
+
+        measure("std::ofstream", [&]() {
+            std::ofstream file(path, std::ios::out | std::ios::binary);
+            for (size_t done = 0; done < totalSize; done += record.size()) {
+                file.write(record.data(), record.size());
+            }
+        });
+
+        measure("std::ifstream, istreambuf_iterator", [&]() {
+            std::ifstream file(path, std::ios::in | std::ios::binary);
+            const std::string read{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+            EXPECT_EQ(totalSize, read.size());
+        });
+
+        // the memory path of the saves and loads: a 100 MB payload read whole
+        std::string state;
+        measure("record writer, memory", [&]() {
+            util::string_record_sink sink(state);
+            util::record_writer writer(sink);
+            for (size_t done = 0; done < totalSize; done += record.size()) {
+                writer.write(record);
+            }
+            writer.flush();
+        });
+        measure("record reader, memory, read whole", [&]() {
+            util::memory_record_source source(state);
+            util::record_reader reader(source);
+            std::string read;
+            reader.read_rest(read);
+            EXPECT_EQ(totalSize, read.size());
+        });
+
+        fs::remove(path);
+    }
+
+    // changes since the base snapshot: changed contents, a changed tag, a new object and a removed one,
+    // whose address the new one may take
+    JC_TEST(flat_format, delta_round_trip)
+    {
+        using namespace flat_format_testing;
+
+        auto reader_of = [](const flat_writer& writer) {
+            return flat_reader(writer.data().data(), writer.data().data() + writer.data().size());
+        };
+
+        map& root = fill_context(context, 1000);
+        flat_writer base;
+        flat_serialization::write_context(context, base, true);
+
+        array& entries = root.u_get(std::string("entries"))->object()->as_link<array>();
+        const array& constEntries = entries;
+        constEntries.u_get(5)->object()->as_link<map>().u_set("count", item(-1));
+        context.collect_garbage();
+        EXPECT_EQ(0, context.filter_objects([](object_base& obj) { return obj.has_equal_tag("unreferenced"); }).size());
+        map& added = map::object(context);
+        added.u_set("name", item("added"));
+        entries.u_push(item(added));
+        root.set_tag("tagged");
+
+        const std::string expectedJson = jdb_json(context);
+        flat_writer delta;
+        flat_serialization::write_context_delta(context, delta);
+        EXPECT_TRUE(delta.data().size() < base.data().size() / 2);
+
+        tes_context_standalone restored;
+        flat_reader baseReader = reader_of(base), deltaReader = reader_of(delta);
+        flat_serialization::read_context_delta(restored, &baseReader, deltaReader, 3);
+
+        EXPECT_EQ(context.object_count(), restored.object_count());
+        EXPECT_EQ(expectedJson, jdb_json(restored));
+        EXPECT_EQ(0, restored.filter_objects([](object_base& obj) { return obj.has_equal_tag("unreferenced"); }).size());
+        EXPECT_EQ(1, restored.filter_objects([](object_base& obj) { return obj.has_equal_tag("tagged"); }).size());
+        EXPECT_EQ(0, restored.filter_objects([&restored](object_base& obj) { return &obj.context() != &restored; }).size());
+
+        // the restored context keeps the base snapshot, its deltas are read against it
+        restored.root().u_set("more", item(1));
+        const std::string moreJson = jdb_json(restored);
+        flat_writer nextDelta;
+        flat_serialization::write_context_delta(restored, nextDelta);
+
+        tes_context_standalone again;
+        baseReader = reader_of(base);
+        deltaReader = reader_of(nextDelta);
+        flat_serialization::read_context_delta(again, &baseReader, deltaReader);
+        EXPECT_EQ(restored.object_count(), again.object_count());
+        EXPECT_EQ(moreJson, jdb_json(again));
+
+        // a delta isn't read without its base
+        tes_context_standalone baseless;
+        deltaReader = reader_of(delta);
+        EXPECT_THROW(flat_serialization::read_context_delta(baseless, nullptr, deltaReader), flat_format_error);
+        EXPECT_EQ(0, baseless.object_count());
+    }
+
+    // 400k objects, 4k of them changed: a delta against writing in whole
+    TEST(flat_format, delta_save_perft)
+    {
+        using namespace flat_format_testing;
+
+        tes_context_standalone ctx;
+        map& root = fill_context(ctx, 400000);
+        flat_writer base;
+        util::do_with_timing("flat format saving the base snapshot, 400k objects", [&]() {
+            flat_serialization::write_context(ctx, base, true);
+        });
+
+        const array& entries = root.u_get(std::string("entries"))->object()->as_link<array>();
+        for (int32_t i = 0; i < 400000; i += 100) {
+            entries.u_get(i)->object()->as_link<map>().u_set("count", item(-i));
+        }
+
+        flat_writer full, delta;
+        util::do_with_timing("flat format saving in whole, 400k objects, 4k changed", [&]() {
+            flat_serialization::write_context(ctx, full);
+        });
+        util::do_with_timing("flat format saving a delta, 400k objects, 4k changed", [&]() {
+            flat_serialization::write_context_delta(ctx, delta);
+        });
+        JC_log("whole: %u KB, delta: %u KB", (uint32_t)(full.data().size() / 1024), (uint32_t)(delta.data().size() / 1024));
+        EXPECT_TRUE(delta.data().size() * 10 < full.data().size());
+
+        tes_context_standalone restored;
+        util::do_with_timing("flat format loading the base and the delta, 400k objects", [&]() {
+            flat_reader baseReader(base.data().data(), base.data().data() + base.data().size());
+            flat_reader deltaReader(delta.data().data(), delta.data().data() + delta.data().size());
+            flat_serialization::read_context_delta(restored, &baseReader, deltaReader, util::hardware_threads());
+        });
+        EXPECT_EQ(ctx.object_count(), restored.object_count());
+    }
+
+    // The snapshot of a context, which another thread keeps modifying while the snapshot is being written
+    JC_TEST(flat_format, snapshot_written_while_modified)
+    {
+        using namespace flat_format_testing;
+
+        auto reader_of = [](const flat_writer& writer) {
+            return flat_reader(writer.data().data(), writer.data().data() + writer.data().size());
+        };
+
+        map& root = fill_context(context, 2000);
+        const std::string expectedJson = jdb_json(context);
+        const size_t objectCount = context.object_count();
+        array& entries = root.u_get(std::string("entries"))->object()->as_link<array>();
+        const array& constEntries = entries;
+
+        flat_writer base;
+        {
+            flat_serialization::snapshot taken(context, true);
+            std::thread modifier([&]() {
+                for (int32_t i = 0; i < 2000; ++i) {
+                    object_base *entry = nullptr;
+                    {
+                        object_lock g(entries);
+                        entry = constEntries.u_get(i)->object();
+                    }
+                    entry->as_link<map>().set("count", item(-i));
+                    if (i % 10 == 0) {
+                        entries.push(item(map::object(context)));
+                        root.set("last", item(i));
+                    }
+                }
+            });
+            flat_serialization::write_snapshot(taken, base);
+            modifier.join();
+            flat_serialization::make_base(taken);
+        }
+        EXPECT_NE(expectedJson, jdb_json(context));
+
+        tes_context_standalone restored;
+        flat_reader reader = reader_of(base);
+        flat_serialization::read_context(restored, reader);
+        EXPECT_EQ(objectCount, restored.object_count());
+        EXPECT_EQ(expectedJson, jdb_json(restored));
+
+        // the base is the context as it was when the snapshot got taken: the modifications made since are the delta's
+        const std::string modifiedJson = jdb_json(context);
+        flat_writer delta;
+        flat_serialization::write_context_delta(context, delta);
+
+        tes_context_standalone again;
+        flat_reader baseReader = reader_of(base), deltaReader = reader_of(delta);
+        flat_serialization::read_context_delta(again, &baseReader, deltaReader);
+        EXPECT_EQ(context.object_count(), again.object_count());
+        EXPECT_EQ(modifiedJson, jdb_json(again));
+    }
+
+    // 400k objects: how long the saving thread is blocked if it takes a snapshot only, against writing in whole.
+    // The snapshot is written in background, while 4k objects get modified
+    TEST(flat_format, snapshot_save_perft)
+    {
+        using namespace flat_format_testing;
+
+        tes_context_standalone ctx;
+        map& root = fill_context(ctx, 400000);
+        const array& entries = root.u_get(std::string("entries"))->object()->as_link<array>();
+
+        flat_writer whole, background;
+        util::do_with_timing("flat format saving in whole, 400k objects", [&]() {
+            flat_serialization::write_context(ctx, whole);
+        });
+
+        const std::string expectedJson = jdb_json(ctx);
+        std::unique_ptr<flat_serialization::snapshot> taken;
+        util::do_with_timing("flat format taking a snapshot, 400k objects", [&]() {
+            taken = std::make_unique<flat_serialization::snapshot>(ctx);
+        });
+        auto written = std::async(std::launch::async, [&]() {
+            util::do_with_timing("flat format writing the snapshot in background, 400k objects", [&]() {
+                flat_serialization::write_snapshot(*taken, background);
+            });
+            taken.reset();
+        });
+        util::do_with_timing("modifying 4k objects while the snapshot is being written", [&]() {
+            for (int32_t i = 0; i < 400000; i += 100) {
+                object_base *entry = nullptr;
+                {
+                    object_lock g(entries);
+                    entry = entries.u_get(i)->object();
+                }
+                entry->as_link<map>().set("count", item(-i));
+            }
+        });
+        written.get();
+
+        tes_context_standalone restored;
+        flat_reader reader(background.data().data(), background.data().data() + background.data().size());
+        flat_serialization::read_context(restored, reader, util::hardware_threads());
+        EXPECT_EQ(expectedJson, jdb_json(restored));
+    }
+
     /*
     TEST(tes_context, backward_compatibility)
     {
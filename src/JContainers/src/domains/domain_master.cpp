@@ -1,6 +1,12 @@
 #include <vector>
 #include <map>
 #include <functional>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <mutex>
+#include <future>
+#include <memory>
 #include <exception>
 #include <type_traits>
 
@@ -17,6 +23,11 @@
 #include "util/util.h"
 #include "util/istring.h"
 #include "iarchive_with_blob.h"
+#include "collections/flat_serialization.h"
+#include "collections/persistence_profile.h"
+#include "util/lz4.h"
+#include "util/record_stream.h"
+#include "util/concurrency.h"
 
 #include "object/object_context.h"
 #include "domains/domain_master.h"
@@ -88,6 +99,8 @@ namespace domain_master {
 
 
         auto u_clearState(master& ths) -> void {
+            ths.delta_base = {};
+            ths.inactive_domains.clear();
             ths.get_form_observer().u_clearState();
             invoke_for_all(ths, std::mem_fn(&context::u_clearState));
         }
@@ -104,6 +117,10 @@ namespace domain_master {
                 JC_log("Domain: %s", pair.first.c_str());
                 pair.second->u_print_stats();
             }
+
+            for (auto& pair : self.inactive_domains) {
+                JC_log("Inactive domain: %s, %lu bytes kept", pair.first.c_str(), pair.second->data.size());
+            }
         }
 
         auto u_delete_inactive_domains(master& self) -> void {
@@ -121,10 +138,17 @@ namespace domain_master {
         }
 
         using serialization_version = collections::serialization_version;
+        using collections::persistence_profile;
 
         struct header {
 
             serialization_version commonVersion;
+            // the data which follows the header is compressed with, if not empty. Only "lz4" is known
+            std::string compression;
+            // the base snapshot a full save has written, see master::delta_saves_directory
+            std::string base;
+            // the base snapshot the data is a delta of
+            std::string deltaOf;
 
             static header imitate_old_header() {
                 return{ serialization_version::no_header };
@@ -135,56 +159,440 @@ namespace domain_master {
             }
 
             static const char *common_version_key() { return "commonVersion"; }
+            static const char *compression_key() { return "compression"; }
+            static const char *lz4_compression() { return "lz4"; }
+            static const char *base_key() { return "base"; }
+            static const char *delta_of_key() { return "deltaOf"; }
 
-            static header read_from_stream(std::istream & stream) {
+            // the size of the JSON in decimal digits, then the JSON
+            static header read_from(util::record_reader& in) {
 
                 uint32_t hdrSize = 0;
-                stream >> hdrSize;
+                if (!util::read_decimal(in, hdrSize)) {
+                    return imitate_old_header();
+                }
 
                 std::vector<char> buffer(hdrSize);
-                stream.read(&buffer.front(), buffer.size());
+                if (in.read(buffer.data(), buffer.size()) != buffer.size()) {
+                    return imitate_old_header();
+                }
 
-                auto js = make_unique_ptr(json_loadb(&buffer.front(), buffer.size(), 0, nullptr), &json_decref);
+                auto js = make_unique_ptr(json_loadb(buffer.data(), buffer.size(), 0, nullptr), &json_decref);
                 if (!js) { // parsing failed
                     return imitate_old_header();
                 }
 
-                return{ (serialization_version)json_integer_value(json_object_get(js.get(), common_version_key())) };
+                auto string_value = [&](const char *key) -> std::string {
+                    auto value = json_string_value(json_object_get(js.get(), key));
+                    return value ? value : "";
+                };
+                return{ (serialization_version)json_integer_value(json_object_get(js.get(), common_version_key())),
+                    string_value(compression_key()), string_value(base_key()), string_value(delta_of_key()) };
             }
 
-            static auto write_to_json() -> decltype(make_unique_ptr((json_t *)nullptr, &json_decref)) {
+            auto write_to_json() const -> decltype(make_unique_ptr((json_t *)nullptr, &json_decref)) {
                 auto header = make_unique_ptr(json_object(), &json_decref);
 
-                json_object_set(header.get(), common_version_key(), json_integer((json_int_t)serialization_version::current));
+                json_object_set_new(header.get(), common_version_key(), json_integer((json_int_t)commonVersion));
+                for (auto& pair : { std::make_pair(compression_key(), &compression), std::make_pair(base_key(), &base),
+                    std::make_pair(delta_of_key(), &deltaOf) })
+                {
+                    if (!pair.second->empty()) {
+                        json_object_set_new(header.get(), pair.first, json_string(pair.second->c_str()));
+                    }
+                }
 
                 return header;
             }
 
-            static void write_to_stream(std::ostream & stream) {
+            void write_to(util::record_writer& out) const {
                 auto header = write_to_json();
                 auto data = make_unique_ptr(json_dumps(header.get(), 0), free);
 
                 uint32_t hdrSize = strlen(data.get());
-                stream << (uint32_t)hdrSize;
-                stream.write(data.get(), hdrSize);
+                util::write_decimal(out, hdrSize);
+                out.write(data.get(), hdrSize);
             }
         };
 
-        auto read_from_stream(master& self, std::istream& stream) -> void {
-            //_context.read_from_stream(s);
+        auto serialization_threads() -> size_t {
+            return util::hardware_threads();
+        }
+
+        // What the contexts are written as: in whole, in whole as the base snapshot of the next deltas, or as deltas
+        enum class flat_payload {
+            full,
+            base,
+            delta,
+        };
+
+        using encoded_state = context::encoded_state;
+
+        // Snapshots of the domains, taken at once (see flat_serialization::snapshot): the default domain's one goes first
+        struct flat_snapshots {
+            std::vector<util::istring> names; // of the active domains
+            std::vector<std::unique_ptr<collections::flat_serialization::snapshot> > domains;
+            // the domains written as they were read: the active ones not decoded yet and the inactive ones
+            std::vector<std::pair<util::istring, std::shared_ptr<encoded_state> > > encoded;
+        };
+
+        // With @journalRemovals the snapshots may become the base of delta saves, see flat_serialization::make_base
+        auto take_flat_snapshots(master& self, size_t threadCount = serialization_threads(), bool journalRemovals = false) -> flat_snapshots {
+            using namespace collections;
+
+            std::vector<context*> domains{ &self.get_default_domain() };
+            std::vector<util::istring> names{ util::istring() };
+            for (auto& pair : self.active_domains_map()) {
+                names.push_back(pair.first);
+                domains.push_back(pair.second.get());
+            }
+
+            // the lock keeps a domain, which isn't decoded yet, from getting decoded while the others are taken
+            std::vector<std::unique_ptr<flat_serialization::snapshot> > snapshots(domains.size());
+            std::vector<std::shared_ptr<encoded_state> > deferred(domains.size());
+            util::for_each_concurrently(domains.size(), threadCount, [&](size_t idx) {
+                auto lock = domains[idx]->deferred_state_lock();
+                deferred[idx] = domains[idx]->u_deferred_state();
+                if (!deferred[idx]) {
+                    snapshots[idx] = std::make_unique<flat_serialization::snapshot>(*domains[idx], journalRemovals);
+                }
+            });
+
+            flat_snapshots taken;
+            taken.domains.push_back(std::move(snapshots[0]));
+            for (size_t idx = 1; idx < domains.size(); ++idx) {
+                if (snapshots[idx]) {
+                    taken.names.push_back(names[idx]);
+                    taken.domains.push_back(std::move(snapshots[idx]));
+                }
+                else {
+                    taken.encoded.emplace_back(names[idx], deferred[idx]);
+                }
+            }
+            for (auto& pair : self.inactive_domains) {
+                taken.encoded.emplace_back(pair.first, pair.second);
+            }
+            return taken;
+        }
+
+        // The flat format counterpart of boost's save/load of the master, see domain_master_serialization.h:
+        // the default domain, then the number of other domains, each one is a name and a context.
+        // The contexts are length-prefixed blocks. The form observer isn't written - form tables rebuild it.
+        // The domains don't share anything but the form observer, so that they are written and read concurrently.
+        // The domains kept encoded are written as they were read. A delta can't have them as deltas: they follow
+        // the delta's domains, in the same way, but the block is empty if it's the same as the base has
+        auto write_flat(const flat_snapshots& taken, collections::flat_writer& out, size_t threadCount = serialization_threads(),
+            flat_payload payload = flat_payload::full) -> void
+        {
+            using namespace collections;
+
+            persistence_profile *profile = persistence_profile::current();
+            std::vector<flat_writer> blocks(taken.domains.size());
+            util::for_each_concurrently(taken.domains.size(), threadCount, [&](size_t idx) {
+                const auto started = std::chrono::steady_clock::now();
+                if (payload == flat_payload::delta) {
+                    flat_serialization::write_snapshot_delta(*taken.domains[idx], blocks[idx]);
+                }
+                else {
+                    flat_serialization::write_snapshot(*taken.domains[idx], blocks[idx]);
+                }
+                if (profile) {
+                    const util::istring& name = idx == 0 ? util::istring() : taken.names[idx - 1];
+                    profile->add_domain(std::string(name.data(), name.size()), taken.domains[idx]->objects().size(),
+                        blocks[idx].data().size(), std::chrono::steady_clock::now() - started);
+                }
+            });
+
+            const bool isDelta = payload == flat_payload::delta;
+            out.bytes(blocks[0].data());
+            out.varint(taken.names.size() + (isDelta ? 0 : taken.encoded.size()));
+            for (size_t idx = 0; idx < taken.names.size(); ++idx) {
+                out.bytes(std::string_view(taken.names[idx].data(), taken.names[idx].size()));
+                out.bytes(blocks[idx + 1].data());
+            }
+
+            if (isDelta && !taken.encoded.empty()) {
+                out.varint(taken.encoded.size());
+            }
+            for (auto& pair : taken.encoded) {
+                const std::string_view data = isDelta && pair.second->inBase.load() ? std::string_view() : std::string_view(pair.second->data);
+                out.bytes(std::string_view(pair.first.data(), pair.first.size()));
+                out.bytes(data);
+                if (profile) {
+                    profile->add_domain(std::string(pair.first.data(), pair.first.size()), 0, data.size(), {}, true);
+                }
+            }
+        }
+
+        // Makes the snapshots, written as a base payload, the base of the next delta saves. The activity must be stopped
+        auto u_make_flat_base(master& self, const flat_snapshots& taken, master::delta_base_info base) -> void {
+            for (auto& domain : taken.domains) {
+                collections::flat_serialization::make_base(*domain);
+            }
+            for (auto& pair : taken.encoded) {
+                pair.second->inBase.store(true);
+            }
+            self.delta_base = std::move(base);
+        }
+
+        auto u_reset_flat_base(master& self) -> void {
+            self.delta_base = {};
+            invoke_for_all(self, [](context& ctx) { collections::flat_delta_tracker::of(ctx).u_reset(); });
+        }
+
+        auto write_flat(master& self, collections::flat_writer& out, size_t threadCount = serialization_threads(),
+            flat_payload payload = flat_payload::full) -> void
+        {
+            write_flat(take_flat_snapshots(self, threadCount), out, threadCount, payload);
+        }
+
+        // a block of a domain, written by write_flat
+        struct located_domain {
+            util::istring name; // empty for the default domain, which goes first
+            collections::flat_reader data;
+            // a domain of a delta, which is not a delta. An empty one is the same as the base has
+            bool whole;
+        };
 
-            stream.flags(stream.flags() | std::ios::binary);
+        // locates the blocks of the domains written by write_flat
+        auto locate_flat_domains(collections::flat_reader& in) -> std::vector<located_domain> {
+            using namespace collections;
 
-#       if 0
-            std::ofstream file("dump", std::ios::binary | std::ios::out);
-            std::copy(
-                std::istreambuf_iterator<char>(stream),
-                std::istreambuf_iterator<char>(),
-                std::ostreambuf_iterator<char>(file)
-                );
+            std::vector<located_domain> domains;
+            domains.push_back({ util::istring(), in.block(), false });
+            for (bool whole : { false, true }) {
+                if (whole && in.at_end()) {
+                    break;
+                }
+                for (size_t count = in.count(2); count > 0; --count) {
+                    const auto name = in.bytes();
+                    util::istring domainName(name.data(), name.size());
+                    for (auto& known : domains) {
+                        if (known.name == domainName) {
+                            throw flat_format_error("duplicate domain");
+                        }
+                    }
+                    domains.push_back({ std::move(domainName), in.block(), whole });
+                }
+            }
+            if (!in.at_end()) {
+                throw flat_format_error("trailing data");
+            }
+            return domains;
+        }
+
+        // Reads what write_flat has written. A delta payload requires the payload of its @base,
+        // a domain the base doesn't have is a delta of an empty domain.
+        // The inactive domains are not decoded, but kept in master::inactive_domains, unless written as deltas.
+        // The active ones are not decoded either, but deferred, if master::lazy_domain_loading is set
+        auto read_flat(master& self, collections::flat_reader& in, size_t threadCount = serialization_threads(),
+            flat_payload payload = flat_payload::full, collections::flat_reader *base = nullptr) -> void
+        {
+            using namespace collections;
+
+            auto blocks = locate_flat_domains(in);
+            std::vector<context*> domains{ &self.get_default_domain() };
+            for (size_t i = 1; i < blocks.size(); ++i) {
+                const bool active = self.active_domain_names.count(blocks[i].name) != 0;
+                domains.push_back(active ? &self.get_or_create_domain_with_name(blocks[i].name) : nullptr);
+            }
+
+            std::vector<located_domain> baseDomains;
+            auto base_block = [&](const util::istring& name) -> flat_reader* {
+                for (auto& baseDomain : baseDomains) {
+                    if (baseDomain.name == name) {
+                        return &baseDomain.data;
+                    }
+                }
+                return nullptr;
+            };
+            if (payload == flat_payload::delta) {
+                if (!base) {
+                    throw std::logic_error("delta without a base");
+                }
+                baseDomains = locate_flat_domains(*base);
+            }
+
+            // the threads are shared out among the domains, each domain decodes its chunks on own share
+            std::vector<std::shared_ptr<encoded_state> > inactive(blocks.size());
+            const size_t domainThreads = (std::max)(size_t(1), threadCount / domains.size());
+            persistence_profile *profile = persistence_profile::current();
+            util::for_each_concurrently(domains.size(), threadCount, [&](size_t idx) {
+                const located_domain& block = blocks[idx];
+                context *domain = domains[idx];
+                flat_reader data = block.data;
+
+                const auto started = std::chrono::steady_clock::now();
+                auto report = [&](size_t objectCount, size_t byteCount, bool encoded) {
+                    if (profile) {
+                        profile->add_domain(std::string(block.name.data(), block.name.size()), objectCount, byteCount,
+                            std::chrono::steady_clock::now() - started, encoded);
+                    }
+                };
+
+                if (payload == flat_payload::delta && !block.whole) {
+                    if (domain) {
+                        flat_serialization::read_context_delta(*domain, base_block(block.name), data, domainThreads);
+                        report(domain->object_count(), block.data.remaining(), false);
+                    }
+                    else { // no way to keep it as it is
+                        context decoded(self.get_form_observer());
+                        flat_serialization::read_context_delta(decoded, base_block(block.name), data, domainThreads);
+                        flat_writer writer;
+                        flat_serialization::write_context(decoded, writer);
+                        inactive[idx] = std::make_shared<encoded_state>();
+                        inactive[idx]->data.swap(writer.data());
+                        report(decoded.object_count(), block.data.remaining(), true);
+                    }
+                    return;
+                }
+
+                const bool fromBase = block.whole && data.at_end();
+                if (fromBase) {
+                    flat_reader *baseData = base_block(block.name);
+                    if (!baseData) {
+                        throw flat_format_error("domain is missing from the base");
+                    }
+                    data = *baseData;
+                }
+                const bool inBase = payload == flat_payload::base || fromBase;
+
+                const size_t byteCount = data.remaining();
+                if (idx == 0 || (domain && !self.lazy_domain_loading)) {
+                    flat_serialization::read_context(*domain, data, domainThreads, inBase);
+                    report(domain->object_count(), byteCount, false);
+                    return;
+                }
+
+                auto state = std::make_shared<encoded_state>();
+                state->data.assign(data.position(), data.remaining());
+                flat_serialization::resolve_forms(state->data);
+                state->inBase.store(inBase);
+                report(0, byteCount, true);
+                if (domain) {
+                    domain->u_defer_loading(std::move(state));
+                }
+                else {
+                    inactive[idx] = std::move(state);
+                }
+            });
+
+            for (size_t idx = 1; idx < blocks.size(); ++idx) {
+                if (inactive[idx]) {
+                    self.inactive_domains[blocks[idx].name] = std::move(inactive[idx]);
+                }
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////////
+
+        // A base snapshot file is the LZ4-framed payload of a full save
+        auto base_snapshot_path(const std::string& directory, const std::string& id) -> boost::filesystem::path {
+            return boost::filesystem::path(directory) / (id + ".jcbase");
+        }
+
+        auto make_base_snapshot_id() -> std::string {
+            const auto time = std::chrono::system_clock::now().time_since_epoch();
+            std::ostringstream id;
+            id << std::hex << std::chrono::duration_cast<std::chrono::microseconds>(time).count() << '-' << std::random_device()();
+            return id.str();
+        }
+
+        auto write_base_snapshot(const std::string& directory, const std::string& id, const std::string& payload) -> bool {
+            namespace fs = boost::filesystem;
+
+            boost::system::error_code error;
+            fs::create_directories(fs::path(directory), error);
+            std::ofstream file(base_snapshot_path(directory, id).generic_string(), std::ios::out | std::ios::binary);
+            util::lz4::write_frames(file, payload, (std::max)(master::save_compression_level(), int(util::lz4::min_level)));
             file.close();
-#       endif
+            return !file.fail();
+        }
 
+        auto read_base_snapshot(const std::string& directory, const std::string& id, std::string& payload) -> bool {
+            if (directory.empty()) {
+                return false;
+            }
+            std::ifstream file(base_snapshot_path(directory, id).generic_string(), std::ios::in | std::ios::binary);
+            if (!file) {
+                return false;
+            }
+            const std::string frames{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+            return util::lz4::read_frames(frames, payload);
+        }
+
+        // Writes a delta if the domains have a base snapshot (@base) and the delta is small enough, otherwise a full payload,
+        // which gets written into @directory as the new base snapshot. Returns the header of the payload: the base's id is set
+        // if the payload should become the base, see u_make_flat_base. Only writes, the domains and the master are not changed
+        auto write_flat_payload(const flat_snapshots& taken, const master::delta_base_info& base, const std::string& directory,
+            std::string& payload) -> header
+        {
+            using namespace collections;
+
+            header hdr = header::make();
+            if (directory.empty()) {
+                flat_writer writer;
+                write_flat(taken, writer);
+                payload.swap(writer.data());
+                return hdr;
+            }
+
+            if (!base.id.empty() && boost::filesystem::exists(base_snapshot_path(directory, base.id))) {
+                flat_writer delta;
+                write_flat(taken, delta, serialization_threads(), flat_payload::delta);
+                if (delta.data().size() <= base.size / 2) {
+                    hdr.deltaOf = base.id;
+                    payload.swap(delta.data());
+                    return hdr;
+                }
+                if (auto profile = persistence_profile::current()) {
+                    profile->discard_counts();
+                }
+            }
+
+            flat_writer writer;
+            write_flat(taken, writer, serialization_threads(), flat_payload::base);
+            payload.swap(writer.data());
+
+            const std::string id = make_base_snapshot_id();
+            persistence_profile::timer baseTimer{ persistence_profile::base_snapshot };
+            if (write_base_snapshot(directory, id, payload)) {
+                hdr.base = id;
+            }
+            else {
+                JC_log("Unable to write the base snapshot %s of delta saves", base_snapshot_path(directory, id).generic_string().c_str());
+            }
+            return hdr;
+        }
+
+        auto read_flat_payload(master& self, const header& hdr, collections::flat_reader& reader) -> void {
+            using namespace collections;
+
+            const std::string directory = master::delta_saves_directory();
+            if (!hdr.deltaOf.empty()) {
+                std::string base;
+                persistence_profile::timer baseTimer{ persistence_profile::base_snapshot };
+                if (!read_base_snapshot(directory, hdr.deltaOf, base)) {
+                    throw std::logic_error("The base snapshot '" + hdr.deltaOf + "' of the delta save is missing or damaged");
+                }
+                baseTimer.stop();
+                flat_reader baseReader(base.data(), base.data() + base.size());
+                read_flat(self, reader, serialization_threads(), flat_payload::delta, &baseReader);
+                self.delta_base = { hdr.deltaOf, base.size() };
+            }
+            else if (!hdr.base.empty() && !directory.empty()) {
+                const size_t size = reader.remaining();
+                read_flat(self, reader, serialization_threads(), flat_payload::base);
+                self.delta_base = { hdr.base, size };
+            }
+            else {
+                read_flat(self, reader);
+            }
+        }
+
+        auto read_from(master& self, util::record_reader& in) -> void {
+            auto profile = std::make_shared<persistence_profile>("load");
+            persistence_profile::scope profiling{ profile };
             activity_stopper stopper{ self };
             {
                 // i have assumed that Skyrim devs are not idiots to run scripts in process of save game loading
@@ -192,11 +600,13 @@ namespace domain_master {
 
                 u_clearState(self);
 
-                if (stream.peek() != std::istream::traits_type::eof()) {
+                if (!in.at_end()) {
 
                     try {
 
-                        auto hdr = header::read_from_stream(stream);
+                        persistence_profile::timer headerTimer{ persistence_profile::header };
+                        auto hdr = header::read_from(in);
+                        headerTimer.stop();
                         bool isNotSupported = serialization_version::current < hdr.commonVersion
                             || hdr.commonVersion <= serialization_version::no_header;
 
@@ -207,7 +617,33 @@ namespace domain_master {
                             throw std::logic_error(error.str());
                         }
 
-                        {
+                        if (!hdr.compression.empty() && hdr.compression != header::lz4_compression()) {
+                            throw std::logic_error("Unknown compression '" + hdr.compression + "'");
+                        }
+
+                        if (hdr.commonVersion > serialization_version::pre_flat_format) {
+                            std::string data;
+                            {
+                                persistence_profile::timer streamTimer{ persistence_profile::stream };
+                                in.read_rest(data);
+                            }
+                            const size_t storedSize = data.size();
+                            if (!hdr.compression.empty()) {
+                                persistence_profile::timer compressionTimer{ persistence_profile::compression };
+                                std::string decompressed;
+                                if (!util::lz4::read_frames(data, decompressed)) {
+                                    throw std::logic_error("Malformed compressed data");
+                                }
+                                data.swap(decompressed);
+                            }
+                            profile->set_sizes(storedSize, data.size());
+                            collections::flat_reader reader(data.data(), data.data() + data.size());
+                            read_flat_payload(self, hdr, reader);
+                        }
+                        else {
+                            persistence_profile::timer streamTimer{ persistence_profile::stream };
+                            util::record_streambuf buffer(in);
+                            std::istream stream(&buffer);
                             hack::iarchive_with_blob real_archive(stream, self.get_default_domain(), self.get_default_domain());
                             boost::archive::binary_iarchive& archive = real_archive;
 
@@ -223,8 +659,14 @@ namespace domain_master {
 
                         u_delete_inactive_domains(self);
 
-                        invoke_for_all(self, std::mem_fn(&context::u_postLoadInitializations));
-                        invoke_for_all(self, std::mem_fn(&context::u_applyUpdates), hdr.commonVersion);
+                        {
+                            persistence_profile::timer postLoadTimer{ persistence_profile::post_load };
+                            if (hdr.commonVersion <= serialization_version::pre_flat_format) { // the flat format reader does it while reading
+                                invoke_for_all(self, std::mem_fn(&context::u_postLoadInitializations));
+                            }
+                            invoke_for_all(self, std::mem_fn(&context::u_applyUpdates), hdr.commonVersion);
+                        }
+                        persistence_profile::timer gcTimer{ persistence_profile::garbage_collection };
                         invoke_for_all(self, std::mem_fn(&context::u_postLoadMaintenance), hdr.commonVersion);
                     }
                     catch (const std::exception& exc) {
@@ -249,25 +691,102 @@ namespace domain_master {
 
         }
 
-        auto write_to_stream(master& self, std::ostream& stream) -> void {
-            stream.flags(stream.flags() | std::ios::binary);
+        // the writer gets flushed
+        auto write_to(master& self, util::record_writer& out, serialization_version version) -> void {
+            // [(name, domain)] -> stream
+            auto profile = std::make_shared<persistence_profile>("save");
+            persistence_profile::scope profiling{ profile };
 
-            activity_stopper s{ self };
-            {
+            // boost archive is written as it always was, uncompressed and in whole. The inactive domains are not written
+            if (version == serialization_version::pre_flat_format) {
+                invoke_for_all(self, std::mem_fn(&context::ensure_loaded));
+                activity_stopper s{ self };
                 // we can also cleanup objects here
+                self.get_form_observer().u_remove_expired_forms();
+
+                header hdr = header::make();
+                hdr.commonVersion = version;
+                hdr.write_to(out);
+                const uint64_t payloadAt = out.written();
+
+                u_reset_flat_base(self);
                 {
-                    self.get_form_observer().u_remove_expired_forms();
+                    util::record_streambuf buffer(out);
+                    std::ostream stream(&buffer);
+                    persistence_profile::timer streamTimer{ persistence_profile::stream };
+                    boost::archive::binary_oarchive arch{ stream };
+                    arch << self;
                 }
+                out.flush();
+                profile->set_sizes(out.written() - payloadAt, out.written() - payloadAt);
 
-                header::write_to_stream(stream);
-                boost::archive::binary_oarchive arch{ stream };
+                u_print_stats(self);
+                return;
+            }
 
-                // [(name, domain)] -> stream
+            // Only the snapshots get taken here. The domains are written in background, while the objects may get modified,
+            // the calling thread waits for the bytes. The delta tracking is changed here only, while the activity is stopped:
+            // the snapshots journal the removals since they are taken, and a base payload becomes the base afterwards
+            const std::string directory = master::delta_saves_directory();
+            std::shared_ptr<flat_snapshots> taken;
+            std::future<std::pair<header, std::string> > written;
+            {
+                activity_stopper s{ self };
+                self.get_form_observer().u_remove_expired_forms();
+                if (directory.empty()) {
+                    u_reset_flat_base(self);
+                }
+                const master::delta_base_info base = self.delta_base;
+
+                persistence_profile::timer snapshotTimer{ persistence_profile::snapshot };
+                taken = std::make_shared<flat_snapshots>(take_flat_snapshots(self, serialization_threads(), !directory.empty()));
+                snapshotTimer.stop();
+                written = std::async(std::launch::async, [taken, base, directory]() {
+                    std::string payload;
+                    header hdr = write_flat_payload(*taken, base, directory, payload);
+                    return std::make_pair(std::move(hdr), std::move(payload));
+                });
+            }
 
-                arch << self;
+            auto result = written.get();
+            header& hdr = result.first;
+            if (!directory.empty() && hdr.deltaOf.empty()) {
+                activity_stopper s{ self };
+                if (!hdr.base.empty()) {
+                    u_make_flat_base(self, *taken, { hdr.base, result.second.size() });
+                }
+                else {
+                    u_reset_flat_base(self);
+                }
+            }
+            taken.reset(); // the objects may get deleted again
 
-                u_print_stats(self);
+            const int compressionLevel = master::save_compression_level();
+            if (compressionLevel > 0) {
+                hdr.compression = header::lz4_compression();
+            }
+            {
+                persistence_profile::timer headerTimer{ persistence_profile::header };
+                hdr.write_to(out);
+            }
+
+            // the compression writes as it goes, so that the stream time is the time of the flush only
+            const uint64_t payloadAt = out.written();
+            if (compressionLevel > 0) {
+                persistence_profile::timer compressionTimer{ persistence_profile::compression };
+                util::lz4::write_frames(out, result.second, compressionLevel);
+            }
+            else {
+                persistence_profile::timer streamTimer{ persistence_profile::stream };
+                out.write(result.second);
             }
+            {
+                persistence_profile::timer streamTimer{ persistence_profile::stream };
+                out.flush();
+            }
+            profile->set_sizes(out.written() - payloadAt, result.second.size());
+
+            u_print_stats(self);
         }
 
 
@@ -288,8 +807,12 @@ namespace domain_master {
 
     context* master::get_domain_if_active(const util::istring& name)
     {
-        return active_domain_names.find(name) != active_domain_names.end()
-            ? &get_or_create_domain_with_name(name) : nullptr;
+        if (active_domain_names.find(name) == active_domain_names.end()) {
+            return nullptr;
+        }
+        context& domain = get_or_create_domain_with_name(name);
+        domain.ensure_loaded();
+        return &domain;
     }
 
     context& master::get_default_domain()
@@ -329,11 +852,47 @@ namespace domain_master {
     }
 
     void master::read_from_stream(std::istream& s) {
-        domain_master::read_from_stream(*this, s);
+        util::stream_record_source source(s);
+        util::record_reader reader(source);
+        domain_master::read_from(*this, reader);
     }
 
-    void master::write_to_stream(std::ostream& s) {
-        domain_master::write_to_stream(*this, s);
+    void master::write_to_stream(std::ostream& s, collections::serialization_version version) {
+        util::stream_record_sink sink(s);
+        util::record_writer writer(sink);
+        domain_master::write_to(*this, writer, version);
+    }
+
+    void master::read_from(util::record_reader& in) {
+        domain_master::read_from(*this, in);
+    }
+
+    void master::write_to(util::record_writer& out, collections::serialization_version version) {
+        domain_master::write_to(*this, out, version);
+    }
+
+    std::atomic<int>& master::save_compression_level_setting() {
+        static std::atomic<int> level{ util::lz4::min_level };
+        return level;
+    }
+
+    void master::set_save_compression_level(int level) {
+        save_compression_level_setting().store(std::min(std::max(level, 0), int(util::lz4::max_level)), std::memory_order_relaxed);
+    }
+
+    namespace {
+        std::mutex g_delta_saves_mutex;
+        std::string g_delta_saves_directory;
+    }
+
+    std::string master::delta_saves_directory() {
+        std::lock_guard<std::mutex> guard(g_delta_saves_mutex);
+        return g_delta_saves_directory;
+    }
+
+    void master::set_delta_saves_directory(std::string directory) {
+        std::lock_guard<std::mutex> guard(g_delta_saves_mutex);
+        g_delta_saves_directory = std::move(directory);
     }
 
     namespace testing {
@@ -357,6 +916,412 @@ namespace domain_master {
             EXPECT_TRUE(m.active_domains_map().empty());
         }
 
+        TEST(master, flat_format_round_trip)
+        {
+            using namespace collections;
+
+            auto write_state = [](master& m, serialization_version version) {
+                std::ostringstream stream;
+                m.write_to_stream(stream, version);
+                return stream.str();
+            };
+
+            master m;
+            m.active_domain_names = { "active" };
+            map::object(m.get_default_domain()).tes_retain();
+            auto& domain = m.get_or_create_domain_with_name("active");
+            array::object(domain).tes_retain();
+            array::object(domain).tes_retain();
+            m.get_or_create_domain_with_name("inactive");
+
+            for (auto version : { serialization_version::current, serialization_version::pre_flat_format }) {
+                const std::string state = write_state(m, version);
+
+                master restored;
+                restored.active_domain_names = { "active" };
+                std::istringstream stream{ state };
+                restored.read_from_stream(stream);
+
+                EXPECT_EQ(1, restored.get_default_domain().object_count());
+                EXPECT_EQ(1, restored.active_domains_map().size());
+                ASSERT_TRUE(restored.get_domain_if_active("active") != nullptr);
+                EXPECT_EQ(2, restored.get_domain_if_active("active")->object_count());
+            }
+        }
+
+        TEST(master, compressed_saves)
+        {
+            using namespace collections;
+
+            auto write_state = [](master& m, int compressionLevel) {
+                const int previousLevel = master::save_compression_level();
+                master::set_save_compression_level(compressionLevel);
+                std::ostringstream stream;
+                m.write_to_stream(stream);
+                master::set_save_compression_level(previousLevel);
+                return stream.str();
+            };
+            auto read_state = [](master& m, const std::string& state) {
+                std::istringstream stream{ state };
+                m.read_from_stream(stream);
+                return m.get_default_domain().object_count();
+            };
+
+            master m;
+            for (int i = 0; i < 1000; ++i) {
+                auto& obj = map::object(m.get_default_domain());
+                obj.u_set("name", item("object #" + std::to_string(i % 10)));
+                obj.tes_retain();
+            }
+
+            const std::string uncompressed = write_state(m, 0);
+            const std::string fastest = write_state(m, 1);
+            const std::string smallest = write_state(m, 9);
+            EXPECT_TRUE(fastest.size() < uncompressed.size());
+            EXPECT_TRUE(smallest.size() <= fastest.size());
+
+            master restored;
+            EXPECT_EQ(1000, read_state(restored, uncompressed));
+            EXPECT_EQ(1000, read_state(restored, fastest));
+            EXPECT_EQ(1000, read_state(restored, smallest));
+
+            EXPECT_EQ(0, read_state(restored, fastest.substr(0, fastest.size() - 1)));
+            std::string unknownCompression = fastest;
+            unknownCompression.replace(unknownCompression.find("lz4"), 3, "lz5");
+            EXPECT_EQ(0, read_state(restored, unknownCompression));
+        }
+
+        // 1 default + 8 active domains, 50k objects each: sequential and concurrent writing and reading of the flat format
+        TEST(master, concurrent_serialization_perft)
+        {
+            using namespace collections;
+
+            const int domainCount = 8, objectCount = 50000;
+
+            master m;
+            auto fill = [](context& domain) {
+                for (int i = 0; i < objectCount; ++i) {
+                    auto& obj = map::object(domain);
+                    obj.u_set("index", item(i));
+                    obj.u_set("name", item("object #" + std::to_string(i % 100)));
+                    obj.u_set("form", item(forms::make_weak_form_id((FormId)(0x14000000 | i), domain)));
+                    obj.tes_retain();
+                }
+            };
+            fill(m.get_default_domain());
+            for (int i = 0; i < domainCount; ++i) {
+                m.active_domain_names.insert("domain" + std::to_string(i));
+                fill(m.get_or_create_domain_with_name("domain" + std::to_string(i)));
+            }
+
+            flat_writer sequential, concurrent;
+            util::do_with_timing("writing 9 domains, 1 thread", [&]() {
+                write_flat(m, sequential, 1);
+            });
+            util::do_with_timing("writing 9 domains, concurrently", [&]() {
+                write_flat(m, concurrent);
+            });
+            EXPECT_EQ(sequential.data(), concurrent.data());
+
+            for (size_t threadCount : { size_t(1), serialization_threads() }) {
+                master restored;
+                restored.active_domain_names = m.active_domain_names;
+                restored.lazy_domain_loading = false;
+                util::do_with_timing(threadCount == 1 ? "reading 9 domains, 1 thread" : "reading 9 domains, concurrently", [&]() {
+                    flat_reader reader(concurrent.data().data(), concurrent.data().data() + concurrent.data().size());
+                    read_flat(restored, reader, threadCount);
+                });
+
+                EXPECT_EQ(objectCount, restored.get_default_domain().object_count());
+                EXPECT_EQ(domainCount, restored.active_domains_map().size());
+                for (auto& pair : restored.active_domains_map()) {
+                    EXPECT_EQ(objectCount, pair.second->object_count());
+                }
+            }
+        }
+
+        TEST(master, delta_saves)
+        {
+            using namespace collections;
+            namespace fs = boost::filesystem;
+
+            auto write_state = [](master& m) {
+                std::ostringstream stream;
+                m.write_to_stream(stream);
+                return stream.str();
+            };
+            auto read_state = [](master& m, const std::string& state) {
+                std::istringstream stream{ state };
+                m.read_from_stream(stream);
+                return m.get_default_domain().object_count();
+            };
+            auto snapshot_count = [](const fs::path& directory) {
+                return std::distance(fs::directory_iterator(directory), fs::directory_iterator());
+            };
+            auto changed_count = [](context& ctx) {
+                return ctx.filter_objects([](object_base& obj) {
+                    auto cnt = obj.as<map>();
+                    auto value = cnt ? cnt->u_get(std::string("name")) : nullptr;
+                    auto str = value ? value->get<std::string>() : nullptr;
+                    return str && *str == "changed";
+                }).size();
+            };
+
+            const fs::path directory = fs::temp_directory_path() / fs::unique_path("jc-delta-saves-%%%%-%%%%");
+            const std::string previousDirectory = master::delta_saves_directory();
+            master::set_delta_saves_directory(directory.generic_string());
+
+            master m;
+            m.active_domain_names = { "active" };
+            std::vector<map*> maps;
+            for (int i = 0; i < 1000; ++i) {
+                auto& obj = map::object(m.get_default_domain());
+                obj.u_set("name", item("object #" + std::to_string(i)));
+                obj.tes_retain();
+                maps.push_back(&obj);
+            }
+
+            // the first save is full and writes the base snapshot
+            const std::string full = write_state(m);
+            EXPECT_NE(std::string::npos, full.find("\"base\""));
+            EXPECT_EQ(1, snapshot_count(directory));
+
+            // a changed object and a domain the snapshot doesn't have make a delta
+            maps[0]->u_set("name", item("changed"));
+            array::object(m.get_or_create_domain_with_name("active")).tes_retain();
+            const std::string delta = write_state(m);
+            EXPECT_NE(std::string::npos, delta.find("\"deltaOf\""));
+            EXPECT_TRUE(delta.size() * 4 < full.size());
+
+            master restored;
+            restored.active_domain_names = { "active" };
+            EXPECT_EQ(1000, read_state(restored, delta));
+            EXPECT_EQ(1, changed_count(restored.get_default_domain()));
+            ASSERT_TRUE(restored.get_domain_if_active("active") != nullptr);
+            EXPECT_EQ(1, restored.get_domain_if_active("active")->object_count());
+
+            // the loaded delta's snapshot stays the base of the next saves
+            const std::string restoredDelta = write_state(restored);
+            EXPECT_NE(std::string::npos, restoredDelta.find("\"deltaOf\""));
+            master again;
+            EXPECT_EQ(1000, read_state(again, restoredDelta));
+            EXPECT_EQ(1, changed_count(again.get_default_domain()));
+
+            // once a delta exceeds a half of the snapshot, the save is full and writes a new snapshot
+            for (int i = 0; i < 1000; ++i) {
+                maps[i]->u_set("name", item("changed"));
+                auto& obj = map::object(m.get_default_domain());
+                obj.u_set("name", item("a new object, unlike the others #" + std::to_string(i)));
+                obj.tes_retain();
+            }
+            const std::string rewritten = write_state(m);
+            EXPECT_NE(std::string::npos, rewritten.find("\"base\""));
+            EXPECT_EQ(2, snapshot_count(directory));
+            EXPECT_EQ(2000, read_state(again, rewritten));
+            EXPECT_EQ(1000, changed_count(again.get_default_domain()));
+
+            // a delta without its snapshot fails to load
+            fs::remove_all(directory);
+            EXPECT_EQ(0, read_state(again, delta));
+
+            master::set_delta_saves_directory(previousDirectory);
+        }
+
+        // the inactive domains are kept as they were read, the active ones get decoded on the first use
+        TEST(master, inactive_and_deferred_domains)
+        {
+            using namespace collections;
+            namespace fs = boost::filesystem;
+
+            auto write_state = [](master& m) {
+                std::ostringstream stream;
+                m.write_to_stream(stream);
+                return stream.str();
+            };
+            auto read_state = [](master& m, const std::string& state) {
+                std::istringstream stream{ state };
+                m.read_from_stream(stream);
+            };
+            auto fill = [](context& domain, int count) {
+                for (int i = 0; i < count; ++i) {
+                    auto& obj = map::object(domain);
+                    obj.u_set("name", item("object #" + std::to_string(i)));
+                    obj.u_set("form", item(forms::make_weak_form_id((FormId)(0x14000000 | i), domain)));
+                    obj.tes_retain();
+                }
+            };
+
+            master m;
+            m.active_domain_names = { "active", "inactive" };
+            fill(m.get_default_domain(), 100);
+            fill(m.get_or_create_domain_with_name("active"), 200);
+            fill(m.get_or_create_domain_with_name("inactive"), 300);
+            const std::string state = write_state(m);
+
+            master restored;
+            restored.active_domain_names = { "active" };
+            read_state(restored, state);
+            EXPECT_EQ(100, restored.get_default_domain().object_count());
+            EXPECT_EQ(1, restored.inactive_domains.size());
+            EXPECT_EQ(1, restored.inactive_domains.count("inactive"));
+            ASSERT_EQ(1, restored.active_domains_map().count("active"));
+            EXPECT_EQ(0, restored.active_domains_map().at("active")->object_count()); // not decoded yet
+
+            // saved again, the domain which isn't decoded yet and the inactive one are the same
+            const std::string again = write_state(restored);
+            master all;
+            all.active_domain_names = { "active", "inactive" };
+            read_state(all, again);
+            ASSERT_TRUE(all.get_domain_if_active("active") != nullptr);
+            EXPECT_EQ(200, all.get_domain_if_active("active")->object_count());
+            ASSERT_TRUE(all.get_domain_if_active("inactive") != nullptr);
+            EXPECT_EQ(300, all.get_domain_if_active("inactive")->object_count());
+            EXPECT_TRUE(all.inactive_domains.empty());
+
+            ASSERT_TRUE(restored.get_domain_if_active("active") != nullptr);
+            EXPECT_EQ(200, restored.get_domain_if_active("active")->object_count());
+            restored.clear_state();
+            EXPECT_TRUE(restored.inactive_domains.empty());
+
+            // a delta has the inactive domain as the base has it
+            const fs::path directory = fs::temp_directory_path() / fs::unique_path("jc-delta-saves-%%%%-%%%%");
+            const std::string previousDirectory = master::delta_saves_directory();
+            master::set_delta_saves_directory(directory.generic_string());
+
+            master withBase;
+            withBase.active_domain_names = { "active" };
+            read_state(withBase, state);
+            const std::string full = write_state(withBase);
+            EXPECT_NE(std::string::npos, full.find("\"base\""));
+            map::object(withBase.get_default_domain()).tes_retain();
+            const std::string delta = write_state(withBase);
+            EXPECT_NE(std::string::npos, delta.find("\"deltaOf\""));
+            EXPECT_TRUE(delta.size() * 4 < full.size());
+
+            read_state(all, delta);
+            EXPECT_EQ(101, all.get_default_domain().object_count());
+            EXPECT_EQ(200, all.get_domain_if_active("active")->object_count());
+            EXPECT_EQ(300, all.get_domain_if_active("inactive")->object_count());
+
+            fs::remove_all(directory);
+            master::set_delta_saves_directory(previousDirectory);
+        }
+
+        // 1 default, 1 active and 4 inactive domains, 50k objects each: loading when all of them get decoded,
+        // against loading when the inactive ones are kept as they are and the active one is decoded on the first use
+        TEST(master, inactive_domains_loading_perft)
+        {
+            using namespace collections;
+
+            const int inactiveCount = 4, objectCount = 50000;
+
+            auto fill = [](context& domain) {
+                for (int i = 0; i < objectCount; ++i) {
+                    auto& obj = map::object(domain);
+                    obj.u_set("index", item(i));
+                    obj.u_set("name", item("object #" + std::to_string(i % 100)));
+                    obj.u_set("form", item(forms::make_weak_form_id((FormId)(0x14000000 | i), domain)));
+                    obj.tes_retain();
+                }
+            };
+
+            master m;
+            fill(m.get_default_domain());
+            m.active_domain_names.insert("active");
+            fill(m.get_or_create_domain_with_name("active"));
+            for (int i = 0; i < inactiveCount; ++i) {
+                m.active_domain_names.insert("inactive" + std::to_string(i));
+                fill(m.get_or_create_domain_with_name("inactive" + std::to_string(i)));
+            }
+
+            std::ostringstream stream;
+            m.write_to_stream(stream);
+            const std::string state = stream.str();
+
+            master eager;
+            eager.active_domain_names = m.active_domain_names;
+            eager.lazy_domain_loading = false;
+            util::do_with_timing("loading 6 domains, all decoded", [&]() {
+                std::istringstream in{ state };
+                eager.read_from_stream(in);
+            });
+            EXPECT_EQ(inactiveCount + 1, eager.active_domains_map().size());
+
+            master lazy;
+            lazy.active_domain_names = { "active" };
+            util::do_with_timing("loading 6 domains, 4 inactive kept, 1 deferred", [&]() {
+                std::istringstream in{ state };
+                lazy.read_from_stream(in);
+            });
+            EXPECT_EQ(objectCount, lazy.get_default_domain().object_count());
+            EXPECT_EQ(inactiveCount, lazy.inactive_domains.size());
+
+            util::do_with_timing("decoding the deferred domain on the first use", [&]() {
+                EXPECT_EQ(objectCount, lazy.get_domain_if_active("active")->object_count());
+            });
+        }
+
+        TEST(master, persistence_profile)
+        {
+            using namespace collections;
+
+            auto fill = [](context& domain, int maps, int arrays) {
+                for (int i = 0; i < maps; ++i) {
+                    map::object(domain).tes_retain();
+                }
+                for (int i = 0; i < arrays; ++i) {
+                    array::object(domain).tes_retain();
+                }
+            };
+            // the profile as it is written next to the log
+            auto last_profile = [](const char *operation) {
+                auto profiles = make_unique_ptr(persistence_profile::last_to_json(), &json_decref);
+                auto text = make_unique_ptr(json_dumps(profiles.get(), JSON_INDENT(2)), free);
+                json_error_t error;
+                auto parsed = make_unique_ptr(json_loads(text.get(), 0, &error), &json_decref);
+                EXPECT_TRUE(parsed != nullptr);
+                return make_unique_ptr(json_incref(json_object_get(parsed.get(), operation)), &json_decref);
+            };
+            auto type_objects = [](json_t *profile, const char *type) {
+                return json_integer_value(json_object_get(json_object_get(json_object_get(profile, "types"), type), "objects"));
+            };
+
+            master m;
+            m.active_domain_names = { "active", "inactive" };
+            fill(m.get_default_domain(), 10, 5);
+            fill(m.get_or_create_domain_with_name("active"), 20, 0);
+            fill(m.get_or_create_domain_with_name("inactive"), 0, 30);
+
+            std::ostringstream stream;
+            m.write_to_stream(stream);
+            auto saved = last_profile("save");
+            ASSERT_TRUE(json_is_object(saved.get()));
+            EXPECT_EQ(30, type_objects(saved.get(), "JMap"));
+            EXPECT_EQ(35, type_objects(saved.get(), "JArray"));
+            EXPECT_EQ(0, type_objects(saved.get(), "JFormMap"));
+            EXPECT_EQ(3, json_array_size(json_object_get(saved.get(), "domains")));
+            EXPECT_EQ(stream.str().size(), stream.str().find('}') + 1 +
+                static_cast<size_t>(json_integer_value(json_object_get(saved.get(), "storedBytes"))));
+
+            // the inactive domain is kept as it is, so that its objects are not counted
+            master restored;
+            restored.active_domain_names = { "active" };
+            restored.lazy_domain_loading = false;
+            std::istringstream in{ stream.str() };
+            restored.read_from_stream(in);
+            auto loaded = last_profile("load");
+            ASSERT_TRUE(json_is_object(loaded.get()));
+            EXPECT_EQ(30, type_objects(loaded.get(), "JMap"));
+            EXPECT_EQ(5, type_objects(loaded.get(), "JArray"));
+            size_t encoded = 0;
+            json_t *domains = json_object_get(loaded.get(), "domains");
+            for (size_t i = 0; i < json_array_size(domains); ++i) {
+                encoded += json_is_true(json_object_get(json_array_get(domains, i), "encoded")) ? 1 : 0;
+            }
+            EXPECT_EQ(3, json_array_size(domains));
+            EXPECT_EQ(1, encoded);
+        }
+
         /*
         TEST(master, backward_compatibility)
         {
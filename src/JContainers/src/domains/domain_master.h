@@ -5,11 +5,17 @@
 #include <map>
 #include <iosfwd>
 #include <memory>
+#include <atomic>
 
 #include "forms/form_observer.h"
 #include "collections/context.h"
 #include "util/istring.h"
 
+namespace util {
+    class record_reader;
+    class record_writer;
+}
+
 namespace domain_master {
 
     using context = ::collections::tes_context;
@@ -24,7 +30,14 @@ namespace domain_master {
 
         std::set<util::istring> active_domain_names;
 
+        // The active domains, read from a save, are decoded on the first use (see tes_context::u_defer_loading), not on load
+        bool lazy_domain_loading = true;
+
+        // The domains a save has, which are not active: kept encoded as read, so that the next saves have them as they were
+        std::map<util::istring, std::shared_ptr<context::encoded_state> > inactive_domains;
+
         context& get_or_create_domain_with_name(const util::istring& name);// or create if none
+        // decodes the domain, if it's not decoded yet
         context* get_domain_if_active(const util::istring& name);
         context& get_default_domain();
 
@@ -39,7 +52,35 @@ namespace domain_master {
 
         void clear_state();
         void read_from_stream(std::istream&);
-        void write_to_stream(std::ostream&);
+        // writes in the current format, pre_flat_format is the other one supported.
+        // The current format is written from snapshots in background, other threads may modify the objects meanwhile
+        void write_to_stream(std::ostream&, collections::serialization_version version = collections::serialization_version::current);
+
+        // the same, but through the buffered record reader and writer (see util/record_stream.h). The writer gets flushed
+        void read_from(util::record_reader& in);
+        void write_to(util::record_writer& out, collections::serialization_version version = collections::serialization_version::current);
+
+        // LZ4 compression level of the saves, from 1 (fastest, the default) to 9. 0 disables the compression.
+        // Loading detects compressed saves by the header, uncompressed ones are loaded as before.
+        // The "saveCompressionLevel" of JCData/settings.json, see apply_settings
+        static int save_compression_level() {
+            return save_compression_level_setting().load(std::memory_order_relaxed);
+        }
+        static void set_save_compression_level(int level);
+
+        // Delta saves: a save holds only the changes made since the base snapshot, a file in @directory written along
+        // with the last full save. A save is full when there is no snapshot yet or when the delta would exceed a half
+        // of the snapshot. Snapshots are never deleted by JContainers. An empty directory (the default) disables delta saves.
+        // The "deltaSavesDirectory" of JCData/settings.json, see apply_settings
+        static std::string delta_saves_directory();
+        static void set_delta_saves_directory(std::string directory);
+
+        // The base snapshot the domains have tracked the changes since. The id is empty if there is none
+        struct delta_base_info {
+            std::string id;
+            size_t size = 0; // of the uncompressed snapshot
+        };
+        delta_base_info delta_base;
 
         // save from stream / load from stream
         // drop (or not save?) loaded contexts if no appropriate config files found?
@@ -50,6 +91,8 @@ namespace domain_master {
         const DomainsMap& active_domains_map() const { return _domains; }
 
     private:
+        static std::atomic<int>& save_compression_level_setting();
+
         // Since it's not a real implementation yet:
         form_observer _form_watcher;
         context _default_domain;
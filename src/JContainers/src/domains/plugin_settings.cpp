@@ -0,0 +1,167 @@
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "boost/filesystem/path.hpp"
+#include "boost/filesystem/operations.hpp"
+
+#include "jansson.h"
+#include "gtest/gtest.h"
+
+#include "util/util.h"
+#include "util/lz4.h"
+#include "collections/json_serialization.h"
+
+#include "domains/domain_master.h"
+#include "domains/plugin_settings.h"
+
+namespace domain_master {
+
+    namespace {
+
+        using namespace collections;
+
+        auto apply_json_reading_backend(json_t *value) -> void {
+            const char *name = json_string_value(value);
+            if (!name) {
+                JC_log("settings: jsonReadingBackend must be a string");
+            }
+            else if (std::strcmp(name, "jansson") == 0) {
+                json_deserializer::set_reading_backend(json_reading_backend::jansson);
+            }
+            else if (std::strcmp(name, "pullParser") == 0) {
+                json_deserializer::set_reading_backend(json_reading_backend::pull_parser);
+            }
+            else if (std::strcmp(name, "structuralIndex") == 0) {
+                json_deserializer::set_reading_backend(json_reading_backend::structural_index);
+            }
+            else {
+                JC_log("settings: unknown jsonReadingBackend '%s'", name);
+            }
+        }
+
+        auto apply_save_compression_level(json_t *value) -> void {
+            const json_int_t level = json_integer_value(value);
+            if (!json_is_integer(value) || level < 0 || level > util::lz4::max_level) {
+                JC_log("settings: saveCompressionLevel must be an integer from 0 to %d", int(util::lz4::max_level));
+            }
+            else {
+                master::set_save_compression_level(static_cast<int>(level));
+            }
+        }
+
+        auto apply_delta_saves_directory(json_t *value) -> void {
+            const char *directory = json_string_value(value);
+            if (!directory) {
+                JC_log("settings: deltaSavesDirectory must be a string");
+            }
+            else if (*directory == '\0' || boost::filesystem::path(directory).is_absolute()) {
+                master::set_delta_saves_directory(directory);
+            }
+            else {
+                master::set_delta_saves_directory(util::relative_to_dll_path(directory).generic_string());
+            }
+        }
+    }
+
+    bool apply_settings(const std::string& path) {
+        if (!boost::filesystem::exists(path)) {
+            return true;
+        }
+
+        json_error_t error;
+        auto settings = make_unique_ptr(json_load_file(path.c_str(), 0, &error), &json_decref);
+        if (!json_is_object(settings.get())) {
+            JC_log("settings: %s isn't a JSON object: %s (line %d)", path.c_str(), error.text, error.line);
+            return false;
+        }
+
+        if (json_t *value = json_object_get(settings.get(), "jsonReadingBackend")) {
+            apply_json_reading_backend(value);
+        }
+        if (json_t *value = json_object_get(settings.get(), "saveCompressionLevel")) {
+            apply_save_compression_level(value);
+        }
+        if (json_t *value = json_object_get(settings.get(), "deltaSavesDirectory")) {
+            apply_delta_saves_directory(value);
+        }
+
+        JC_log("settings: applied %s", path.c_str());
+        return true;
+    }
+
+    namespace testing {
+
+        TEST(plugin_settings, apply_settings)
+        {
+            using namespace collections;
+            namespace fs = boost::filesystem;
+
+            const auto backend = json_deserializer::reading_backend();
+            const int compressionLevel = master::save_compression_level();
+            const std::string deltaSavesDirectory = master::delta_saves_directory();
+            const auto write = [](const fs::path& path, const char *text) {
+                std::ofstream(path.generic_string(), std::ios::out | std::ios::trunc) << text;
+            };
+
+            const fs::path directory = fs::temp_directory_path() / fs::unique_path("jc-settings-%%%%-%%%%");
+            fs::create_directories(directory);
+            const fs::path path = directory / "settings.json";
+
+            EXPECT_TRUE(apply_settings(path.generic_string())); // no file, the defaults stay
+            EXPECT_EQ(backend, json_deserializer::reading_backend());
+
+            write(path, R"({"jsonReadingBackend": "structuralIndex"})");
+            EXPECT_TRUE(apply_settings(path.generic_string()));
+            EXPECT_EQ(json_reading_backend::structural_index, json_deserializer::reading_backend());
+
+            write(path, R"({"jsonReadingBackend": "jansson"})");
+            EXPECT_TRUE(apply_settings(path.generic_string()));
+            EXPECT_EQ(json_reading_backend::jansson, json_deserializer::reading_backend());
+
+            write(path, R"({"jsonReadingBackend": "sax"})");
+            EXPECT_TRUE(apply_settings(path.generic_string()));
+            EXPECT_EQ(json_reading_backend::jansson, json_deserializer::reading_backend());
+
+            write(path, R"({"saveCompressionLevel": 0})");
+            EXPECT_TRUE(apply_settings(path.generic_string()));
+            EXPECT_EQ(0, master::save_compression_level());
+
+            write(path, R"({"saveCompressionLevel": 9, "jsonReadingBackend": "pullParser"})");
+            EXPECT_TRUE(apply_settings(path.generic_string()));
+            EXPECT_EQ(9, master::save_compression_level());
+            EXPECT_EQ(json_reading_backend::pull_parser, json_deserializer::reading_backend());
+
+            for (auto invalid : { R"({"saveCompressionLevel": 10})", R"({"saveCompressionLevel": -1})", R"({"saveCompressionLevel": "fast"})" }) {
+                write(path, invalid);
+                EXPECT_TRUE(apply_settings(path.generic_string()));
+                EXPECT_EQ(9, master::save_compression_level());
+            }
+
+            const std::string snapshots = (directory / "snapshots").generic_string();
+            write(path, (R"({"deltaSavesDirectory": ")" + snapshots + R"("})").c_str());
+            EXPECT_TRUE(apply_settings(path.generic_string()));
+            EXPECT_EQ(snapshots, master::delta_saves_directory());
+
+            write(path, R"({"deltaSavesDirectory": "JCData/DeltaSaves"})");
+            EXPECT_TRUE(apply_settings(path.generic_string()));
+            EXPECT_EQ(util::relative_to_dll_path("JCData/DeltaSaves").generic_string(), master::delta_saves_directory());
+
+            write(path, R"({"deltaSavesDirectory": 1})");
+            EXPECT_TRUE(apply_settings(path.generic_string()));
+            EXPECT_EQ(snapshots, master::delta_saves_directory());
+
+            write(path, R"({"deltaSavesDirectory": ""})");
+            EXPECT_TRUE(apply_settings(path.generic_string()));
+            EXPECT_TRUE(master::delta_saves_directory().empty());
+
+            write(path, R"([1, 2])");
+            EXPECT_FALSE(apply_settings(path.generic_string()));
+
+            json_deserializer::set_reading_backend(backend);
+            master::set_save_compression_level(compressionLevel);
+            master::set_delta_saves_directory(deltaSavesDirectory);
+            fs::remove_all(directory);
+        }
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+namespace domain_master {
+
+    // The settings the plugin reads once, when it gets loaded, from JCData/settings.json. A missing file
+    // or setting keeps the default, an invalid value is logged and ignored:
+    //   {"jsonReadingBackend": "pullParser"}  - how JSON files get parsed: "jansson", "pullParser" or "structuralIndex"
+    //   {"saveCompressionLevel": 1}           - LZ4 compression level of the saves, 0 to 9, see master::save_compression_level
+    //   {"deltaSavesDirectory": ""}           - where the base snapshots of the delta saves go, relative to the DLL
+    //                                           unless absolute. Empty disables delta saves, see master::delta_saves_directory
+    // Returns false if the file exists, but isn't a JSON object
+    bool apply_settings(const std::string& path);
+}
@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+#include "boost/filesystem/operations.hpp"
+
+#include "jansson.h"
+#include "gtest/gtest.h"
+
+#include "util/util.h"
+#include "util/istring.h"
+#include "util/record_stream.h"
+#include "object/object_registry.h"
+#include "collections/collections.h"
+#include "collections/json_serialization.h"
+#include "collections/persistence_profile.h"
+
+#include "domains/domain_master.h"
+#include "domains/save_inspector.h"
+
+namespace domain_master {
+
+    namespace {
+
+        using namespace collections;
+
+        // the more roots a domain has, the longer the subtrees take: the largest roots are explored only
+        enum : size_t { explored_roots_limit = 4096 };
+
+        auto milliseconds(std::chrono::steady_clock::duration time) -> double {
+            return std::chrono::duration_cast<std::chrono::microseconds>(time).count() / 1000.0;
+        }
+
+        // 0, 1, 2-3, 4-7 ...
+        auto size_bucket(uint32_t count) -> size_t {
+            size_t bucket = 0;
+            for (; count != 0; count >>= 1) {
+                ++bucket;
+            }
+            return bucket;
+        }
+
+        auto size_bucket_name(size_t bucket) -> std::string {
+            if (bucket <= 1) {
+                return std::to_string(bucket);
+            }
+            const uint64_t first = uint64_t(1) << (bucket - 1);
+            return std::to_string(first) + "-" + std::to_string(first * 2 - 1);
+        }
+
+        auto load_record(master& self, const std::string& record) -> void {
+            util::memory_record_source source(record);
+            util::record_reader reader(source);
+            self.read_from(reader);
+        }
+
+        // a root and what it keeps alive
+        struct subtree {
+            object_base *root;
+            uint64_t objects;
+            uint64_t elements;
+        };
+
+        auto largest_subtrees(context& domain, size_t count) -> std::vector<subtree> {
+            std::vector<object_base*> roots;
+            object_base *database = domain.u_getObject(domain.u_root_object_id());
+            for (auto obj : domain.registry->u_all_objects()) {
+                if (obj == database || obj->u_is_user_retains()) {
+                    roots.push_back(obj);
+                }
+            }
+            if (roots.size() > explored_roots_limit) {
+                std::partial_sort(roots.begin(), roots.begin() + explored_roots_limit, roots.end(),
+                    [](object_base *l, object_base *r) { return l->u_count() > r->u_count(); });
+                roots.resize(explored_roots_limit);
+            }
+
+            // an object is visited once per root: its mark is the number of the root
+            std::unordered_map<object_base*, size_t> marks;
+            std::vector<object_base*> toVisit;
+            std::vector<subtree> subtrees;
+            for (size_t idx = 0; idx < roots.size(); ++idx) {
+                subtree tree{ roots[idx], 0, 0 };
+                marks[roots[idx]] = idx;
+                toVisit.assign(1, roots[idx]);
+                while (!toVisit.empty()) {
+                    object_base *obj = toVisit.back();
+                    toVisit.pop_back();
+                    ++tree.objects;
+                    tree.elements += obj->u_count();
+                    obj->u_visit_referenced_objects([&](object_base& referenced) {
+                        auto inserted = marks.emplace(&referenced, idx);
+                        if (inserted.second || inserted.first->second != idx) {
+                            inserted.first->second = idx;
+                            toVisit.push_back(&referenced);
+                        }
+                    });
+                }
+                subtrees.push_back(tree);
+            }
+
+            std::sort(subtrees.begin(), subtrees.end(), [](const subtree& l, const subtree& r) {
+                return l.objects != r.objects ? l.objects > r.objects : l.elements > r.elements;
+            });
+            subtrees.resize((std::min)(count, subtrees.size()));
+            return subtrees;
+        }
+
+        auto inspect_domain(context& domain, const std::string& name, const save_inspection_options& options) -> json_t* {
+            struct type_stats {
+                uint64_t objects = 0;
+                uint64_t elements = 0;
+                std::vector<uint64_t> histogram;
+            };
+            type_stats types[persistence_profile::type_count];
+            std::map<std::string, uint64_t> tags;
+
+            for (auto obj : domain.registry->u_all_objects()) {
+                const auto count = static_cast<uint32_t>((std::max)(obj->u_count(), 0));
+                auto& stats = types[static_cast<size_t>(obj->type()) < persistence_profile::type_count ? obj->type() : CollectionType::None];
+                ++stats.objects;
+                stats.elements += count;
+                const size_t bucket = size_bucket(count);
+                if (stats.histogram.size() <= bucket) {
+                    stats.histogram.resize(bucket + 1);
+                }
+                ++stats.histogram[bucket];
+                if (!obj->_tag.empty()) {
+                    ++tags[std::string(obj->_tag.c_str())];
+                }
+            }
+
+            json_t *report = json_object();
+            json_object_set_new(report, "name", json_string(name.c_str()));
+            json_object_set_new(report, "objects", json_integer(static_cast<json_int_t>(domain.object_count())));
+
+            json_t *typesReport = json_object();
+            for (uint8_t type = 1; type < persistence_profile::type_count; ++type) {
+                const auto& stats = types[type];
+                if (stats.objects == 0) {
+                    continue;
+                }
+                json_t *histogram = json_object();
+                for (size_t bucket = 0; bucket < stats.histogram.size(); ++bucket) {
+                    if (stats.histogram[bucket] != 0) {
+                        json_object_set_new(histogram, size_bucket_name(bucket).c_str(), json_integer(static_cast<json_int_t>(stats.histogram[bucket])));
+                    }
+                }
+                json_t *entry = json_object();
+                json_object_set_new(entry, "objects", json_integer(static_cast<json_int_t>(stats.objects)));
+                json_object_set_new(entry, "elements", json_integer(static_cast<json_int_t>(stats.elements)));
+                json_object_set_new(entry, "sizeHistogram", histogram);
+                json_object_set_new(typesReport, persistence_profile::type_name(type), entry);
+            }
+            json_object_set_new(report, "types", typesReport);
+
+            json_t *tagsReport = json_object();
+            for (auto& pair : tags) {
+                json_object_set_new(tagsReport, pair.first.c_str(), json_integer(static_cast<json_int_t>(pair.second)));
+            }
+            json_object_set_new(report, "tags", tagsReport);
+
+            json_t *subtrees = json_array();
+            for (auto& tree : largest_subtrees(domain, options.largestSubtrees)) {
+                json_t *entry = json_object();
+                json_object_set_new(entry, "id", json_integer(static_cast<json_int_t>(tree.root->_uid())));
+                json_object_set_new(entry, "type", json_string(persistence_profile::type_name(tree.root->type())));
+                json_object_set_new(entry, "tag", json_string(tree.root->_tag.c_str()));
+                json_object_set_new(entry, "objects", json_integer(static_cast<json_int_t>(tree.objects)));
+                json_object_set_new(entry, "elements", json_integer(static_cast<json_int_t>(tree.elements)));
+                json_array_append_new(subtrees, entry);
+            }
+            json_object_set_new(report, "largestSubtrees", subtrees);
+
+            object_base *database = domain.u_getObject(domain.u_root_object_id());
+            if (!options.exportDirectory.empty() && database) {
+                namespace fs = boost::filesystem;
+                boost::system::error_code code;
+                fs::create_directories(options.exportDirectory, code);
+                const std::string path = (fs::path(options.exportDirectory) / ((name.empty() ? "default" : name) + ".json")).generic_string();
+                if (json_serializer::write_json_file(*database, path.c_str(), JSON_INDENT(2))) {
+                    json_object_set_new(report, "exported", json_string(path.c_str()));
+                }
+            }
+            return report;
+        }
+
+        auto measure_round_trips(master& loaded, unsigned count) -> json_t* {
+            std::chrono::steady_clock::duration saving{}, loading{};
+            size_t bytes = 0;
+
+            for (unsigned i = 0; i < count; ++i) {
+                std::string saved;
+                util::string_record_sink sink(saved);
+                util::record_writer writer(sink);
+                auto started = std::chrono::steady_clock::now();
+                loaded.write_to(writer);
+                saving += std::chrono::steady_clock::now() - started;
+                bytes = saved.size();
+
+                master restored;
+                restored.active_domain_names = loaded.active_domain_names;
+                restored.lazy_domain_loading = false;
+                started = std::chrono::steady_clock::now();
+                load_record(restored, saved);
+                loading += std::chrono::steady_clock::now() - started;
+            }
+
+            auto megabytes_per_second = [&](std::chrono::steady_clock::duration time) {
+                const double seconds = milliseconds(time) / 1000.0;
+                return json_real(seconds > 0 ? bytes * double(count) / seconds / (1 << 20) : 0.0);
+            };
+            json_t *report = json_object();
+            json_object_set_new(report, "count", json_integer(count));
+            json_object_set_new(report, "bytes", json_integer(static_cast<json_int_t>(bytes)));
+            json_object_set_new(report, "saveMs", json_real(count ? milliseconds(saving) / count : 0.0));
+            json_object_set_new(report, "loadMs", json_real(count ? milliseconds(loading) / count : 0.0));
+            json_object_set_new(report, "saveMBps", megabytes_per_second(saving));
+            json_object_set_new(report, "loadMBps", megabytes_per_second(loading));
+            return report;
+        }
+
+        // restores the directory of the base snapshots on destruction
+        struct delta_saves_directory_scope {
+            std::string previous = master::delta_saves_directory();
+            ~delta_saves_directory_scope() { master::set_delta_saves_directory(previous); }
+        };
+    }
+
+    json_t* inspect_save(const save_inspection_options& options, std::string& error) {
+        std::ifstream file(options.recordPath, std::ios::in | std::ios::binary);
+        if (!file) {
+            error = "Unable to open " + options.recordPath;
+            return nullptr;
+        }
+        const std::string record{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+        delta_saves_directory_scope directoryScope;
+        master::set_delta_saves_directory(options.deltaSavesDirectory);
+
+        // none of the domains is active, so that all of them are kept encoded: that's how their names get known.
+        // Older records (see serialization_version::pre_flat_format) drop them instead, only the default domain is left
+        master probe;
+        load_record(probe, record);
+        master loaded;
+        for (auto& pair : probe.inactive_domains) {
+            loaded.active_domain_names.insert(pair.first);
+        }
+        probe.clear_state();
+
+        loaded.lazy_domain_loading = false;
+        load_record(loaded, record);
+        auto loadProfile = persistence_profile::last("load");
+
+        json_t *report = json_object();
+        json_object_set_new(report, "record", json_string(options.recordPath.c_str()));
+        json_object_set_new(report, "recordBytes", json_integer(static_cast<json_int_t>(record.size())));
+        json_object_set_new(report, "garbageObjects", json_integer(static_cast<json_int_t>(loadProfile ? loadProfile->garbage_objects() : 0)));
+
+        json_t *domains = json_array();
+        json_array_append_new(domains, inspect_domain(loaded.get_default_domain(), std::string(), options));
+        for (auto& pair : loaded.active_domains_map()) {
+            json_array_append_new(domains, inspect_domain(*pair.second, std::string(pair.first.c_str()), options));
+        }
+        json_object_set_new(report, "domains", domains);
+
+        // the round trips don't write base snapshots next to the ones of the game
+        master::set_delta_saves_directory(std::string());
+        if (options.roundTrips > 0) {
+            json_object_set_new(report, "roundTrips", measure_round_trips(loaded, options.roundTrips));
+        }
+        json_object_set_new(report, "profiles", persistence_profile::last_to_json());
+        return report;
+    }
+
+    namespace testing {
+
+        TEST(save_inspector, inspect_save)
+        {
+            using namespace collections;
+            namespace fs = boost::filesystem;
+
+            master m;
+            m.active_domain_names = { "mod" };
+            auto& defaultDomain = m.get_default_domain();
+            auto& mod = m.get_or_create_domain_with_name("mod");
+
+            auto& big = array::object(defaultDomain);
+            for (int i = 0; i < 10; ++i) {
+                auto& small = map::object(defaultDomain);
+                small.u_set("value", item(i));
+                small.set_tag("settings");
+                big.u_push(item(small));
+            }
+            defaultDomain.root().u_set("big", item(big));
+            map::object(mod).tes_retain();
+            for (int i = 0; i < 3; ++i) {
+                array::object(defaultDomain); // garbage: nothing keeps them
+            }
+
+            const fs::path directory = fs::temp_directory_path() / fs::unique_path("jc-inspect-save-%%%%-%%%%");
+            fs::create_directories(directory);
+            const std::string recordPath = (directory / "record.bin").generic_string();
+            {
+                std::ofstream file(recordPath, std::ios::out | std::ios::binary);
+                m.write_to_stream(file);
+            }
+
+            save_inspection_options options;
+            options.recordPath = recordPath;
+            options.exportDirectory = (directory / "export").generic_string();
+            options.roundTrips = 1;
+            std::string error;
+            auto report = make_unique_ptr(inspect_save(options, error), &json_decref);
+            ASSERT_TRUE(report != nullptr);
+            EXPECT_TRUE(error.empty());
+
+            EXPECT_EQ(3, json_integer_value(json_object_get(report.get(), "garbageObjects")));
+            json_t *domains = json_object_get(report.get(), "domains");
+            ASSERT_EQ(2, json_array_size(domains));
+
+            json_t *defaultReport = json_array_get(domains, 0);
+            json_t *maps = json_object_get(json_object_get(defaultReport, "types"), "JMap");
+            EXPECT_EQ(11, json_integer_value(json_object_get(maps, "objects"))); // JDB and the small ones
+            EXPECT_EQ(11, json_integer_value(json_object_get(json_object_get(maps, "sizeHistogram"), "1")));
+            EXPECT_EQ(10, json_integer_value(json_object_get(json_object_get(defaultReport, "tags"), "settings")));
+
+            json_t *largest = json_array_get(json_object_get(defaultReport, "largestSubtrees"), 0);
+            EXPECT_EQ(12, json_integer_value(json_object_get(largest, "objects"))); // JDB, the array and the maps
+            EXPECT_TRUE(fs::is_regular_file(json_string_value(json_object_get(defaultReport, "exported"))));
+
+            EXPECT_STREQ("mod", json_string_value(json_object_get(json_array_get(domains, 1), "name")));
+            EXPECT_EQ(1, json_integer_value(json_object_get(json_array_get(domains, 1), "objects")));
+
+            json_t *roundTrips = json_object_get(report.get(), "roundTrips");
+            EXPECT_EQ(1, json_integer_value(json_object_get(roundTrips, "count")));
+            EXPECT_TRUE(json_integer_value(json_object_get(roundTrips, "bytes")) > 0);
+
+            options.recordPath = (directory / "missing.bin").generic_string();
+            EXPECT_TRUE(inspect_save(options, error) == nullptr);
+            EXPECT_FALSE(error.empty());
+
+            fs::remove_all(directory);
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+
+#include "jansson.h"
+
+namespace domain_master {
+
+    // Offline inspection of the data JContainers writes into a co-save: the record, dumped into a file as it is
+    // (what master::write_to_stream writes). See JC_inspectSave and tools/inspect_save.py
+    struct save_inspection_options {
+        std::string recordPath;
+        // each domain's database (JDB) gets exported into as <domain>.json, the default domain as default.json
+        std::string exportDirectory;
+        // where the base snapshot of a delta save is, see master::delta_saves_directory
+        std::string deltaSavesDirectory;
+        // save and load round trips, which measure the throughput
+        unsigned roundTrips = 0;
+        // the number of the largest subtrees reported per domain
+        unsigned largestSubtrees = 10;
+    };
+
+    // Loads the record into a standalone master, all the domains active and decoded, and returns the report:
+    //   {"record", "recordBytes", "garbageObjects",
+    //    "domains": [{"name", "objects", "types": {type: {"objects", "elements", "sizeHistogram": {range: count}}},
+    //                 "tags": {tag: count}, "largestSubtrees": [{"id", "type", "tag", "objects", "elements"}], "exported"}],
+    //    "roundTrips": {"count", "bytes", "saveMs", "loadMs", "saveMBps", "loadMBps"},
+    //    "profiles": {"save", "load"}}
+    // A subtree is what a root - JDB or an object retained by scripts - keeps alive. The garbage is what
+    // the garbage collection has found after loading. Returns null and sets @error if the file can't be read,
+    // a record which fails to load is reported as empty - the log has the reason
+    json_t* inspect_save(const save_inspection_options& options, std::string& error);
+}
@@ -3,6 +3,7 @@
 #include <string>
 #include <cstdint>
 #include <optional>
+#include <utility>
 #include "skse/skse.h"
 
 namespace forms 
@@ -43,6 +44,45 @@ inline std::uint32_t local_id (FormId n)
 
 //--------------------------------------------------------------------------------------------------
 
+/**
+ * Split the incoming absolute form id into the mod it originates from and the id relative to the mod
+ *
+ * The result is what `form_from_file` takes back: an empty mod name and the whole id for dynamic forms
+ *
+ * @param n is the form id
+ * @return the mod name and the relative id or std::nullopt if a mod for the incoming static form was not found
+ */
+
+inline std::optional<std::pair<std::string_view, std::uint32_t>> form_origin (FormId n)
+{
+    using namespace std;
+
+    auto u32 = static_cast<uint32_t> (n);
+
+    if (!is_static (n))
+        return make_pair (string_view (), u32);
+
+    optional<string_view> mod;
+
+    if (is_light (n))
+    {
+        mod = skse::loaded_light_mod_name (uint16_t ((u32 >> 12) & 0x0fffu));
+        u32 &= 0x0000'0fffu;
+    }
+    else
+    {
+        mod = skse::loaded_mod_name (uint8_t (u32 >> 24));
+        u32 &= 0x00ff'ffffu;
+    }
+
+    if (!mod)
+        return nullopt;
+
+    return make_pair (string_view (mod->data ()), u32);
+}
+
+//--------------------------------------------------------------------------------------------------
+
 /**
  * Convert the incoming absolute form id to canonical string representation
  *
@@ -56,33 +96,16 @@ inline std::optional<std::string> form_to_string (FormId n)
 {
     using namespace std;
 
-    string s ("__formData|"); //likely on stack (aka SSO)
-    auto u32 = static_cast<uint32_t> (n);
+    auto origin = form_origin (n);
+    if (!origin)
+        return nullopt;
 
-    if (is_static (n))
-    {
-        optional<string_view> mod;
-
-        if (is_light (n))
-        {
-            mod = skse::loaded_light_mod_name (uint16_t ((u32 >> 12) & 0x0fffu));
-            u32 &= 0x0000'0fffu;
-        }
-        else
-        {
-            mod = skse::loaded_mod_name (uint8_t (u32 >> 24));
-            u32 &= 0x00ff'ffffu;
-        }
-
-        if (!mod)
-            return nullopt;
-
-        s += mod->data ();
-    }
+    string s ("__formData|"); //likely on stack (aka SSO)
+    s.append (origin->first.data (), origin->first.size ());
 
     //TODO: replace with std::to_chars when MSVC wake to implement it
     char form[12];
-    snprintf (form, sizeof form, "|0x%x", u32);
+    snprintf (form, sizeof form, "|0x%x", origin->second);
 
     return s + form;
 }
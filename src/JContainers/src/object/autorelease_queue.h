@@ -94,6 +94,15 @@ namespace collections {
             _toRelease.clear();
         }
 
+        // the state the flat save format stores, see flat_serialization
+        time_point u_tick_counter() const { return _tickCounter; }
+        const queue& u_queue() const { return _queue; }
+
+        void u_load(time_point tickCounter, queue&& objects) {
+            _tickCounter = tickCounter;
+            _queue = std::move(objects);
+        }
+
         friend class boost::serialization::access;
         BOOST_SERIALIZATION_SPLIT_MEMBER();
 
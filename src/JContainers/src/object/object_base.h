@@ -27,6 +27,9 @@ namespace collections {
         Map,
         FormMap,
         IntegerMap,
+        IntArray,
+        FloatArray,
+        Set,
     };
 
     struct object_base_stack_ref_policy {
@@ -61,10 +64,14 @@ namespace collections {
         util::istring                           _tag;
     private:
         object_context *_context                = nullptr;
+        uint32_t _modificationCount             = 0;
+        // the contents are a part of the snapshot being written, see snapshot_observer
+        std::atomic_bool _snapshotPending       = false;
 
         void release_counter(std::atomic_int32_t& counter);
         bool is_completely_initialized() const { return _context != nullptr; }
         void try_prolong_lifetime();
+        void u_preserve_for_snapshot();
 
     public:
 
@@ -168,6 +175,20 @@ namespace collections {
 
         void _registerSelf();
 
+        // The counter gets bumped by each modification of the contents. Non-const accessors,
+        // which let the contents be modified directly, bump it as well.
+        // The contents, which a snapshot still needs, get preserved before the first modification
+        void u_mark_modified() {
+            if (_snapshotPending.load(std::memory_order_acquire)) {
+                u_preserve_for_snapshot();
+            }
+            ++_modificationCount;
+        }
+        uint32_t u_modification_count() const { return _modificationCount; }
+
+        bool u_snapshot_pending() const { return _snapshotPending.load(std::memory_order_relaxed); }
+        void u_set_snapshot_pending(bool pending) { _snapshotPending.store(pending, std::memory_order_release); }
+
         virtual void u_clear() = 0;
         virtual SInt32 u_count() const = 0;
         virtual void u_onLoaded() {};
@@ -1,7 +1,29 @@
 namespace collections
 {
     void object_base::_registerSelf() {
-        context().registry->registerNewObject(*this);
+        auto arena = object_staging_arena::current();
+        if (!arena || !arena->stage(*this)) {
+            context().registry->registerNewObject(*this);
+        }
+    }
+
+    bool object_staging_arena::stage(object_base& obj) {
+        if (&obj.context() != &_context) {
+            return false;
+        }
+        obj.stack_retain();
+        _objects.push_back(&obj);
+        return true;
+    }
+
+    void object_staging_arena::commit() {
+        if (!_objects.empty()) {
+            _context.registry->registerNewObjects(_objects);
+            for (auto obj : _objects) {
+                obj->stack_release();
+            }
+            _objects.clear();
+        }
     }
 
     Handle object_base::public_id() {
@@ -138,6 +160,13 @@ namespace collections
         }
     }
 
+    void object_base::u_preserve_for_snapshot() {
+        _snapshotPending.store(false, std::memory_order_relaxed);
+        if (auto observer = context().u_snapshot_observer()) {
+            observer->u_preserve(*this);
+        }
+    }
+
     object_base* object_base::prolong_lifetime() {
         context().aqueue->prolong_lifetime(*this, is_public());
         return this;
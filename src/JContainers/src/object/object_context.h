@@ -3,6 +3,8 @@
 #include <atomic>
 #include <functional>
 #include <deque>
+#include <mutex>
+#include <condition_variable>
 #include <boost/serialization/split_member.hpp>
 
 #include "object_base.h"
@@ -23,16 +25,28 @@ namespace collections {
     class dependent_context {
     public:
         virtual ~dependent_context() {}
+        // called before clear_state, with no locks held: blocks until the background work of the context is done
+        virtual void wait_pending() {}
         virtual void clear_state() = 0;
     };
 
 
+    // Preserves the contents of the objects a snapshot still needs, before they get modified.
+    // Called with the object locked, by the thread which is about to modify the object
+    class snapshot_observer {
+    public:
+        virtual ~snapshot_observer() {}
+        virtual void u_preserve(const object_base& obj) = 0;
+    };
+
+
     enum class serialization_version {
         pre_aqueue_fix = 2,
         no_header = 3, // no JSON header in the beginning of a stream
         pre_gc = 4, // next version implements GC
         pre_dyn_form_watcher = 5, // next version implements dynamic-form-watcher
-        current = 6,
+        pre_flat_format = 6, // next version is written in the flat format instead of boost::serialization archive
+        current = 7,
     };
 
     /*
@@ -94,6 +108,31 @@ namespace collections {
         void start_activity();
         void u_clearState();
 
+        // What the flat save format (see collections/flat_serialization.h) stores besides the contents of the objects
+        struct flat_state {
+            std::vector<object_base*> objects;
+            // ranges of unused identifiers and the one the next identifier is taken from
+            std::vector<std::pair<HandleT, HandleT> > freeHandles;
+            uint32_t currentFreeHandles = 0;
+            object_base::time_point aqueueTickCounter = 0;
+            std::vector<object_base*> aqueue;
+        };
+
+        flat_state u_flat_state() const;
+        // registers the objects read from a save. Returns false if the state is inconsistent
+        bool u_load_flat_state(const flat_state& state);
+
+        // The journal of removed objects, needed to tell the objects of the last full save from the new ones
+        void u_journal_removals(bool enable);
+        std::vector<object_base*> u_take_removed_objects();
+
+        // A snapshot is written while the objects may be modified: the objects marked as pending get preserved by
+        // @observer before the first modification. No object gets deleted until the snapshot ends - the autorelease
+        // queue is stopped, garbage collection and u_clearState wait. One snapshot at a time, the next one waits too
+        void begin_snapshot(snapshot_observer& observer);
+        void end_snapshot();
+        snapshot_observer* u_snapshot_observer() const { return _snapshot_observer.load(std::memory_order_acquire); }
+
     public:
 
         template<class Archive>
@@ -110,6 +149,16 @@ namespace collections {
         spinlock _dependent_contexts_mutex;
         std::vector<dependent_context*> _dependent_contexts;
 
+        // the activity is stopped until each stop_activity call is paired with start_activity
+        std::mutex _activity_mutex;
+        uint32_t _activity_stops = 0;
+
+        std::mutex _snapshot_mutex;
+        std::condition_variable _snapshot_ended;
+        std::atomic<snapshot_observer*> _snapshot_observer = nullptr;
+
+        std::unique_lock<std::mutex> wait_for_snapshot_end();
+
     public:
         void add_dependent_context(dependent_context& ctx);
         void remove_dependent_context(dependent_context& ctx);
@@ -22,14 +22,55 @@ namespace collections
     }
 
     void object_context::stop_activity() {
-        aqueue->stop();
+        std::lock_guard<std::mutex> g(_activity_mutex);
+        if (_activity_stops++ == 0) {
+            aqueue->stop();
+        }
     }
 
     void object_context::start_activity() {
-        aqueue->start();
+        std::lock_guard<std::mutex> g(_activity_mutex);
+        if (_activity_stops > 0 && --_activity_stops == 0) {
+            aqueue->start();
+        }
+    }
+
+    void object_context::begin_snapshot(snapshot_observer& observer) {
+        auto g = wait_for_snapshot_end();
+        _snapshot_observer.store(&observer, std::memory_order_release);
+        stop_activity();
+    }
+
+    void object_context::end_snapshot() {
+        {
+            std::lock_guard<std::mutex> g(_snapshot_mutex);
+            _snapshot_observer.store(nullptr, std::memory_order_release);
+        }
+        _snapshot_ended.notify_all();
+        start_activity();
+    }
+
+    // returns the lock, which keeps a next snapshot from beginning
+    std::unique_lock<std::mutex> object_context::wait_for_snapshot_end() {
+        std::unique_lock<std::mutex> g(_snapshot_mutex);
+        _snapshot_ended.wait(g, [this]() { return u_snapshot_observer() == nullptr; });
+        return g;
     }
     
     void object_context::u_clearState() {
+        {
+            // the dependent contexts live as long as the context does, so they're waited for with no locks held
+            std::vector<dependent_context*> dependents;
+            {
+                spinlock::guard g(_dependent_contexts_mutex);
+                dependents = _dependent_contexts;
+            }
+            for (auto& ctx : dependents) {
+                ctx->wait_pending();
+            }
+        }
+
+        auto snapshotLock = wait_for_snapshot_end();
         {
             spinlock::guard g(_dependent_contexts_mutex);
             for (auto& ctx : _dependent_contexts) {
@@ -88,6 +129,7 @@ namespace collections
 
     size_t object_context::collect_garbage() {
         activity_stopper s{ *this };
+        auto snapshotLock = wait_for_snapshot_end();
         auto res = garbage_collector::u_collect(*registry, *aqueue);
         return res.garbage_total;
     }
@@ -109,6 +151,67 @@ namespace collections
         ar >> *registry >> *aqueue;
     }
 
+    object_context::flat_state object_context::u_flat_state() const {
+        flat_state state;
+        state.objects.assign(registry->u_all_objects().begin(), registry->u_all_objects().end());
+
+        const auto& idGen = registry->u_id_generator();
+        for (const auto& range : idGen._empty_ranges) {
+            state.freeHandles.emplace_back(range.first, range.last);
+        }
+        state.currentFreeHandles = static_cast<uint32_t>(idGen._current_range - idGen._empty_ranges.begin());
+
+        state.aqueueTickCounter = aqueue->u_tick_counter();
+        for (const auto& ref : aqueue->u_queue()) {
+            state.aqueue.push_back(ref.get());
+        }
+        return state;
+    }
+
+    bool object_context::u_load_flat_state(const flat_state& state) {
+        bool consistent = true;
+        for (auto obj : state.objects) {
+            consistent &= registry->u_register_loaded(*obj);
+        }
+        if (!consistent) {
+            return false;
+        }
+
+        auto& idGen = registry->u_id_generator();
+        idGen._empty_ranges.clear();
+        for (const auto& range : state.freeHandles) {
+            if (range.first > range.second) {
+                idGen.u_clear();
+                return false;
+            }
+            idGen._empty_ranges.push_back(id_generator_type::range::with_first_last(range.first, range.second));
+        }
+        if (state.currentFreeHandles >= idGen._empty_ranges.size()) {
+            idGen.u_clear();
+            return false;
+        }
+        idGen._current_range = idGen._empty_ranges.begin() + state.currentFreeHandles;
+        if (!idGen.is_valid()) {
+            idGen.u_clear();
+            return false;
+        }
+
+        autorelease_queue::queue queue;
+        for (auto obj : state.aqueue) {
+            queue.emplace_back(obj);
+        }
+        aqueue->u_load(state.aqueueTickCounter, std::move(queue));
+        return true;
+    }
+
+    void object_context::u_journal_removals(bool enable) {
+        registry->u_journal_removals(enable);
+    }
+
+    std::vector<object_base*> object_context::u_take_removed_objects() {
+        return registry->u_take_removed_objects();
+    }
+
     void object_context::u_print_stats() const {
         JC_log("%lu objects total", registry->u_all_objects().size());
         JC_log("%lu public objects", registry->u_public_object_count());
@@ -131,6 +234,9 @@ namespace collections
         util::do_with_timing("Garbage collection", [&]() {
             auto res = garbage_collector::u_collect(*registry, *aqueue);
             JC_log("%u garbage objects collected. %u objects are parts of cyclic graphs", res.garbage_total, res.part_of_graphs);
+            if (auto profile = persistence_profile::current()) {
+                profile->add_garbage(res.garbage_total);
+            }
         });
     }
 
@@ -37,6 +37,7 @@
 #include "jcontainers_constants.h"
 #include "object_base.h"
 #include "object_context.h"
+#include "object_staging_arena.h"
 
 #include "object_base_serialization.h"
 
@@ -44,6 +45,7 @@
 #include "object_registry.h"
 #include "autorelease_queue.h"
 #include "garbage_collector.h"
+#include "collections/persistence_profile.h"
 
 #include "object_base.hpp"
 #include "object_context.hpp"
@@ -17,6 +17,9 @@ namespace collections
         id_generator_type _idGen;
         all_objects_set _all_objects;
         mutable bshared_mutex _mutex;
+        // removed objects are remembered here while the journal is enabled, see flat_delta_tracker
+        std::vector<object_base*> _removedObjects;
+        bool _journalRemovals = false;
 
         object_registry(const object_registry& );
         object_registry& operator = (const object_registry& );
@@ -35,6 +38,15 @@ namespace collections
             _all_objects.insert(&obj);
         }
 
+        void registerNewObjects(const std::vector<object_base*>& objects) {
+            write_lock g(_mutex);
+            _all_objects.reserve(_all_objects.size() + objects.size());
+            for (auto obj : objects) {
+                jc_assert(_all_objects.find(obj) == _all_objects.end());
+                _all_objects.insert(obj);
+            }
+        }
+
         Handle registerNewObjectId(object_base& obj) {
             //jc_assert(obj._uid() == Handle::Null);
 
@@ -61,6 +73,10 @@ namespace collections
             auto itr = _all_objects.find(&obj);
             jc_assert(itr != _all_objects.end());
             _all_objects.erase(itr);
+
+            if (_journalRemovals) {
+                _removedObjects.push_back(&obj);
+            }
         }
 
         object_base *getObject(Handle hdl) const {
@@ -111,12 +127,37 @@ namespace collections
             _map.clear();
             _idGen.u_clear();
             _all_objects.clear();
+            _removedObjects.clear();
+        }
+
+        // The pointers are never dereferenced - the objects are deleted already. A pointer may be taken by a new object
+        void u_journal_removals(bool enable) {
+            _journalRemovals = enable;
+            _removedObjects.clear();
+        }
+
+        std::vector<object_base*> u_take_removed_objects() {
+            return std::move(_removedObjects);
         }
 
         all_objects_set& u_all_objects() {
             return _all_objects;
         }
 
+        // registers an object, read from a save, under its identifier. Returns false if the identifier is taken
+        bool u_register_loaded(object_base& obj) {
+            _all_objects.insert(&obj);
+            return !obj.is_public() || _map.insert(registry_container::value_type(obj._uid(), &obj)).second;
+        }
+
+        id_generator_type& u_id_generator() {
+            return _idGen;
+        }
+
+        const id_generator_type& u_id_generator() const {
+            return _idGen;
+        }
+
         size_t u_public_object_count() const {
             return _map.size();
         }
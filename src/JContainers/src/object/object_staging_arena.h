@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include "boost/noncopyable.hpp"
+
+namespace collections {
+
+    class object_base;
+    class object_context;
+
+    // Takes over the registration of the objects, created on the current thread while the arena is active:
+    // the objects stay unknown to the registry (and to the garbage collector) until commit() registers all of them
+    // under a single lock. Lets worker threads build detached object graphs.
+    // The arena owns what it has staged (as a stack reference does): an object, released before the commit,
+    // can't get into the autorelease queue and be deleted while unregistered. The commit registers the objects
+    // and drops the ownership - the ones nothing else owns get released as usual
+    class object_staging_arena : boost::noncopyable {
+    public:
+
+        explicit object_staging_arena(object_context& context) : _context(context) {}
+
+        ~object_staging_arena() {
+            commit();
+        }
+
+        // activates @arena on the current thread until destroyed
+        class scope : boost::noncopyable {
+            object_staging_arena *_previous;
+        public:
+            explicit scope(object_staging_arena& arena) : _previous(current()) {
+                current() = &arena;
+            }
+            ~scope() {
+                current() = _previous;
+            }
+        };
+
+        static object_staging_arena*& current() {
+            static thread_local object_staging_arena *arena = nullptr;
+            return arena;
+        }
+
+        // Returns false if @obj belongs to another context and must be registered as usual
+        bool stage(object_base& obj);
+
+        // registers the staged objects and stops owning them
+        void commit();
+
+        size_t staged_count() const { return _objects.size(); }
+
+    private:
+        object_context& _context;
+        std::vector<object_base*> _objects;
+    };
+}
@@ -239,6 +239,7 @@ namespace reflection { namespace binding {
                     State& state,
                     convert_to_tes_type<Params> ... params)
                 {
+                    state.ensure_loaded(); // the state may be deferred till the first use, see tes_context::u_defer_loading
                     return GetConv<R>::convert2Tes(
                         func(
                             state,
@@ -253,6 +254,7 @@ namespace reflection { namespace binding {
                     State& state,
                     convert_to_tes_type<Params> ... params)
                 {
+                    state.ensure_loaded();
                     func(state, get_converter<Params>::convert2J(params, state) ...);
                 }
             };
@@ -1,4 +1,3 @@
-#include <boost/iostreams/stream.hpp>
 #include <ShlObj.h>
 
 #include "skse64/PluginAPI.h"
@@ -10,14 +9,18 @@
 #include "skse/skse.h"
 #include "skse64/PapyrusVM.h"
 #include "util/util.h"
+#include "util/record_stream.h"
 #include "jc_interface.h"
 #include "reflection/reflection.h"
 #include "jcontainers_constants.h"
 
+#include "jansson.h"
 #include "collections/context.h"
+#include "collections/persistence_profile.h"
 #include "forms/form_observer.h"
 
 #include "domains/domain_master.h"
+#include "domains/plugin_settings.h"
 
 class VMClassRegistry;
 
@@ -44,54 +47,68 @@ namespace {
         });
     }
 
-    void save(SKSESerializationInterface * intfc) {
-
-        namespace io = boost::iostreams;
+    // the co-save record, written and read in large blocks directly
+    class skse_record_sink : public util::record_sink {
+        SKSESerializationInterface* _sink;
+    public:
+        explicit skse_record_sink(SKSESerializationInterface* sink) : _sink(sink) {}
 
-        struct skse_data_sink {
-            typedef char      char_type;
-            typedef io::sink_tag  category;
+        void write(const char *data, size_t size) override {
+            (void)_sink->WriteRecordData(data, static_cast<UInt32>(size)); // always returns true
+        }
+    };
 
-            std::streamsize write(const char* s, std::streamsize n) const {
-                (void)_sink->WriteRecordData(s, n); // always returns true
-                return n;
+    class skse_record_source : public util::record_source {
+        SKSESerializationInterface* _source;
+        size_t _remaining;
+    public:
+        // @source is null if there is no record to read
+        skse_record_source(SKSESerializationInterface* source, size_t length)
+            : _source(source), _remaining(source ? length : 0) {}
+
+        size_t read(char *buffer, size_t size) override {
+            if (!_source) {
+                return 0;
             }
+            const size_t got = _source->ReadRecordData(buffer, static_cast<UInt32>(size));
+            _remaining -= (std::min)(got, _remaining);
+            return got;
+        }
 
-            SKSESerializationInterface* _sink;
-        };
+        size_t remaining_hint() const override { return _remaining; }
+    };
+
+    // the profiles of the last save and load go next to the log, see persistence_profile
+    void write_persistence_profiles() {
+        char path[MAX_PATH];
+        if (!SUCCEEDED(SHGetFolderPath(NULL, CSIDL_MYDOCUMENTS, NULL, SHGFP_TYPE_CURRENT, path))) {
+            return;
+        }
+        strcat_s(path, sizeof path, JC_SKSE_LOGS JC_PLUGIN_NAME "_profile.json");
 
+        json_t *profiles = persistence_profile::last_to_json();
+        if (json_dump_file(profiles, path, JSON_INDENT(2)) != 0) {
+            JC_log("Unable to write the save/load profile to %s", path);
+        }
+        json_decref(profiles);
+    }
 
+    void save(SKSESerializationInterface * intfc) {
         util::do_with_timing("Save", [intfc]() {
             if (intfc->OpenRecord((UInt32)consts::storage_chunk, (UInt32)serialization_version::current)) {
-                io::stream<skse_data_sink> stream(skse_data_sink{ intfc });
-                domain_master::master::instance().write_to_stream(stream);
-                //_DMESSAGE("%lu bytes saved", stream.tellp());
+                skse_record_sink sink(intfc);
+                util::record_writer writer(sink);
+                domain_master::master::instance().write_to(writer);
+                //_DMESSAGE("%llu bytes saved", writer.written());
             }
             else {
                 JC_log("Unable open JC record");
             }
         });
+        write_persistence_profiles();
     }
 
     void load(SKSESerializationInterface * intfc) {
-
-        namespace io = boost::iostreams;
-
-        class skse_data_source {
-        public:
-            typedef char char_type;
-            typedef io::source_tag  category;
-
-            explicit skse_data_source(SKSESerializationInterface* src = nullptr) : _source(src){}
-
-            std::streamsize read(char* buffer, std::streamsize n) const {
-                return _source ? _source->ReadRecordData(buffer, n) : 0;
-            }
-
-        private:
-            SKSESerializationInterface* _source;
-        };
-
         util::do_with_timing("Load", [intfc]() {
 
             skse::set_silent_api();
@@ -108,9 +125,12 @@ namespace {
                 }
             }
 
-            io::stream<skse_data_source> stream(skse_data_source(static_cast<consts>(type) == consts::storage_chunk ? intfc : nullptr));
-            domain_master::master::instance().read_from_stream(stream);
+            const bool found = static_cast<consts>(type) == consts::storage_chunk;
+            skse_record_source source(found ? intfc : nullptr, length);
+            util::record_reader reader(source);
+            domain_master::master::instance().read_from(reader);
         });
+        write_persistence_profiles();
     }
 
     extern "C" {
@@ -263,6 +283,8 @@ namespace {
                 domain_master::master::instance().get_form_observer().on_form_deleted((forms::FormHandle)handle);
             });
 
+            domain_master::apply_settings(util::relative_to_dll_path(JC_DATA_FILES "settings.json").generic_string());
+
             g_papyrus->Register(registerAllFunctions);
 
             if (g_messaging) {
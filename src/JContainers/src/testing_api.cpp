@@ -1,6 +1,9 @@
 #include "jcontainers_constants.h"
 #include "reflection/reflection.h"
 #include "gtest.h"
+#include "collections/data_pack.h"
+#include "domains/save_inspector.h"
+#include "skse/skse.h"
 
 // C API for python scripts as a part of bundling and testing functionality
 extern "C" {
@@ -17,6 +20,39 @@ extern "C" {
         code_producer::produceAmalgamatedCodeToFile(class_registry(), path, "JContainers_DomainExample");
     }
 
+    // packs JSON file into a data pack, see JDataPack
+    __declspec(dllexport) bool JC_packDataFile(const char *jsonPath, const char *packPath) {
+        return jsonPath && packPath && collections::data_pack_writer::pack_json_file(jsonPath, packPath);
+    }
+
+    // inspects a co-save record dumped into @recordPath and writes the JSON report into @reportPath, see domain_master::inspect_save.
+    // @exportDirectory and @deltaSavesDirectory may be null. Returns false if the record or the report can't be accessed
+    __declspec(dllexport) bool JC_inspectSave(const char *recordPath, const char *reportPath, const char *exportDirectory,
+        const char *deltaSavesDirectory, unsigned roundTrips, unsigned largestSubtrees)
+    {
+        if (!recordPath || !reportPath) {
+            return false;
+        }
+        skse::set_fake_api();
+
+        domain_master::save_inspection_options options;
+        options.recordPath = recordPath;
+        options.exportDirectory = exportDirectory ? exportDirectory : "";
+        options.deltaSavesDirectory = deltaSavesDirectory ? deltaSavesDirectory : "";
+        options.roundTrips = roundTrips;
+        options.largestSubtrees = largestSubtrees;
+
+        std::string error;
+        json_t *report = domain_master::inspect_save(options, error);
+        if (!report) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return false;
+        }
+        const bool written = json_dump_file(report, reportPath, JSON_INDENT(2)) == 0;
+        json_decref(report);
+        return written;
+    }
+
     __declspec(dllexport) bool JC_runTests(int argc, const char** argv) {
         using namespace std;
 
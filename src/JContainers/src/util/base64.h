@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace util {
+
+    // Standard (RFC 4648) base64 with padding. Papyrus strings can't hold arbitrary bytes, binary data is passed as base64
+
+    inline std::string base64_encode(std::string_view data) {
+        static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        std::string result;
+        result.reserve((data.size() + 2) / 3 * 4);
+
+        size_t i = 0;
+        for (; i + 2 < data.size(); i += 3) {
+            const uint32_t bits = uint32_t(uint8_t(data[i])) << 16 | uint32_t(uint8_t(data[i + 1])) << 8 | uint8_t(data[i + 2]);
+            result.push_back(alphabet[bits >> 18]);
+            result.push_back(alphabet[(bits >> 12) & 0x3F]);
+            result.push_back(alphabet[(bits >> 6) & 0x3F]);
+            result.push_back(alphabet[bits & 0x3F]);
+        }
+
+        const size_t rest = data.size() - i;
+        if (rest != 0) {
+            const uint32_t bits = uint32_t(uint8_t(data[i])) << 16 | (rest == 2 ? uint32_t(uint8_t(data[i + 1])) << 8 : 0);
+            result.push_back(alphabet[bits >> 18]);
+            result.push_back(alphabet[(bits >> 12) & 0x3F]);
+            result.push_back(rest == 2 ? alphabet[(bits >> 6) & 0x3F] : '=');
+            result.push_back('=');
+        }
+
+        return result;
+    }
+
+    // Returns nothing if @text isn't base64. Whitespace is not allowed, the padding is optional
+    inline std::optional<std::string> base64_decode(std::string_view text) {
+        auto sextet = [](char c) -> int {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '+') return 62;
+            if (c == '/') return 63;
+            return -1;
+        };
+
+        while (!text.empty() && text.back() == '=') {
+            text.remove_suffix(1);
+        }
+        if (text.size() % 4 == 1) {
+            return std::nullopt;
+        }
+
+        std::string result;
+        result.reserve(text.size() / 4 * 3 + 2);
+
+        uint32_t bits = 0;
+        int count = 0;
+        for (char c : text) {
+            const int value = sextet(c);
+            if (value < 0) {
+                return std::nullopt;
+            }
+            bits = bits << 6 | uint32_t(value);
+            if (++count == 4) {
+                result.push_back(char(bits >> 16));
+                result.push_back(char(bits >> 8));
+                result.push_back(char(bits));
+                bits = 0;
+                count = 0;
+            }
+        }
+
+        if (count == 3) {
+            result.push_back(char(bits >> 10));
+            result.push_back(char(bits >> 2));
+        }
+        else if (count == 2) {
+            result.push_back(char(bits >> 4));
+        }
+
+        return result;
+    }
+}
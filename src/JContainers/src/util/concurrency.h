@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+    // The number of hardware threads, up to @limit
+    inline size_t hardware_threads(size_t limit = 8) {
+        return (std::max)(size_t(1), (std::min)(size_t(std::thread::hardware_concurrency()), limit));
+    }
+
+    // Calls @func(index) for each index in [0, @count) on up to @threadCount threads, the calling thread included.
+    // The first exception thrown gets rethrown once all threads are done
+    template<class Func>
+    void for_each_concurrently(size_t count, size_t threadCount, Func&& func) {
+        std::atomic<size_t> nextIndex{ 0 };
+        std::exception_ptr firstError;
+        std::atomic_flag errorTaken = ATOMIC_FLAG_INIT;
+
+        auto work = [&]() {
+            for (size_t idx = nextIndex++; idx < count; idx = nextIndex++) {
+                try {
+                    func(idx);
+                }
+                catch (...) {
+                    if (!errorTaken.test_and_set()) {
+                        firstError = std::current_exception();
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < (std::min)(threadCount, count); ++i) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+    }
+}
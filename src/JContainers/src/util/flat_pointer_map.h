@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+    // Open addressing hash map from non-null pointers to values, with linear probing.
+    // Supports insertion and lookup only, no erasure. clear() keeps the allocated slots,
+    // so the map is cheap to reuse for another run of the same size
+    template<class Key, class Value>
+    class flat_pointer_map {
+        static_assert(std::is_pointer<Key>::value, "Key must be a pointer type");
+
+        std::vector<Key> _keys;
+        std::vector<Value> _values;
+        size_t _count = 0;
+
+        enum { min_capacity = 16 };
+
+        size_t slot_of(Key key) const {
+            // Fibonacci hashing: multiplication spreads the pointer bits, the high bits are the best mixed ones
+            const uint64_t hash = (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key)) >> 3) * 0x9E3779B97F4A7C15ull;
+            return static_cast<size_t>(hash >> 32) & (_keys.size() - 1);
+        }
+
+        size_t find_slot(Key key) const {
+            size_t slot = slot_of(key);
+            while (_keys[slot] && _keys[slot] != key) {
+                slot = (slot + 1) & (_keys.size() - 1);
+            }
+            return slot;
+        }
+
+        void rehash(size_t capacity) {
+            std::vector<Key> keys(capacity, nullptr);
+            std::vector<Value> values(capacity);
+            keys.swap(_keys);
+            values.swap(_values);
+
+            for (size_t i = 0; i < keys.size(); ++i) {
+                if (keys[i]) {
+                    const size_t slot = find_slot(keys[i]);
+                    _keys[slot] = keys[i];
+                    _values[slot] = std::move(values[i]);
+                }
+            }
+        }
+
+    public:
+
+        size_t size() const { return _count; }
+        bool empty() const { return _count == 0; }
+        size_t capacity() const { return _keys.size(); }
+
+        void reserve(size_t count) {
+            size_t capacity = _keys.empty() ? size_t(min_capacity) : _keys.size();
+            while (capacity < count * 2) {
+                capacity *= 2;
+            }
+            if (capacity != _keys.size()) {
+                rehash(capacity);
+            }
+        }
+
+        Value* find(Key key) {
+            if (_count == 0) {
+                return nullptr;
+            }
+            const size_t slot = find_slot(key);
+            return _keys[slot] ? &_values[slot] : nullptr;
+        }
+
+        const Value* find(Key key) const {
+            return const_cast<flat_pointer_map*>(this)->find(key);
+        }
+
+        // inserts the value unless @key is already present. Returns the stored value and whether it has been inserted
+        template<class V>
+        std::pair<Value*, bool> emplace(Key key, V&& value) {
+            reserve(_count + 1);
+            const size_t slot = find_slot(key);
+            if (_keys[slot]) {
+                return{ &_values[slot], false };
+            }
+            _keys[slot] = key;
+            _values[slot] = std::forward<V>(value);
+            ++_count;
+            return{ &_values[slot], true };
+        }
+
+        // removes the items, keeps the slots
+        void clear() {
+            if (_count == 0) {
+                return;
+            }
+            for (size_t i = 0; i < _keys.size(); ++i) {
+                if (_keys[i]) {
+                    _keys[i] = nullptr;
+                    _values[i] = Value();
+                }
+            }
+            _count = 0;
+        }
+    };
+
+    // flat_pointer_map without values
+    template<class Key>
+    class flat_pointer_set {
+        struct none {};
+        flat_pointer_map<Key, none> _map;
+
+    public:
+
+        size_t size() const { return _map.size(); }
+        size_t capacity() const { return _map.capacity(); }
+        void reserve(size_t count) { _map.reserve(count); }
+        void clear() { _map.clear(); }
+
+        bool contains(Key key) const {
+            return _map.find(key) != nullptr;
+        }
+
+        // returns false if @key is already present
+        bool insert(Key key) {
+            return _map.emplace(key, none()).second;
+        }
+    };
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace util { namespace lz4 {
+
+    // LZ4 block format (see lz4_Block_format.md of the reference implementation): a sequence is a token,
+    // literals and a back-reference of 4+ bytes within 64 KB. The last 5 bytes are always literals,
+    // the last match starts 12 bytes before the end at least.
+    // Levels: 1 takes the most recent candidate only, higher levels walk the hash chain deeper (up to 2^(level-1) candidates)
+
+    enum : size_t {
+        min_match = 4,
+        last_literals = 5,
+        match_start_limit = 12,
+        max_offset = 65535,
+        hash_bits = 16,
+        window_size = 65536,
+    };
+
+    enum : int {
+        min_level = 1,
+        max_level = 9,
+    };
+
+    namespace detail {
+
+        inline uint32_t read32(const uint8_t *p) {
+            uint32_t value;
+            memcpy(&value, p, sizeof value);
+            return value;
+        }
+
+        inline uint32_t hash(uint32_t sequence) {
+            return (sequence * 2654435761u) >> (32 - hash_bits);
+        }
+
+        inline void write_length(std::string& out, size_t length) {
+            for (; length >= 255; length -= 255) {
+                out.push_back(char(255));
+            }
+            out.push_back(char(length));
+        }
+
+        inline void write_sequence(std::string& out, const uint8_t *literals, size_t literalCount, size_t offset, size_t matchLength) {
+            const size_t tokenPos = out.size();
+            out.push_back(0);
+
+            uint8_t token = uint8_t(std::min<size_t>(literalCount, 15) << 4);
+            if (literalCount >= 15) {
+                write_length(out, literalCount - 15);
+            }
+            out.append(reinterpret_cast<const char *>(literals), literalCount);
+
+            if (matchLength != 0) {
+                out.push_back(char(offset));
+                out.push_back(char(offset >> 8));
+                const size_t extra = matchLength - min_match;
+                token |= uint8_t(std::min<size_t>(extra, 15));
+                if (extra >= 15) {
+                    write_length(out, extra - 15);
+                }
+            }
+            out[tokenPos] = char(token);
+        }
+
+        // reads the extra length bytes which follow 15 in a token. Returns false if the data ends too early
+        inline bool read_length(const uint8_t *& ip, const uint8_t *end, size_t& length) {
+            uint8_t next;
+            do {
+                if (ip == end) {
+                    return false;
+                }
+                next = *ip++;
+                length += next;
+            } while (next == 255);
+            return true;
+        }
+    }
+
+    inline size_t max_compressed_size(size_t size) {
+        return size + size / 255 + 16;
+    }
+
+    // Appends the compressed @size bytes at @src to @out
+    inline void compress_block(const char *src, size_t size, std::string& out, int level = min_level) {
+        using namespace detail;
+
+        const uint8_t *const in = reinterpret_cast<const uint8_t *>(src);
+        out.reserve(out.size() + max_compressed_size(size));
+
+        size_t anchor = 0;
+        if (size > match_start_limit) {
+            const size_t matchStartLimit = size - match_start_limit;
+            const size_t matchEndLimit = size - last_literals;
+            const uint32_t maxAttempts = 1u << (std::min(std::max(level, int(min_level)), int(max_level)) - 1);
+
+            // the most recent position of each hash, and the distance to the previous position with the same hash
+            std::vector<int32_t> head(size_t(1) << hash_bits, -1);
+            std::vector<uint16_t> chain(window_size, 0);
+
+            auto insert = [&](size_t pos) {
+                int32_t& last = head[hash(read32(in + pos))];
+                chain[pos & (window_size - 1)] = uint16_t(last < 0 || pos - last > max_offset ? 0 : pos - last);
+                last = int32_t(pos);
+            };
+
+            size_t pos = 0;
+            while (pos < matchStartLimit) {
+                const uint32_t sequence = read32(in + pos);
+                size_t bestLength = 0, bestOffset = 0;
+
+                int32_t candidate = head[hash(sequence)];
+                for (uint32_t attempts = maxAttempts; candidate >= 0 && pos - candidate <= max_offset && attempts > 0; --attempts) {
+                    if (read32(in + candidate) == sequence) {
+                        const uint8_t *l = in + candidate + min_match, *r = in + pos + min_match;
+                        while (r < in + matchEndLimit && *l == *r) {
+                            ++l;
+                            ++r;
+                        }
+                        const size_t length = r - (in + pos);
+                        if (length > bestLength) {
+                            bestLength = length;
+                            bestOffset = pos - candidate;
+                        }
+                    }
+                    const uint16_t delta = chain[candidate & (window_size - 1)];
+                    if (delta == 0) {
+                        break;
+                    }
+                    candidate -= delta;
+                }
+                insert(pos);
+
+                if (bestLength < min_match) {
+                    ++pos;
+                    continue;
+                }
+
+                write_sequence(out, in + anchor, pos - anchor, bestOffset, bestLength);
+                const size_t matchEnd = pos + bestLength;
+                for (++pos; pos < matchEnd && pos < matchStartLimit; ++pos) {
+                    insert(pos);
+                }
+                pos = anchor = matchEnd;
+            }
+        }
+
+        write_sequence(out, in + anchor, size - anchor, 0, 0);
+    }
+
+    // Decompresses exactly @dstSize bytes. Returns false if the data is malformed or doesn't decompress to @dstSize bytes
+    inline bool decompress_block(const char *src, size_t size, char *dst, size_t dstSize) {
+        const uint8_t *ip = reinterpret_cast<const uint8_t *>(src);
+        const uint8_t *const end = ip + size;
+        uint8_t *const out = reinterpret_cast<uint8_t *>(dst);
+        size_t op = 0;
+
+        for (;;) {
+            if (ip == end) {
+                return false;
+            }
+            const uint8_t token = *ip++;
+
+            size_t literalCount = token >> 4;
+            if (literalCount == 15 && !detail::read_length(ip, end, literalCount)) {
+                return false;
+            }
+            if (literalCount > size_t(end - ip) || literalCount > dstSize - op) {
+                return false;
+            }
+            memcpy(out + op, ip, literalCount);
+            ip += literalCount;
+            op += literalCount;
+
+            if (ip == end) { // the last sequence has no match
+                return op == dstSize;
+            }
+            if (end - ip < 2) {
+                return false;
+            }
+            const size_t offset = size_t(ip[0]) | size_t(ip[1]) << 8;
+            ip += 2;
+            if (offset == 0 || offset > op) {
+                return false;
+            }
+
+            size_t matchLength = token & 15;
+            if (matchLength == 15 && !detail::read_length(ip, end, matchLength)) {
+                return false;
+            }
+            matchLength += min_match;
+            if (matchLength > dstSize - op) {
+                return false;
+            }
+
+            const uint8_t *match = out + op - offset;
+            if (offset >= matchLength) {
+                memcpy(out + op, match, matchLength);
+            }
+            else { // overlapping copy repeats the last @offset bytes
+                for (size_t i = 0; i < matchLength; ++i) {
+                    out[op + i] = match[i];
+                }
+            }
+            op += matchLength;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+
+    // Framed stream: independent blocks of up to 1 MB, each prefixed with its decompressed and stored sizes (4 bytes LE each).
+    // A block that doesn't shrink is stored as is (stored size equals decompressed size)
+
+    enum : size_t { frame_block_size = 1 << 20 };
+
+    namespace detail {
+        template<class Stream>
+        inline void write32(Stream& stream, uint32_t value) {
+            const char bytes[4] = { char(value), char(value >> 8), char(value >> 16), char(value >> 24) };
+            stream.write(bytes, sizeof bytes);
+        }
+
+        inline uint32_t read32le(const char *p) {
+            const auto b = reinterpret_cast<const uint8_t *>(p);
+            return uint32_t(b[0]) | uint32_t(b[1]) << 8 | uint32_t(b[2]) << 16 | uint32_t(b[3]) << 24;
+        }
+    }
+
+    // Compresses and writes @data block by block, so that at most one compressed block is kept in memory.
+    // @stream is std::ostream or anything else with the same write(data, size)
+    template<class Stream>
+    inline void write_frames(Stream& stream, std::string_view data, int level = min_level) {
+        std::string compressed;
+        for (size_t offset = 0; offset < data.size(); offset += frame_block_size) {
+            const size_t blockSize = std::min<size_t>(frame_block_size, data.size() - offset);
+            compressed.clear();
+            compress_block(data.data() + offset, blockSize, compressed, level);
+
+            const bool stored = compressed.size() >= blockSize;
+            detail::write32(stream, uint32_t(blockSize));
+            detail::write32(stream, uint32_t(stored ? blockSize : compressed.size()));
+            if (stored) {
+                stream.write(data.data() + offset, blockSize);
+            }
+            else {
+                stream.write(compressed.data(), compressed.size());
+            }
+        }
+    }
+
+    // Returns false if @frames are malformed
+    inline bool read_frames(std::string_view frames, std::string& out) {
+        out.clear();
+        while (!frames.empty()) {
+            if (frames.size() < 8) {
+                return false;
+            }
+            const uint32_t blockSize = detail::read32le(frames.data());
+            const uint32_t storedSize = detail::read32le(frames.data() + 4);
+            frames.remove_prefix(8);
+            if (blockSize == 0 || blockSize > frame_block_size || storedSize > blockSize || storedSize > frames.size()) {
+                return false;
+            }
+
+            const size_t offset = out.size();
+            out.resize(offset + blockSize);
+            if (storedSize == blockSize) {
+                memcpy(&out[offset], frames.data(), blockSize);
+            }
+            else if (!decompress_block(frames.data(), storedSize, &out[offset], blockSize)) {
+                return false;
+            }
+            frames.remove_prefix(storedSize);
+        }
+        return true;
+    }
+}}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace util {
+
+    // Maps a number to an unsigned key, preserving number's order
+    template<class T>
+    inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value && sizeof(T) == 4, uint32_t>::type
+        radix_key(T value)
+    {
+        return static_cast<uint32_t>(value) ^ 0x80000000u;
+    }
+
+    inline uint32_t radix_key(float value) {
+        uint32_t bits;
+        static_assert(sizeof bits == sizeof value, "unexpected float size");
+        memcpy(&bits, &value, sizeof bits);
+        // negative numbers: flip all bits, positive ones: flip the sign bit only
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+
+    // Stable LSD radix sort, 8 bits per pass. @key maps a value to uint32_t
+    // Passes where all keys share the same byte are skipped
+    template<class T, class KeyFunc>
+    void radix_sort(std::vector<T>& values, KeyFunc&& key) {
+        const size_t count = values.size();
+        if (count < 2) {
+            return;
+        }
+
+        std::vector<uint32_t> keys(count);
+        size_t histogram[4][256] = {};
+
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t k = key(values[i]);
+            keys[i] = k;
+            for (int pass = 0; pass < 4; ++pass) {
+                ++histogram[pass][(k >> (pass * 8)) & 0xFF];
+            }
+        }
+
+        std::vector<T> valuesTmp(count);
+        std::vector<uint32_t> keysTmp(count);
+
+        for (int pass = 0; pass < 4; ++pass) {
+            auto& hist = histogram[pass];
+            const int shift = pass * 8;
+
+            if (hist[keys[0] >> shift & 0xFF] == count) {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (auto& bucket : hist) {
+                size_t c = bucket;
+                bucket = offset;
+                offset += c;
+            }
+
+            for (size_t i = 0; i < count; ++i) {
+                const size_t dest = hist[keys[i] >> shift & 0xFF]++;
+                keysTmp[dest] = keys[i];
+                valuesTmp[dest] = std::move(values[i]);
+            }
+
+            keys.swap(keysTmp);
+            values.swap(valuesTmp);
+        }
+    }
+
+    template<class T>
+    void radix_sort(std::vector<T>& values) {
+        radix_sort(values, [](const T& v) { return radix_key(v); });
+    }
+}
@@ -0,0 +1,371 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+namespace util {
+
+    // Block-oriented I/O of save records: SKSE co-save records, files or memory. The reader and the writer keep
+    // one large buffer for small reads and writes, the larger ones go directly from and to the caller's memory
+
+    class record_sink {
+    public:
+        virtual ~record_sink() {}
+        virtual void write(const char *data, size_t size) = 0;
+    };
+
+    class record_source {
+    public:
+        virtual ~record_source() {}
+        // returns less than @size only at the end of the data
+        virtual size_t read(char *buffer, size_t size) = 0;
+        // the number of bytes left, if known, otherwise 0
+        virtual size_t remaining_hint() const { return 0; }
+    };
+
+    enum : size_t { record_buffer_size = 1 << 20 };
+
+    //////////////////////////////////////////////////////////////////////////
+
+    class record_writer {
+        record_sink& _sink;
+        std::unique_ptr<char[]> _buffer;
+        size_t _capacity;
+        size_t _used = 0;
+        uint64_t _written = 0;
+
+    public:
+
+        explicit record_writer(record_sink& sink, size_t bufferSize = record_buffer_size)
+            : _sink(sink), _buffer(new char[bufferSize]), _capacity(bufferSize) {}
+
+        record_writer(const record_writer&) = delete;
+        record_writer& operator = (const record_writer&) = delete;
+
+        void write(const char *data, size_t size) {
+            _written += size;
+            if (size <= _capacity - _used) {
+                memcpy(_buffer.get() + _used, data, size);
+                _used += size;
+                return;
+            }
+            flush();
+            if (size >= _capacity) {
+                _sink.write(data, size);
+            }
+            else {
+                memcpy(_buffer.get(), data, size);
+                _used = size;
+            }
+        }
+
+        void write(std::string_view data) {
+            write(data.data(), data.size());
+        }
+
+        void put(char c) {
+            if (_used == _capacity) {
+                flush();
+            }
+            _buffer[_used++] = c;
+            ++_written;
+        }
+
+        // the writer isn't flushed on destruction, as the sink may throw
+        void flush() {
+            if (_used > 0) {
+                _sink.write(_buffer.get(), _used);
+                _used = 0;
+            }
+        }
+
+        // the number of bytes written so far, flushed or not
+        uint64_t written() const { return _written; }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+
+    class record_reader {
+        record_source& _source;
+        std::unique_ptr<char[]> _buffer;
+        size_t _capacity;
+        size_t _position = 0;
+        size_t _end = 0;
+        bool _exhausted = false;
+
+        bool fill() {
+            if (_exhausted) {
+                return false;
+            }
+            _position = 0;
+            _end = _source.read(_buffer.get(), _capacity);
+            _exhausted = _end < _capacity;
+            return _end > 0;
+        }
+
+    public:
+
+        explicit record_reader(record_source& source, size_t bufferSize = record_buffer_size)
+            : _source(source), _buffer(new char[bufferSize]), _capacity(bufferSize) {}
+
+        record_reader(const record_reader&) = delete;
+        record_reader& operator = (const record_reader&) = delete;
+
+        // the next byte, or -1 at the end
+        int peek() {
+            if (_position == _end && !fill()) {
+                return -1;
+            }
+            return static_cast<unsigned char>(_buffer[_position]);
+        }
+
+        int get() {
+            const int c = peek();
+            if (c >= 0) {
+                ++_position;
+            }
+            return c;
+        }
+
+        bool at_end() {
+            return peek() < 0;
+        }
+
+        // returns less than @size only at the end of the data
+        size_t read(char *data, size_t size) {
+            size_t done = (std::min)(size, _end - _position);
+            memcpy(data, _buffer.get() + _position, done);
+            _position += done;
+
+            while (done < size && !_exhausted) {
+                const size_t left = size - done;
+                if (left >= _capacity) {
+                    const size_t got = _source.read(data + done, left);
+                    _exhausted = got < left;
+                    done += got;
+                }
+                else if (fill()) {
+                    const size_t chunk = (std::min)(left, _end);
+                    memcpy(data + done, _buffer.get(), chunk);
+                    _position = chunk;
+                    done += chunk;
+                }
+            }
+            return done;
+        }
+
+        // appends the rest of the data to @out. If the source knows how much is left, the data is read directly into @out
+        void read_rest(std::string& out) {
+            out.append(_buffer.get() + _position, _end - _position);
+            _position = _end;
+            if (const size_t hint = _exhausted ? 0 : _source.remaining_hint()) {
+                out.reserve(out.size() + hint);
+            }
+
+            while (!_exhausted) {
+                const size_t offset = out.size();
+                const size_t room = out.capacity() - offset;
+                if (room >= _capacity) {
+                    out.resize(offset + room);
+                    const size_t got = _source.read(&out[offset], room);
+                    out.resize(offset + got);
+                    _exhausted = got < room;
+                }
+                else if (fill()) {
+                    out.append(_buffer.get(), _end);
+                    _position = _end;
+                }
+            }
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+
+    // std::streambuf over a reader or a writer, for the readers and writers which need std::istream or std::ostream:
+    // boost archives. Reading through it may consume more than is read through it
+    class record_streambuf : public std::streambuf {
+        record_reader *_reader = nullptr;
+        record_writer *_writer = nullptr;
+        char _buffer[64 * 1024];
+
+    public:
+
+        explicit record_streambuf(record_reader& reader) : _reader(&reader) {}
+        explicit record_streambuf(record_writer& writer) : _writer(&writer) {}
+
+    protected:
+
+        int_type underflow() override {
+            if (!_reader) {
+                return traits_type::eof();
+            }
+            const size_t got = _reader->read(_buffer, sizeof _buffer);
+            if (got == 0) {
+                return traits_type::eof();
+            }
+            setg(_buffer, _buffer, _buffer + got);
+            return traits_type::to_int_type(_buffer[0]);
+        }
+
+        std::streamsize xsgetn(char *data, std::streamsize size) override {
+            std::streamsize done = (std::min)(size, static_cast<std::streamsize>(egptr() - gptr()));
+            if (done > 0) {
+                memcpy(data, gptr(), static_cast<size_t>(done));
+                gbump(static_cast<int>(done));
+            }
+            if (done < size && _reader) {
+                done += _reader->read(data + done, static_cast<size_t>(size - done));
+            }
+            return done;
+        }
+
+        int_type overflow(int_type c) override {
+            if (!_writer || traits_type::eq_int_type(c, traits_type::eof())) {
+                return traits_type::not_eof(c);
+            }
+            _writer->put(traits_type::to_char_type(c));
+            return c;
+        }
+
+        std::streamsize xsputn(const char *data, std::streamsize size) override {
+            if (!_writer) {
+                return 0;
+            }
+            _writer->write(data, static_cast<size_t>(size));
+            return size;
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+
+    // An unsigned decimal number the way std::istream's operator >> reads it: leading whitespace gets skipped,
+    // the first non-digit is not consumed. Returns false if there are no digits or the number is too large
+    inline bool read_decimal(record_reader& in, uint32_t& value) {
+        while (in.peek() == ' ' || (in.peek() >= '\t' && in.peek() <= '\r')) {
+            in.get();
+        }
+        uint64_t number = 0;
+        bool digits = false;
+        for (int c = in.peek(); c >= '0' && c <= '9'; c = in.peek()) {
+            number = number * 10 + (c - '0');
+            if (number > UINT32_MAX) {
+                return false;
+            }
+            digits = true;
+            in.get();
+        }
+        value = static_cast<uint32_t>(number);
+        return digits;
+    }
+
+    inline void write_decimal(record_writer& out, uint32_t value) {
+        char digits[10];
+        size_t count = 0;
+        do {
+            digits[sizeof digits - ++count] = char('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        out.write(digits + sizeof digits - count, count);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+
+    class memory_record_source : public record_source {
+        std::string_view _data;
+    public:
+        explicit memory_record_source(std::string_view data) : _data(data) {}
+
+        size_t read(char *buffer, size_t size) override {
+            size = (std::min)(size, _data.size());
+            memcpy(buffer, _data.data(), size);
+            _data.remove_prefix(size);
+            return size;
+        }
+
+        size_t remaining_hint() const override { return _data.size(); }
+    };
+
+    class string_record_sink : public record_sink {
+        std::string& _data;
+    public:
+        explicit string_record_sink(std::string& data) : _data(data) {}
+
+        void write(const char *data, size_t size) override {
+            _data.append(data, size);
+        }
+    };
+
+    class stream_record_source : public record_source {
+        std::istream& _stream;
+    public:
+        explicit stream_record_source(std::istream& stream) : _stream(stream) {}
+
+        size_t read(char *buffer, size_t size) override {
+            return static_cast<size_t>(_stream.rdbuf()->sgetn(buffer, static_cast<std::streamsize>(size)));
+        }
+    };
+
+    class stream_record_sink : public record_sink {
+        std::ostream& _stream;
+    public:
+        explicit stream_record_sink(std::ostream& stream) : _stream(stream) {}
+
+        void write(const char *data, size_t size) override {
+            _stream.write(data, static_cast<std::streamsize>(size));
+        }
+    };
+
+    // Files, opened unbuffered - the reader and the writer buffer. Check is_open() before use
+    class file_record_source : public record_source {
+        FILE *_file = nullptr;
+    public:
+        explicit file_record_source(const char *path) {
+            if (fopen_s(&_file, path, "rb") == 0) {
+                setvbuf(_file, nullptr, _IONBF, 0);
+            }
+        }
+        ~file_record_source() {
+            if (_file) {
+                fclose(_file);
+            }
+        }
+
+        bool is_open() const { return _file != nullptr; }
+
+        size_t read(char *buffer, size_t size) override {
+            return _file ? fread(buffer, 1, size, _file) : 0;
+        }
+    };
+
+    class file_record_sink : public record_sink {
+        FILE *_file = nullptr;
+        bool _failed = false;
+    public:
+        explicit file_record_sink(const char *path) {
+            if (fopen_s(&_file, path, "wb") == 0) {
+                setvbuf(_file, nullptr, _IONBF, 0);
+            }
+        }
+        ~file_record_sink() {
+            if (_file) {
+                fclose(_file);
+            }
+        }
+
+        bool is_open() const { return _file != nullptr; }
+        // true if a write has failed
+        bool failed() const { return _failed || !_file; }
+
+        void write(const char *data, size_t size) override {
+            _failed |= !_file || fwrite(data, 1, size, _file) != size;
+        }
+    };
+}
@@ -1,5 +1,6 @@
 #include <boost/filesystem/path.hpp>
 #include <windef.h>
+#include <psapi.h>
 
 namespace util {
 
@@ -22,6 +23,11 @@ namespace util {
         auto imagePath = dll_path();
         return (imagePath.remove_filename() /= relative_path);
     }
+
+    size_t peak_memory_usage() {
+        PROCESS_MEMORY_COUNTERS counters = { sizeof(counters) };
+        return K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+    }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -14,6 +14,9 @@ namespace util {
     boost::filesystem::path dll_path();
     boost::filesystem::path relative_to_dll_path(const char *relative_path);
 
+    // peak working set size of the process, in bytes
+    size_t peak_memory_usage();
+
     template<class T>
     void do_with_timing(const char *operation_name, T&& func) {
         assert(operation_name);
@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""
+Inspects JContainers save data outside the game: object counts by type, size histograms, largest subtrees,
+tag usage and garbage, optionally exports each domain's JDB to JSON and measures save/load throughput.
+
+The record is the data JContainers writes into a co-save, dumped into a file as it is.
+"""
+import argparse
+import ctypes
+import json
+import os
+import sys
+import tempfile
+
+#------------------------------------------------------------------------------
+
+def inspect (dll, args):
+    lib = ctypes.CDLL (dll)
+    lib.JC_inspectSave.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p,
+                                   ctypes.c_uint, ctypes.c_uint]
+    lib.JC_inspectSave.restype = ctypes.c_bool
+
+    report_path = args.report or os.path.join (tempfile.mkdtemp (), 'report.json')
+    optional = lambda s: s.encode ('utf-8') if s else None
+
+    if not lib.JC_inspectSave (args.record.encode ('utf-8'), report_path.encode ('utf-8'),
+                               optional (args.export), optional (args.delta_saves), args.round_trips, args.top):
+        return None
+
+    with open (report_path) as f:
+        return json.load (f)
+
+#------------------------------------------------------------------------------
+
+def print_report (report):
+    print ("Record: %s, %d bytes" % (report['record'], report['recordBytes']))
+    print ("Garbage collected on load: %d objects" % report['garbageObjects'])
+
+    for domain in report['domains']:
+        print ()
+        print ("Domain: %s, %d objects" % (domain['name'] or '<default>', domain['objects']))
+
+        for name, stats in sorted (domain['types'].items ()):
+            print ("  %-10s %8d objects %10d elements" % (name, stats['objects'], stats['elements']))
+            histogram = sorted (stats['sizeHistogram'].items (), key = lambda pair: int (pair[0].split ('-')[0]))
+            print ("             sizes: " + ", ".join ("%s: %d" % pair for pair in histogram))
+
+        if domain['tags']:
+            print ("  tags:")
+            for tag, count in sorted (domain['tags'].items (), key = lambda pair: -pair[1]):
+                print ("    %-30s %d" % (tag, count))
+
+        if domain['largestSubtrees']:
+            print ("  largest subtrees:")
+            for tree in domain['largestSubtrees']:
+                print ("    id %-10d %-10s %8d objects %10d elements %s" % (tree['id'], tree['type'],
+                    tree['objects'], tree['elements'], tree['tag']))
+
+        if 'exported' in domain:
+            print ("  exported:", domain['exported'])
+
+    trips = report.get ('roundTrips')
+    if trips:
+        print ()
+        print ("Round trips: %d, %d bytes" % (trips['count'], trips['bytes']))
+        print ("  save %.2f ms, %.1f MB/s" % (trips['saveMs'], trips['saveMBps']))
+        print ("  load %.2f ms, %.1f MB/s" % (trips['loadMs'], trips['loadMBps']))
+
+    for operation in ('save', 'load'):
+        profile = report['profiles'].get (operation)
+        if profile:
+            print ()
+            print ("Last %s: %.2f ms" % (operation, profile['wallMs']))
+            for phase, ms in profile['phasesMs'].items ():
+                if ms > 0:
+                    print ("  %-20s %10.2f ms" % (phase, ms))
+
+#------------------------------------------------------------------------------
+
+if __name__ == '__main__':
+
+    parser = argparse.ArgumentParser (description = __doc__, formatter_class = argparse.RawDescriptionHelpFormatter)
+    parser.add_argument ('dll', help = "JContainers DLL filepath")
+    parser.add_argument ('record', help = "dumped JContainers co-save record")
+    parser.add_argument ('--report', help = "where the JSON report goes, it's printed only if not set")
+    parser.add_argument ('--export', help = "exports each domain's JDB as JSON into this directory")
+    parser.add_argument ('--delta-saves', help = "the directory of the base snapshots, if the record is a delta save")
+    parser.add_argument ('--round-trips', type = int, default = 0, help = "save/load round trips to measure the throughput")
+    parser.add_argument ('--top', type = int, default = 10, help = "the number of the largest subtrees per domain")
+    args = parser.parse_args ()
+
+    report = inspect (args.dll, args)
+    if report is None:
+        print ("Unable to inspect", args.record)
+        sys.exit (1)
+    print_report (report)
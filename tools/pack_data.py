@@ -0,0 +1,28 @@
+#!/usr/bin/env python3
+import sys
+import ctypes
+
+# Packs JSON files into read-only data packs, see JDataPack
+
+if __name__ == '__main__':
+
+    if len (sys.argv) < 4 or len (sys.argv) % 2 != 0:
+        print("Usage: pack_data.py <JContainers DLL filepath> <JSON file> <pack file> [<JSON file> <pack file> ...]")
+        sys.exit(1)
+
+    errors = 0
+    try:
+        lib = ctypes.cdll.LoadLibrary(sys.argv[1])
+        lib.JC_packDataFile.argtypes = [ctypes.c_char_p, ctypes.c_char_p]
+        lib.JC_packDataFile.restype = ctypes.c_bool
+
+        for json_path, pack_path in zip(sys.argv[2::2], sys.argv[3::2]):
+            if lib.JC_packDataFile(json_path.encode('utf-8'), pack_path.encode('utf-8')):
+                print("Packed:", json_path, "->", pack_path)
+            else:
+                print("Failed to pack:", json_path)
+                errors += 1
+    except BaseException as e:
+        print("Error:", e)
+        errors += 1
+    sys.exit (errors)